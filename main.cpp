@@ -2,19 +2,65 @@
 #include "src/scenes/Basic.hpp"
 // #include "src/scenes/Chair.hpp"
 
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
-int main(int, char**) {
+int main(int argc, char** argv) {
+    int simulationHz = 0;
+    const char* telemetryPath = nullptr;
+    float hitchMultiple = 2.5f;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--bench-jobs") == 0) {
+            RunJobSystemBenchmark();
+            return 0;
+        }
+        if (std::strcmp(argv[i], "--bench-math") == 0) {
+            const bool ok = RunMathSelfCheck();
+            if (ok) {
+                RunMathBenchmark();
+            }
+            return ok ? 0 : 1;
+        }
+        if (std::strcmp(argv[i], "--test-graph") == 0) {
+            return RunGraphSelfCheck() ? 0 : 1;
+        }
+        if (std::strcmp(argv[i], "--bench-occlusion") == 0) {
+            RunOcclusionBenchmark();
+            return 0;
+        }
+        if (std::strcmp(argv[i], "--sim-hz") == 0 && i + 1 < argc) {
+            simulationHz = std::atoi(argv[++i]);
+        }
+        if (std::strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc) {
+            telemetryPath = argv[++i];
+        }
+        if (std::strcmp(argv[i], "--hitch-multiple") == 0 && i + 1 < argc) {
+            hitchMultiple = (float)std::atof(argv[++i]);
+        }
+        if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            Profiler::beginCapture((uint32_t)std::atoi(argv[++i]),
+                                   "evergreen-trace.json");
+        }
+    }
+
     Engine engine;
     if (!engine.init()) {
         return 1;
     }
 
-    engine.loadScene(LoadScene(engine.renderer()));
+    if (simulationHz > 0) {
+        engine.setSimulationRate((uint32_t)simulationHz);
+    }
+    if (telemetryPath) {
+        engine.enableTelemetry(telemetryPath, hitchMultiple);
+    }
+
+    engine.loadScene(LoadScene(engine.renderer(), engine.jobs()));
 
     engine.run();
 
-    // LoadScene(engine.renderer());
+    // LoadScene(engine.renderer(), engine.jobs());
 
     return 0;
 }
@@ -0,0 +1,88 @@
+// Clustered forward lighting, shared by cluster_cull.comp and the shading
+// fragment shaders. Define LIGHTING_SET and LIGHTING_BUFFER_ACCESS before
+// including (fragment stages must declare the buffers readonly).
+
+const uint kMaxLightsPerCluster = 128;
+
+const uint kPointLight = 0;
+const uint kSpotLight = 1;
+
+struct Light {
+    vec4 positionRange;  // xyz world position, w range
+    vec4 colorIntensity; // rgb color, a intensity
+    vec4 directionType;  // xyz spot direction, w type
+    vec4 spotAngles;     // x cos(inner), y cos(outer)
+};
+
+layout(std140, set = LIGHTING_SET, binding = 0) uniform ClusterParams {
+    mat4 view;
+    mat4 invProj;
+    vec4 screen; // width, height, 1/width, 1/height
+    vec4 depth;  // near, far, log(far/near), unused
+    uvec4 grid;  // x, y, z slices, light count
+} clusters;
+
+layout(std430, set = LIGHTING_SET, binding = 1) LIGHTING_BUFFER_ACCESS buffer Lights {
+    Light lights[];
+};
+
+layout(std430, set = LIGHTING_SET, binding = 2) LIGHTING_BUFFER_ACCESS buffer ClusterCounts {
+    uint clusterLightCounts[];
+};
+
+layout(std430, set = LIGHTING_SET, binding = 3) LIGHTING_BUFFER_ACCESS buffer ClusterIndices {
+    uint clusterLightIndices[];
+};
+
+uint clusterIndex(vec2 fragCoord, vec3 worldPos) {
+    float viewDepth = -(clusters.view * vec4(worldPos, 1.0)).z;
+
+    uvec2 tile = uvec2(fragCoord * clusters.screen.zw * vec2(clusters.grid.xy));
+    tile = min(tile, clusters.grid.xy - 1u);
+
+    // Exponential slices: slice = log(z / near) / log(far / near) * slices.
+    float slice = log(max(viewDepth, clusters.depth.x) / clusters.depth.x) /
+                  clusters.depth.z * float(clusters.grid.z);
+    uint z = uint(clamp(slice, 0.0, float(clusters.grid.z - 1u)));
+
+    return tile.x + tile.y * clusters.grid.x +
+           z * clusters.grid.x * clusters.grid.y;
+}
+
+// Diffuse contribution of every light binned into the fragment's cluster.
+vec3 clusterLighting(vec2 fragCoord, vec3 worldPos, vec3 N) {
+    uint cluster = clusterIndex(fragCoord, worldPos);
+    uint count = clusterLightCounts[cluster];
+    uint base = cluster * kMaxLightsPerCluster;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < count; ++i) {
+        Light light = lights[clusterLightIndices[base + i]];
+
+        vec3 toLight = light.positionRange.xyz - worldPos;
+        float dist = length(toLight);
+        float range = light.positionRange.w;
+        if (dist >= range) {
+            continue;
+        }
+
+        vec3 L = toLight / max(dist, 1e-4);
+
+        // Smooth windowed inverse-square falloff that reaches 0 at range.
+        float ratio = dist / range;
+        float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+        float attenuation = window * window / (dist * dist + 1.0);
+
+        if (uint(light.directionType.w) == kSpotLight) {
+            float cosAngle = dot(-L, light.directionType.xyz);
+            attenuation *= smoothstep(light.spotAngles.y, light.spotAngles.x,
+                                      cosAngle);
+        }
+
+        float ndotl = max(dot(N, L), 0.0);
+        result += light.colorIntensity.rgb * light.colorIntensity.a *
+                  attenuation * ndotl;
+    }
+
+    return result;
+}
@@ -0,0 +1,24 @@
+#version 450
+
+// Position-only vertex shader for the depth pre-pass. Must produce exactly the
+// same gl_Position as test.vert so the shading subpass can test EQUAL.
+
+layout(location = 0) in vec3 inPos;
+
+layout(set = 0, binding = 0) uniform CameraUBO {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    vec3 eye;
+} ubo;
+
+layout(push_constant) uniform Push {
+    mat4 model;
+} pc;
+
+invariant gl_Position;
+
+void main() {
+    vec4 worldPos = pc.model * vec4(inPos, 1.0);
+    gl_Position = ubo.viewProj * worldPos;
+}
@@ -0,0 +1,11 @@
+// Screen-space motion for TAA: current (unjittered) UV minus the UV the same
+// world position had last frame. Written to color attachment 1 in TAA mode;
+// without a second attachment the write is discarded.
+
+vec2 motionVector(vec3 worldPos, vec2 fragCoord, vec2 invScreen,
+                  mat4 prevViewProj, vec4 jitter) {
+    vec4 prevClip = prevViewProj * vec4(worldPos, 1.0);
+    vec2 prevUV = prevClip.xy / prevClip.w * 0.5 + 0.5;
+    vec2 currentUV = fragCoord * invScreen - jitter.xy * 0.5;
+    return currentUV - prevUV;
+}
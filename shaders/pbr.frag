@@ -1,27 +1,47 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+
+#define LIGHTING_SET 2
+#define LIGHTING_BUFFER_ACCESS readonly
+#include "clusters.glsl"
+
+#define SHADOW_SET 3
+#include "shadows.glsl"
+
+#include "motion.glsl"
 
 layout(set = 0, binding = 0) uniform CameraUBO {
   mat4 view;
   mat4 proj;
   mat4 viewProj;
   vec4 viewPos;
+  mat4 prevViewProj;
+  vec4 jitter;
 } ubo;
 
 layout(location = 0) in vec3 vNormal;
 layout(location = 1) in vec2 vUV;
+layout(location = 2) in vec3 vWorldPos;
 
 layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec2 outMotion;
 
 // Placeholder "PBR".
 // Replace this with your proper IBL BRDF + texture bindings.
 
 void main() {
   vec3 N = normalize(vNormal);
-  vec3 L = normalize(vec3(0.3, 0.7, 0.6));
+  vec3 L = -normalize(shadow.lightDir.xyz);
   float ndotl = max(dot(N, L), 0.0);
 
+  float viewDepth = -(clusters.view * vec4(vWorldPos, 1.0)).z;
+  ndotl *= shadowFactor(vWorldPos, viewDepth);
+
   vec3 base = vec3(vUV, 1.0);
   vec3 color = base * (0.15 + 0.85 * ndotl);
+  color += base * clusterLighting(gl_FragCoord.xy, vWorldPos, N);
 
   outColor = vec4(color, 1.0);
+  outMotion = motionVector(vWorldPos, gl_FragCoord.xy, clusters.screen.zw,
+                           ubo.prevViewProj, ubo.jitter);
 }
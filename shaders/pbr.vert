@@ -17,10 +17,12 @@ layout(location = 2) in vec2 inUV;
 
 layout(location = 0) out vec3 vNormal;
 layout(location = 1) out vec2 vUV;
+layout(location = 2) out vec3 vWorldPos;
 
 void main() {
   mat4 mvp = ubo.viewProj * push.model;
   gl_Position = mvp * vec4(inPos, 1.0);
   vNormal = mat3(push.model) * inNormal;
   vUV = inUV;
+  vWorldPos = (push.model * vec4(inPos, 1.0)).xyz;
 }
@@ -0,0 +1,48 @@
+// Programmable vertex pulling: vertices and indices are fetched from the
+// scene GeometryBuffer (set 1) using gl_VertexIndex, which starts at the
+// mesh's firstIndex, and gl_InstanceIndex, which picks the draw record.
+// Shared by pull.vert and shadow_pull.vert.
+
+layout(std430, set = 1, binding = 0) readonly buffer Vertices {
+    float vertices[];
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer Indices {
+    uint indices[];
+};
+
+// One record per draw, selected by firstInstance (see GeometryBuffer), so
+// a whole draw list is one indirect draw. Matches `PulledDraw` in
+// Geometry.hpp. Attribute slots: 0 position, 1 normal, 2 tangent, 3 uv,
+// 4 color.
+struct PulledDraw {
+    mat4 model;
+    uint vertexOffset;
+    uint vertexStride;
+    int attributeOffsets[5];
+    uint padding;
+};
+
+layout(std430, set = 1, binding = 2) readonly buffer Draws {
+    PulledDraw draws[];
+};
+
+// Only the cascade index is pushed, once per pass; it sits at the end of
+// DrawPush.
+layout(push_constant) uniform Push {
+    layout(offset = 64) uint shadowCascade;
+} pc;
+
+vec3 fetch3(uint base, int offset, vec3 fallback) {
+    if (offset < 0) {
+        return fallback;
+    }
+
+    uint i = base + uint(offset);
+    return vec3(vertices[i], vertices[i + 1], vertices[i + 2]);
+}
+
+uint pulledVertexBase(PulledDraw draw) {
+    uint index = indices[gl_VertexIndex];
+    return draw.vertexOffset + index * draw.vertexStride;
+}
@@ -0,0 +1,36 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// Programmable vertex pulling: no fixed-function vertex input.
+
+#include "pull.glsl"
+
+layout(set = 0, binding = 0) uniform CameraUBO {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    vec3 eye;
+} ubo;
+
+layout(location = 0) out vec3 vNrm;
+layout(location = 1) out vec3 vColor;
+layout(location = 2) out vec3 vWorldPos;
+
+// Also used for the pulled depth pre-pass, which is tested with EQUAL.
+invariant gl_Position;
+
+void main() {
+    PulledDraw draw = draws[gl_InstanceIndex];
+    uint base = pulledVertexBase(draw);
+
+    vec3 inPos = fetch3(base, draw.attributeOffsets[0], vec3(0.0));
+    vec3 inNrm = fetch3(base, draw.attributeOffsets[1], vec3(0.0, 1.0, 0.0));
+    vec3 inColor = fetch3(base, draw.attributeOffsets[4], vec3(1.0));
+
+    vec4 worldPos = draw.model * vec4(inPos, 1.0);
+    gl_Position = ubo.viewProj * worldPos;
+
+    vNrm = mat3(draw.model) * inNrm;
+    vColor = inColor;
+    vWorldPos = worldPos.xyz;
+}
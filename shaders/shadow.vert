@@ -0,0 +1,20 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// Position-only caster for one shadow cascade (selected by push constant).
+
+#define SHADOW_SET 3
+#define SHADOW_CASTER
+#include "shadows.glsl"
+
+layout(location = 0) in vec3 inPos;
+
+layout(push_constant) uniform Push {
+    mat4 model;
+    uint shadowCascade;
+} pc;
+
+void main() {
+    vec4 worldPos = pc.model * vec4(inPos, 1.0);
+    gl_Position = shadow.lightViewProj[pc.shadowCascade] * worldPos;
+}
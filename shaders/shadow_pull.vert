@@ -0,0 +1,18 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// Vertex pulling variant of shadow.vert.
+
+#define SHADOW_SET 3
+#define SHADOW_CASTER
+#include "shadows.glsl"
+#include "pull.glsl"
+
+void main() {
+    PulledDraw draw = draws[gl_InstanceIndex];
+    uint base = pulledVertexBase(draw);
+    vec3 inPos = fetch3(base, draw.attributeOffsets[0], vec3(0.0));
+
+    vec4 worldPos = draw.model * vec4(inPos, 1.0);
+    gl_Position = shadow.lightViewProj[pc.shadowCascade] * worldPos;
+}
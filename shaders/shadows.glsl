@@ -0,0 +1,48 @@
+// Cascaded shadow map for the scene's directional light. Define SHADOW_SET
+// before including; casters also define SHADOW_CASTER (no sampler needed).
+// Must match ShadowParams in src/engine/Shadows.hpp.
+
+#define SHADOW_CASCADE_COUNT 4
+
+layout(std140, set = SHADOW_SET, binding = 0) uniform ShadowParams {
+    mat4 lightViewProj[SHADOW_CASCADE_COUNT];
+    vec4 splits;   // view distance where each cascade ends
+    vec4 lightDir; // xyz direction the light travels
+} shadow;
+
+#ifndef SHADOW_CASTER
+layout(set = SHADOW_SET, binding = 1) uniform sampler2DArrayShadow shadowMap;
+
+uint shadowCascade(float viewDepth) {
+    uint cascade = 0u;
+    for (uint c = 0u; c < SHADOW_CASCADE_COUNT - 1; ++c) {
+        if (viewDepth > shadow.splits[c]) {
+            cascade = c + 1u;
+        }
+    }
+    return cascade;
+}
+
+// 1 = lit, 0 = fully shadowed. 3x3 PCF over hardware 2x2 comparisons.
+float shadowFactor(vec3 worldPos, float viewDepth) {
+    if (viewDepth > shadow.splits[SHADOW_CASCADE_COUNT - 1]) {
+        return 1.0;
+    }
+
+    uint cascade = shadowCascade(viewDepth);
+    vec4 p = shadow.lightViewProj[cascade] * vec4(worldPos, 1.0);
+    vec3 ndc = p.xyz / p.w;
+    vec2 uv = ndc.xy * 0.5 + 0.5;
+
+    vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+
+    float lit = 0.0;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            vec2 offset = vec2(x, y) * texel;
+            lit += texture(shadowMap, vec4(uv + offset, float(cascade), ndc.z));
+        }
+    }
+    return lit / 9.0;
+}
+#endif
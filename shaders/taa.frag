@@ -0,0 +1,62 @@
+#version 450
+
+// Temporal resolve: reproject last frame's history with the motion vectors,
+// clamp it to the current 3x3 neighborhood to reject stale samples, and
+// blend. Writes the new history and the presented image. With dynamic
+// resolution only the top-left params.yz fraction of each image is rendered;
+// vUV and the motion vectors are relative to that region.
+
+layout(set = 0, binding = 0) uniform sampler2D sceneColor;
+layout(set = 0, binding = 1) uniform sampler2D motionVectors;
+layout(set = 0, binding = 2) uniform sampler2D history;
+
+layout(push_constant) uniform Push {
+    vec4 texel;  // 1/width, 1/height, width, height of the images
+    vec4 params; // x history weight (0 = reset), yz rendered uv extent
+} pc;
+
+layout(location = 0) in vec2 vUV;
+
+layout(location = 0) out vec4 outHistory;
+layout(location = 1) out vec4 outColor;
+
+// Keeps image uvs half a texel inside the rendered region so bilinear taps
+// never pick up stale pixels outside it.
+vec2 clampToRegion(vec2 uv) {
+    vec2 halfTexel = 0.5 * pc.texel.xy;
+    return clamp(uv, halfTexel, pc.params.yz - halfTexel);
+}
+
+vec2 regionToImage(vec2 uv) { return clampToRegion(uv * pc.params.yz); }
+
+void main() {
+    vec2 uv = regionToImage(vUV);
+    vec3 current = texture(sceneColor, uv).rgb;
+
+    vec3 neighborhoodMin = current;
+    vec3 neighborhoodMax = current;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            vec2 offset = vec2(x, y) * pc.texel.xy;
+            vec3 c = texture(sceneColor, clampToRegion(uv + offset)).rgb;
+            neighborhoodMin = min(neighborhoodMin, c);
+            neighborhoodMax = max(neighborhoodMax, c);
+        }
+    }
+
+    vec2 previousUV = vUV - texture(motionVectors, uv).xy;
+
+    float weight = pc.params.x;
+    if (any(lessThan(previousUV, vec2(0.0))) ||
+        any(greaterThan(previousUV, vec2(1.0)))) {
+        weight = 0.0;
+    }
+
+    vec3 previous = texture(history, regionToImage(previousUV)).rgb;
+    previous = clamp(previous, neighborhoodMin, neighborhoodMax);
+
+    vec3 result = mix(current, previous, weight);
+
+    outHistory = vec4(result, 1.0);
+    outColor = vec4(result, 1.0);
+}
@@ -1,15 +1,42 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+
+#define LIGHTING_SET 2
+#define LIGHTING_BUFFER_ACCESS readonly
+#include "clusters.glsl"
+
+#define SHADOW_SET 3
+#include "shadows.glsl"
+
+#include "motion.glsl"
+
+layout(set = 0, binding = 0) uniform CameraUBO {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    vec4 viewPos;
+    mat4 prevViewProj;
+    vec4 jitter;
+} ubo;
 
 layout(location = 0) in vec3 vNrm;
 layout(location = 1) in vec3 vColor;
+layout(location = 2) in vec3 vWorldPos;
 
 layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec2 outMotion;
 
 void main() {
     vec3 n = normalize(vNrm);
-    vec3 l = normalize(vec3(-0.3, -1.0, -0.2));
+    vec3 l = normalize(shadow.lightDir.xyz);
     float ndotl = max(dot(n, -l), 0.0);
 
+    float viewDepth = -(clusters.view * vec4(vWorldPos, 1.0)).z;
+    ndotl *= shadowFactor(vWorldPos, viewDepth);
+
     vec3 lit = vColor * (0.15 + 0.85 * ndotl);
+    lit += vColor * clusterLighting(gl_FragCoord.xy, vWorldPos, n);
     outColor = vec4(lit, 1.0);
+    outMotion = motionVector(vWorldPos, gl_FragCoord.xy, clusters.screen.zw,
+                             ubo.prevViewProj, ubo.jitter);
 }
@@ -6,6 +6,7 @@ layout(location = 2) in vec3 inColor;
 
 layout(location = 0) out vec3 vNrm;
 layout(location = 1) out vec3 vColor;
+layout(location = 2) out vec3 vWorldPos;
 
 layout(set = 0, binding = 0) uniform CameraUBO {
     mat4 view;
@@ -18,16 +19,14 @@ layout(push_constant) uniform Push {
     mat4 model;
 } pc;
 
-void main() {
-    // vec4 worldPos = pc.model * vec4(inPos, 1.0);
-    // gl_Position = ubo.viewProj * worldPos;
+// Shared with depth.vert so the depth pre-pass can be tested with EQUAL.
+invariant gl_Position;
 
-    // vNrm = mat3(pc.model) * inNrm;
-    
-    vec4 worldPos = vec4(inPos, 1.0);
+void main() {
+    vec4 worldPos = pc.model * vec4(inPos, 1.0);
     gl_Position = ubo.viewProj * worldPos;
 
-    vNrm = inNrm;
-    
+    vNrm = mat3(pc.model) * inNrm;
     vColor = inColor;
+    vWorldPos = worldPos.xyz;
 }
@@ -0,0 +1,44 @@
+#version 450
+
+// Dynamic resolution upscale: bilinear fetch of the rendered top-left region
+// followed by a contrast-adaptive sharpen that restores some of the detail
+// lost to the lower render scale without ringing on strong edges.
+
+layout(set = 0, binding = 0) uniform sampler2D source;
+
+layout(push_constant) uniform Push {
+    vec4 source; // 1/width, 1/height of the source image
+    vec4 region; // xy rendered uv extent, z sharpness (0..1)
+} pc;
+
+layout(location = 0) in vec2 vUV;
+
+layout(location = 0) out vec4 outColor;
+
+vec3 fetch(vec2 uv) {
+    vec2 halfTexel = 0.5 * pc.source.xy;
+    return texture(source, clamp(uv, halfTexel, pc.region.xy - halfTexel)).rgb;
+}
+
+void main() {
+    vec2 uv = vUV * pc.region.xy;
+
+    vec3 center = fetch(uv);
+    vec3 north = fetch(uv + vec2(0.0, -pc.source.y));
+    vec3 south = fetch(uv + vec2(0.0, pc.source.y));
+    vec3 west = fetch(uv + vec2(-pc.source.x, 0.0));
+    vec3 east = fetch(uv + vec2(pc.source.x, 0.0));
+
+    vec3 minimum = min(center, min(min(north, south), min(west, east)));
+    vec3 maximum = max(center, max(max(north, south), max(west, east)));
+
+    // Less sharpening where the neighborhood already has high contrast.
+    vec3 amount = sqrt(clamp(min(minimum, 2.0 - maximum) / max(maximum, 1e-4),
+                             0.0, 1.0));
+    vec3 lobe = -amount * mix(0.125, 0.2, pc.region.z);
+
+    vec3 result = (center + lobe * (north + south + west + east)) /
+                  (1.0 + 4.0 * lobe);
+
+    outColor = vec4(max(result, vec3(0.0)), 1.0);
+}
@@ -14,6 +14,8 @@
 
 #include <windows.h>
 
+#include "engine/Log.hpp"
+
 #include <algorithm>
 #include <array>
 #include <cstdint>
@@ -82,11 +84,16 @@ static bool CreateBuffer(VkPhysicalDevice physicalDevice, VkDevice device,
   return true;
 }
 
+// Images with TRANSIENT_ATTACHMENT usage prefer LAZILY_ALLOCATED memory,
+// which tile-based GPUs may never back with physical pages; elsewhere they
+// fall back to plain DEVICE_LOCAL memory. outputLazilyAllocated reports which
+// one was used.
 static bool CreateImage2D(VkPhysicalDevice physicalDevice, VkDevice device,
                           VkSampleCountFlagBits sampleCountFlagBits,
                           uint32_t width, uint32_t height, VkFormat format,
                           VkImageUsageFlags imageUsageFlags,
-                          VkImage &outputImage, VkDeviceMemory &outputMemory) {
+                          VkImage &outputImage, VkDeviceMemory &outputMemory,
+                          bool *outputLazilyAllocated = nullptr) {
   VkImageCreateInfo imageCreateInfo{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
   imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
   imageCreateInfo.extent = {width, height, 1};
@@ -106,9 +113,19 @@ static bool CreateImage2D(VkPhysicalDevice physicalDevice, VkDevice device,
 
   VkMemoryRequirements memoryRequirement{};
   vkGetImageMemoryRequirements(device, outputImage, &memoryRequirement);
-  uint32_t memType =
-      FindMemoryType(physicalDevice, memoryRequirement.memoryTypeBits,
-                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  uint32_t memType = UINT32_MAX;
+  bool lazilyAllocated = false;
+  if (imageUsageFlags & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) {
+    memType = FindMemoryType(physicalDevice, memoryRequirement.memoryTypeBits,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                                 VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+    lazilyAllocated = memType != UINT32_MAX;
+  }
+  if (memType == UINT32_MAX) {
+    memType = FindMemoryType(physicalDevice, memoryRequirement.memoryTypeBits,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
   if (memType == UINT32_MAX) {
     return false;
   }
@@ -122,6 +139,10 @@ static bool CreateImage2D(VkPhysicalDevice physicalDevice, VkDevice device,
 
   vkBindImageMemory(device, outputImage, outputMemory, 0);
 
+  if (outputLazilyAllocated) {
+    *outputLazilyAllocated = lazilyAllocated;
+  }
+
   return true;
 }
 
@@ -171,13 +192,18 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(
   (void)debugUtilsMessageTypeFlags;
   (void)userData;
 
-  // Only print warnings/errors by default.
+  // Runs on whichever thread made the call; the logger only queues it.
+  // Verbose and info messages are debug level, so filtered by default.
+  LogLevel level = LogDebug;
   if (debugUtilsMessageSeverityFlagsBits >=
-      VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
-    std::cerr << "[Vulkan] "
-              << (data && data->pMessage ? data->pMessage : "(no message)")
-              << std::endl;
+      VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+    level = LogError;
+  } else if (debugUtilsMessageSeverityFlagsBits >=
+             VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+    level = LogWarning;
   }
+  Log::write(level, "[Vulkan] %s",
+             data && data->pMessage ? data->pMessage : "(no message)");
 
   return VK_FALSE;
 }
@@ -240,10 +266,10 @@ struct SwapchainSupport {
   std::vector<VkPresentModeKHR> presentModes;
 };
 
-static SwapchainSupport QuerySwapchainSupport(VkPhysicalDevice physicalDevice,
-                                              VkSurfaceKHR surface) {
-  SwapchainSupport swapchainSupport{};
-
+// Fills swapchainSupport in place so a kept instance reuses its vectors.
+static void QuerySwapchainSupport(VkPhysicalDevice physicalDevice,
+                                  VkSurfaceKHR surface,
+                                  SwapchainSupport &swapchainSupport) {
   vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface,
                                             &swapchainSupport.caps);
 
@@ -264,8 +290,6 @@ static SwapchainSupport QuerySwapchainSupport(VkPhysicalDevice physicalDevice,
     vkGetPhysicalDeviceSurfacePresentModesKHR(
         physicalDevice, surface, &pCount, swapchainSupport.presentModes.data());
   }
-
-  return swapchainSupport;
 }
 
 static VkSurfaceFormatKHR
@@ -285,12 +309,14 @@ ChooseSurfaceFormat(const std::vector<VkSurfaceFormatKHR> &surfaceFormats) {
              : surfaceFormats[0];
 }
 
+// First of preferred the surface supports; else FIFO (guaranteed).
 static VkPresentModeKHR
-ChoosePresentMode(const std::vector<VkPresentModeKHR> &presentModes) {
-  // Mailbox; else FIFO (guaranteed).
-  for (auto presentMode : presentModes) {
-    if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-      return presentMode;
+ChoosePresentMode(const std::vector<VkPresentModeKHR> &presentModes,
+                  const VkPresentModeKHR *preferred, size_t preferredCount) {
+  for (size_t i = 0; i < preferredCount; ++i) {
+    if (std::find(presentModes.begin(), presentModes.end(), preferred[i]) !=
+        presentModes.end()) {
+      return preferred[i];
     }
   }
 
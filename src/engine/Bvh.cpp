@@ -0,0 +1,746 @@
+#include "Bvh.hpp"
+
+#include "Jobs.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <numeric>
+
+static constexpr uint32_t kNone = UINT32_MAX;
+
+static constexpr uint32_t kBinCount = 16;
+static constexpr uint32_t kMaxLeafItems = 4;
+// Relative to testing one item.
+static constexpr float kTraversalCost = 1.0f;
+// Past this depth nodes split at the median, which bounds the depth (and
+// the traversal stacks) whatever the input.
+static constexpr uint32_t kMaxSahDepth = 48;
+static constexpr uint32_t kStackSize = 128;
+// Nodes with more items than this build their halves as separate jobs.
+static constexpr uint32_t kParallelItems = 2048;
+
+// update() rebuilds once the refitted tree costs this much more than it
+// did when built, or this share of its items came or went.
+static constexpr float kRebuildQuality = 1.5f;
+static constexpr uint32_t kMinLooseItems = 32;
+
+static const Vec3 kEmptyMin{FLT_MAX, FLT_MAX, FLT_MAX};
+static const Vec3 kEmptyMax{-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+static float Component(Vec3 v, int axis) {
+  return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+static void Grow(Vec3 &boundsMin, Vec3 &boundsMax, Vec3 otherMin,
+                 Vec3 otherMax) {
+  boundsMin = {std::min(boundsMin.x, otherMin.x),
+               std::min(boundsMin.y, otherMin.y),
+               std::min(boundsMin.z, otherMin.z)};
+  boundsMax = {std::max(boundsMax.x, otherMax.x),
+               std::max(boundsMax.y, otherMax.y),
+               std::max(boundsMax.z, otherMax.z)};
+}
+
+static float SurfaceArea(Vec3 boundsMin, Vec3 boundsMax) {
+  const Vec3 extent = sub(boundsMax, boundsMin);
+  if (extent.x < 0.0f || extent.y < 0.0f || extent.z < 0.0f) {
+    return 0.0f;
+  }
+  return 2.0f * (extent.x * extent.y + extent.y * extent.z +
+                 extent.z * extent.x);
+}
+
+struct Bvh::Rebuild {
+  JobSystem *jobs = nullptr;
+  JobCounter counter;
+
+  // Snapshot of the live boxes when the rebuild started.
+  std::vector<uint32_t> ids;
+  std::vector<Vec3> boundsMin;
+  std::vector<Vec3> boundsMax;
+
+  Tree tree;
+};
+
+namespace {
+
+struct Builder {
+  JobSystem *jobs = nullptr;
+  const Vec3 *boundsMin = nullptr;
+  const Vec3 *boundsMax = nullptr;
+  std::vector<Vec3> centroids;
+  uint32_t *order = nullptr; // item indices, partitioned in place
+  BvhNode *nodes = nullptr;
+  uint32_t *parents = nullptr;
+  std::atomic<uint32_t> nodeCount{1};
+
+  void build(uint32_t node, uint32_t begin, uint32_t end, uint32_t depth);
+};
+
+void Builder::build(uint32_t node, uint32_t begin, uint32_t end,
+                    uint32_t depth) {
+  Vec3 nodeMin = kEmptyMin, nodeMax = kEmptyMax;
+  Vec3 centroidMin = kEmptyMin, centroidMax = kEmptyMax;
+  for (uint32_t i = begin; i < end; ++i) {
+    const uint32_t item = order[i];
+    Grow(nodeMin, nodeMax, boundsMin[item], boundsMax[item]);
+    Grow(centroidMin, centroidMax, centroids[item], centroids[item]);
+  }
+  nodes[node].boundsMin = nodeMin;
+  nodes[node].boundsMax = nodeMax;
+
+  const uint32_t count = end - begin;
+  auto makeLeaf = [&] {
+    nodes[node].first = begin;
+    nodes[node].count = count;
+  };
+  if (count <= 1) {
+    makeLeaf();
+    return;
+  }
+
+  // Binned SAH along the axis the centroids spread most on.
+  const Vec3 centroidExtent = sub(centroidMax, centroidMin);
+  const int axis = centroidExtent.x >= centroidExtent.y &&
+                           centroidExtent.x >= centroidExtent.z
+                       ? 0
+                   : centroidExtent.y >= centroidExtent.z ? 1
+                                                          : 2;
+  const float low = Component(centroidMin, axis);
+  const float extent = Component(centroidExtent, axis);
+  const float scale = extent > 0.0f ? (float)kBinCount / extent : 0.0f;
+  auto binOf = [&](uint32_t item) {
+    return std::min(kBinCount - 1,
+                    (uint32_t)((Component(centroids[item], axis) - low) *
+                               scale));
+  };
+
+  int bestSplit = -1; // bins [0, bestSplit] go left
+  float bestCost = FLT_MAX;
+
+  if (extent > 0.0f && depth < kMaxSahDepth) {
+    uint32_t binCounts[kBinCount] = {};
+    Vec3 binMin[kBinCount], binMax[kBinCount];
+    std::fill(binMin, binMin + kBinCount, kEmptyMin);
+    std::fill(binMax, binMax + kBinCount, kEmptyMax);
+
+    for (uint32_t i = begin; i < end; ++i) {
+      const uint32_t item = order[i];
+      const uint32_t bin = binOf(item);
+      ++binCounts[bin];
+      Grow(binMin[bin], binMax[bin], boundsMin[item], boundsMax[item]);
+    }
+
+    // Right-to-left sweep first, then left-to-right evaluating each plane.
+    float rightCost[kBinCount];
+    Vec3 sweepMin = kEmptyMin, sweepMax = kEmptyMax;
+    uint32_t sweepCount = 0;
+    for (uint32_t bin = kBinCount - 1; bin > 0; --bin) {
+      Grow(sweepMin, sweepMax, binMin[bin], binMax[bin]);
+      sweepCount += binCounts[bin];
+      rightCost[bin - 1] = SurfaceArea(sweepMin, sweepMax) * sweepCount;
+    }
+
+    sweepMin = kEmptyMin;
+    sweepMax = kEmptyMax;
+    sweepCount = 0;
+    for (uint32_t bin = 0; bin + 1 < kBinCount; ++bin) {
+      Grow(sweepMin, sweepMax, binMin[bin], binMax[bin]);
+      sweepCount += binCounts[bin];
+      if (sweepCount == 0 || sweepCount == count) {
+        continue;
+      }
+      const float cost =
+          SurfaceArea(sweepMin, sweepMax) * sweepCount + rightCost[bin];
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestSplit = (int)bin;
+      }
+    }
+  }
+
+  uint32_t middle = begin;
+  if (bestSplit >= 0) {
+    const float nodeArea = SurfaceArea(nodeMin, nodeMax);
+    const float splitCost =
+        nodeArea > 0.0f ? kTraversalCost + bestCost / nodeArea : 0.0f;
+    if (count <= kMaxLeafItems && splitCost >= (float)count) {
+      makeLeaf();
+      return;
+    }
+
+    middle = (uint32_t)(std::partition(order + begin, order + end,
+                                       [&](uint32_t item) {
+                                         return (int)binOf(item) <= bestSplit;
+                                       }) -
+                        order);
+  }
+
+  if (middle == begin || middle == end) {
+    // Too deep, or every centroid in one spot: split at the median.
+    if (count <= kMaxLeafItems) {
+      makeLeaf();
+      return;
+    }
+    middle = begin + count / 2;
+    std::nth_element(order + begin, order + middle, order + end,
+                     [&](uint32_t a, uint32_t b) {
+                       return Component(centroids[a], axis) <
+                              Component(centroids[b], axis);
+                     });
+  }
+
+  const uint32_t children = nodeCount.fetch_add(2, std::memory_order_relaxed);
+  nodes[node].first = children;
+  nodes[node].count = 0;
+  parents[children] = node;
+  parents[children + 1] = node;
+
+  if (jobs && count > kParallelItems) {
+    JobCounter counter;
+    jobs->run([this, children, begin, middle,
+               depth] { build(children, begin, middle, depth + 1); },
+              &counter);
+    build(children + 1, middle, end, depth + 1);
+    jobs->wait(counter);
+  } else {
+    build(children, begin, middle, depth + 1);
+    build(children + 1, middle, end, depth + 1);
+  }
+}
+
+} // namespace
+
+void Bvh::buildTree(Rebuild &rebuild) {
+  PROFILE_ZONE("Bvh::build");
+
+  const std::vector<uint32_t> &ids = rebuild.ids;
+  const std::vector<Vec3> &boundsMin = rebuild.boundsMin;
+  const std::vector<Vec3> &boundsMax = rebuild.boundsMax;
+  Tree &tree = rebuild.tree;
+
+  const uint32_t count = (uint32_t)ids.size();
+  tree.nodeCount = 0;
+  tree.items.clear();
+  if (count == 0) {
+    tree.nodes.clear();
+    tree.parents.clear();
+    return;
+  }
+
+  tree.nodes.assign(2 * count - 1, BvhNode{});
+  tree.parents.assign(2 * count - 1, kNone);
+
+  std::vector<uint32_t> order(count);
+  std::iota(order.begin(), order.end(), 0u);
+
+  Builder builder;
+  builder.jobs = rebuild.jobs;
+  builder.boundsMin = boundsMin.data();
+  builder.boundsMax = boundsMax.data();
+  builder.centroids.resize(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    builder.centroids[i] = mul(add(boundsMin[i], boundsMax[i]), 0.5f);
+  }
+  builder.order = order.data();
+  builder.nodes = tree.nodes.data();
+  builder.parents = tree.parents.data();
+  builder.build(0, 0, count, 0);
+
+  tree.nodeCount = builder.nodeCount.load(std::memory_order_relaxed);
+  tree.nodes.resize(tree.nodeCount);
+  tree.parents.resize(tree.nodeCount);
+
+  tree.items.resize(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    tree.items[i] = ids[order[i]];
+  }
+}
+
+Bvh::Bvh() = default;
+
+Bvh::~Bvh() { clear(); }
+
+Bvh::Bvh(Bvh &&) noexcept = default;
+
+Bvh &Bvh::operator=(Bvh &&other) noexcept {
+  if (this != &other) {
+    clear();
+    m_boundsMin = std::move(other.m_boundsMin);
+    m_boundsMax = std::move(other.m_boundsMax);
+    m_alive = std::move(other.m_alive);
+    m_changed = std::move(other.m_changed);
+    m_leafOf = std::move(other.m_leafOf);
+    m_looseSlot = std::move(other.m_looseSlot);
+    m_changedIds = std::move(other.m_changedIds);
+    m_loose = std::move(other.m_loose);
+    m_deadInTree = other.m_deadInTree;
+    m_tree = std::move(other.m_tree);
+    m_cost = other.m_cost;
+    m_buildCost = other.m_buildCost;
+    m_dirty = std::move(other.m_dirty);
+    m_dirtyNodes = std::move(other.m_dirtyNodes);
+    m_rebuild = std::move(other.m_rebuild);
+  }
+  return *this;
+}
+
+void Bvh::setBounds(uint32_t id, Vec3 boundsMin, Vec3 boundsMax) {
+  grow(id);
+
+  if (m_alive[id] && m_boundsMin[id].x == boundsMin.x &&
+      m_boundsMin[id].y == boundsMin.y && m_boundsMin[id].z == boundsMin.z &&
+      m_boundsMax[id].x == boundsMax.x && m_boundsMax[id].y == boundsMax.y &&
+      m_boundsMax[id].z == boundsMax.z) {
+    return;
+  }
+  m_boundsMin[id] = boundsMin;
+  m_boundsMax[id] = boundsMax;
+
+  if (!m_alive[id]) {
+    m_alive[id] = 1;
+    if (m_leafOf[id] == kNone) {
+      m_looseSlot[id] = (uint32_t)m_loose.size();
+      m_loose.push_back(id);
+      return;
+    }
+    --m_deadInTree;
+  }
+
+  if (m_leafOf[id] != kNone && !m_changed[id]) {
+    m_changed[id] = 1;
+    m_changedIds.push_back(id);
+  }
+}
+
+void Bvh::remove(uint32_t id) {
+  if (id >= m_alive.size() || !m_alive[id]) {
+    return;
+  }
+  m_alive[id] = 0;
+
+  if (m_leafOf[id] == kNone) {
+    removeLoose(id);
+    return;
+  }
+
+  // Stays in its leaf until the next rebuild; the refit drops its box.
+  ++m_deadInTree;
+  if (!m_changed[id]) {
+    m_changed[id] = 1;
+    m_changedIds.push_back(id);
+  }
+}
+
+void Bvh::update(JobSystem &jobs) {
+  PROFILE_ZONE("Bvh::update");
+
+  if (m_rebuild && m_rebuild->counter.done()) {
+    finishRebuild();
+  }
+
+  refit();
+
+  if (m_rebuild) {
+    return;
+  }
+
+  if (m_tree.nodeCount == 0) {
+    if (!m_loose.empty()) {
+      startRebuild(jobs, true);
+    }
+    return;
+  }
+
+  const uint32_t items = (uint32_t)m_tree.items.size();
+  if (quality() > kRebuildQuality ||
+      m_loose.size() > std::max(kMinLooseItems, items / 8) ||
+      m_deadInTree > items / 4) {
+    startRebuild(jobs, false);
+  }
+}
+
+void Bvh::queryFrustum(const Vec4 planes[6], std::vector<uint32_t> &out) {
+  auto classify = [planes](Vec3 boundsMin, Vec3 boundsMax, uint32_t &mask) {
+    for (uint32_t p = 0; p < 6; ++p) {
+      if (!(mask & (1u << p))) {
+        continue;
+      }
+      const Vec4 &plane = planes[p];
+      // The corners farthest along and against the plane normal.
+      const Vec3 inner{plane.x >= 0.0f ? boundsMax.x : boundsMin.x,
+                       plane.y >= 0.0f ? boundsMax.y : boundsMin.y,
+                       plane.z >= 0.0f ? boundsMax.z : boundsMin.z};
+      const Vec3 outer{plane.x >= 0.0f ? boundsMin.x : boundsMax.x,
+                       plane.y >= 0.0f ? boundsMin.y : boundsMax.y,
+                       plane.z >= 0.0f ? boundsMin.z : boundsMax.z};
+      if (dot({plane.x, plane.y, plane.z}, inner) + plane.w < 0.0f) {
+        return false;
+      }
+      if (dot({plane.x, plane.y, plane.z}, outer) + plane.w >= 0.0f) {
+        mask &= ~(1u << p); // entirely on the inside of this plane
+      }
+    }
+    return true;
+  };
+
+  if (m_tree.nodeCount) {
+    // Planes a node is entirely inside are not tested again below it.
+    uint32_t stack[kStackSize];
+    uint32_t masks[kStackSize];
+    uint32_t top = 0;
+    stack[top] = 0;
+    masks[top++] = 0x3f;
+
+    while (top) {
+      --top;
+      const BvhNode &node = m_tree.nodes[stack[top]];
+      uint32_t mask = masks[top];
+      if (mask && !classify(node.boundsMin, node.boundsMax, mask)) {
+        continue;
+      }
+
+      if (node.count) {
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+          const uint32_t id = m_tree.items[i];
+          uint32_t itemMask = mask;
+          if (m_alive[id] &&
+              (!mask || classify(m_boundsMin[id], m_boundsMax[id], itemMask))) {
+            out.push_back(id);
+          }
+        }
+        continue;
+      }
+
+      stack[top] = node.first;
+      masks[top++] = mask;
+      stack[top] = node.first + 1;
+      masks[top++] = mask;
+    }
+  }
+
+  for (uint32_t id : m_loose) {
+    uint32_t mask = 0x3f;
+    if (classify(m_boundsMin[id], m_boundsMax[id], mask)) {
+      out.push_back(id);
+    }
+  }
+}
+
+void Bvh::queryPoint(Vec3 point, std::vector<uint32_t> &out) {
+  queryRadius(point, 0.0f, out);
+}
+
+void Bvh::queryRadius(Vec3 center, float radius, std::vector<uint32_t> &out) {
+  const float radiusSquared = radius * radius;
+  auto overlaps = [&](Vec3 boundsMin, Vec3 boundsMax) {
+    // Squared distance from the center to the box.
+    const Vec3 nearest{std::clamp(center.x, boundsMin.x, boundsMax.x),
+                       std::clamp(center.y, boundsMin.y, boundsMax.y),
+                       std::clamp(center.z, boundsMin.z, boundsMax.z)};
+    const Vec3 offset = sub(center, nearest);
+    return boundsMin.x <= boundsMax.x && dot(offset, offset) <= radiusSquared;
+  };
+
+  if (m_tree.nodeCount) {
+    uint32_t stack[kStackSize];
+    uint32_t top = 0;
+    stack[top++] = 0;
+
+    while (top) {
+      const BvhNode &node = m_tree.nodes[stack[--top]];
+      if (!overlaps(node.boundsMin, node.boundsMax)) {
+        continue;
+      }
+
+      if (node.count) {
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+          const uint32_t id = m_tree.items[i];
+          if (m_alive[id] && overlaps(m_boundsMin[id], m_boundsMax[id])) {
+            out.push_back(id);
+          }
+        }
+        continue;
+      }
+
+      stack[top++] = node.first;
+      stack[top++] = node.first + 1;
+    }
+  }
+
+  for (uint32_t id : m_loose) {
+    if (overlaps(m_boundsMin[id], m_boundsMax[id])) {
+      out.push_back(id);
+    }
+  }
+}
+
+bool Bvh::raycast(Vec3 origin, Vec3 direction, float maxDistance,
+                  uint32_t &id, float &distance) {
+  const Vec3 inverse{1.0f / direction.x, 1.0f / direction.y,
+                     1.0f / direction.z};
+
+  // Entry distance into the box, or FLT_MAX on a miss.
+  auto intersect = [&](Vec3 boundsMin, Vec3 boundsMax, float limit) {
+    const float x0 = (boundsMin.x - origin.x) * inverse.x;
+    const float x1 = (boundsMax.x - origin.x) * inverse.x;
+    const float y0 = (boundsMin.y - origin.y) * inverse.y;
+    const float y1 = (boundsMax.y - origin.y) * inverse.y;
+    const float z0 = (boundsMin.z - origin.z) * inverse.z;
+    const float z1 = (boundsMax.z - origin.z) * inverse.z;
+    const float enter = std::max(
+        {std::min(x0, x1), std::min(y0, y1), std::min(z0, z1), 0.0f});
+    const float exit =
+        std::min({std::max(x0, x1), std::max(y0, y1), std::max(z0, z1)});
+    return enter <= exit && enter <= limit ? enter : FLT_MAX;
+  };
+
+  float best = maxDistance;
+  uint32_t hit = kNone;
+
+  if (m_tree.nodeCount &&
+      intersect(m_tree.nodes[0].boundsMin, m_tree.nodes[0].boundsMax, best) !=
+          FLT_MAX) {
+    uint32_t stack[kStackSize];
+    uint32_t top = 0;
+    stack[top++] = 0;
+
+    while (top) {
+      const BvhNode &node = m_tree.nodes[stack[--top]];
+
+      if (node.count) {
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+          const uint32_t item = m_tree.items[i];
+          if (!m_alive[item]) {
+            continue;
+          }
+          const float t =
+              intersect(m_boundsMin[item], m_boundsMax[item], best);
+          if (t != FLT_MAX && (hit == kNone || t < best)) {
+            best = t;
+            hit = item;
+          }
+        }
+        continue;
+      }
+
+      // Nearer child on top of the stack, so it is visited first.
+      const BvhNode &left = m_tree.nodes[node.first];
+      const BvhNode &right = m_tree.nodes[node.first + 1];
+      const float leftT = intersect(left.boundsMin, left.boundsMax, best);
+      const float rightT = intersect(right.boundsMin, right.boundsMax, best);
+      if (leftT <= rightT) {
+        if (rightT != FLT_MAX) {
+          stack[top++] = node.first + 1;
+        }
+        if (leftT != FLT_MAX) {
+          stack[top++] = node.first;
+        }
+      } else {
+        if (leftT != FLT_MAX) {
+          stack[top++] = node.first;
+        }
+        stack[top++] = node.first + 1;
+      }
+    }
+  }
+
+  for (uint32_t item : m_loose) {
+    const float t = intersect(m_boundsMin[item], m_boundsMax[item], best);
+    if (t != FLT_MAX && (hit == kNone || t < best)) {
+      best = t;
+      hit = item;
+    }
+  }
+
+  if (hit == kNone) {
+    return false;
+  }
+  id = hit;
+  distance = best;
+  return true;
+}
+
+void Bvh::clear() {
+  if (m_rebuild) {
+    m_rebuild->jobs->wait(m_rebuild->counter);
+    m_rebuild.reset();
+  }
+
+  m_boundsMin.clear();
+  m_boundsMax.clear();
+  m_alive.clear();
+  m_changed.clear();
+  m_leafOf.clear();
+  m_looseSlot.clear();
+  m_changedIds.clear();
+  m_loose.clear();
+  m_deadInTree = 0;
+  m_tree = Tree{};
+  m_cost = 0.0f;
+  m_buildCost = 0.0f;
+  m_dirty.clear();
+  m_dirtyNodes.clear();
+}
+
+float Bvh::quality() {
+  if (m_tree.nodeCount == 0 || m_buildCost <= 0.0f) {
+    return 1.0f;
+  }
+  const float rootArea =
+      SurfaceArea(m_tree.nodes[0].boundsMin, m_tree.nodes[0].boundsMax);
+  if (rootArea <= 0.0f) {
+    return 1.0f;
+  }
+  return (m_cost / rootArea) / m_buildCost;
+}
+
+void Bvh::grow(uint32_t id) {
+  if (id < m_alive.size()) {
+    return;
+  }
+  const size_t size = (size_t)id + 1;
+  m_boundsMin.resize(size, kEmptyMin);
+  m_boundsMax.resize(size, kEmptyMax);
+  m_alive.resize(size, 0);
+  m_changed.resize(size, 0);
+  m_leafOf.resize(size, kNone);
+  m_looseSlot.resize(size, kNone);
+}
+
+void Bvh::removeLoose(uint32_t id) {
+  const uint32_t slot = m_looseSlot[id];
+  const uint32_t last = m_loose.back();
+  m_loose[slot] = last;
+  m_looseSlot[last] = slot;
+  m_loose.pop_back();
+  m_looseSlot[id] = kNone;
+}
+
+void Bvh::refit() {
+  if (m_changedIds.empty()) {
+    return;
+  }
+  PROFILE_ZONE("Bvh::refit");
+
+  // Only the paths from changed leaves to the root.
+  for (uint32_t id : m_changedIds) {
+    m_changed[id] = 0;
+    for (uint32_t node = m_leafOf[id]; node != kNone && !m_dirty[node];
+         node = m_tree.parents[node]) {
+      m_dirty[node] = 1;
+      m_dirtyNodes.push_back(node);
+    }
+  }
+  m_changedIds.clear();
+
+  // Children always have higher indices than their parent.
+  std::sort(m_dirtyNodes.begin(), m_dirtyNodes.end(),
+            [](uint32_t a, uint32_t b) { return a > b; });
+  for (uint32_t node : m_dirtyNodes) {
+    const float previous = nodeCost(node);
+    refitNode(node);
+    m_cost += nodeCost(node) - previous;
+    m_dirty[node] = 0;
+  }
+  m_dirtyNodes.clear();
+}
+
+void Bvh::refitNode(uint32_t node) {
+  BvhNode &target = m_tree.nodes[node];
+  Vec3 boundsMin = kEmptyMin, boundsMax = kEmptyMax;
+
+  if (target.count) {
+    for (uint32_t i = target.first; i < target.first + target.count; ++i) {
+      const uint32_t id = m_tree.items[i];
+      if (m_alive[id]) {
+        Grow(boundsMin, boundsMax, m_boundsMin[id], m_boundsMax[id]);
+      }
+    }
+  } else {
+    const BvhNode &left = m_tree.nodes[target.first];
+    const BvhNode &right = m_tree.nodes[target.first + 1];
+    Grow(boundsMin, boundsMax, left.boundsMin, left.boundsMax);
+    Grow(boundsMin, boundsMax, right.boundsMin, right.boundsMax);
+  }
+
+  target.boundsMin = boundsMin;
+  target.boundsMax = boundsMax;
+}
+
+void Bvh::startRebuild(JobSystem &jobs, bool wait) {
+  auto rebuild = std::make_unique<Rebuild>();
+  rebuild->jobs = &jobs;
+
+  for (uint32_t id = 0; id < m_alive.size(); ++id) {
+    if (m_alive[id]) {
+      rebuild->ids.push_back(id);
+      rebuild->boundsMin.push_back(m_boundsMin[id]);
+      rebuild->boundsMax.push_back(m_boundsMax[id]);
+    }
+  }
+
+  Rebuild *target = rebuild.get();
+  m_rebuild = std::move(rebuild);
+  jobs.run([target] { buildTree(*target); }, &target->counter);
+
+  if (wait) {
+    jobs.wait(target->counter);
+    finishRebuild();
+  }
+}
+
+void Bvh::finishRebuild() {
+  PROFILE_ZONE("Bvh::finishRebuild");
+
+  m_tree = std::move(m_rebuild->tree);
+  m_rebuild.reset();
+
+  // Boxes may have moved, been added or removed while it was building.
+  std::fill(m_leafOf.begin(), m_leafOf.end(), kNone);
+  m_deadInTree = 0;
+  for (uint32_t node = 0; node < m_tree.nodeCount; ++node) {
+    const BvhNode &leaf = m_tree.nodes[node];
+    for (uint32_t i = leaf.first; i < leaf.first + leaf.count; ++i) {
+      const uint32_t id = m_tree.items[i];
+      m_leafOf[id] = node;
+      m_deadInTree += m_alive[id] ? 0 : 1;
+    }
+  }
+
+  m_loose.clear();
+  for (uint32_t id = 0; id < m_alive.size(); ++id) {
+    m_looseSlot[id] = kNone;
+    if (m_alive[id] && m_leafOf[id] == kNone) {
+      m_looseSlot[id] = (uint32_t)m_loose.size();
+      m_loose.push_back(id);
+    }
+  }
+
+  for (uint32_t id : m_changedIds) {
+    m_changed[id] = 0;
+  }
+  m_changedIds.clear();
+
+  m_dirty.assign(m_tree.nodeCount, 0);
+  m_cost = 0.0f;
+  for (uint32_t node = m_tree.nodeCount; node-- > 0;) {
+    refitNode(node);
+    m_cost += nodeCost(node);
+  }
+
+  m_buildCost = 0.0f;
+  if (m_tree.nodeCount) {
+    const float rootArea =
+        SurfaceArea(m_tree.nodes[0].boundsMin, m_tree.nodes[0].boundsMax);
+    m_buildCost = rootArea > 0.0f ? m_cost / rootArea : 0.0f;
+  }
+}
+
+float Bvh::nodeCost(uint32_t node) {
+  const BvhNode &target = m_tree.nodes[node];
+  const float area = SurfaceArea(target.boundsMin, target.boundsMax);
+  return target.count ? area * (float)target.count : area * kTraversalCost;
+}
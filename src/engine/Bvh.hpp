@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Math.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class JobSystem; // forward declaration
+
+struct BvhNode {
+  Vec3 boundsMin;
+  uint32_t first = 0; // leaf: first item; interior: left child (right + 1)
+  Vec3 boundsMax;
+  uint32_t count = 0; // items in a leaf; 0 for interior nodes
+};
+
+// Bounding volume hierarchy over axis-aligned boxes keyed by caller ids
+// (the scene uses entity indices). Built top down with binned SAH; the
+// two halves of every large node are built as separate jobs.
+//
+// setBounds() and remove() are cheap and only take effect in update():
+// moved boxes are refitted bottom up along their paths to the root, and
+// new ones wait in a short linear list until the next rebuild. When refits
+// have made the tree noticeably worse than it was when built, or enough
+// boxes were added or removed, update() starts a rebuild on the job system
+// and swaps the result in once it has finished, so a frame never waits for
+// one. Only the very first build is synchronous.
+//
+// Queries append ids to out and are safe to run concurrently with each
+// other, but not with setBounds(), remove() or update().
+class Bvh {
+public:
+  Bvh();
+  ~Bvh();
+
+  Bvh(Bvh &&) noexcept;
+  Bvh &operator=(Bvh &&) noexcept;
+
+  // Inserts id or moves it.
+  void setBounds(uint32_t id, Vec3 boundsMin, Vec3 boundsMax);
+  void remove(uint32_t id);
+
+  void update(JobSystem &jobs);
+
+  // Ids whose box intersects the volume inside all six planes (see
+  // frustumPlanes()).
+  void queryFrustum(const Vec4 planes[6], std::vector<uint32_t> &out);
+  void queryPoint(Vec3 point, std::vector<uint32_t> &out);
+  void queryRadius(Vec3 center, float radius, std::vector<uint32_t> &out);
+  // Nearest box along the ray, not the geometry inside it. direction need
+  // not be normalized; distance is in units of its length.
+  bool raycast(Vec3 origin, Vec3 direction, float maxDistance, uint32_t &id,
+               float &distance);
+
+  // id's box as last given to setBounds().
+  void bounds(uint32_t id, Vec3 &boundsMin, Vec3 &boundsMax) {
+    boundsMin = m_boundsMin[id];
+    boundsMax = m_boundsMax[id];
+  }
+
+  // Waits for a running rebuild; the caller's job system must still be up.
+  void clear();
+
+  // SAH cost now relative to when the tree was built; 1 is as built.
+  float quality();
+  uint32_t nodeCount() { return m_tree.nodeCount; }
+  bool rebuilding() { return m_rebuild != nullptr; }
+
+private:
+  struct Tree {
+    std::vector<BvhNode> nodes;
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> items; // ids, in leaf order
+    uint32_t nodeCount = 0;
+  };
+
+  struct Rebuild; // defined in Bvh.cpp
+
+  // By id.
+  std::vector<Vec3> m_boundsMin;
+  std::vector<Vec3> m_boundsMax;
+  std::vector<uint8_t> m_alive;
+  std::vector<uint8_t> m_changed;
+  std::vector<uint32_t> m_leafOf;    // node in m_tree, or kNone if loose
+  std::vector<uint32_t> m_looseSlot; // position in m_loose
+
+  std::vector<uint32_t> m_changedIds;
+  std::vector<uint32_t> m_loose; // alive ids not in m_tree
+  uint32_t m_deadInTree = 0;     // removed ids still referenced by leaves
+
+  Tree m_tree;
+  // Sum over nodes of surface area x (item count for leaves, 1 otherwise),
+  // kept up to date by refits, and right after the build divided by the
+  // root's area.
+  float m_cost = 0.0f;
+  float m_buildCost = 0.0f;
+
+  std::vector<uint8_t> m_dirty; // by node, during refit
+  std::vector<uint32_t> m_dirtyNodes;
+
+  std::unique_ptr<Rebuild> m_rebuild;
+
+  static void buildTree(Rebuild &rebuild);
+
+  void grow(uint32_t id);
+  void removeLoose(uint32_t id);
+  void refit();
+  void refitNode(uint32_t node);
+  void startRebuild(JobSystem &jobs, bool wait);
+  void finishRebuild();
+  float nodeCost(uint32_t node);
+};
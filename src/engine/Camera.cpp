@@ -8,10 +8,14 @@ void Camera::setPerspective(float fovyRadians, float aspect, float zNear,
   m_zFar = zFar;
 }
 
-void Camera::setPosition(Vec3 p) { m_pos = p; }
+void Camera::setPosition(Vec3 p) {
+  m_pos = p;
+  m_previousPos = p;
+}
 
 void Camera::lookAt(Vec3 target, Vec3 up) {
   m_target = target;
+  m_previousTarget = target;
   m_up = up;
 }
 
@@ -21,14 +25,60 @@ void Camera::onResize(int w, int h) {
   }
 }
 
-void Camera::updateMatrices() {
-  m_ubo.view = lookAtRH(m_pos, m_target, m_up);
+void Camera::setJitter(bool enabled, float width, float height) {
+  m_jitterEnabled = enabled;
+  if (width > 0.0f && height > 0.0f) {
+    m_jitterWidth = width;
+    m_jitterHeight = height;
+  }
+}
+
+static float Halton(uint32_t index, uint32_t base) {
+  float result = 0.0f;
+  float fraction = 1.0f;
+  while (index > 0) {
+    fraction /= (float)base;
+    result += fraction * (float)(index % base);
+    index /= base;
+  }
+  return result;
+}
+
+void Camera::updateMatrices(float alpha) {
+  // 8 samples is enough for TAA's history to converge without visible
+  // cycling.
+  const uint32_t kJitterSamples = 8;
+
+  const Vec3 pos = lerp(m_previousPos, m_pos, alpha);
+  const Vec3 target = lerp(m_previousTarget, m_target, alpha);
+
+  m_ubo.view = lookAtRH(pos, target, m_up);
   m_ubo.proj = perspectiveRH(m_fovy, m_aspect, m_zNear, m_zFar);
+
+  Mat4 viewProj = mul(m_ubo.proj, m_ubo.view);
+  m_ubo.prevViewProj = m_hasPrevious ? m_unjitteredViewProj : viewProj;
+  m_unjitteredViewProj = viewProj;
+  m_hasPrevious = true;
+
+  float jitterX = 0.0f;
+  float jitterY = 0.0f;
+  if (m_jitterEnabled) {
+    m_jitterIndex = (m_jitterIndex + 1) % kJitterSamples;
+    // Offsets in [-0.5, 0.5) pixels, expressed in NDC.
+    jitterX = (Halton(m_jitterIndex + 1, 2) - 0.5f) * 2.0f / m_jitterWidth;
+    jitterY = (Halton(m_jitterIndex + 1, 3) - 0.5f) * 2.0f / m_jitterHeight;
+    m_ubo.proj = mul(translate({jitterX, jitterY, 0.0f}), m_ubo.proj);
+  }
+
+  m_ubo.jitter = {jitterX, jitterY, m_ubo.jitter.x, m_ubo.jitter.y};
   m_ubo.viewProj = mul(m_ubo.proj, m_ubo.view);
-  m_ubo.viewPos = {m_pos.x, m_pos.y, m_pos.z, 1.0f};
+  m_ubo.viewPos = {pos.x, pos.y, pos.z, 1.0f};
 }
 
 void Camera::orbitStep(float dtSeconds, float yawSpeed) {
+  m_previousPos = m_pos;
+  m_previousTarget = m_target;
+
   m_orbitYaw += dtSeconds * yawSpeed;
 
   // clamp pitch to avoid pole flip
@@ -49,6 +99,7 @@ void Camera::orbitStep(float dtSeconds, float yawSpeed) {
       m_orbitTarget.z + m_orbitRadius * (cp * sy),
   };
 
-  setPosition(eye);
-  lookAt(m_orbitTarget);
+  m_pos = eye;
+  m_target = m_orbitTarget;
+  m_up = {0.0f, 1.0f, 0.0f};
 }
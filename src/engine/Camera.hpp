@@ -2,6 +2,8 @@
 
 #include "Math.hpp"
 
+#include <cstdint>
+
 // Simple FPS/orbit-ish camera. Keep it tiny for now.
 
 struct CameraUBO {
@@ -9,6 +11,10 @@ struct CameraUBO {
   Mat4 proj;
   Mat4 viewProj;
   Vec4 viewPos;
+  // Unjittered previous frame viewProj, for motion vectors.
+  Mat4 prevViewProj;
+  // xy this frame's projection jitter, zw last frame's (NDC units).
+  Vec4 jitter;
 };
 
 class Camera {
@@ -18,11 +24,22 @@ public:
   void lookAt(Vec3 target, Vec3 up = {0.0f, 1.0f, 0.0f});
   void onResize(int w, int h);
 
-  // Call after changing params.
-  void updateMatrices();
+  // Sub-pixel projection jitter for TAA, applied by updateMatrices. The
+  // size is the render target in pixels.
+  void setJitter(bool enabled, float width, float height);
+
+  // Call after changing params. The view is placed alpha of the way from the
+  // pose before the last orbitStep() to the current one, so rendering can run
+  // between fixed simulation steps.
+  void updateMatrices(float alpha = 1.0f);
 
   const CameraUBO &ubo() const { return m_ubo; }
 
+  float fovy() const { return m_fovy; }
+  float aspect() const { return m_aspect; }
+  float zNear() const { return m_zNear; }
+  float zFar() const { return m_zFar; }
+
   // Orbit controls
   void setOrbitTarget(Vec3 t) { m_orbitTarget = t; }
   void setOrbitRadius(float r) { m_orbitRadius = r; }
@@ -31,7 +48,7 @@ public:
     m_orbitPitch = pitchRadians;
   }
 
-  // Call once per frame. dtSeconds can come from Engine/Renderer.
+  // Call once per simulation step with the fixed step length.
   void orbitStep(float dtSeconds, float yawSpeed = 0.7f);
 
 private:
@@ -39,6 +56,11 @@ private:
   Vec3 m_target{0.0f, 0.0f, 0.0f};
   Vec3 m_up{0.0f, 1.0f, 0.0f};
 
+  // Pose before the last orbitStep(), for interpolation. setPosition() and
+  // lookAt() move both, so explicit placement does not interpolate.
+  Vec3 m_previousPos{0.0f, 0.0f, 3.0f};
+  Vec3 m_previousTarget{0.0f, 0.0f, 0.0f};
+
   float m_fovy = 1.04719755f; // 60deg
   float m_aspect = 16.0f / 9.0f;
   float m_zNear = 0.1f;
@@ -50,5 +72,13 @@ private:
   float m_orbitYaw = 0.0f;    // radians
   float m_orbitPitch = 0.35f; // radians
 
+  // Halton(2, 3) sequence position and render target size for jitter.
+  bool m_jitterEnabled = false;
+  uint32_t m_jitterIndex = 0;
+  float m_jitterWidth = 1.0f;
+  float m_jitterHeight = 1.0f;
+  Mat4 m_unjitteredViewProj{};
+  bool m_hasPrevious = false;
+
   CameraUBO m_ubo{};
 };
@@ -1,3 +1,6 @@
 #pragma once
 
-static constexpr int FRAME_COUNT = 2;
+// Per-frame resources (command buffers, uniform buffers, descriptor sets) are
+// allocated for this many slots; the renderer cycles through
+// Renderer::framesInFlight() <= MAX_FRAMES_IN_FLIGHT of them at runtime.
+static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
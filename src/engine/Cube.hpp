@@ -42,6 +42,6 @@ void GenerateCube(VertexCollector *vertexCollector) {
       0,  1,  2,  0,  2,  3,  4,  5,  6,  4,  6,  7,  8,  9,  10, 8,  10, 11,
       12, 13, 14, 12, 14, 15, 16, 17, 18, 16, 18, 19, 20, 21, 22, 20, 22, 23};
 
-  vertexCollector->addVertices(vertices);
-  vertexCollector->addIndices(indices);
+  vertexCollector->addVertices(std::move(vertices));
+  vertexCollector->addIndices(std::move(indices));
 }
@@ -0,0 +1,239 @@
+#include "Entities.hpp"
+
+#include "Jobs.hpp"
+#include "Profiler.hpp"
+#include "Transform.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+const char *EntityArchetypeName(EntityArchetype archetype) {
+  switch (archetype) {
+  case ArchetypeStatic:
+    return "static";
+  case ArchetypeDynamic:
+    return "dynamic";
+  default:
+    return "unknown";
+  }
+}
+
+Entity EntityStorage::create(const EntityDesc &desc) {
+  uint32_t index;
+  if (!m_free.empty()) {
+    index = m_free.back();
+    m_free.pop_back();
+  } else {
+    index = (uint32_t)m_records.size();
+    m_records.emplace_back();
+  }
+
+  Record &record = m_records[index];
+  record.archetype = desc.isStatic ? ArchetypeStatic : ArchetypeDynamic;
+  record.row = append(record.archetype, index, desc);
+  return {index, record.generation};
+}
+
+void EntityStorage::destroy(Entity entity) {
+  Record *record = find(entity);
+  if (!record) {
+    return;
+  }
+
+  remove(record->archetype, record->row);
+  ++record->generation;
+  m_free.push_back(entity.index);
+  m_destroyed.push_back(entity.index);
+}
+
+bool EntityStorage::alive(Entity entity) { return find(entity) != nullptr; }
+
+Entity EntityStorage::handle(uint32_t index) {
+  if (index >= m_records.size()) {
+    return Entity{};
+  }
+  const Record &record = m_records[index];
+  const EntityTable &table = m_tables[record.archetype];
+  if (record.row >= table.entity.size() || table.entity[record.row] != index) {
+    return Entity{};
+  }
+  return {index, record.generation};
+}
+
+void EntityStorage::setStatic(Entity entity, bool isStatic) {
+  Record *record = find(entity);
+  const EntityArchetype archetype =
+      isStatic ? ArchetypeStatic : ArchetypeDynamic;
+  if (!record || record->archetype == archetype) {
+    return;
+  }
+
+  EntityTable &from = m_tables[record->archetype];
+  const uint32_t row = record->row;
+
+  EntityDesc desc;
+  desc.node = from.node[row];
+  desc.model = from.model[row];
+  desc.mesh = from.mesh[row];
+  desc.material = from.material[row];
+  desc.flags = from.flags[row];
+  desc.boundsMin = from.localMin[row];
+  desc.boundsMax = from.localMax[row];
+
+  remove(record->archetype, row);
+  record->archetype = archetype;
+  record->row = append(archetype, entity.index, desc);
+}
+
+void EntityStorage::setFlags(Entity entity, uint32_t flags) {
+  Record *record = find(entity);
+  if (!record) {
+    return;
+  }
+
+  uint32_t &current = m_tables[record->archetype].flags[record->row];
+  if (record->archetype == ArchetypeStatic && current != flags) {
+    m_staticEdited = true;
+  }
+  current = flags;
+}
+
+uint32_t EntityStorage::flags(Entity entity) {
+  Record *record = find(entity);
+  return record ? m_tables[record->archetype].flags[record->row] : 0;
+}
+
+uint32_t EntityStorage::node(Entity entity) {
+  Record *record = find(entity);
+  return record ? m_tables[record->archetype].node[record->row]
+                : TransformHierarchy::kNoParent;
+}
+
+void EntityStorage::update(TransformHierarchy &transforms, JobSystem &jobs) {
+  PROFILE_ZONE("EntityStorage::update");
+
+  m_staticChanged = m_staticEdited || m_tableGrew[ArchetypeStatic];
+  m_staticEdited = false;
+
+  for (uint32_t a = 0; a < ArchetypeCount; ++a) {
+    // Static entities only move when something in the hierarchy did.
+    m_refreshed[a] = a != ArchetypeStatic || m_tableGrew[a] ||
+                     transforms.updatedCount() > 0;
+    if (!m_refreshed[a]) {
+      continue;
+    }
+    m_tableGrew[a] = false;
+
+    EntityTable &table = m_tables[a];
+    const bool watch = a == ArchetypeStatic && !m_staticChanged;
+    std::atomic<bool> moved{false};
+    jobs.parallelFor(
+        table.size(),
+        [&table, &transforms, watch, &moved](uint32_t begin, uint32_t end) {
+          for (uint32_t row = begin; row < end; ++row) {
+            const Mat4 &world = transforms.world(table.node[row]);
+            if (watch && std::memcmp(&table.world[row], &world,
+                                     sizeof(Mat4)) != 0) {
+              moved.store(true, std::memory_order_relaxed);
+            }
+            table.world[row] = world;
+            table.worldMin[row] = table.localMin[row];
+            table.worldMax[row] = table.localMax[row];
+            transformBounds(world, table.worldMin[row], table.worldMax[row]);
+          }
+        },
+        1024);
+    if (moved.load(std::memory_order_relaxed)) {
+      m_staticChanged = true;
+    }
+  }
+}
+
+EntityTable &EntityStorage::table(EntityArchetype archetype) {
+  return m_tables[archetype];
+}
+
+uint32_t EntityStorage::size() {
+  return m_tables[ArchetypeStatic].size() + m_tables[ArchetypeDynamic].size();
+}
+
+void EntityStorage::clear() {
+  // Generations keep counting so handles from before stay dead.
+  for (uint32_t a = 0; a < ArchetypeCount; ++a) {
+    EntityTable &table = m_tables[a];
+    while (table.size()) {
+      const uint32_t index = table.entity.back();
+      remove((EntityArchetype)a, table.size() - 1);
+      ++m_records[index].generation;
+      m_free.push_back(index);
+      m_destroyed.push_back(index);
+    }
+  }
+}
+
+EntityStorage::Record *EntityStorage::find(Entity entity) {
+  if (entity.index >= m_records.size()) {
+    return nullptr;
+  }
+  Record &record = m_records[entity.index];
+  return record.generation == entity.generation ? &record : nullptr;
+}
+
+uint32_t EntityStorage::append(EntityArchetype archetype, uint32_t index,
+                               const EntityDesc &desc) {
+  EntityTable &table = m_tables[archetype];
+  const uint32_t row = table.size();
+
+  table.entity.push_back(index);
+  table.node.push_back(desc.node);
+  table.model.push_back(desc.model);
+  table.mesh.push_back(desc.mesh);
+  table.material.push_back(desc.material);
+  table.flags.push_back(desc.flags);
+  table.localMin.push_back(desc.boundsMin);
+  table.localMax.push_back(desc.boundsMax);
+  table.world.push_back(Mat4::identity());
+  table.worldMin.push_back(desc.boundsMin);
+  table.worldMax.push_back(desc.boundsMax);
+
+  m_tableGrew[archetype] = true;
+  return row;
+}
+
+void EntityStorage::remove(EntityArchetype archetype, uint32_t row) {
+  if (archetype == ArchetypeStatic) {
+    m_staticEdited = true;
+  }
+
+  EntityTable &table = m_tables[archetype];
+  const uint32_t last = table.size() - 1;
+  assert(row <= last);
+
+  if (row != last) {
+    table.entity[row] = table.entity[last];
+    table.node[row] = table.node[last];
+    table.model[row] = table.model[last];
+    table.mesh[row] = table.mesh[last];
+    table.material[row] = table.material[last];
+    table.flags[row] = table.flags[last];
+    table.localMin[row] = table.localMin[last];
+    table.localMax[row] = table.localMax[last];
+    table.world[row] = table.world[last];
+    table.worldMin[row] = table.worldMin[last];
+    table.worldMax[row] = table.worldMax[last];
+    m_records[table.entity[row]].row = row;
+  }
+
+  table.entity.pop_back();
+  table.node.pop_back();
+  table.model.pop_back();
+  table.mesh.pop_back();
+  table.material.pop_back();
+  table.flags.pop_back();
+  table.localMin.pop_back();
+  table.localMax.pop_back();
+  table.world.pop_back();
+  table.worldMin.pop_back();
+  table.worldMax.pop_back();
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "Math.hpp"
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;          // forward declaration
+class TransformHierarchy; // forward declaration
+
+// Entities with the same set of components share an archetype table. Only
+// static entities go into the cached shadow cascades, so static and dynamic
+// ones are kept apart and each pass walks just the table it needs.
+enum EntityArchetype : uint32_t {
+  ArchetypeStatic = 0,
+  ArchetypeDynamic,
+  ArchetypeCount,
+};
+
+const char *EntityArchetypeName(EntityArchetype archetype);
+
+enum EntityFlags : uint32_t {
+  EntityHidden = 1 << 0,
+  EntityNoShadows = 1 << 1,
+};
+
+// Stable reference to an entity. The generation tells a destroyed entity
+// from a newer one reusing its index.
+struct Entity {
+  uint32_t index = UINT32_MAX;
+  uint32_t generation = 0;
+};
+
+// One archetype's components as parallel arrays: row i of every column is
+// the same entity. Rows are dense; destroying an entity moves the last row
+// into its place.
+struct EntityTable {
+  std::vector<uint32_t> entity; // index, to fix up the record on a move
+  std::vector<uint32_t> node;   // TransformHierarchy handle
+  std::vector<uint32_t> model;  // index into Scene::models()
+  std::vector<uint32_t> mesh;   // index into the model's meshes
+  std::vector<uint32_t> material;
+  std::vector<uint32_t> flags; // EntityFlags
+  std::vector<Vec3> localMin;  // mesh bounds
+  std::vector<Vec3> localMax;
+  // Filled by EntityStorage::update().
+  std::vector<Mat4> world;
+  std::vector<Vec3> worldMin;
+  std::vector<Vec3> worldMax;
+
+  uint32_t size() { return (uint32_t)entity.size(); }
+};
+
+struct EntityDesc {
+  uint32_t node = 0;
+  uint32_t model = 0;
+  uint32_t mesh = 0;
+  uint32_t material = 0;
+  uint32_t flags = 0;
+  Vec3 boundsMin{};
+  Vec3 boundsMax{};
+  bool isStatic = true;
+};
+
+// Structure-of-arrays entity storage for what the scene draws: one entity
+// per placed mesh. Create and destroy are O(1); handles stay valid until
+// their entity is destroyed. Systems walk the tables directly.
+class EntityStorage {
+public:
+  Entity create(const EntityDesc &desc);
+  void destroy(Entity entity);
+  bool alive(Entity entity);
+
+  // Moves the entity to the other archetype table.
+  void setStatic(Entity entity, bool isStatic);
+  void setFlags(Entity entity, uint32_t flags);
+  uint32_t flags(Entity entity);
+  uint32_t node(Entity entity);
+
+  // Copies world matrices out of transforms and refreshes world bounds.
+  // The static table is skipped while the hierarchy is unchanged.
+  void update(TransformHierarchy &transforms, JobSystem &jobs);
+  // Whether the last update() refreshed archetype's table.
+  bool refreshed(EntityArchetype archetype) { return m_refreshed[archetype]; }
+  // Whether the static table changed by the last update(): rows added or
+  // removed, flags changed, or a world matrix moved. The cached shadow
+  // cascades hold exactly these rows.
+  bool staticChanged() { return m_staticChanged; }
+
+  // Indices destroyed since clearDestroyed(), for indexes kept elsewhere.
+  const std::vector<uint32_t> &destroyed() { return m_destroyed; }
+  void clearDestroyed() { m_destroyed.clear(); }
+
+  // The live entity at index, or an invalid handle.
+  Entity handle(uint32_t index);
+
+  EntityTable &table(EntityArchetype archetype);
+  uint32_t size();
+
+  void clear();
+
+private:
+  struct Record {
+    uint32_t generation = 0;
+    EntityArchetype archetype = ArchetypeStatic;
+    uint32_t row = 0;
+  };
+
+  std::vector<Record> m_records; // by entity index
+  std::vector<uint32_t> m_free;  // destroyed indices
+  EntityTable m_tables[ArchetypeCount];
+  // A table gained rows since the last update().
+  bool m_tableGrew[ArchetypeCount] = {};
+  bool m_refreshed[ArchetypeCount] = {};
+  // Static rows were removed or had their flags changed since update().
+  bool m_staticEdited = false;
+  bool m_staticChanged = false;
+  std::vector<uint32_t> m_destroyed;
+
+  Record *find(Entity entity);
+  uint32_t append(EntityArchetype archetype, uint32_t index,
+                  const EntityDesc &desc);
+  // Swap-removes row and fixes up the record of the row moved into it.
+  void remove(EntityArchetype archetype, uint32_t row);
+};
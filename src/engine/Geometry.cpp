@@ -0,0 +1,320 @@
+#include "../Vulkan.hpp"
+
+#include "Constants.hpp"
+#include "Geometry.hpp"
+#include "Renderer.hpp"
+
+#include <iostream>
+
+static constexpr VkDeviceSize kDrawSlotBytes =
+    sizeof(PulledDraw) * GeometryBuffer::kMaxDraws;
+
+static void CreateMappedBuffer(VkPhysicalDevice physicalDevice,
+                               VkDevice device, VkDeviceSize size,
+                               VkBufferUsageFlags usage, const char *name,
+                               VkBuffer &buffer, VkDeviceMemory &memory,
+                               void **mapped) {
+  if (!CreateBuffer(physicalDevice, device, size, usage,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                    buffer, memory)) {
+    std::cerr << "Failed to create geometry " << name << " buffer"
+              << std::endl;
+    std::abort();
+  }
+  vkMapMemory(device, memory, 0, size, 0, mapped);
+}
+
+static void DestroyBuffer(VkDevice device, VkBuffer &buffer,
+                          VkDeviceMemory &memory) {
+  if (buffer) {
+    vkDestroyBuffer(device, buffer, nullptr);
+    buffer = VK_NULL_HANDLE;
+  }
+  if (memory) {
+    vkFreeMemory(device, memory, nullptr);
+    memory = VK_NULL_HANDLE;
+  }
+}
+
+void GeometryBuffer::init(Renderer &renderer, uint32_t maxVertexFloats,
+                          uint32_t maxIndices) {
+  auto physicalDevice = renderer.physicalDevice();
+  auto device = renderer.device();
+
+  m_maxVertexFloats = maxVertexFloats;
+  m_maxIndices = maxIndices;
+  m_vertexFloats = 0;
+  m_indices = 0;
+  m_uploadedVertexFloats = 0;
+  m_uploadedIndices = 0;
+
+  const VkDeviceSize vertexBufferSize = sizeof(float) * maxVertexFloats;
+  const VkDeviceSize indexBufferSize = sizeof(uint32_t) * maxIndices;
+
+  if (!CreateBuffer(physicalDevice, device, vertexBufferSize,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertexBuffer,
+                    m_vertexMemory)) {
+    std::cerr << "Failed to create geometry vertex buffer" << std::endl;
+    std::abort();
+  }
+
+  if (!CreateBuffer(physicalDevice, device, indexBufferSize,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexBuffer,
+                    m_indexMemory)) {
+    std::cerr << "Failed to create geometry index buffer" << std::endl;
+    std::abort();
+  }
+
+  void *data = nullptr;
+  CreateMappedBuffer(physicalDevice, device, vertexBufferSize,
+                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT, "vertex staging",
+                     m_vertexStaging, m_vertexStagingMemory, &data);
+  m_vertexMapped = static_cast<float *>(data);
+  CreateMappedBuffer(physicalDevice, device, indexBufferSize,
+                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT, "index staging",
+                     m_indexStaging, m_indexStagingMemory, &data);
+  m_indexMapped = static_cast<uint32_t *>(data);
+
+  CreateMappedBuffer(physicalDevice, device,
+                     kDrawSlotBytes * MAX_FRAMES_IN_FLIGHT,
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, "draw", m_drawBuffer,
+                     m_drawMemory, &data);
+  m_drawMapped = static_cast<PulledDraw *>(data);
+  CreateMappedBuffer(physicalDevice, device,
+                     sizeof(VkDrawIndirectCommand) * kMaxDraws *
+                         MAX_FRAMES_IN_FLIGHT,
+                     VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, "indirect",
+                     m_indirectBuffer, m_indirectMemory, &data);
+  m_indirectMapped = static_cast<VkDrawIndirectCommand *>(data);
+
+  // Set 1: binding 0 = vertices, binding 1 = indices, binding 2 = this
+  // frame's draw records.
+  VkDescriptorSetLayoutBinding descriptorSetLayoutBindings[3]{};
+  for (uint32_t i = 0; i < 3; ++i) {
+    descriptorSetLayoutBindings[i].binding = i;
+    descriptorSetLayoutBindings[i].descriptorType =
+        i == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC
+               : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorSetLayoutBindings[i].descriptorCount = 1;
+    descriptorSetLayoutBindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  }
+
+  VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+  descriptorSetLayoutCreateInfo.bindingCount = 3;
+  descriptorSetLayoutCreateInfo.pBindings = descriptorSetLayoutBindings;
+
+  if (vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo,
+                                  nullptr,
+                                  &m_descriptorSetLayout) != VK_SUCCESS) {
+    std::cerr << "vkCreateDescriptorSetLayout failed for geometry"
+              << std::endl;
+    std::abort();
+  }
+
+  VkDescriptorPoolSize descriptorPoolSizes[2]{};
+  descriptorPoolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  descriptorPoolSizes[0].descriptorCount = 2;
+  descriptorPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  descriptorPoolSizes[1].descriptorCount = 1;
+
+  VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+  descriptorPoolCreateInfo.maxSets = 1;
+  descriptorPoolCreateInfo.poolSizeCount = 2;
+  descriptorPoolCreateInfo.pPoolSizes = descriptorPoolSizes;
+
+  if (vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr,
+                             &m_descriptorPool) != VK_SUCCESS) {
+    std::cerr << "vkCreateDescriptorPool failed for geometry" << std::endl;
+    std::abort();
+  }
+
+  VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+  descriptorSetAllocateInfo.descriptorPool = m_descriptorPool;
+  descriptorSetAllocateInfo.descriptorSetCount = 1;
+  descriptorSetAllocateInfo.pSetLayouts = &m_descriptorSetLayout;
+
+  if (vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
+                               &m_descriptorSet) != VK_SUCCESS) {
+    std::cerr << "vkAllocateDescriptorSets failed for geometry" << std::endl;
+    std::abort();
+  }
+
+  VkDescriptorBufferInfo descriptorBufferInfos[3]{};
+  descriptorBufferInfos[0].buffer = m_vertexBuffer;
+  descriptorBufferInfos[0].offset = 0;
+  descriptorBufferInfos[0].range = VK_WHOLE_SIZE;
+  descriptorBufferInfos[1].buffer = m_indexBuffer;
+  descriptorBufferInfos[1].offset = 0;
+  descriptorBufferInfos[1].range = VK_WHOLE_SIZE;
+  // One frame slot; drawsOffset() picks which.
+  descriptorBufferInfos[2].buffer = m_drawBuffer;
+  descriptorBufferInfos[2].offset = 0;
+  descriptorBufferInfos[2].range = kDrawSlotBytes;
+
+  VkWriteDescriptorSet writeDescriptorSets[3]{};
+  for (uint32_t i = 0; i < 3; ++i) {
+    writeDescriptorSets[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeDescriptorSets[i].dstSet = m_descriptorSet;
+    writeDescriptorSets[i].dstBinding = i;
+    writeDescriptorSets[i].descriptorCount = 1;
+    writeDescriptorSets[i].descriptorType =
+        descriptorSetLayoutBindings[i].descriptorType;
+    writeDescriptorSets[i].pBufferInfo = &descriptorBufferInfos[i];
+  }
+
+  vkUpdateDescriptorSets(device, 3, writeDescriptorSets, 0, nullptr);
+}
+
+bool GeometryBuffer::append(const std::vector<float> &vertexData,
+                            uint32_t vertexStride,
+                            const std::vector<uint32_t> &indices,
+                            GeometryRange &outRange) {
+  if (m_vertexFloats + vertexData.size() > m_maxVertexFloats ||
+      m_indices + indices.size() > m_maxIndices) {
+    return false;
+  }
+
+  std::memcpy(m_vertexMapped + m_vertexFloats, vertexData.data(),
+              sizeof(float) * vertexData.size());
+  std::memcpy(m_indexMapped + m_indices, indices.data(),
+              sizeof(uint32_t) * indices.size());
+
+  outRange.firstIndex = m_indices;
+  outRange.indexCount = (uint32_t)indices.size();
+  outRange.vertexOffset = m_vertexFloats;
+  outRange.vertexStride = vertexStride;
+
+  m_vertexFloats += (uint32_t)vertexData.size();
+  m_indices += (uint32_t)indices.size();
+
+  return true;
+}
+
+void GeometryBuffer::beginFrame(VkCommandBuffer commandBuffer,
+                                int frameIndex) {
+  m_frameIndex = frameIndex;
+  m_drawCount = 0;
+
+  if (m_vertexFloats == m_uploadedVertexFloats &&
+      m_indices == m_uploadedIndices) {
+    return;
+  }
+
+  // Append only: the copied ranges are new, so nothing in flight reads them.
+  if (m_vertexFloats > m_uploadedVertexFloats) {
+    VkBufferCopy region{};
+    region.srcOffset = sizeof(float) * m_uploadedVertexFloats;
+    region.dstOffset = region.srcOffset;
+    region.size = sizeof(float) * (m_vertexFloats - m_uploadedVertexFloats);
+    vkCmdCopyBuffer(commandBuffer, m_vertexStaging, m_vertexBuffer, 1,
+                    &region);
+  }
+  if (m_indices > m_uploadedIndices) {
+    VkBufferCopy region{};
+    region.srcOffset = sizeof(uint32_t) * m_uploadedIndices;
+    region.dstOffset = region.srcOffset;
+    region.size = sizeof(uint32_t) * (m_indices - m_uploadedIndices);
+    vkCmdCopyBuffer(commandBuffer, m_indexStaging, m_indexBuffer, 1, &region);
+  }
+
+  VkMemoryBarrier2 memoryBarrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+  memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+  memoryBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+  memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT;
+  memoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+
+  VkDependencyInfo dependencyInfo{VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+  dependencyInfo.memoryBarrierCount = 1;
+  dependencyInfo.pMemoryBarriers = &memoryBarrier;
+  vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+  m_uploadedVertexFloats = m_vertexFloats;
+  m_uploadedIndices = m_indices;
+}
+
+uint32_t GeometryBuffer::reserveDraws(uint32_t &count) {
+  const uint32_t first = m_drawCount;
+  if (count > kMaxDraws - first) {
+    if (!m_drawsWarned) {
+      Log::warning("GeometryBuffer: more than %u pulled draws in a frame; "
+                   "the rest are dropped",
+                   kMaxDraws);
+      m_drawsWarned = true;
+    }
+    count = kMaxDraws - first;
+  }
+  m_drawCount += count;
+  return first;
+}
+
+void GeometryBuffer::writeDraw(uint32_t draw, const Mat4 &model,
+                               const GeometryRange &range) {
+  const uint32_t slot = (uint32_t)m_frameIndex * kMaxDraws + draw;
+
+  PulledDraw &record = m_drawMapped[slot];
+  record.model = model;
+  record.vertexOffset = range.vertexOffset;
+  record.vertexStride = range.vertexStride;
+  std::memcpy(record.attributeOffsets, range.attributeOffsets,
+              sizeof(record.attributeOffsets));
+
+  // gl_VertexIndex starts at firstIndex and indexes the index buffer;
+  // gl_InstanceIndex is the record.
+  VkDrawIndirectCommand &command = m_indirectMapped[slot];
+  command.vertexCount = range.indexCount;
+  command.instanceCount = 1;
+  command.firstVertex = range.firstIndex;
+  command.firstInstance = draw;
+}
+
+VkDeviceSize GeometryBuffer::indirectOffset(uint32_t draw) {
+  return sizeof(VkDrawIndirectCommand) *
+         ((VkDeviceSize)m_frameIndex * kMaxDraws + draw);
+}
+
+uint32_t GeometryBuffer::drawsOffset() {
+  return (uint32_t)(kDrawSlotBytes * (VkDeviceSize)m_frameIndex);
+}
+
+VkDescriptorSetLayout *GeometryBuffer::descriptorSetLayout() {
+  return &m_descriptorSetLayout;
+}
+
+VkDescriptorSet GeometryBuffer::descriptorSet() { return m_descriptorSet; }
+
+void GeometryBuffer::shutdown(VkDevice device) {
+  if (!device) {
+    return;
+  }
+
+  if (m_descriptorPool) {
+    vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+    m_descriptorPool = VK_NULL_HANDLE;
+    m_descriptorSet = VK_NULL_HANDLE;
+  }
+
+  if (m_descriptorSetLayout) {
+    vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+    m_descriptorSetLayout = VK_NULL_HANDLE;
+  }
+
+  // Freeing mapped memory unmaps it.
+  DestroyBuffer(device, m_vertexBuffer, m_vertexMemory);
+  DestroyBuffer(device, m_vertexStaging, m_vertexStagingMemory);
+  m_vertexMapped = nullptr;
+  DestroyBuffer(device, m_indexBuffer, m_indexMemory);
+  DestroyBuffer(device, m_indexStaging, m_indexStagingMemory);
+  m_indexMapped = nullptr;
+  DestroyBuffer(device, m_drawBuffer, m_drawMemory);
+  m_drawMapped = nullptr;
+  DestroyBuffer(device, m_indirectBuffer, m_indirectMemory);
+  m_indirectMapped = nullptr;
+}
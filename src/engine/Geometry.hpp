@@ -0,0 +1,133 @@
+#pragma once
+
+#include "Math.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Renderer; // forward declaration
+
+static constexpr int kPulledAttributeCount = 5;
+
+// Where a mesh lives inside the shared GeometryBuffer. Offsets are in floats
+// (vertices) and uint32 elements (indices), which is how pull.vert indexes
+// the storage buffers.
+struct GeometryRange {
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+  uint32_t vertexOffset = 0;
+  uint32_t vertexStride = 0;
+  // Float offset of each VertexAttribute within a vertex, -1 when absent.
+  int32_t attributeOffsets[kPulledAttributeCount] = {-1, -1, -1, -1, -1};
+};
+
+// Push constants shared by the fixed-function and vertex pulling pipelines.
+// The pulled ones ignore model and read their PulledDraw record instead.
+struct DrawPush {
+  Mat4 model;
+  // Index into ShadowParams::lightViewProj, read by the shadow pipelines.
+  uint32_t shadowCascade = 0;
+};
+
+static_assert(sizeof(DrawPush) <= 128, "DrawPush exceeds push constant limit");
+// pull.glsl only declares this member of the block.
+static_assert(offsetof(DrawPush, shadowCascade) == 64,
+              "pull.glsl reads shadowCascade at offset 64");
+
+// Per-draw data of the vertex pulling path, read by pull.glsl as
+// draws[gl_InstanceIndex]. Matches `PulledDraw` there (std430).
+struct PulledDraw {
+  Mat4 model;
+  uint32_t vertexOffset = 0;
+  uint32_t vertexStride = 0;
+  int32_t attributeOffsets[kPulledAttributeCount] = {-1, -1, -1, -1, -1};
+  uint32_t padding = 0;
+};
+
+static_assert(sizeof(PulledDraw) == 96, "PulledDraw must match pull.glsl");
+
+// One vertex and one index storage buffer that every pulled mesh appends
+// into, so meshes with different VertexAttribute sets share a single pipeline
+// and a single descriptor set (set 1). Both live in device local memory;
+// append() writes a host visible staging copy and beginFrame() uploads what
+// is new.
+//
+// The set also carries each frame slot's PulledDraw records (binding 2, a
+// dynamic offset per slot) and the matching indirect commands, so a whole
+// draw list is one vkCmdDrawIndirect.
+class GeometryBuffer {
+public:
+  // Pulled draws per frame slot, over the main view and every cascade.
+  static constexpr uint32_t kMaxDraws = 16384;
+
+  GeometryBuffer() = default;
+  ~GeometryBuffer() = default;
+
+  void init(Renderer &renderer, uint32_t maxVertexFloats,
+            uint32_t maxIndices);
+
+  // Copies mesh data in and returns its range, false when the buffer is full.
+  // The range is drawable from the next beginFrame() on. Scenes load before
+  // the render thread starts, so this never races beginFrame().
+  bool append(const std::vector<float> &vertexData, uint32_t vertexStride,
+              const std::vector<uint32_t> &indices, GeometryRange &outRange);
+
+  // Render thread, before any pulled draw is recorded: uploads appended
+  // geometry and starts frameIndex's draw records over.
+  void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+
+  // Reserves count consecutive draws in this frame's records and returns
+  // the first; count is clamped to what is left.
+  uint32_t reserveDraws(uint32_t &count);
+  void writeDraw(uint32_t draw, const Mat4 &model,
+                 const GeometryRange &range);
+
+  VkBuffer indirectBuffer() { return m_indirectBuffer; }
+  VkDeviceSize indirectOffset(uint32_t draw);
+  // Dynamic offset of binding 2 for this frame's records.
+  uint32_t drawsOffset();
+
+  VkDescriptorSetLayout *descriptorSetLayout();
+  VkDescriptorSet descriptorSet();
+
+  void shutdown(VkDevice device);
+
+private:
+  uint32_t m_maxVertexFloats = 0;
+  uint32_t m_maxIndices = 0;
+
+  uint32_t m_vertexFloats = 0;
+  uint32_t m_indices = 0;
+  uint32_t m_uploadedVertexFloats = 0;
+  uint32_t m_uploadedIndices = 0;
+
+  VkBuffer m_vertexBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory m_vertexMemory = VK_NULL_HANDLE;
+  VkBuffer m_vertexStaging = VK_NULL_HANDLE;
+  VkDeviceMemory m_vertexStagingMemory = VK_NULL_HANDLE;
+  float *m_vertexMapped = nullptr;
+
+  VkBuffer m_indexBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory m_indexMemory = VK_NULL_HANDLE;
+  VkBuffer m_indexStaging = VK_NULL_HANDLE;
+  VkDeviceMemory m_indexStagingMemory = VK_NULL_HANDLE;
+  uint32_t *m_indexMapped = nullptr;
+
+  // kMaxDraws per frame slot, written by the render thread.
+  VkBuffer m_drawBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory m_drawMemory = VK_NULL_HANDLE;
+  PulledDraw *m_drawMapped = nullptr;
+  VkBuffer m_indirectBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory m_indirectMemory = VK_NULL_HANDLE;
+  VkDrawIndirectCommand *m_indirectMapped = nullptr;
+  int m_frameIndex = 0;
+  uint32_t m_drawCount = 0;
+  bool m_drawsWarned = false;
+
+  VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+  VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+};
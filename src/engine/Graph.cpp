@@ -0,0 +1,823 @@
+#include "../Vulkan.hpp"
+
+#include "Graph.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+GraphAccess GraphComputeStorageRead() {
+  return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+          VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL};
+}
+
+GraphAccess GraphComputeStorageWrite() {
+  return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+          VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL};
+}
+
+GraphAccess GraphFragmentStorageRead() {
+  return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+          VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL};
+}
+
+GraphAccess GraphFragmentSampledRead() {
+  return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+          VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+}
+
+GraphAccess GraphDepthSampledRead() {
+  return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+          VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+          VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+}
+
+GraphAccess GraphColorAttachmentWrite() {
+  return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+          VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+}
+
+GraphAccess GraphDepthAttachmentWrite() {
+  return {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+              VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+          VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+              VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+          VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+}
+
+GraphAccess GraphRenderPassAccess(GraphAccess access,
+                                  VkImageLayout finalLayout) {
+  access.layout = finalLayout;
+  access.layoutManagedByPass = true;
+  return access;
+}
+
+void RenderGraph::init(VkPhysicalDevice physicalDevice, VkDevice device) {
+  m_physicalDevice = physicalDevice;
+  m_device = device;
+}
+
+void RenderGraph::begin(uint64_t completedValue, uint64_t submittedValue,
+                        FrameArena &arena) {
+  m_submittedValue = submittedValue;
+  m_arena = &arena;
+
+  m_resources.clear();
+  releasePasses();
+
+  // Anything replaced by a recompile may still be in use by frames in
+  // flight; keep it until they have all retired.
+  auto expired = [this, completedValue](Retired &retired) {
+    if (retired.value > completedValue) {
+      return false;
+    }
+    destroyTransients(retired.images, retired.blocks);
+    return true;
+  };
+  m_retired.erase(std::remove_if(m_retired.begin(), m_retired.end(), expired),
+                  m_retired.end());
+}
+
+GraphResource RenderGraph::importImage(const char *name, VkImage image,
+                                       VkImageAspectFlags aspect,
+                                       VkImageLayout initialLayout,
+                                       VkPipelineStageFlags2 initialStage,
+                                       VkAccessFlags2 initialAccess) {
+  Resource resource{};
+  resource.name = name;
+  resource.isImage = true;
+  resource.imported = true;
+  resource.image = image;
+  resource.aspect = aspect;
+  resource.initial = {initialStage, initialAccess, initialLayout};
+
+  m_resources.push_back(resource);
+  return (GraphResource)(m_resources.size() - 1);
+}
+
+GraphResource RenderGraph::importBuffer(const char *name, VkBuffer buffer,
+                                        VkPipelineStageFlags2 initialStage,
+                                        VkAccessFlags2 initialAccess) {
+  Resource resource{};
+  resource.name = name;
+  resource.imported = true;
+  resource.buffer = buffer;
+  resource.initial = {initialStage, initialAccess};
+
+  m_resources.push_back(resource);
+  return (GraphResource)(m_resources.size() - 1);
+}
+
+GraphResource
+RenderGraph::createImage(const char *name,
+                         const GraphImageDescription &description) {
+  Resource resource{};
+  resource.name = name;
+  resource.isImage = true;
+  resource.aspect = description.aspect;
+  resource.description = description;
+
+  m_resources.push_back(resource);
+  return (GraphResource)(m_resources.size() - 1);
+}
+
+void RenderGraph::markOutput(GraphResource resource,
+                             VkImageLayout finalLayout) {
+  m_resources[resource].output = true;
+  m_resources[resource].finalLayout = finalLayout;
+}
+
+uint32_t RenderGraph::addPass(const char *name, PassFunction invoke,
+                              const void *callable) {
+  Pass *pass = m_passPool.acquire();
+  pass->name = name;
+  pass->invoke = invoke;
+  pass->callable = callable;
+  pass->uses.clear();
+
+  m_passes.push_back(pass);
+  return (uint32_t)(m_passes.size() - 1);
+}
+
+void RenderGraph::releasePasses() {
+  for (Pass *pass : m_passes) {
+    m_passPool.release(pass);
+  }
+  m_passes.clear();
+}
+
+void RenderGraph::read(uint32_t pass, GraphResource resource,
+                       GraphAccess access) {
+  m_passes[pass]->uses.push_back({resource, access, false});
+}
+
+// Writes are full overwrites; a pass that accumulates into a resource
+// declares a read as well.
+void RenderGraph::write(uint32_t pass, GraphResource resource,
+                        GraphAccess access) {
+  m_passes[pass]->uses.push_back({resource, access, true});
+}
+
+bool RenderGraph::compile() {
+  const uint64_t topologyHash = hashTopology();
+  if (m_compiled && topologyHash == m_topologyHash) {
+    return false;
+  }
+
+  m_topologyHash = topologyHash;
+  m_compiled = true;
+
+  cull();
+  retireTransients();
+  allocateTransients();
+  planBarriers();
+
+  uint32_t culledCount = 0;
+  for (bool culled : m_passCulled) {
+    culledCount += culled ? 1 : 0;
+  }
+
+  size_t barrierCount = m_finalBarriers.size();
+  for (const PlannedPass &planned : m_plan) {
+    barrierCount += planned.barriers.size();
+  }
+
+  constexpr double kMiB = 1024.0 * 1024.0;
+  Log::info("Render graph: %zu passes (%u culled), %zu barriers, %g MiB "
+            "transient (%g MiB unaliased)",
+            m_passes.size(), culledCount, barrierCount,
+            transientBytes() / kMiB, transientBytesWithoutAliasing() / kMiB);
+
+  return true;
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer,
+                          GpuProfiler *profiler) {
+  const bool profiled = profiler && Profiler::active();
+
+  for (const PlannedPass &planned : m_plan) {
+    recordBarriers(commandBuffer, planned.barriers);
+
+    const Pass &pass = *m_passes[planned.pass];
+    if (profiled) {
+      profiler->beginZone(commandBuffer, pass.name);
+    }
+    if (pass.invoke) {
+      pass.invoke(pass.callable, commandBuffer);
+    }
+    if (profiled) {
+      profiler->endZone(commandBuffer);
+    }
+  }
+
+  recordBarriers(commandBuffer, m_finalBarriers);
+}
+
+VkImage RenderGraph::image(GraphResource resource) {
+  if (m_resources[resource].imported) {
+    return m_resources[resource].image;
+  }
+  return resource < m_transientImages.size()
+             ? m_transientImages[resource].image
+             : VK_NULL_HANDLE;
+}
+
+VkImageView RenderGraph::imageView(GraphResource resource) {
+  if (m_resources[resource].imported) {
+    return VK_NULL_HANDLE; // owned by whoever imported it
+  }
+  return resource < m_transientImages.size() ? m_transientImages[resource].view
+                                             : VK_NULL_HANDLE;
+}
+
+const std::vector<RenderGraph::PlannedBarrier> *
+RenderGraph::plannedBarriers(uint32_t pass) {
+  for (const PlannedPass &planned : m_plan) {
+    if (planned.pass == pass) {
+      return &planned.barriers;
+    }
+  }
+  return nullptr;
+}
+
+bool RenderGraph::culled(uint32_t pass) {
+  return pass < m_passCulled.size() && m_passCulled[pass];
+}
+
+VkDeviceSize RenderGraph::transientBytes() {
+  VkDeviceSize bytes = 0;
+  for (const TransientBlock &block : m_transientBlocks) {
+    bytes += block.size;
+  }
+  return bytes;
+}
+
+VkDeviceSize RenderGraph::transientBytesWithoutAliasing() {
+  VkDeviceSize bytes = 0;
+  for (const TransientImage &transient : m_transientImages) {
+    if (transient.image) {
+      bytes += transient.memoryRequirements.size;
+    }
+  }
+  return bytes;
+}
+
+void RenderGraph::shutdown(VkDevice device) {
+  if (!device) {
+    return;
+  }
+
+  for (Retired &retired : m_retired) {
+    destroyTransients(retired.images, retired.blocks);
+  }
+  m_retired.clear();
+
+  destroyTransients(m_transientImages, m_transientBlocks);
+
+  m_resources.clear();
+  releasePasses();
+  m_plan.clear();
+  m_finalBarriers.clear();
+  m_passCulled.clear();
+  m_compiled = false;
+}
+
+uint64_t RenderGraph::hashTopology() {
+  // FNV-1a over everything that shapes the plan; handles are left out.
+  uint64_t hash = 1469598103934665603ull;
+  auto mix = [&hash](const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < size; ++i) {
+      hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+  };
+  auto mixValue = [&mix](auto value) { mix(&value, sizeof(value)); };
+  auto mixAccess = [&mixValue](const GraphAccess &access) {
+    mixValue(access.stage);
+    mixValue(access.access);
+    mixValue(access.layout);
+    mixValue(access.layoutManagedByPass);
+  };
+
+  mixValue(m_resources.size());
+  for (const Resource &resource : m_resources) {
+    mix(resource.name, std::strlen(resource.name));
+    mixValue(resource.isImage);
+    mixValue(resource.imported);
+    mixValue(resource.aspect);
+    mixAccess(resource.initial);
+    mixValue(resource.output);
+    mixValue(resource.finalLayout);
+    if (!resource.imported) {
+      mixValue(resource.description.format);
+      mixValue(resource.description.extent.width);
+      mixValue(resource.description.extent.height);
+      mixValue(resource.description.samples);
+      mixValue(resource.description.usage);
+    }
+  }
+
+  mixValue(m_passes.size());
+  for (const Pass *pass : m_passes) {
+    mix(pass->name, std::strlen(pass->name));
+    mixValue(pass->uses.size());
+    for (const Use &use : pass->uses) {
+      mixValue(use.resource);
+      mixValue(use.write);
+      mixAccess(use.access);
+    }
+  }
+
+  return hash;
+}
+
+void RenderGraph::cull() {
+  // Walk backwards from the outputs: a pass survives if something
+  // downstream (or an output) consumes one of its writes.
+  m_passCulled.assign(m_passes.size(), true);
+  std::vector<bool> needed(m_resources.size(), false);
+
+  for (size_t r = 0; r < m_resources.size(); ++r) {
+    needed[r] = m_resources[r].output;
+  }
+
+  for (size_t p = m_passes.size(); p-- > 0;) {
+    bool keep = false;
+    for (const Use &use : m_passes[p]->uses) {
+      keep = keep || (use.write && needed[use.resource]);
+    }
+    if (!keep) {
+      continue;
+    }
+
+    m_passCulled[p] = false;
+    for (const Use &use : m_passes[p]->uses) {
+      if (!use.write) {
+        needed[use.resource] = true;
+      }
+    }
+  }
+}
+
+void RenderGraph::allocateTransients() {
+  m_transientImages.assign(m_resources.size(), TransientImage{});
+  m_transientBlocks.clear();
+
+  // Lifetimes in execution order, ignoring culled passes.
+  uint32_t order = 0;
+  for (size_t p = 0; p < m_passes.size(); ++p) {
+    if (m_passCulled[p]) {
+      continue;
+    }
+    for (const Use &use : m_passes[p]->uses) {
+      if (m_resources[use.resource].imported) {
+        continue;
+      }
+      TransientImage &transient = m_transientImages[use.resource];
+      transient.firstPass = std::min(transient.firstPass, order);
+      transient.lastPass = std::max(transient.lastPass, order);
+    }
+    ++order;
+  }
+
+  std::vector<GraphResource> transients;
+  for (size_t r = 0; r < m_resources.size(); ++r) {
+    const Resource &resource = m_resources[r];
+    TransientImage &transient = m_transientImages[r];
+    if (resource.imported || transient.firstPass == UINT32_MAX) {
+      continue;
+    }
+
+    VkImageCreateInfo imageCreateInfo{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.extent = {resource.description.extent.width,
+                              resource.description.extent.height, 1};
+    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.format = resource.description.format;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageCreateInfo.usage = resource.description.usage;
+    imageCreateInfo.samples = resource.description.samples;
+    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateImage(m_device, &imageCreateInfo, nullptr, &transient.image) !=
+        VK_SUCCESS) {
+      std::cerr << "Failed to create graph image " << resource.name
+                << std::endl;
+      std::abort();
+    }
+
+    vkGetImageMemoryRequirements(m_device, transient.image,
+                                 &transient.memoryRequirements);
+    transients.push_back((GraphResource)r);
+  }
+
+  // Largest first, so every block is sized by its first occupant and later
+  // (smaller) images only need a free lifetime slot.
+  std::sort(transients.begin(), transients.end(),
+            [this](GraphResource a, GraphResource b) {
+              return m_transientImages[a].memoryRequirements.size >
+                     m_transientImages[b].memoryRequirements.size;
+            });
+
+  for (GraphResource r : transients) {
+    TransientImage &transient = m_transientImages[r];
+
+    for (uint32_t b = 0; b < m_transientBlocks.size(); ++b) {
+      TransientBlock &block = m_transientBlocks[b];
+
+      const uint32_t memoryTypeBits =
+          block.memoryTypeBits & transient.memoryRequirements.memoryTypeBits;
+      if (transient.memoryRequirements.size > block.size ||
+          FindMemoryType(m_physicalDevice, memoryTypeBits,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) == UINT32_MAX) {
+        continue;
+      }
+
+      bool overlaps = false;
+      for (GraphResource occupant : block.occupants) {
+        const TransientImage &other = m_transientImages[occupant];
+        overlaps = overlaps || (transient.firstPass <= other.lastPass &&
+                                other.firstPass <= transient.lastPass);
+      }
+      if (overlaps) {
+        continue;
+      }
+
+      block.memoryTypeBits = memoryTypeBits;
+      block.occupants.push_back(r);
+      transient.block = b;
+      break;
+    }
+
+    if (transient.block == UINT32_MAX) {
+      TransientBlock block{};
+      block.size = transient.memoryRequirements.size;
+      block.memoryTypeBits = transient.memoryRequirements.memoryTypeBits;
+      block.occupants.push_back(r);
+
+      transient.block = (uint32_t)m_transientBlocks.size();
+      m_transientBlocks.push_back(block);
+    }
+  }
+
+  for (TransientBlock &block : m_transientBlocks) {
+    // Blocks holding only attachments that never leave tile memory may be
+    // lazily allocated, like the renderer's own (see CreateImage2D).
+    bool lazy = true;
+    for (GraphResource occupant : block.occupants) {
+      lazy = lazy && (m_resources[occupant].description.usage &
+                      VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
+    }
+    uint32_t memoryType = UINT32_MAX;
+    if (lazy) {
+      memoryType = FindMemoryType(m_physicalDevice, block.memoryTypeBits,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                                      VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+    }
+    if (memoryType == UINT32_MAX) {
+      memoryType = FindMemoryType(m_physicalDevice, block.memoryTypeBits,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+
+    VkMemoryAllocateInfo memoryAllocateInfo{
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    memoryAllocateInfo.allocationSize = block.size;
+    memoryAllocateInfo.memoryTypeIndex = memoryType;
+
+    if (vkAllocateMemory(m_device, &memoryAllocateInfo, nullptr,
+                         &block.memory) != VK_SUCCESS) {
+      std::cerr << "Failed to allocate graph transient memory" << std::endl;
+      std::abort();
+    }
+
+    for (GraphResource occupant : block.occupants) {
+      TransientImage &transient = m_transientImages[occupant];
+      vkBindImageMemory(m_device, transient.image, block.memory, 0);
+
+      transient.view =
+          CreateImageView(m_device, transient.image,
+                          m_resources[occupant].description.format,
+                          m_resources[occupant].aspect);
+      if (!transient.view) {
+        std::cerr << "Failed to create graph image view "
+                  << m_resources[occupant].name << std::endl;
+        std::abort();
+      }
+    }
+  }
+}
+
+void RenderGraph::planBarriers() {
+  // Last known state of every resource while walking the plan.
+  struct State {
+    VkPipelineStageFlags2 writeStage = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+    VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 readAccess = VK_ACCESS_2_NONE;
+    // Reader whose barrier last changed the layout. The transition is a
+    // write too, so later readers are ordered after it through this stage
+    // while the write fields keep naming the real writer.
+    VkPipelineStageFlags2 transitionStage = VK_PIPELINE_STAGE_2_NONE;
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  };
+
+  std::vector<State> states(m_resources.size());
+  for (size_t r = 0; r < m_resources.size(); ++r) {
+    const Resource &resource = m_resources[r];
+    if (resource.imported) {
+      states[r].writeStage = resource.initial.stage;
+      states[r].writeAccess = resource.initial.access;
+      states[r].layout = resource.initial.layout;
+    } else {
+      // Aliased memory may still be in use by an earlier occupant (this
+      // frame or the previous one); start from "anything" and UNDEFINED.
+      states[r].writeStage = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+      states[r].writeAccess = VK_ACCESS_2_MEMORY_WRITE_BIT;
+    }
+  }
+
+  m_plan.clear();
+  m_finalBarriers.clear();
+
+  for (size_t p = 0; p < m_passes.size(); ++p) {
+    if (m_passCulled[p]) {
+      continue;
+    }
+
+    PlannedPass planned{};
+    planned.pass = (uint32_t)p;
+
+    for (const Use &use : m_passes[p]->uses) {
+      const Resource &resource = m_resources[use.resource];
+      State &state = states[use.resource];
+
+      const bool transition = resource.isImage &&
+                              !use.access.layoutManagedByPass &&
+                              state.layout != use.access.layout;
+
+      PlannedBarrier barrier{};
+      barrier.resource = use.resource;
+      barrier.dstStage = use.access.stage;
+      barrier.dstAccess = use.access.access;
+
+      bool needed = transition;
+      if (use.write || transition) {
+        // Write-after-write/read, or a layout change (itself a write).
+        barrier.srcStage = state.writeStage | state.readStages;
+        barrier.srcAccess = state.writeAccess;
+        needed = needed || barrier.srcStage != VK_PIPELINE_STAGE_2_NONE;
+      } else if ((state.readStages & use.access.stage) != use.access.stage ||
+                 (state.readAccess & use.access.access) != use.access.access) {
+        // Read-after-write not already covered by an earlier read barrier.
+        barrier.srcStage = state.writeStage | state.transitionStage;
+        barrier.srcAccess = state.writeAccess;
+        needed = barrier.srcStage != VK_PIPELINE_STAGE_2_NONE;
+      }
+
+      if (needed) {
+        if (transition) {
+          barrier.oldLayout = state.layout;
+          barrier.newLayout = use.access.layout;
+        } else if (resource.isImage && !use.access.layoutManagedByPass) {
+          barrier.oldLayout = state.layout;
+          barrier.newLayout = state.layout;
+        }
+        planned.barriers.push_back(barrier);
+      }
+
+      if (use.write) {
+        state.writeStage = use.access.stage;
+        state.writeAccess = use.access.access;
+        state.readStages = VK_PIPELINE_STAGE_2_NONE;
+        state.readAccess = VK_ACCESS_2_NONE;
+        state.transitionStage = VK_PIPELINE_STAGE_2_NONE;
+      } else if (transition) {
+        state.transitionStage = use.access.stage;
+        state.readStages = use.access.stage;
+        state.readAccess = use.access.access;
+      } else {
+        state.readStages |= use.access.stage;
+        state.readAccess |= use.access.access;
+      }
+
+      if (resource.isImage) {
+        state.layout = use.access.layout;
+      }
+    }
+
+    m_plan.push_back(std::move(planned));
+  }
+
+  for (size_t r = 0; r < m_resources.size(); ++r) {
+    const Resource &resource = m_resources[r];
+    const State &state = states[r];
+    if (!resource.isImage || !resource.output ||
+        resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED ||
+        resource.finalLayout == state.layout) {
+      continue;
+    }
+
+    PlannedBarrier barrier{};
+    barrier.resource = (GraphResource)r;
+    barrier.srcStage = state.writeStage | state.readStages;
+    barrier.srcAccess = state.writeAccess;
+    barrier.oldLayout = state.layout;
+    barrier.newLayout = resource.finalLayout;
+    m_finalBarriers.push_back(barrier);
+  }
+}
+
+void RenderGraph::retireTransients() {
+  bool any = !m_transientBlocks.empty();
+  for (const TransientImage &transient : m_transientImages) {
+    any = any || transient.image;
+  }
+  if (!any) {
+    return;
+  }
+
+  Retired retired{};
+  retired.value = m_submittedValue;
+  retired.images = std::move(m_transientImages);
+  retired.blocks = std::move(m_transientBlocks);
+  m_retired.push_back(std::move(retired));
+
+  m_transientImages.clear();
+  m_transientBlocks.clear();
+}
+
+void RenderGraph::destroyTransients(std::vector<TransientImage> &images,
+                                    std::vector<TransientBlock> &blocks) {
+  if (!m_device) {
+    return;
+  }
+
+  for (TransientImage &transient : images) {
+    if (transient.view) {
+      vkDestroyImageView(m_device, transient.view, nullptr);
+    }
+    if (transient.image) {
+      vkDestroyImage(m_device, transient.image, nullptr);
+    }
+  }
+  images.clear();
+
+  for (TransientBlock &block : blocks) {
+    if (block.memory) {
+      vkFreeMemory(m_device, block.memory, nullptr);
+    }
+  }
+  blocks.clear();
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer,
+                                 const std::vector<PlannedBarrier> &barriers) {
+  if (barriers.empty()) {
+    return;
+  }
+
+  // Scratch for this call only; each list holds at most every barrier.
+  VkMemoryBarrier2 *memoryBarriers =
+      m_arena->allocateArray<VkMemoryBarrier2>(barriers.size());
+  VkBufferMemoryBarrier2 *bufferMemoryBarriers =
+      m_arena->allocateArray<VkBufferMemoryBarrier2>(barriers.size());
+  VkImageMemoryBarrier2 *imageMemoryBarriers =
+      m_arena->allocateArray<VkImageMemoryBarrier2>(barriers.size());
+  uint32_t memoryBarrierCount = 0;
+  uint32_t bufferMemoryBarrierCount = 0;
+  uint32_t imageMemoryBarrierCount = 0;
+
+  for (const PlannedBarrier &barrier : barriers) {
+    const Resource &resource = m_resources[barrier.resource];
+
+    if (resource.isImage && barrier.newLayout != VK_IMAGE_LAYOUT_UNDEFINED) {
+      VkImageMemoryBarrier2 imageMemoryBarrier{
+          VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+      imageMemoryBarrier.srcStageMask = barrier.srcStage;
+      imageMemoryBarrier.srcAccessMask = barrier.srcAccess;
+      imageMemoryBarrier.dstStageMask = barrier.dstStage;
+      imageMemoryBarrier.dstAccessMask = barrier.dstAccess;
+      imageMemoryBarrier.oldLayout = barrier.oldLayout;
+      imageMemoryBarrier.newLayout = barrier.newLayout;
+      imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      imageMemoryBarrier.image = image(barrier.resource);
+      imageMemoryBarrier.subresourceRange = {resource.aspect, 0,
+                                             VK_REMAINING_MIP_LEVELS, 0,
+                                             VK_REMAINING_ARRAY_LAYERS};
+      imageMemoryBarriers[imageMemoryBarrierCount++] = imageMemoryBarrier;
+    } else if (!resource.isImage) {
+      VkBufferMemoryBarrier2 bufferMemoryBarrier{
+          VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2};
+      bufferMemoryBarrier.srcStageMask = barrier.srcStage;
+      bufferMemoryBarrier.srcAccessMask = barrier.srcAccess;
+      bufferMemoryBarrier.dstStageMask = barrier.dstStage;
+      bufferMemoryBarrier.dstAccessMask = barrier.dstAccess;
+      bufferMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      bufferMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      bufferMemoryBarrier.buffer = resource.buffer;
+      bufferMemoryBarrier.offset = 0;
+      bufferMemoryBarrier.size = VK_WHOLE_SIZE;
+      bufferMemoryBarriers[bufferMemoryBarrierCount++] = bufferMemoryBarrier;
+    } else {
+      // Layout owned by a VkRenderPass: order the work, leave the layout.
+      VkMemoryBarrier2 memoryBarrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+      memoryBarrier.srcStageMask = barrier.srcStage;
+      memoryBarrier.srcAccessMask = barrier.srcAccess;
+      memoryBarrier.dstStageMask = barrier.dstStage;
+      memoryBarrier.dstAccessMask = barrier.dstAccess;
+      memoryBarriers[memoryBarrierCount++] = memoryBarrier;
+    }
+  }
+
+  VkDependencyInfo dependencyInfo{VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+  dependencyInfo.memoryBarrierCount = memoryBarrierCount;
+  dependencyInfo.pMemoryBarriers = memoryBarriers;
+  dependencyInfo.bufferMemoryBarrierCount = bufferMemoryBarrierCount;
+  dependencyInfo.pBufferMemoryBarriers = bufferMemoryBarriers;
+  dependencyInfo.imageMemoryBarrierCount = imageMemoryBarrierCount;
+  dependencyInfo.pImageMemoryBarriers = imageMemoryBarriers;
+
+  vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+bool RunGraphSelfCheck() {
+  // Planning only: no device, and every image is imported.
+  RenderGraph graph;
+  graph.init(VK_NULL_HANDLE, VK_NULL_HANDLE);
+  FrameArena arena;
+  graph.begin(0, 0, arena);
+
+  GraphResource image = graph.importImage(
+      "image", VK_NULL_HANDLE, VK_IMAGE_ASPECT_COLOR_BIT,
+      VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+  GraphResource target = graph.importImage(
+      "target", VK_NULL_HANDLE, VK_IMAGE_ASPECT_COLOR_BIT,
+      VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+  GraphResource result =
+      graph.importBuffer("result", VK_NULL_HANDLE, VK_PIPELINE_STAGE_2_NONE,
+                         VK_ACCESS_2_NONE);
+  graph.markOutput(target);
+  graph.markOutput(result);
+
+  // Write, a read that transitions the layout, then a read at another
+  // stage in the layout the transition left.
+  const GraphAccess computeSampledRead = {
+      VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+      VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+
+  uint32_t write = graph.addPass("write", [](VkCommandBuffer) {});
+  graph.write(write, image, GraphColorAttachmentWrite());
+  uint32_t transition = graph.addPass("transition", [](VkCommandBuffer) {});
+  graph.read(transition, image, GraphFragmentSampledRead());
+  graph.write(transition, target, GraphColorAttachmentWrite());
+  uint32_t read = graph.addPass("read", [](VkCommandBuffer) {});
+  graph.read(read, image, computeSampledRead);
+  graph.write(read, result, GraphComputeStorageWrite());
+
+  graph.compile();
+
+  const RenderGraph::PlannedBarrier *found = nullptr;
+  if (const auto *barriers = graph.plannedBarriers(read)) {
+    for (const RenderGraph::PlannedBarrier &barrier : *barriers) {
+      if (barrier.resource == image) {
+        found = &barrier;
+      }
+    }
+  }
+
+  // The writer's access is only valid with the writer's stage in scope,
+  // and the transitioning reader must be in scope to order after it.
+  const VkPipelineStageFlags2 srcStage =
+      VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT |
+      VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+  const bool ok =
+      found && found->srcStage == srcStage &&
+      found->srcAccess == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT &&
+      found->dstStage == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT &&
+      found->dstAccess == VK_ACCESS_2_SHADER_SAMPLED_READ_BIT &&
+      found->oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL &&
+      found->newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  std::printf("Render graph self-check\n");
+  if (found) {
+    std::printf("  read after transition: src 0x%llx / 0x%llx, dst 0x%llx "
+                "/ 0x%llx  %s\n",
+                (unsigned long long)found->srcStage,
+                (unsigned long long)found->srcAccess,
+                (unsigned long long)found->dstStage,
+                (unsigned long long)found->dstAccess, ok ? "ok" : "FAIL");
+  } else {
+    std::printf("  read after transition: no barrier  FAIL\n");
+  }
+
+  graph.shutdown(VK_NULL_HANDLE);
+  return ok;
+}
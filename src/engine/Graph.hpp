@@ -0,0 +1,238 @@
+#pragma once
+
+#include "Memory.hpp"
+#include "Profiler.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// Index of an image or buffer declared in the current frame's graph.
+using GraphResource = uint32_t;
+static constexpr GraphResource kInvalidGraphResource = UINT32_MAX;
+
+// How a pass touches a resource, in synchronization2 terms.
+struct GraphAccess {
+  VkPipelineStageFlags2 stage = VK_PIPELINE_STAGE_2_NONE;
+  VkAccessFlags2 access = VK_ACCESS_2_NONE;
+  VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED; // images only
+  // The pass's own VkRenderPass transitions the image (initialLayout /
+  // finalLayout); the graph only orders the pass and records `layout` as the
+  // state it leaves behind.
+  bool layoutManagedByPass = false;
+};
+
+GraphAccess GraphComputeStorageRead();
+GraphAccess GraphComputeStorageWrite();
+GraphAccess GraphFragmentStorageRead();
+GraphAccess GraphFragmentSampledRead();
+GraphAccess GraphDepthSampledRead();
+GraphAccess GraphColorAttachmentWrite();
+GraphAccess GraphDepthAttachmentWrite();
+// Wraps an attachment access of a VkRenderPass that ends in finalLayout.
+GraphAccess GraphRenderPassAccess(GraphAccess access, VkImageLayout finalLayout);
+
+// Graph-owned image that only lives within a frame. Transient images whose
+// pass ranges do not overlap share memory.
+struct GraphImageDescription {
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  VkExtent2D extent{};
+  VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+  VkImageUsageFlags usage = 0;
+  VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+};
+
+// Frame graph. Every frame the renderer re-declares its passes and the
+// named images and buffers they read and write, then calls compile() and
+// execute(). compile() hashes the declaration and only re-runs culling,
+// barrier planning and transient allocation when that topology changed;
+// imported handles (swapchain image, per-frame buffers) are bound at
+// execute time and are not part of the topology.
+//
+// Declaring a frame does not touch the heap once the graph has seen it:
+// passes are pooled, their record callbacks live in the frame's arena and
+// resource and pass names must be string literals (or otherwise outlive
+// the graph).
+class RenderGraph {
+public:
+  RenderGraph() = default;
+  ~RenderGraph() = default;
+
+  RenderGraph(const RenderGraph &) = delete;
+  RenderGraph &operator=(const RenderGraph &) = delete;
+
+  void init(VkPhysicalDevice physicalDevice, VkDevice device);
+
+  // Starts a new declaration. completedValue/submittedValue are the
+  // renderer's Timeline values; transient allocations replaced by a
+  // recompile are destroyed once every submission that could use them has
+  // completed. arena holds this frame's pass callbacks and must not be
+  // reset before execute().
+  void begin(uint64_t completedValue, uint64_t submittedValue,
+             FrameArena &arena);
+
+  // External resources. initial describes the last access before this
+  // frame; the default is the conservative "anything may have written it".
+  GraphResource importImage(const char *name, VkImage image,
+                            VkImageAspectFlags aspect,
+                            VkImageLayout initialLayout,
+                            VkPipelineStageFlags2 initialStage =
+                                VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                            VkAccessFlags2 initialAccess =
+                                VK_ACCESS_2_MEMORY_WRITE_BIT);
+  GraphResource importBuffer(const char *name, VkBuffer buffer,
+                             VkPipelineStageFlags2 initialStage =
+                                 VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                             VkAccessFlags2 initialAccess =
+                                 VK_ACCESS_2_MEMORY_WRITE_BIT);
+  GraphResource createImage(const char *name,
+                            const GraphImageDescription &description);
+
+  // Keeps whatever produces resource alive through culling. A finalLayout
+  // other than UNDEFINED adds a trailing transition.
+  void markOutput(GraphResource resource,
+                  VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED);
+
+  // record is copied into the frame arena, so it must be trivially
+  // destructible: capture pointers and values, not owning containers.
+  template <typename Record>
+  uint32_t addPass(const char *name, const Record &record) {
+    const Record *stored = m_arena->create<Record>(record);
+    return addPass(
+        name,
+        [](const void *callable, VkCommandBuffer commandBuffer) {
+          (*static_cast<const Record *>(callable))(commandBuffer);
+        },
+        stored);
+  }
+  void read(uint32_t pass, GraphResource resource, GraphAccess access);
+  void write(uint32_t pass, GraphResource resource, GraphAccess access);
+
+  // Returns true when the topology changed and the plan was rebuilt.
+  bool compile();
+  // With a profiler, every pass is a GPU zone.
+  void execute(VkCommandBuffer commandBuffer,
+               GpuProfiler *profiler = nullptr);
+
+  // Valid after compile(); transient images of culled passes are null.
+  VkImage image(GraphResource resource);
+  VkImageView imageView(GraphResource resource);
+
+  // Barriers are planned against resource indices and patched with the
+  // frame's handles at execute time.
+  struct PlannedBarrier {
+    GraphResource resource = kInvalidGraphResource;
+    VkPipelineStageFlags2 srcStage = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 srcAccess = VK_ACCESS_2_NONE;
+    VkPipelineStageFlags2 dstStage = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 dstAccess = VK_ACCESS_2_NONE;
+    VkImageLayout oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkImageLayout newLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  };
+
+  // Valid after compile(); null for culled passes.
+  const std::vector<PlannedBarrier> *plannedBarriers(uint32_t pass);
+  bool culled(uint32_t pass);
+  VkDeviceSize transientBytes();
+  VkDeviceSize transientBytesWithoutAliasing();
+
+  void shutdown(VkDevice device);
+
+private:
+  struct Resource {
+    const char *name = nullptr;
+    bool isImage = false;
+    bool imported = false;
+    VkImage image = VK_NULL_HANDLE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    GraphImageDescription description{};
+    GraphAccess initial{};
+    bool output = false;
+    VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  };
+
+  struct Use {
+    GraphResource resource = kInvalidGraphResource;
+    GraphAccess access{};
+    bool write = false;
+  };
+
+  using PassFunction = void (*)(const void *callable,
+                                VkCommandBuffer commandBuffer);
+
+  struct Pass {
+    const char *name = nullptr;
+    PassFunction invoke = nullptr;
+    const void *callable = nullptr; // in the frame arena
+    std::vector<Use> uses;
+  };
+
+  struct PlannedPass {
+    uint32_t pass = 0;
+    std::vector<PlannedBarrier> barriers;
+  };
+
+  // One memory block shared by transient images with disjoint lifetimes.
+  struct TransientBlock {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    uint32_t memoryTypeBits = 0;
+    std::vector<GraphResource> occupants;
+  };
+
+  struct TransientImage {
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkMemoryRequirements memoryRequirements{};
+    uint32_t firstPass = UINT32_MAX; // in plan order
+    uint32_t lastPass = 0;
+    uint32_t block = UINT32_MAX;
+  };
+
+  struct Retired {
+    uint64_t value = 0; // last timeline value that may reference it
+    std::vector<TransientImage> images;
+    std::vector<TransientBlock> blocks;
+  };
+
+  VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+  VkDevice m_device = VK_NULL_HANDLE;
+  uint64_t m_submittedValue = 0;
+  FrameArena *m_arena = nullptr;
+
+  // Current declaration. Passes keep their use lists' capacity between
+  // frames by going back to the pool instead of being destroyed.
+  std::vector<Resource> m_resources;
+  std::vector<Pass *> m_passes;
+  ObjectPool<Pass> m_passPool;
+
+  // Compiled plan for m_topologyHash.
+  uint64_t m_topologyHash = 0;
+  bool m_compiled = false;
+  std::vector<bool> m_passCulled;
+  std::vector<PlannedPass> m_plan;
+  std::vector<PlannedBarrier> m_finalBarriers;
+  std::vector<TransientImage> m_transientImages; // by resource index
+  std::vector<TransientBlock> m_transientBlocks;
+  std::vector<Retired> m_retired;
+
+  uint32_t addPass(const char *name, PassFunction invoke,
+                   const void *callable);
+  void releasePasses();
+
+  uint64_t hashTopology();
+  void cull();
+  void allocateTransients();
+  void planBarriers();
+  void retireTransients();
+  void destroyTransients(std::vector<TransientImage> &images,
+                         std::vector<TransientBlock> &blocks);
+  void recordBarriers(VkCommandBuffer commandBuffer,
+                      const std::vector<PlannedBarrier> &barriers);
+};
+
+// Plans a small graph without a device and checks its barriers (a read
+// after a layout-changing read). Run with --test-graph.
+bool RunGraphSelfCheck();
@@ -0,0 +1,305 @@
+#include "Jobs.hpp"
+
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+// Which pool (if any) the current thread works for, and its queue.
+static thread_local JobSystem *t_jobSystem = nullptr;
+static thread_local int t_workerIndex = -1;
+
+// Failed steal rounds before an idle worker sleeps.
+static constexpr int kIdleSpins = 64;
+
+JobSystem::~JobSystem() { shutdown(); }
+
+void JobSystem::init(int workerCount) {
+  if (workerCount < 0) {
+    const unsigned hardwareThreads = std::thread::hardware_concurrency();
+    workerCount = hardwareThreads > 1 ? (int)hardwareThreads - 1 : 0;
+  }
+
+  m_mainThread = std::this_thread::get_id();
+  m_running = true;
+
+  m_queues.clear();
+  for (int i = 0; i < workerCount; ++i) {
+    m_queues.push_back(std::make_unique<WorkQueue>());
+  }
+
+  for (int i = 0; i < workerCount; ++i) {
+    m_workers.emplace_back([this, i] { workerLoop((uint32_t)i); });
+  }
+}
+
+void JobSystem::shutdown() {
+  if (!m_running) {
+    return;
+  }
+
+  m_running = false;
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+  }
+  m_wake.notify_all();
+
+  for (std::thread &worker : m_workers) {
+    worker.join();
+  }
+  m_workers.clear();
+
+  // Finish whatever was still queued so nobody waits on a counter forever.
+  Job job;
+  while (findJob(-1, job) || popMainThreadJob(job)) {
+    execute(job);
+  }
+  m_queues.clear();
+}
+
+uint32_t JobSystem::threadCount() { return (uint32_t)m_workers.size() + 1; }
+
+void JobSystem::run(std::function<void()> job, JobCounter *counter,
+                    JobAffinity affinity) {
+  if (counter) {
+    counter->m_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if (affinity == MainThread) {
+    std::lock_guard<std::mutex> lock(m_mainQueue.mutex);
+    m_mainQueue.jobs.push_back({std::move(job), counter});
+    return;
+  }
+
+  WorkQueue &queue = t_jobSystem == this && t_workerIndex >= 0
+                         ? *m_queues[t_workerIndex]
+                         : m_injectionQueue;
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.jobs.push_back({std::move(job), counter});
+  }
+
+  m_pending.fetch_add(1);
+  wakeWorker();
+}
+
+void JobSystem::wait(JobCounter &counter) {
+  const bool mainThread = std::this_thread::get_id() == m_mainThread;
+  const int workerIndex = t_jobSystem == this ? t_workerIndex : -1;
+
+  while (!counter.done()) {
+    Job job;
+    if ((mainThread && popMainThreadJob(job)) || findJob(workerIndex, job)) {
+      execute(job);
+    } else {
+      // The remaining jobs are running elsewhere.
+      std::this_thread::yield();
+    }
+  }
+}
+
+void JobSystem::parallelFor(
+    uint32_t count, const std::function<void(uint32_t, uint32_t)> &body,
+    uint32_t minChunk) {
+  if (count == 0) {
+    return;
+  }
+
+  // A few chunks per thread so a slow chunk does not hold up the rest.
+  const uint32_t targetChunks = threadCount() * 4;
+  const uint32_t chunk = std::max(std::max(minChunk, 1u),
+                                  (count + targetChunks - 1) / targetChunks);
+
+  if (chunk >= count) {
+    body(0, count);
+    return;
+  }
+
+  JobCounter counter;
+  for (uint32_t begin = chunk; begin < count; begin += chunk) {
+    const uint32_t end = std::min(count, begin + chunk);
+    run([&body, begin, end] { body(begin, end); }, &counter);
+  }
+
+  body(0, chunk);
+  wait(counter);
+}
+
+void JobSystem::runMainThreadJobs() {
+  Job job;
+  while (popMainThreadJob(job)) {
+    execute(job);
+  }
+}
+
+void JobSystem::workerLoop(uint32_t index) {
+  t_jobSystem = this;
+  t_workerIndex = (int)index;
+  Profiler::setThreadName(
+      Profiler::intern("Worker " + std::to_string(index)));
+
+  int idle = 0;
+  while (m_running) {
+    Job job;
+    if (findJob((int)index, job)) {
+      execute(job);
+      idle = 0;
+      continue;
+    }
+
+    if (++idle < kIdleSpins) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    // Announce the sleep before the final check so run() either sees a
+    // sleeper to wake or we see its job.
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    m_sleeping.fetch_add(1);
+    m_wake.wait(lock, [this] { return m_pending.load() > 0 || !m_running; });
+    m_sleeping.fetch_sub(1);
+    idle = 0;
+  }
+
+  t_jobSystem = nullptr;
+  t_workerIndex = -1;
+}
+
+bool JobSystem::findJob(int workerIndex, Job &job) {
+  if (m_pending.load(std::memory_order_relaxed) == 0) {
+    return false;
+  }
+
+  auto take = [this, &job](WorkQueue &queue, bool back) {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty()) {
+      return false;
+    }
+    if (back) {
+      job = std::move(queue.jobs.back());
+      queue.jobs.pop_back();
+    } else {
+      job = std::move(queue.jobs.front());
+      queue.jobs.pop_front();
+    }
+    m_pending.fetch_sub(1);
+    return true;
+  };
+
+  // Own work first (newest), then new submissions, then steal (oldest).
+  if (workerIndex >= 0 && take(*m_queues[workerIndex], true)) {
+    return true;
+  }
+  if (take(m_injectionQueue, false)) {
+    return true;
+  }
+
+  const size_t queueCount = m_queues.size();
+  const size_t start = workerIndex >= 0 ? (size_t)workerIndex + 1 : 0;
+  for (size_t i = 0; i < queueCount; ++i) {
+    const size_t victim = (start + i) % queueCount;
+    if ((int)victim != workerIndex && take(*m_queues[victim], false)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool JobSystem::popMainThreadJob(Job &job) {
+  std::lock_guard<std::mutex> lock(m_mainQueue.mutex);
+  if (m_mainQueue.jobs.empty()) {
+    return false;
+  }
+  job = std::move(m_mainQueue.jobs.front());
+  m_mainQueue.jobs.pop_front();
+  return true;
+}
+
+void JobSystem::execute(Job &job) {
+  {
+    PROFILE_ZONE("Job");
+    job.function();
+  }
+  if (job.counter) {
+    job.counter->m_count.fetch_sub(1, std::memory_order_acq_rel);
+  }
+  job = Job{};
+}
+
+void JobSystem::wakeWorker() {
+  if (m_sleeping.load() == 0) {
+    return;
+  }
+
+  // Taking the lock orders this against a worker between its final check
+  // and the wait, so the notification cannot be lost.
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+  }
+  m_wake.notify_one();
+}
+
+void RunJobSystemBenchmark() {
+  using Clock = std::chrono::steady_clock;
+
+  // Enough arithmetic per element that the loop is compute bound, as
+  // culling and animation are.
+  const uint32_t elementCount = 1u << 20;
+  std::vector<float> values(elementCount);
+
+  auto workload = [&values](uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; ++i) {
+      float x = (float)i * 1e-6f + 1.0f;
+      for (int k = 0; k < 64; ++k) {
+        x = x * 0.999f + std::sqrt(x) * 0.001f;
+      }
+      values[i] = x;
+    }
+  };
+
+  const unsigned hardwareThreads =
+      std::max(1u, std::thread::hardware_concurrency());
+
+  std::printf("Job system scaling (%u elements, best of 5)\n", elementCount);
+  std::printf("threads      ms  speedup  efficiency  empty jobs/s\n");
+
+  double baseline = 0.0;
+  for (unsigned threads = 1; threads <= hardwareThreads; ++threads) {
+    JobSystem jobs;
+    jobs.init((int)threads - 1);
+
+    double best = 1e30;
+    for (int repeat = 0; repeat < 5; ++repeat) {
+      const Clock::time_point start = Clock::now();
+      jobs.parallelFor(elementCount, workload, 1024);
+      const double milliseconds =
+          std::chrono::duration<double, std::milli>(Clock::now() - start)
+              .count();
+      best = std::min(best, milliseconds);
+    }
+    if (threads == 1) {
+      baseline = best;
+    }
+
+    // Scheduling overhead: many jobs that do nothing.
+    const uint32_t emptyJobCount = 100000;
+    JobCounter counter;
+    const Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < emptyJobCount; ++i) {
+      jobs.run([] {}, &counter);
+    }
+    jobs.wait(counter);
+    const double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+
+    const double speedup = baseline / best;
+    std::printf("%7u %7.2f %8.2f %10.0f%% %13.0f\n", threads, best, speedup,
+                100.0 * speedup / threads, emptyJobCount / seconds);
+
+    jobs.shutdown();
+  }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Jobs with MainThread affinity only run on the thread that called
+// JobSystem::init() (SDL window and event calls must stay there).
+enum JobAffinity {
+  AnyThread = 0,
+  MainThread,
+};
+
+// Counts outstanding jobs. Pass one to run() for each job that should be
+// waited on together; JobSystem::wait() returns once it reaches zero.
+class JobCounter {
+public:
+  JobCounter() = default;
+
+  JobCounter(const JobCounter &) = delete;
+  JobCounter &operator=(const JobCounter &) = delete;
+
+  bool done() const { return m_count.load(std::memory_order_acquire) == 0; }
+
+private:
+  friend class JobSystem;
+  std::atomic<uint32_t> m_count{0};
+};
+
+// Work-stealing job system. Each worker owns a deque: it pushes and pops its
+// own jobs at the back (LIFO, cache warm) and steals from the front of the
+// others' (FIFO, oldest and usually largest). Jobs submitted from outside
+// the pool go to a shared injection queue. Threads that wait() on a counter
+// run jobs instead of blocking, so nested waits cannot deadlock the pool.
+class JobSystem {
+public:
+  JobSystem() = default;
+  ~JobSystem();
+
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  // A negative workerCount uses one worker per hardware thread besides this
+  // one; 0 runs every job on the main thread inside wait(). The calling
+  // thread becomes the main thread.
+  void init(int workerCount = -1);
+  void shutdown();
+
+  // Worker threads plus the main thread, which helps while waiting.
+  uint32_t threadCount();
+
+  void run(std::function<void()> job, JobCounter *counter = nullptr,
+           JobAffinity affinity = AnyThread);
+
+  // Runs jobs until counter reaches zero.
+  void wait(JobCounter &counter);
+
+  // Calls body(begin, end) over [0, count) in chunks of at least minChunk,
+  // sized so every thread gets a few to balance uneven work. Blocks until
+  // all chunks are done; the calling thread takes part.
+  void parallelFor(uint32_t count,
+                   const std::function<void(uint32_t, uint32_t)> &body,
+                   uint32_t minChunk = 64);
+
+  // Runs queued MainThread jobs; call once per frame from the main loop.
+  void runMainThreadJobs();
+
+private:
+  struct Job {
+    std::function<void()> function;
+    JobCounter *counter = nullptr;
+  };
+
+  // Guarded by a per-queue lock; contention is limited to steals.
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  std::vector<std::thread> m_workers;
+  std::vector<std::unique_ptr<WorkQueue>> m_queues; // one per worker
+  WorkQueue m_injectionQueue;
+  WorkQueue m_mainQueue;
+  std::thread::id m_mainThread;
+
+  std::atomic<bool> m_running{false};
+  // Jobs queued anywhere but the main queue; workers sleep when it is zero.
+  std::atomic<uint32_t> m_pending{0};
+  std::atomic<uint32_t> m_sleeping{0};
+  std::mutex m_sleepMutex;
+  std::condition_variable m_wake;
+
+  void workerLoop(uint32_t index);
+  bool findJob(int workerIndex, Job &job);
+  bool popMainThreadJob(Job &job);
+  void execute(Job &job);
+  void wakeWorker();
+};
+
+// Times a parallelFor workload with 1..hardware threads and prints speedup
+// and efficiency per thread count. Run with --bench-jobs.
+void RunJobSystemBenchmark();
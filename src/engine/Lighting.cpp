@@ -0,0 +1,302 @@
+#include "../Vulkan.hpp"
+
+#include "Lighting.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+void ClusteredLighting::init(VkPhysicalDevice physicalDevice, VkDevice device) {
+  const VkDeviceSize lightBufferSize = sizeof(Light) * kMaxLights;
+  const VkDeviceSize countBufferSize = sizeof(uint32_t) * kClusterCount;
+  const VkDeviceSize indexBufferSize =
+      sizeof(uint32_t) * kClusterCount * kMaxLightsPerCluster;
+
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    if (!CreateBuffer(physicalDevice, device, sizeof(ClusterParams),
+                      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                      m_paramsBuffers[i], m_paramsMemory[i])) {
+      std::cerr << "Failed to create cluster params buffer" << std::endl;
+      std::abort();
+    }
+
+    if (!CreateBuffer(physicalDevice, device, lightBufferSize,
+                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                      m_lightBuffers[i], m_lightMemory[i])) {
+      std::cerr << "Failed to create light buffer" << std::endl;
+      std::abort();
+    }
+
+    if (!CreateBuffer(physicalDevice, device, countBufferSize,
+                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_countBuffers[i],
+                      m_countMemory[i])) {
+      std::cerr << "Failed to create cluster count buffer" << std::endl;
+      std::abort();
+    }
+
+    if (!CreateBuffer(physicalDevice, device, indexBufferSize,
+                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexBuffers[i],
+                      m_indexMemory[i])) {
+      std::cerr << "Failed to create cluster index buffer" << std::endl;
+      std::abort();
+    }
+
+    vkMapMemory(device, m_paramsMemory[i], 0, sizeof(ClusterParams), 0,
+                &m_paramsMapped[i]);
+    vkMapMemory(device, m_lightMemory[i], 0, lightBufferSize, 0,
+                &m_lightMapped[i]);
+  }
+
+  createDescriptors(device);
+  createPipeline(device);
+}
+
+void ClusteredLighting::update(int frameIndex, const Camera &camera,
+                               const std::vector<Light> &lights,
+                               VkExtent2D extent) {
+  const uint32_t lightCount =
+      (uint32_t)std::min<size_t>(lights.size(), kMaxLights);
+
+  if (lightCount) {
+    std::memcpy(m_lightMapped[frameIndex], lights.data(),
+                sizeof(Light) * lightCount);
+  }
+
+  const CameraUBO &ubo = camera.ubo();
+  const float zNear = camera.zNear();
+  const float zFar = camera.zFar();
+
+  ClusterParams params{};
+  params.view = ubo.view;
+  params.invProj = inverse(ubo.proj);
+  params.screen = {(float)extent.width, (float)extent.height,
+                   1.0f / (float)extent.width, 1.0f / (float)extent.height};
+  params.depth = {zNear, zFar, std::log(zFar / zNear), 0.0f};
+  params.grid[0] = kClusterCountX;
+  params.grid[1] = kClusterCountY;
+  params.grid[2] = kClusterCountZ;
+  params.grid[3] = lightCount;
+
+  std::memcpy(m_paramsMapped[frameIndex], &params, sizeof(ClusterParams));
+}
+
+VkBuffer ClusteredLighting::countBuffer(int frameIndex) {
+  return m_countBuffers[frameIndex];
+}
+
+VkBuffer ClusteredLighting::indexBuffer(int frameIndex) {
+  return m_indexBuffers[frameIndex];
+}
+
+void ClusteredLighting::dispatch(VkCommandBuffer commandBuffer,
+                                 int frameIndex) {
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          m_pipelineLayout, 0, 1, &m_descriptorSets[frameIndex],
+                          0, nullptr);
+
+  // One workgroup per depth slice, one invocation per screen tile.
+  vkCmdDispatch(commandBuffer, 1, 1, kClusterCountZ);
+}
+
+VkDescriptorSetLayout ClusteredLighting::descriptorSetLayout() {
+  return m_descriptorSetLayout;
+}
+
+VkDescriptorSet ClusteredLighting::descriptorSet(int frameIndex) {
+  return m_descriptorSets[frameIndex];
+}
+
+void ClusteredLighting::createDescriptors(VkDevice device) {
+  // binding 0 = params, 1 = lights, 2 = per-cluster counts, 3 = indices.
+  VkDescriptorSetLayoutBinding descriptorSetLayoutBindings[4]{};
+  for (uint32_t i = 0; i < 4; ++i) {
+    descriptorSetLayoutBindings[i].binding = i;
+    descriptorSetLayoutBindings[i].descriptorType =
+        i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+               : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorSetLayoutBindings[i].descriptorCount = 1;
+    descriptorSetLayoutBindings[i].stageFlags =
+        VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+  }
+
+  VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+  descriptorSetLayoutCreateInfo.bindingCount = 4;
+  descriptorSetLayoutCreateInfo.pBindings = descriptorSetLayoutBindings;
+
+  if (vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo,
+                                  nullptr,
+                                  &m_descriptorSetLayout) != VK_SUCCESS) {
+    std::cerr << "vkCreateDescriptorSetLayout failed for lighting"
+              << std::endl;
+    std::abort();
+  }
+
+  VkDescriptorPoolSize descriptorPoolSizes[2]{};
+  descriptorPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  descriptorPoolSizes[0].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+  descriptorPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  descriptorPoolSizes[1].descriptorCount = 3 * MAX_FRAMES_IN_FLIGHT;
+
+  VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+  descriptorPoolCreateInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+  descriptorPoolCreateInfo.poolSizeCount = 2;
+  descriptorPoolCreateInfo.pPoolSizes = descriptorPoolSizes;
+
+  if (vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr,
+                             &m_descriptorPool) != VK_SUCCESS) {
+    std::cerr << "vkCreateDescriptorPool failed for lighting" << std::endl;
+    std::abort();
+  }
+
+  std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> descriptorSetLayouts;
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    descriptorSetLayouts[i] = m_descriptorSetLayout;
+  }
+
+  VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+  descriptorSetAllocateInfo.descriptorPool = m_descriptorPool;
+  descriptorSetAllocateInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+  descriptorSetAllocateInfo.pSetLayouts = descriptorSetLayouts.data();
+
+  if (vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
+                               m_descriptorSets.data()) != VK_SUCCESS) {
+    std::cerr << "vkAllocateDescriptorSets failed for lighting" << std::endl;
+    std::abort();
+  }
+
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    VkDescriptorBufferInfo descriptorBufferInfos[4]{};
+    descriptorBufferInfos[0].buffer = m_paramsBuffers[i];
+    descriptorBufferInfos[0].range = sizeof(ClusterParams);
+    descriptorBufferInfos[1].buffer = m_lightBuffers[i];
+    descriptorBufferInfos[1].range = VK_WHOLE_SIZE;
+    descriptorBufferInfos[2].buffer = m_countBuffers[i];
+    descriptorBufferInfos[2].range = VK_WHOLE_SIZE;
+    descriptorBufferInfos[3].buffer = m_indexBuffers[i];
+    descriptorBufferInfos[3].range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet writeDescriptorSets[4]{};
+    for (uint32_t b = 0; b < 4; ++b) {
+      writeDescriptorSets[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writeDescriptorSets[b].dstSet = m_descriptorSets[i];
+      writeDescriptorSets[b].dstBinding = b;
+      writeDescriptorSets[b].descriptorCount = 1;
+      writeDescriptorSets[b].descriptorType =
+          descriptorSetLayoutBindings[b].descriptorType;
+      writeDescriptorSets[b].pBufferInfo = &descriptorBufferInfos[b];
+    }
+
+    vkUpdateDescriptorSets(device, 4, writeDescriptorSets, 0, nullptr);
+  }
+}
+
+void ClusteredLighting::createPipeline(VkDevice device) {
+  std::vector<char> csBytes;
+  if (!ReadFileBytes("shaders/cluster_cull.comp.spv", csBytes)) {
+    std::cerr << "Missing compute shader shaders/cluster_cull.comp.spv"
+              << std::endl;
+    std::abort();
+  }
+
+  VkShaderModule cs = CreateShaderModule(device, csBytes);
+  if (!cs) {
+    std::cerr << "Failed to create compute shader module" << std::endl;
+    std::abort();
+  }
+
+  VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+  pipelineLayoutCreateInfo.setLayoutCount = 1;
+  pipelineLayoutCreateInfo.pSetLayouts = &m_descriptorSetLayout;
+
+  if (vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr,
+                             &m_pipelineLayout) != VK_SUCCESS) {
+    std::cerr << "vkCreatePipelineLayout failed for light culling\n";
+    vkDestroyShaderModule(device, cs, nullptr);
+    std::abort();
+  }
+
+  VkComputePipelineCreateInfo computePipelineCreateInfo{
+      VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+  computePipelineCreateInfo.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  computePipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  computePipelineCreateInfo.stage.module = cs;
+  computePipelineCreateInfo.stage.pName = "main";
+  computePipelineCreateInfo.layout = m_pipelineLayout;
+
+  if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1,
+                               &computePipelineCreateInfo, nullptr,
+                               &m_pipeline) != VK_SUCCESS) {
+    std::cerr << "vkCreateComputePipelines failed for light culling\n";
+    vkDestroyShaderModule(device, cs, nullptr);
+    std::abort();
+  }
+
+  vkDestroyShaderModule(device, cs, nullptr);
+}
+
+void ClusteredLighting::shutdown(VkDevice device) {
+  if (!device) {
+    return;
+  }
+
+  if (m_pipeline) {
+    vkDestroyPipeline(device, m_pipeline, nullptr);
+    m_pipeline = VK_NULL_HANDLE;
+  }
+
+  if (m_pipelineLayout) {
+    vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+    m_pipelineLayout = VK_NULL_HANDLE;
+  }
+
+  if (m_descriptorPool) {
+    vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+    m_descriptorPool = VK_NULL_HANDLE;
+    m_descriptorSets = {};
+  }
+
+  if (m_descriptorSetLayout) {
+    vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+    m_descriptorSetLayout = VK_NULL_HANDLE;
+  }
+
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    if (m_paramsMapped[i]) {
+      vkUnmapMemory(device, m_paramsMemory[i]);
+      m_paramsMapped[i] = nullptr;
+    }
+    if (m_lightMapped[i]) {
+      vkUnmapMemory(device, m_lightMemory[i]);
+      m_lightMapped[i] = nullptr;
+    }
+
+    VkBuffer *buffers[] = {&m_paramsBuffers[i], &m_lightBuffers[i],
+                           &m_countBuffers[i], &m_indexBuffers[i]};
+    VkDeviceMemory *memories[] = {&m_paramsMemory[i], &m_lightMemory[i],
+                                  &m_countMemory[i], &m_indexMemory[i]};
+
+    for (int b = 0; b < 4; ++b) {
+      if (*buffers[b]) {
+        vkDestroyBuffer(device, *buffers[b], nullptr);
+        *buffers[b] = VK_NULL_HANDLE;
+      }
+      if (*memories[b]) {
+        vkFreeMemory(device, *memories[b], nullptr);
+        *memories[b] = VK_NULL_HANDLE;
+      }
+    }
+  }
+}
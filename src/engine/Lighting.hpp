@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Camera.hpp"
+#include "Constants.hpp"
+#include "Math.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Froxel grid: screen tiles x exponential depth slices.
+static constexpr uint32_t kClusterCountX = 16;
+static constexpr uint32_t kClusterCountY = 9;
+static constexpr uint32_t kClusterCountZ = 24;
+static constexpr uint32_t kClusterCount =
+    kClusterCountX * kClusterCountY * kClusterCountZ;
+
+// Upper bounds keep the per-pixel loop and the buffers a fixed size.
+static constexpr uint32_t kMaxLights = 1024;
+static constexpr uint32_t kMaxLightsPerCluster = 128;
+
+enum LightType {
+  PointLight = 0,
+  SpotLight = 1,
+};
+
+// Matches `Light` in shaders/clusters.glsl (std430).
+struct Light {
+  Vec4 positionRange;  // xyz world position, w range
+  Vec4 colorIntensity; // rgb color, a intensity
+  Vec4 directionType;  // xyz spot direction, w LightType
+  Vec4 spotAngles;     // x cos(inner), y cos(outer)
+};
+
+static_assert(sizeof(Light) == 64, "Light must be 64 bytes");
+
+inline Light MakePointLight(Vec3 position, float range, Vec3 color,
+                            float intensity) {
+  Light light{};
+  light.positionRange = {position.x, position.y, position.z, range};
+  light.colorIntensity = {color.x, color.y, color.z, intensity};
+  light.directionType = {0.0f, -1.0f, 0.0f, (float)PointLight};
+  light.spotAngles = {-1.0f, -1.0f, 0.0f, 0.0f};
+  return light;
+}
+
+inline Light MakeSpotLight(Vec3 position, Vec3 direction, float range,
+                           float innerRadians, float outerRadians, Vec3 color,
+                           float intensity) {
+  Vec3 d = normalize(direction);
+
+  Light light{};
+  light.positionRange = {position.x, position.y, position.z, range};
+  light.colorIntensity = {color.x, color.y, color.z, intensity};
+  light.directionType = {d.x, d.y, d.z, (float)SpotLight};
+  light.spotAngles = {std::cos(innerRadians), std::cos(outerRadians), 0.0f,
+                      0.0f};
+  return light;
+}
+
+// Matches `ClusterParams` in shaders/clusters.glsl (std140).
+struct ClusterParams {
+  Mat4 view;
+  Mat4 invProj;
+  Vec4 screen; // width, height, 1/width, 1/height
+  Vec4 depth;  // near, far, log(far/near), unused
+  uint32_t grid[4]; // x, y, z slices, light count
+};
+
+// Clustered forward light culling. Every frame the scene's light list is
+// uploaded, a compute pass bins it into the froxel grid, and the shading
+// pipelines read the result through the lighting set (set 2).
+class ClusteredLighting {
+public:
+  ClusteredLighting() = default;
+  ~ClusteredLighting() = default;
+
+  void init(VkPhysicalDevice physicalDevice, VkDevice device);
+
+  // Uploads lights and grid parameters for this frame in flight.
+  void update(int frameIndex, const Camera &camera,
+              const std::vector<Light> &lights, VkExtent2D extent);
+
+  // Records the culling dispatch. Must be recorded outside a render pass;
+  // the render graph orders it before the fragment reads of the outputs.
+  void dispatch(VkCommandBuffer commandBuffer, int frameIndex);
+
+  // Culling outputs (per-cluster counts and light indices).
+  VkBuffer countBuffer(int frameIndex);
+  VkBuffer indexBuffer(int frameIndex);
+
+  VkDescriptorSetLayout descriptorSetLayout();
+  VkDescriptorSet descriptorSet(int frameIndex);
+
+  void shutdown(VkDevice device);
+
+private:
+  VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+  VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+  std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> m_descriptorSets{};
+
+  VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+  VkPipeline m_pipeline = VK_NULL_HANDLE;
+
+  // Per frame in flight so culling never races the previous frame's shading.
+  std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> m_paramsBuffers{};
+  std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> m_paramsMemory{};
+  std::array<void *, MAX_FRAMES_IN_FLIGHT> m_paramsMapped{};
+
+  std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> m_lightBuffers{};
+  std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> m_lightMemory{};
+  std::array<void *, MAX_FRAMES_IN_FLIGHT> m_lightMapped{};
+
+  std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> m_countBuffers{};
+  std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> m_countMemory{};
+
+  std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> m_indexBuffers{};
+  std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> m_indexMemory{};
+
+  void createDescriptors(VkDevice device);
+  void createPipeline(VkDevice device);
+};
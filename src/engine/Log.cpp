@@ -0,0 +1,246 @@
+#include "Log.hpp"
+
+#include "Profiler.hpp"
+#include "Queue.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+// How often the writer looks for messages; producers never wake it.
+static constexpr std::chrono::milliseconds kWriterPeriod{5};
+static constexpr size_t kQueueCapacity = 1024;
+static constexpr size_t kRepeatSiteCount = 256;
+
+struct LogMessage {
+  LogLevel level = LogInfo;
+  uint32_t suppressed = 0; // repeats of this text dropped before it
+  char text[Log::kMaxMessageLength];
+};
+
+// Repeat budget for the texts hashing into one slot. Updated without
+// locks, so under contention the counts are approximate.
+struct RepeatSite {
+  std::atomic<uint64_t> hash{0};
+  std::atomic<uint64_t> second{0};
+  std::atomic<uint32_t> count{0};
+  std::atomic<uint32_t> suppressed{0};
+};
+
+static MpscQueue<LogMessage, kQueueCapacity> g_queue;
+static RepeatSite g_repeatSites[kRepeatSiteCount];
+static std::atomic<uint32_t> g_level{LogInfo};
+static std::atomic<uint32_t> g_dropped{0};
+static std::atomic<bool> g_running{false};
+
+static std::thread g_writer;
+static std::mutex g_writerMutex;
+static std::condition_variable g_writerWake;
+static bool g_writerStop = false;
+
+const char *LogLevelName(LogLevel level) {
+  switch (level) {
+  case LogDebug:
+    return "debug";
+  case LogInfo:
+    return "info";
+  case LogWarning:
+    return "warning";
+  case LogError:
+    return "error";
+  default:
+    return "unknown";
+  }
+}
+
+static void Output(const LogMessage &message) {
+  FILE *stream = message.level >= LogWarning ? stderr : stdout;
+  std::fputs(message.text, stream);
+  if (message.suppressed) {
+    std::fprintf(stream, " (%u repeats suppressed)", message.suppressed);
+  }
+  std::fputc('\n', stream);
+}
+
+// Drains the queue; returns whether anything was written.
+static bool Drain() {
+  // Static: a message is too large to keep on the writer's stack per pop.
+  static LogMessage message;
+
+  bool wrote = false;
+  while (g_queue.pop(message)) {
+    Output(message);
+    wrote = true;
+  }
+
+  const uint32_t dropped = g_dropped.exchange(0, std::memory_order_relaxed);
+  if (dropped) {
+    std::fprintf(stderr, "Log: queue full, %u messages dropped\n", dropped);
+    wrote = true;
+  }
+
+  if (wrote) {
+    std::fflush(stdout);
+    std::fflush(stderr);
+  }
+  return wrote;
+}
+
+static void WriterMain() {
+  Profiler::setThreadName("Log");
+
+  std::unique_lock<std::mutex> lock(g_writerMutex);
+  while (!g_writerStop) {
+    lock.unlock();
+    Drain();
+    lock.lock();
+    g_writerWake.wait_for(lock, kWriterPeriod, [] { return g_writerStop; });
+  }
+}
+
+static uint64_t HashText(const char *text) {
+  // FNV-1a
+  uint64_t hash = 1469598103934665603ull;
+  for (; *text; ++text) {
+    hash = (hash ^ (uint8_t)*text) * 1099511628211ull;
+  }
+  return hash;
+}
+
+// Returns false when this text is over its budget for the current second;
+// otherwise suppressed is how many of its repeats were dropped before.
+static bool AllowRepeat(const char *text, uint32_t &suppressed) {
+  const uint64_t hash = HashText(text);
+  const uint64_t second =
+      (uint64_t)std::chrono::duration_cast<std::chrono::seconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+
+  RepeatSite &site = g_repeatSites[hash % kRepeatSiteCount];
+  const bool sameText = site.hash.load(std::memory_order_relaxed) == hash;
+  suppressed = 0;
+
+  if (!sameText || site.second.load(std::memory_order_relaxed) != second) {
+    // A new second or a different text: start a fresh budget. Suppressed
+    // repeats of an evicted text go unreported.
+    const uint32_t pending =
+        site.suppressed.exchange(0, std::memory_order_relaxed);
+    if (sameText) {
+      suppressed = pending;
+    }
+    site.hash.store(hash, std::memory_order_relaxed);
+    site.second.store(second, std::memory_order_relaxed);
+    site.count.store(0, std::memory_order_relaxed);
+  }
+
+  if (site.count.fetch_add(1, std::memory_order_relaxed) >= Log::kRepeatBurst) {
+    site.suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+static void Enqueue(LogLevel level, const char *format, va_list arguments) {
+  if (level < g_level.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  LogMessage message;
+  message.level = level;
+  const int length = std::vsnprintf(message.text, sizeof(message.text),
+                                    format, arguments);
+  if (length < 0) {
+    return;
+  }
+  if ((size_t)length >= sizeof(message.text)) {
+    // Truncated; make it visible.
+    char *end = message.text + sizeof(message.text) - 4;
+    end[0] = end[1] = end[2] = '.';
+  }
+
+  if (!AllowRepeat(message.text, message.suppressed)) {
+    return;
+  }
+
+  if (!g_running.load(std::memory_order_acquire)) {
+    Output(message);
+    return;
+  }
+
+  if (!g_queue.push(message)) {
+    g_dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void Log::init() {
+  if (g_running.load(std::memory_order_acquire)) {
+    return;
+  }
+
+  g_writerStop = false;
+  g_writer = std::thread(WriterMain);
+  g_running.store(true, std::memory_order_release);
+}
+
+void Log::shutdown() {
+  if (!g_running.exchange(false, std::memory_order_acq_rel)) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(g_writerMutex);
+    g_writerStop = true;
+  }
+  g_writerWake.notify_one();
+  g_writer.join();
+
+  // Whatever was pushed while the writer was stopping.
+  Drain();
+}
+
+void Log::setLevel(LogLevel level) {
+  g_level.store(level, std::memory_order_relaxed);
+}
+
+LogLevel Log::level() {
+  return (LogLevel)g_level.load(std::memory_order_relaxed);
+}
+
+void Log::write(LogLevel level, const char *format, ...) {
+  va_list arguments;
+  va_start(arguments, format);
+  Enqueue(level, format, arguments);
+  va_end(arguments);
+}
+
+void Log::debug(const char *format, ...) {
+  va_list arguments;
+  va_start(arguments, format);
+  Enqueue(LogDebug, format, arguments);
+  va_end(arguments);
+}
+
+void Log::info(const char *format, ...) {
+  va_list arguments;
+  va_start(arguments, format);
+  Enqueue(LogInfo, format, arguments);
+  va_end(arguments);
+}
+
+void Log::warning(const char *format, ...) {
+  va_list arguments;
+  va_start(arguments, format);
+  Enqueue(LogWarning, format, arguments);
+  va_end(arguments);
+}
+
+void Log::error(const char *format, ...) {
+  va_list arguments;
+  va_start(arguments, format);
+  Enqueue(LogError, format, arguments);
+  va_end(arguments);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+enum LogLevel : uint32_t {
+  LogDebug = 0,
+  LogInfo,
+  LogWarning, // written to stderr from here up
+  LogError,
+  LogLevelCount,
+};
+
+const char *LogLevelName(LogLevel level);
+
+// Asynchronous logger. The calling thread only formats the message
+// (printf-style, truncated at kMaxMessageLength) into a lock-free queue; a
+// writer thread does the I/O, so logging never blocks the render thread,
+// workers or driver callbacks:
+//
+//   Log::info("Vertex pulling: %s", enabled ? "on" : "off");
+//
+// Messages below level() are dropped before formatting. The same text
+// logged more than kRepeatBurst times within a second is suppressed, and
+// the next one through notes how many were. A full queue drops messages
+// and the writer reports how many.
+//
+// Before init() and after shutdown() messages are written synchronously.
+// Paths that abort right after logging keep using std::cerr, since the
+// writer would not get to their message.
+class Log {
+public:
+  static constexpr uint32_t kMaxMessageLength = 1024;
+  static constexpr uint32_t kRepeatBurst = 5;
+
+  // Starts the writer thread.
+  static void init();
+  // Writes everything still queued and stops the writer thread.
+  static void shutdown();
+
+  static void setLevel(LogLevel level);
+  static LogLevel level();
+
+  static void write(LogLevel level, const char *format, ...);
+
+  static void debug(const char *format, ...);
+  static void info(const char *format, ...);
+  static void warning(const char *format, ...);
+  static void error(const char *format, ...);
+};
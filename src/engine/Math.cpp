@@ -0,0 +1,472 @@
+#include "Math.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#if MATH_SSE && defined(__AVX__)
+#define MATH_AVX 1
+#include <immintrin.h>
+#endif
+
+void mulBatchScalar(const Mat4 *a, const Mat4 *b, Mat4 *out, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    out[i] = mulScalar(a[i], b[i]);
+  }
+}
+
+void transformPointsScalar(const Mat4 &m, const Vec3Array &points,
+                           const Vec3Array &out, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    const Vec3 point =
+        transformPoint(m, {points.x[i], points.y[i], points.z[i]});
+    out.x[i] = point.x;
+    out.y[i] = point.y;
+    out.z[i] = point.z;
+  }
+}
+
+#if MATH_AVX
+// Two output columns per op: a's columns are repeated in both 128-bit
+// halves, and each half of columns broadcasts its own weights. Every load
+// happens before the stores, so out may alias b.
+static inline void MulColumnPairs(__m256 a0, __m256 a1, __m256 a2, __m256 a3,
+                                  const float *b, float *out) {
+  const __m256 b01 = _mm256_loadu_ps(b + 0);
+  const __m256 b23 = _mm256_loadu_ps(b + 8);
+  __m256 r01 = _mm256_mul_ps(a0, _mm256_permute_ps(b01, 0x00));
+  __m256 r23 = _mm256_mul_ps(a0, _mm256_permute_ps(b23, 0x00));
+  r01 = _mm256_add_ps(r01, _mm256_mul_ps(a1, _mm256_permute_ps(b01, 0x55)));
+  r23 = _mm256_add_ps(r23, _mm256_mul_ps(a1, _mm256_permute_ps(b23, 0x55)));
+  r01 = _mm256_add_ps(r01, _mm256_mul_ps(a2, _mm256_permute_ps(b01, 0xAA)));
+  r23 = _mm256_add_ps(r23, _mm256_mul_ps(a2, _mm256_permute_ps(b23, 0xAA)));
+  r01 = _mm256_add_ps(r01, _mm256_mul_ps(a3, _mm256_permute_ps(b01, 0xFF)));
+  r23 = _mm256_add_ps(r23, _mm256_mul_ps(a3, _mm256_permute_ps(b23, 0xFF)));
+  _mm256_storeu_ps(out + 0, r01);
+  _mm256_storeu_ps(out + 8, r23);
+}
+
+static inline __m256 BroadcastColumn(const float *column) {
+  return _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(column));
+}
+#elif MATH_SSE
+// Like mul(), but b's columns are loaded whole and each weight is
+// broadcast in a register instead of being loaded as a scalar. Every load
+// happens before the stores, so out may alias a or b.
+static inline void MulColumns(const float *a, const float *b, float *out) {
+  const __m128 a0 = _mm_loadu_ps(a + 0);
+  const __m128 a1 = _mm_loadu_ps(a + 4);
+  const __m128 a2 = _mm_loadu_ps(a + 8);
+  const __m128 a3 = _mm_loadu_ps(a + 12);
+  const __m128 columns[4] = {_mm_loadu_ps(b + 0), _mm_loadu_ps(b + 4),
+                             _mm_loadu_ps(b + 8), _mm_loadu_ps(b + 12)};
+
+  __m128 result[4];
+  for (int c = 0; c < 4; ++c) {
+    result[c] = _mm_mul_ps(a0, MathSwizzle(columns[c], 0x00));
+    result[c] =
+        _mm_add_ps(result[c], _mm_mul_ps(a1, MathSwizzle(columns[c], 0x55)));
+    result[c] =
+        _mm_add_ps(result[c], _mm_mul_ps(a2, MathSwizzle(columns[c], 0xAA)));
+    result[c] =
+        _mm_add_ps(result[c], _mm_mul_ps(a3, MathSwizzle(columns[c], 0xFF)));
+  }
+  for (int c = 0; c < 4; ++c) {
+    _mm_storeu_ps(out + c * 4, result[c]);
+  }
+}
+#endif
+
+void mulBatch(const Mat4 *a, const Mat4 *b, Mat4 *out, size_t count) {
+  size_t i = 0;
+
+#if MATH_AVX
+  for (; i < count; ++i) {
+    MulColumnPairs(BroadcastColumn(a[i].m + 0), BroadcastColumn(a[i].m + 4),
+                   BroadcastColumn(a[i].m + 8), BroadcastColumn(a[i].m + 12),
+                   b[i].m, out[i].m);
+  }
+#elif MATH_SSE
+  // Two independent products per iteration, so one's loads overlap the
+  // other's arithmetic.
+  for (; i + 2 <= count; i += 2) {
+    MulColumns(a[i].m, b[i].m, out[i].m);
+    MulColumns(a[i + 1].m, b[i + 1].m, out[i + 1].m);
+  }
+#endif
+
+  // Remainder, and NEON, whose mul() already multiplies by lane.
+  for (; i < count; ++i) {
+    out[i] = mul(a[i], b[i]);
+  }
+}
+
+void mulBatch(const Mat4 &parent, const Mat4 *locals, Mat4 *out,
+              size_t count) {
+#if MATH_AVX
+  // The parent's columns stay in registers across the whole batch.
+  const __m256 p0 = BroadcastColumn(parent.m + 0);
+  const __m256 p1 = BroadcastColumn(parent.m + 4);
+  const __m256 p2 = BroadcastColumn(parent.m + 8);
+  const __m256 p3 = BroadcastColumn(parent.m + 12);
+
+  for (size_t i = 0; i < count; ++i) {
+    MulColumnPairs(p0, p1, p2, p3, locals[i].m, out[i].m);
+  }
+#elif MATH_SSE
+  // The parent's columns stay in registers across the whole batch.
+  const __m128 p0 = _mm_loadu_ps(parent.m + 0);
+  const __m128 p1 = _mm_loadu_ps(parent.m + 4);
+  const __m128 p2 = _mm_loadu_ps(parent.m + 8);
+  const __m128 p3 = _mm_loadu_ps(parent.m + 12);
+
+  for (size_t i = 0; i < count; ++i) {
+    for (int c = 0; c < 4; ++c) {
+      const float *column = locals[i].m + c * 4;
+      __m128 result = _mm_mul_ps(p0, _mm_set1_ps(column[0]));
+      result = _mm_add_ps(result, _mm_mul_ps(p1, _mm_set1_ps(column[1])));
+      result = _mm_add_ps(result, _mm_mul_ps(p2, _mm_set1_ps(column[2])));
+      result = _mm_add_ps(result, _mm_mul_ps(p3, _mm_set1_ps(column[3])));
+      _mm_storeu_ps(out[i].m + c * 4, result);
+    }
+  }
+#elif MATH_NEON
+  const float32x4_t p0 = vld1q_f32(parent.m + 0);
+  const float32x4_t p1 = vld1q_f32(parent.m + 4);
+  const float32x4_t p2 = vld1q_f32(parent.m + 8);
+  const float32x4_t p3 = vld1q_f32(parent.m + 12);
+
+  for (size_t i = 0; i < count; ++i) {
+    for (int c = 0; c < 4; ++c) {
+      const float *column = locals[i].m + c * 4;
+      float32x4_t result = vmulq_n_f32(p0, column[0]);
+      result = vmlaq_n_f32(result, p1, column[1]);
+      result = vmlaq_n_f32(result, p2, column[2]);
+      result = vmlaq_n_f32(result, p3, column[3]);
+      vst1q_f32(out[i].m + c * 4, result);
+    }
+  }
+#else
+  for (size_t i = 0; i < count; ++i) {
+    out[i] = mulScalar(parent, locals[i]);
+  }
+#endif
+}
+
+void transformPoints(const Mat4 &m, const Vec3Array &points,
+                     const Vec3Array &out, size_t count) {
+  size_t i = 0;
+
+#if MATH_AVX
+  {
+    __m256 columns[12];
+    for (int c = 0; c < 4; ++c) {
+      for (int r = 0; r < 3; ++r) {
+        columns[c * 3 + r] = _mm256_set1_ps(m.m[c * 4 + r]);
+      }
+    }
+
+    for (; i + 8 <= count; i += 8) {
+      const __m256 x = _mm256_loadu_ps(points.x + i);
+      const __m256 y = _mm256_loadu_ps(points.y + i);
+      const __m256 z = _mm256_loadu_ps(points.z + i);
+      for (int r = 0; r < 3; ++r) {
+        __m256 result = _mm256_add_ps(_mm256_mul_ps(columns[r], x),
+                                      columns[9 + r]);
+        result = _mm256_add_ps(result, _mm256_mul_ps(columns[3 + r], y));
+        result = _mm256_add_ps(result, _mm256_mul_ps(columns[6 + r], z));
+        float *target = r == 0 ? out.x : r == 1 ? out.y : out.z;
+        _mm256_storeu_ps(target + i, result);
+      }
+    }
+  }
+#endif
+
+#if MATH_SSE
+  {
+    __m128 columns[12];
+    for (int c = 0; c < 4; ++c) {
+      for (int r = 0; r < 3; ++r) {
+        columns[c * 3 + r] = _mm_set1_ps(m.m[c * 4 + r]);
+      }
+    }
+
+    for (; i + 4 <= count; i += 4) {
+      const __m128 x = _mm_loadu_ps(points.x + i);
+      const __m128 y = _mm_loadu_ps(points.y + i);
+      const __m128 z = _mm_loadu_ps(points.z + i);
+      for (int r = 0; r < 3; ++r) {
+        __m128 result = _mm_add_ps(_mm_mul_ps(columns[r], x), columns[9 + r]);
+        result = _mm_add_ps(result, _mm_mul_ps(columns[3 + r], y));
+        result = _mm_add_ps(result, _mm_mul_ps(columns[6 + r], z));
+        float *target = r == 0 ? out.x : r == 1 ? out.y : out.z;
+        _mm_storeu_ps(target + i, result);
+      }
+    }
+  }
+#elif MATH_NEON
+  for (; i + 4 <= count; i += 4) {
+    const float32x4_t x = vld1q_f32(points.x + i);
+    const float32x4_t y = vld1q_f32(points.y + i);
+    const float32x4_t z = vld1q_f32(points.z + i);
+    for (int r = 0; r < 3; ++r) {
+      float32x4_t result = vdupq_n_f32(m.m[12 + r]);
+      result = vmlaq_n_f32(result, x, m.m[r]);
+      result = vmlaq_n_f32(result, y, m.m[4 + r]);
+      result = vmlaq_n_f32(result, z, m.m[8 + r]);
+      float *target = r == 0 ? out.x : r == 1 ? out.y : out.z;
+      vst1q_f32(target + i, result);
+    }
+  }
+#endif
+
+  // Remainder (or everything without SIMD).
+  const Vec3Array tailPoints{points.x + i, points.y + i, points.z + i};
+  const Vec3Array tailOut{out.x + i, out.y + i, out.z + i};
+  transformPointsScalar(m, tailPoints, tailOut, count - i);
+}
+
+const char *MathBackendName() {
+#if MATH_AVX
+  return "SSE2 + AVX";
+#elif MATH_SSE
+  return "SSE2";
+#elif MATH_NEON
+  return "NEON";
+#else
+  return "scalar";
+#endif
+}
+
+// Random affine-ish matrices, kept well conditioned so inverse errors
+// measure the code rather than the input.
+static Mat4 RandomMatrix(std::mt19937 &random) {
+  std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+  Mat4 out;
+  for (float &value : out.m) {
+    value = distribution(random);
+  }
+  for (int i = 0; i < 4; ++i) {
+    out.m[i * 5] += 4.0f;
+  }
+  return out;
+}
+
+static float RelativeError(const float *a, const float *b, size_t count) {
+  float worst = 0.0f;
+  for (size_t i = 0; i < count; ++i) {
+    const float scale = std::max(1.0f, std::fabs(b[i]));
+    worst = std::max(worst, std::fabs(a[i] - b[i]) / scale);
+  }
+  return worst;
+}
+
+bool RunMathSelfCheck() {
+  const float kTolerance = 1e-4f;
+  // Not a multiple of 8, so the remainder paths run too.
+  const size_t count = 1003;
+
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+
+  std::vector<Mat4> a(count);
+  std::vector<Mat4> b(count);
+  for (size_t i = 0; i < count; ++i) {
+    a[i] = RandomMatrix(random);
+    b[i] = RandomMatrix(random);
+  }
+
+  float mulError = 0.0f;
+  float vectorError = 0.0f;
+  float transposeError = 0.0f;
+  float inverseError = 0.0f;
+  for (size_t i = 0; i < count; ++i) {
+    const Mat4 product = mul(a[i], b[i]);
+    const Mat4 productScalar = mulScalar(a[i], b[i]);
+    mulError =
+        std::max(mulError, RelativeError(product.m, productScalar.m, 16));
+
+    const Vec4 v{distribution(random), distribution(random),
+                 distribution(random), distribution(random)};
+    const Vec4 transformed = mul(a[i], v);
+    const Vec4 transformedScalar = mulScalar(a[i], v);
+    vectorError = std::max(
+        vectorError, RelativeError(&transformed.x, &transformedScalar.x, 4));
+
+    const Mat4 transposed = transpose(a[i]);
+    const Mat4 transposedScalar = transposeScalar(a[i]);
+    transposeError = std::max(
+        transposeError, RelativeError(transposed.m, transposedScalar.m, 16));
+
+    const Mat4 inverted = inverse(a[i]);
+    const Mat4 invertedScalar = inverseScalar(a[i]);
+    inverseError = std::max(
+        inverseError, RelativeError(inverted.m, invertedScalar.m, 16));
+  }
+
+  std::vector<Mat4> batch(count);
+  std::vector<Mat4> batchScalar(count);
+  mulBatch(a.data(), b.data(), batch.data(), count);
+  mulBatchScalar(a.data(), b.data(), batchScalar.data(), count);
+  float batchError = RelativeError(batch[0].m, batchScalar[0].m, 16 * count);
+
+  mulBatch(a[0], b.data(), batch.data(), count);
+  for (size_t i = 0; i < count; ++i) {
+    batchScalar[i] = mulScalar(a[0], b[i]);
+  }
+  batchError = std::max(
+      batchError, RelativeError(batch[0].m, batchScalar[0].m, 16 * count));
+
+  std::vector<float> points(3 * count);
+  for (float &value : points) {
+    value = distribution(random);
+  }
+  std::vector<float> transformedPoints(3 * count);
+  std::vector<float> transformedPointsScalar(3 * count);
+  const Vec3Array in{points.data(), points.data() + count,
+                     points.data() + 2 * count};
+  transformPoints(a[0], in,
+                  {transformedPoints.data(), transformedPoints.data() + count,
+                   transformedPoints.data() + 2 * count},
+                  count);
+  transformPointsScalar(a[0], in,
+                        {transformedPointsScalar.data(),
+                         transformedPointsScalar.data() + count,
+                         transformedPointsScalar.data() + 2 * count},
+                        count);
+  const float pointError = RelativeError(
+      transformedPoints.data(), transformedPointsScalar.data(), 3 * count);
+
+  struct Check {
+    const char *name;
+    float error;
+  };
+  const Check checks[] = {
+      {"mul(Mat4, Mat4)", mulError},   {"mul(Mat4, Vec4)", vectorError},
+      {"transpose", transposeError},   {"inverse", inverseError},
+      {"mulBatch", batchError},        {"transformPoints", pointError},
+  };
+
+  std::printf("Math self-check (%s, %zu samples)\n", MathBackendName(), count);
+  bool passed = true;
+  for (const Check &check : checks) {
+    const bool ok = check.error <= kTolerance;
+    passed = passed && ok;
+    std::printf("  %-16s max relative error %.2e  %s\n", check.name,
+                check.error, ok ? "ok" : "FAILED");
+  }
+  return passed;
+}
+
+void RunMathBenchmark() {
+  using Clock = std::chrono::steady_clock;
+
+  auto best = [](auto &&function) {
+    double result = 1e30;
+    for (int repeat = 0; repeat < 5; ++repeat) {
+      const Clock::time_point start = Clock::now();
+      function();
+      result = std::min(
+          result, std::chrono::duration<double, std::milli>(Clock::now() -
+                                                            start)
+                      .count());
+    }
+    return result;
+  };
+
+  std::mt19937 random(42);
+  std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+
+  // The compiler may auto-vectorize the scalar references too, so the
+  // speedups are over what plain loops already get. At 1M matrices the
+  // mat4 kernels are bound by memory bandwidth, not arithmetic.
+  std::printf("Math batch kernels (%s, best of 5)\n", MathBackendName());
+  std::printf("   count  kernel             scalar ms    simd ms  speedup\n");
+
+  const size_t counts[] = {10000, 100000, 1000000};
+  for (size_t count : counts) {
+    std::vector<Mat4> a(count);
+    std::vector<Mat4> b(count);
+    std::vector<Mat4> out(count);
+    for (size_t i = 0; i < count; ++i) {
+      a[i] = RandomMatrix(random);
+      b[i] = RandomMatrix(random);
+    }
+
+    std::vector<float> points(3 * count);
+    std::vector<float> transformed(3 * count);
+    for (float &value : points) {
+      value = distribution(random);
+    }
+    const Vec3Array in{points.data(), points.data() + count,
+                       points.data() + 2 * count};
+    const Vec3Array result{transformed.data(), transformed.data() + count,
+                           transformed.data() + 2 * count};
+
+    std::vector<Vec4> vectors(count);
+    std::vector<Vec4> vectorsOut(count);
+    for (Vec4 &vector : vectors) {
+      vector = {distribution(random), distribution(random),
+                distribution(random), distribution(random)};
+    }
+
+    const double mulScalarMs = best(
+        [&] { mulBatchScalar(a.data(), b.data(), out.data(), count); });
+    const double mulSimdMs =
+        best([&] { mulBatch(a.data(), b.data(), out.data(), count); });
+    const double parentMs =
+        best([&] { mulBatch(a[0], b.data(), out.data(), count); });
+    const double pointsScalarMs =
+        best([&] { transformPointsScalar(a[0], in, result, count); });
+    const double pointsSimdMs =
+        best([&] { transformPoints(a[0], in, result, count); });
+
+    const double vectorScalarMs = best([&] {
+      for (size_t i = 0; i < count; ++i) {
+        vectorsOut[i] = mulScalar(a[i], vectors[i]);
+      }
+    });
+    const double vectorSimdMs = best([&] {
+      for (size_t i = 0; i < count; ++i) {
+        vectorsOut[i] = mul(a[i], vectors[i]);
+      }
+    });
+    const double transposeScalarMs = best([&] {
+      for (size_t i = 0; i < count; ++i) {
+        out[i] = transposeScalar(a[i]);
+      }
+    });
+    const double transposeSimdMs = best([&] {
+      for (size_t i = 0; i < count; ++i) {
+        out[i] = transpose(a[i]);
+      }
+    });
+    const double inverseScalarMs = best([&] {
+      for (size_t i = 0; i < count; ++i) {
+        out[i] = inverseScalar(a[i]);
+      }
+    });
+    const double inverseSimdMs = best([&] {
+      for (size_t i = 0; i < count; ++i) {
+        out[i] = inverse(a[i]);
+      }
+    });
+
+    std::printf("%8zu  mat4 x mat4      %10.3f %10.3f %8.2f\n", count,
+                mulScalarMs, mulSimdMs, mulScalarMs / mulSimdMs);
+    std::printf("%8zu  parent x mat4    %10.3f %10.3f %8.2f\n", count,
+                mulScalarMs, parentMs, mulScalarMs / parentMs);
+    std::printf("%8zu  points (SoA)     %10.3f %10.3f %8.2f\n", count,
+                pointsScalarMs, pointsSimdMs, pointsScalarMs / pointsSimdMs);
+    std::printf("%8zu  mat4 x vec4      %10.3f %10.3f %8.2f\n", count,
+                vectorScalarMs, vectorSimdMs, vectorScalarMs / vectorSimdMs);
+    std::printf("%8zu  transpose        %10.3f %10.3f %8.2f\n", count,
+                transposeScalarMs, transposeSimdMs,
+                transposeScalarMs / transposeSimdMs);
+    std::printf("%8zu  inverse          %10.3f %10.3f %8.2f\n", count,
+                inverseScalarMs, inverseSimdMs,
+                inverseScalarMs / inverseSimdMs);
+  }
+}
@@ -1,6 +1,21 @@
 #pragma once
 
 #include <cmath>
+#include <cstddef>
+
+// SIMD backend for the Mat4 operations, picked at compile time: SSE2 on
+// x86 (always there on x64), NEON on ARM. Define MATH_FORCE_SCALAR to use
+// the scalar reference versions everywhere.
+#if !defined(MATH_FORCE_SCALAR) &&                                             \
+    (defined(__SSE2__) || defined(_M_X64) ||                                   \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define MATH_SSE 1
+#include <emmintrin.h>
+#elif !defined(MATH_FORCE_SCALAR) &&                                           \
+    (defined(__ARM_NEON) || defined(_M_ARM64))
+#define MATH_NEON 1
+#include <arm_neon.h>
+#endif
 
 struct Vec3 {
   float x = 0.0f, y = 0.0f, z = 0.0f;
@@ -13,6 +28,7 @@ struct Vec4 {
 inline Vec3 add(Vec3 a, Vec3 b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
 inline Vec3 sub(Vec3 a, Vec3 b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
 inline Vec3 mul(Vec3 a, float s) { return {a.x * s, a.y * s, a.z * s}; }
+inline Vec3 lerp(Vec3 a, Vec3 b, float t) { return add(a, mul(sub(b, a), t)); }
 
 inline float dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
 
@@ -37,7 +53,9 @@ struct Mat4 {
   static Mat4 identity() { return Mat4{}; }
 };
 
-inline Mat4 mul(Mat4 a, Mat4 b) {
+// Scalar reference versions. The SIMD paths below must match them (see
+// RunMathSelfCheck()).
+inline Mat4 mulScalar(const Mat4 &a, const Mat4 &b) {
   Mat4 out{};
   // column-major multiplication: out = a * b
   for (int c = 0; c < 4; ++c) {
@@ -50,6 +68,263 @@ inline Mat4 mul(Mat4 a, Mat4 b) {
   return out;
 }
 
+inline Vec4 mulScalar(const Mat4 &a, Vec4 v) {
+  return {a.m[0] * v.x + a.m[4] * v.y + a.m[8] * v.z + a.m[12] * v.w,
+          a.m[1] * v.x + a.m[5] * v.y + a.m[9] * v.z + a.m[13] * v.w,
+          a.m[2] * v.x + a.m[6] * v.y + a.m[10] * v.z + a.m[14] * v.w,
+          a.m[3] * v.x + a.m[7] * v.y + a.m[11] * v.z + a.m[15] * v.w};
+}
+
+inline Mat4 transposeScalar(const Mat4 &a) {
+  Mat4 out{};
+  for (int c = 0; c < 4; ++c) {
+    for (int r = 0; r < 4; ++r) {
+      out.m[c * 4 + r] = a.m[r * 4 + c];
+    }
+  }
+  return out;
+}
+
+// General 4x4 inverse (cofactor expansion). Returns identity if singular.
+inline Mat4 inverseScalar(const Mat4 &a) {
+  const float *m = a.m;
+  Mat4 out{};
+  float *o = out.m;
+
+  o[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] +
+         m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+  o[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] -
+         m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+  o[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] +
+         m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+  o[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] -
+          m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+  o[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] -
+         m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+  o[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] +
+         m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+  o[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] -
+         m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+  o[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] +
+          m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+  o[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] +
+         m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+  o[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] -
+         m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+  o[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] +
+          m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+  o[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] -
+          m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+  o[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] -
+         m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+  o[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] +
+         m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+  o[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] -
+          m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+  o[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] +
+          m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+  float det = m[0] * o[0] + m[1] * o[4] + m[2] * o[8] + m[3] * o[12];
+  if (std::fabs(det) < 1e-12f) {
+    return Mat4::identity();
+  }
+
+  float invDet = 1.0f / det;
+  for (int i = 0; i < 16; ++i) {
+    o[i] *= invDet;
+  }
+  return out;
+}
+
+#if MATH_SSE
+
+inline __m128 MathSwizzle(__m128 v, int mask) {
+  return _mm_castsi128_ps(_mm_shuffle_epi32(_mm_castps_si128(v), mask));
+}
+
+// 2x2 blocks packed as (m00, m01, m10, m11): A * B, adj(A) * B and
+// A * adj(B).
+inline __m128 Mat2Mul(__m128 a, __m128 b) {
+  return _mm_add_ps(
+      _mm_mul_ps(a, MathSwizzle(b, _MM_SHUFFLE(3, 0, 3, 0))),
+      _mm_mul_ps(MathSwizzle(a, _MM_SHUFFLE(2, 3, 0, 1)),
+                 MathSwizzle(b, _MM_SHUFFLE(1, 2, 1, 2))));
+}
+
+inline __m128 Mat2AdjMul(__m128 a, __m128 b) {
+  return _mm_sub_ps(
+      _mm_mul_ps(MathSwizzle(a, _MM_SHUFFLE(0, 0, 3, 3)), b),
+      _mm_mul_ps(MathSwizzle(a, _MM_SHUFFLE(2, 2, 1, 1)),
+                 MathSwizzle(b, _MM_SHUFFLE(1, 0, 3, 2))));
+}
+
+inline __m128 Mat2MulAdj(__m128 a, __m128 b) {
+  return _mm_sub_ps(
+      _mm_mul_ps(a, MathSwizzle(b, _MM_SHUFFLE(0, 3, 0, 3))),
+      _mm_mul_ps(MathSwizzle(a, _MM_SHUFFLE(2, 3, 0, 1)),
+                 MathSwizzle(b, _MM_SHUFFLE(1, 2, 1, 2))));
+}
+
+#endif
+
+inline Mat4 mul(const Mat4 &a, const Mat4 &b) {
+#if MATH_SSE
+  const __m128 a0 = _mm_loadu_ps(a.m + 0);
+  const __m128 a1 = _mm_loadu_ps(a.m + 4);
+  const __m128 a2 = _mm_loadu_ps(a.m + 8);
+  const __m128 a3 = _mm_loadu_ps(a.m + 12);
+
+  // Each output column is a's columns weighted by one column of b.
+  Mat4 out;
+  for (int c = 0; c < 4; ++c) {
+    const float *column = b.m + c * 4;
+    __m128 result = _mm_mul_ps(a0, _mm_set1_ps(column[0]));
+    result = _mm_add_ps(result, _mm_mul_ps(a1, _mm_set1_ps(column[1])));
+    result = _mm_add_ps(result, _mm_mul_ps(a2, _mm_set1_ps(column[2])));
+    result = _mm_add_ps(result, _mm_mul_ps(a3, _mm_set1_ps(column[3])));
+    _mm_storeu_ps(out.m + c * 4, result);
+  }
+  return out;
+#elif MATH_NEON
+  const float32x4_t a0 = vld1q_f32(a.m + 0);
+  const float32x4_t a1 = vld1q_f32(a.m + 4);
+  const float32x4_t a2 = vld1q_f32(a.m + 8);
+  const float32x4_t a3 = vld1q_f32(a.m + 12);
+
+  Mat4 out;
+  for (int c = 0; c < 4; ++c) {
+    const float *column = b.m + c * 4;
+    float32x4_t result = vmulq_n_f32(a0, column[0]);
+    result = vmlaq_n_f32(result, a1, column[1]);
+    result = vmlaq_n_f32(result, a2, column[2]);
+    result = vmlaq_n_f32(result, a3, column[3]);
+    vst1q_f32(out.m + c * 4, result);
+  }
+  return out;
+#else
+  return mulScalar(a, b);
+#endif
+}
+
+inline Vec4 mul(const Mat4 &a, Vec4 v) {
+#if MATH_SSE
+  __m128 result = _mm_mul_ps(_mm_loadu_ps(a.m + 0), _mm_set1_ps(v.x));
+  result = _mm_add_ps(result,
+                      _mm_mul_ps(_mm_loadu_ps(a.m + 4), _mm_set1_ps(v.y)));
+  result = _mm_add_ps(result,
+                      _mm_mul_ps(_mm_loadu_ps(a.m + 8), _mm_set1_ps(v.z)));
+  result = _mm_add_ps(result,
+                      _mm_mul_ps(_mm_loadu_ps(a.m + 12), _mm_set1_ps(v.w)));
+  Vec4 out;
+  _mm_storeu_ps(&out.x, result);
+  return out;
+#elif MATH_NEON
+  float32x4_t result = vmulq_n_f32(vld1q_f32(a.m + 0), v.x);
+  result = vmlaq_n_f32(result, vld1q_f32(a.m + 4), v.y);
+  result = vmlaq_n_f32(result, vld1q_f32(a.m + 8), v.z);
+  result = vmlaq_n_f32(result, vld1q_f32(a.m + 12), v.w);
+  Vec4 out;
+  vst1q_f32(&out.x, result);
+  return out;
+#else
+  return mulScalar(a, v);
+#endif
+}
+
+inline Mat4 transpose(const Mat4 &a) {
+#if MATH_SSE
+  __m128 c0 = _mm_loadu_ps(a.m + 0);
+  __m128 c1 = _mm_loadu_ps(a.m + 4);
+  __m128 c2 = _mm_loadu_ps(a.m + 8);
+  __m128 c3 = _mm_loadu_ps(a.m + 12);
+  _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+  Mat4 out;
+  _mm_storeu_ps(out.m + 0, c0);
+  _mm_storeu_ps(out.m + 4, c1);
+  _mm_storeu_ps(out.m + 8, c2);
+  _mm_storeu_ps(out.m + 12, c3);
+  return out;
+#elif MATH_NEON
+  // De-interleaving load: lane i of every column lands in row i.
+  const float32x4x4_t rows = vld4q_f32(a.m);
+  Mat4 out;
+  vst1q_f32(out.m + 0, rows.val[0]);
+  vst1q_f32(out.m + 4, rows.val[1]);
+  vst1q_f32(out.m + 8, rows.val[2]);
+  vst1q_f32(out.m + 12, rows.val[3]);
+  return out;
+#else
+  return transposeScalar(a);
+#endif
+}
+
+// Same contract as inverseScalar(). The SSE version inverts by 2x2 blocks;
+// since inverse(transpose(M)) == transpose(inverse(M)) it works on the
+// column-major storage directly. NEON uses the scalar version.
+inline Mat4 inverse(const Mat4 &a) {
+#if MATH_SSE
+  const __m128 c0 = _mm_loadu_ps(a.m + 0);
+  const __m128 c1 = _mm_loadu_ps(a.m + 4);
+  const __m128 c2 = _mm_loadu_ps(a.m + 8);
+  const __m128 c3 = _mm_loadu_ps(a.m + 12);
+
+  // 2x2 blocks | A B |
+  //            | C D |
+  const __m128 blockA = _mm_movelh_ps(c0, c1);
+  const __m128 blockB = _mm_movehl_ps(c1, c0);
+  const __m128 blockC = _mm_movelh_ps(c2, c3);
+  const __m128 blockD = _mm_movehl_ps(c3, c2);
+
+  // (|A|, |B|, |C|, |D|)
+  const __m128 determinants = _mm_sub_ps(
+      _mm_mul_ps(_mm_shuffle_ps(c0, c2, _MM_SHUFFLE(2, 0, 2, 0)),
+                 _mm_shuffle_ps(c1, c3, _MM_SHUFFLE(3, 1, 3, 1))),
+      _mm_mul_ps(_mm_shuffle_ps(c0, c2, _MM_SHUFFLE(3, 1, 3, 1)),
+                 _mm_shuffle_ps(c1, c3, _MM_SHUFFLE(2, 0, 2, 0))));
+  const __m128 detA = MathSwizzle(determinants, _MM_SHUFFLE(0, 0, 0, 0));
+  const __m128 detB = MathSwizzle(determinants, _MM_SHUFFLE(1, 1, 1, 1));
+  const __m128 detC = MathSwizzle(determinants, _MM_SHUFFLE(2, 2, 2, 2));
+  const __m128 detD = MathSwizzle(determinants, _MM_SHUFFLE(3, 3, 3, 3));
+
+  const __m128 adjDC = Mat2AdjMul(blockD, blockC);
+  const __m128 adjAB = Mat2AdjMul(blockA, blockB);
+
+  __m128 x = _mm_sub_ps(_mm_mul_ps(detD, blockA), Mat2Mul(blockB, adjDC));
+  __m128 w = _mm_sub_ps(_mm_mul_ps(detA, blockD), Mat2Mul(blockC, adjAB));
+  __m128 y = _mm_sub_ps(_mm_mul_ps(detB, blockC), Mat2MulAdj(blockD, adjAB));
+  __m128 z = _mm_sub_ps(_mm_mul_ps(detC, blockB), Mat2MulAdj(blockA, adjDC));
+
+  // |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+  __m128 trace =
+      _mm_mul_ps(adjAB, MathSwizzle(adjDC, _MM_SHUFFLE(3, 1, 2, 0)));
+  trace = _mm_add_ps(trace, MathSwizzle(trace, _MM_SHUFFLE(2, 3, 0, 1)));
+  trace = _mm_add_ps(trace, MathSwizzle(trace, _MM_SHUFFLE(1, 0, 3, 2)));
+  const __m128 determinant = _mm_sub_ps(
+      _mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), trace);
+
+  if (std::fabs(_mm_cvtss_f32(determinant)) < 1e-12f) {
+    return Mat4::identity();
+  }
+
+  const __m128 scale =
+      _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), determinant);
+  x = _mm_mul_ps(x, scale);
+  y = _mm_mul_ps(y, scale);
+  z = _mm_mul_ps(z, scale);
+  w = _mm_mul_ps(w, scale);
+
+  // Adjugate of each block, scattered back into columns.
+  Mat4 out;
+  _mm_storeu_ps(out.m + 0, _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 3, 1, 3)));
+  _mm_storeu_ps(out.m + 4, _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 2, 0, 2)));
+  _mm_storeu_ps(out.m + 8, _mm_shuffle_ps(z, w, _MM_SHUFFLE(1, 3, 1, 3)));
+  _mm_storeu_ps(out.m + 12, _mm_shuffle_ps(z, w, _MM_SHUFFLE(0, 2, 0, 2)));
+  return out;
+#else
+  return inverseScalar(a);
+#endif
+}
+
 inline Mat4 translate(Vec3 t) {
   Mat4 out = Mat4::identity();
   out.m[3 * 4 + 0] = t.x;
@@ -66,6 +341,129 @@ inline Mat4 scale(Vec3 s) {
   return out;
 }
 
+// Unit quaternion; (0, 0, 0, 1) is no rotation.
+struct Quat {
+  float x = 0.0f, y = 0.0f, z = 0.0f, w = 1.0f;
+};
+
+inline Quat quatAxisAngle(Vec3 axis, float radians) {
+  const Vec3 a = normalize(axis);
+  const float s = std::sin(radians * 0.5f);
+  return {a.x * s, a.y * s, a.z * s, std::cos(radians * 0.5f)};
+}
+
+// Rotation b, then a.
+inline Quat mul(Quat a, Quat b) {
+  return {a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+          a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+          a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+          a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z};
+}
+
+inline Quat normalize(Quat q) {
+  const float len = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+  if (len <= 0.0f) {
+    return Quat{};
+  }
+  const float inv = 1.0f / len;
+  return {q.x * inv, q.y * inv, q.z * inv, q.w * inv};
+}
+
+// translate(t) * rotation(r) * scale(s) in one go.
+inline Mat4 compose(Vec3 t, Quat r, Vec3 s) {
+  const float xx = r.x * r.x, yy = r.y * r.y, zz = r.z * r.z;
+  const float xy = r.x * r.y, xz = r.x * r.z, yz = r.y * r.z;
+  const float wx = r.w * r.x, wy = r.w * r.y, wz = r.w * r.z;
+
+  Mat4 out;
+  out.m[0] = (1.0f - 2.0f * (yy + zz)) * s.x;
+  out.m[1] = 2.0f * (xy + wz) * s.x;
+  out.m[2] = 2.0f * (xz - wy) * s.x;
+  out.m[3] = 0.0f;
+
+  out.m[4] = 2.0f * (xy - wz) * s.y;
+  out.m[5] = (1.0f - 2.0f * (xx + zz)) * s.y;
+  out.m[6] = 2.0f * (yz + wx) * s.y;
+  out.m[7] = 0.0f;
+
+  out.m[8] = 2.0f * (xz + wy) * s.z;
+  out.m[9] = 2.0f * (yz - wx) * s.z;
+  out.m[10] = (1.0f - 2.0f * (xx + yy)) * s.z;
+  out.m[11] = 0.0f;
+
+  out.m[12] = t.x;
+  out.m[13] = t.y;
+  out.m[14] = t.z;
+  out.m[15] = 1.0f;
+  return out;
+}
+
+// Transforms a point (w = 1) and returns xyz (no perspective divide).
+inline Vec3 transformPoint(const Mat4 &a, Vec3 p) {
+  return {a.m[0] * p.x + a.m[4] * p.y + a.m[8] * p.z + a.m[12],
+          a.m[1] * p.x + a.m[5] * p.y + a.m[9] * p.z + a.m[13],
+          a.m[2] * p.x + a.m[6] * p.y + a.m[10] * p.z + a.m[14]};
+}
+
+// Axis-aligned box around the transformed box [boundsMin, boundsMax],
+// written back in place.
+inline void transformBounds(const Mat4 &a, Vec3 &boundsMin, Vec3 &boundsMax) {
+  const float lo[3] = {boundsMin.x, boundsMin.y, boundsMin.z};
+  const float hi[3] = {boundsMax.x, boundsMax.y, boundsMax.z};
+  float outMin[3] = {a.m[12], a.m[13], a.m[14]};
+  float outMax[3] = {a.m[12], a.m[13], a.m[14]};
+  for (int row = 0; row < 3; ++row) {
+    for (int col = 0; col < 3; ++col) {
+      const float e = a.m[col * 4 + row] * lo[col];
+      const float f = a.m[col * 4 + row] * hi[col];
+      outMin[row] += e < f ? e : f;
+      outMax[row] += e < f ? f : e;
+    }
+  }
+  boundsMin = {outMin[0], outMin[1], outMin[2]};
+  boundsMax = {outMax[0], outMax[1], outMax[2]};
+}
+
+// The six planes (xyz normal pointing inwards, w distance) of the volume a
+// view-projection matrix maps into clip space, depth [0, 1]. A point p is
+// inside when dot(n, p) + w >= 0 for all of them.
+inline void frustumPlanes(const Mat4 &viewProj, Vec4 planes[6]) {
+  const float *m = viewProj.m;
+  auto row = [m](int r) { return Vec4{m[r], m[4 + r], m[8 + r], m[12 + r]}; };
+  const Vec4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+
+  planes[0] = {r3.x + r0.x, r3.y + r0.y, r3.z + r0.z, r3.w + r0.w}; // left
+  planes[1] = {r3.x - r0.x, r3.y - r0.y, r3.z - r0.z, r3.w - r0.w}; // right
+  planes[2] = {r3.x + r1.x, r3.y + r1.y, r3.z + r1.z, r3.w + r1.w}; // bottom
+  planes[3] = {r3.x - r1.x, r3.y - r1.y, r3.z - r1.z, r3.w - r1.w}; // top
+  planes[4] = r2;                                                   // near
+  planes[5] = {r3.x - r2.x, r3.y - r2.y, r3.z - r2.z, r3.w - r2.w}; // far
+
+  for (int i = 0; i < 6; ++i) {
+    const float len = std::sqrt(planes[i].x * planes[i].x +
+                                planes[i].y * planes[i].y +
+                                planes[i].z * planes[i].z);
+    if (len > 0.0f) {
+      planes[i] = {planes[i].x / len, planes[i].y / len, planes[i].z / len,
+                   planes[i].w / len};
+    }
+  }
+}
+
+// Right-handed orthographic matrix, depth mapped to [0, 1] like
+// perspectiveRH. zNear/zFar are distances along -Z.
+inline Mat4 orthoRH(float left, float right, float bottom, float top,
+                    float zNear, float zFar) {
+  Mat4 out = Mat4::identity();
+  out.m[0] = 2.0f / (right - left);
+  out.m[5] = 2.0f / (top - bottom);
+  out.m[10] = 1.0f / (zNear - zFar);
+  out.m[12] = -(right + left) / (right - left);
+  out.m[13] = -(top + bottom) / (top - bottom);
+  out.m[14] = zNear / (zNear - zFar);
+  return out;
+}
+
 // Right-handed perspective matrix.
 inline Mat4 perspectiveRH(float fovyRadians, float aspect, float zNear,
                           float zFar) {
@@ -107,3 +505,35 @@ inline Mat4 lookAtRH(Vec3 eye, Vec3 center, Vec3 up) {
 
   return out;
 }
+
+// Batch kernels (Math.cpp). Points are in structure-of-arrays form so the
+// SIMD width runs across points: 4 with SSE/NEON, 8 when built with AVX
+// (the EVERGREEN_AVX CMake option).
+struct Vec3Array {
+  float *x = nullptr;
+  float *y = nullptr;
+  float *z = nullptr;
+};
+
+// out[i] = a[i] * b[i]; out may be a or b.
+void mulBatch(const Mat4 *a, const Mat4 *b, Mat4 *out, size_t count);
+// out[i] = parent * locals[i]; out may be locals.
+void mulBatch(const Mat4 &parent, const Mat4 *locals, Mat4 *out,
+              size_t count);
+// out[i] = transformPoint(m, points[i]); out may be points.
+void transformPoints(const Mat4 &m, const Vec3Array &points,
+                     const Vec3Array &out, size_t count);
+
+void mulBatchScalar(const Mat4 *a, const Mat4 *b, Mat4 *out, size_t count);
+void transformPointsScalar(const Mat4 &m, const Vec3Array &points,
+                           const Vec3Array &out, size_t count);
+
+// "SSE2", "SSE2 + AVX", "NEON" or "scalar": what the kernels were built for.
+const char *MathBackendName();
+
+// Compares every SIMD path against its scalar reference on random input
+// and prints the worst error; returns false on a mismatch.
+bool RunMathSelfCheck();
+// Times the batch kernels against the scalar references at 10k to 1M
+// elements. Run with --bench-math, which runs the self-check first.
+void RunMathBenchmark();
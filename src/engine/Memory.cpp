@@ -0,0 +1,167 @@
+#include "Memory.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+
+// Alignment of the arena's blocks; the largest an allocation may ask for.
+static constexpr std::align_val_t kBlockAlignment{64};
+
+FrameArena::FrameArena(size_t capacity) : m_capacity(capacity) {
+  m_block =
+      static_cast<std::byte *>(::operator new(m_capacity, kBlockAlignment));
+}
+
+FrameArena::~FrameArena() {
+  reset();
+  ::operator delete(m_block, kBlockAlignment);
+}
+
+void *FrameArena::allocate(size_t size, size_t alignment) {
+  assert(alignment <= (size_t)kBlockAlignment &&
+         (alignment & (alignment - 1)) == 0);
+
+  const size_t offset = (m_offset + alignment - 1) & ~(alignment - 1);
+  if (offset + size <= m_capacity) {
+    m_offset = offset + size;
+    return m_block + offset;
+  }
+
+  // Over budget: serve from the heap and remember how much was missing.
+  void *overflow = ::operator new(size, kBlockAlignment);
+  m_overflow.push_back(overflow);
+  m_overflowBytes += size + alignment;
+  return overflow;
+}
+
+void FrameArena::reset() {
+  for (void *overflow : m_overflow) {
+    ::operator delete(overflow, kBlockAlignment);
+  }
+  m_overflow.clear();
+
+  if (m_overflowBytes) {
+    // Grow to the high-water mark so the next frame like this one fits.
+    const size_t capacity =
+        std::max(m_capacity * 2, m_offset + m_overflowBytes);
+    ::operator delete(m_block, kBlockAlignment);
+    m_block =
+        static_cast<std::byte *>(::operator new(capacity, kBlockAlignment));
+    m_capacity = capacity;
+    m_overflowBytes = 0;
+  }
+
+  m_offset = 0;
+}
+
+size_t FrameArena::used() { return m_offset + m_overflowBytes; }
+
+size_t FrameArena::capacity() { return m_capacity; }
+
+#ifndef NDEBUG
+
+// Replacing the global allocation functions sees every allocation made
+// through operator new, including the standard library's. Only the count
+// is added; memory still comes from malloc.
+static std::atomic<uint64_t> g_heapAllocations{0};
+
+uint64_t HeapAllocationCount() {
+  return g_heapAllocations.load(std::memory_order_relaxed);
+}
+
+static void *CountedAllocate(size_t size, size_t alignment) {
+  g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+
+  if (size == 0) {
+    size = 1;
+  }
+
+  void *pointer = nullptr;
+  if (alignment <= alignof(std::max_align_t)) {
+    pointer = std::malloc(size);
+  } else {
+#ifdef _WIN32
+    pointer = _aligned_malloc(size, alignment);
+#else
+    pointer = std::aligned_alloc(alignment,
+                                 (size + alignment - 1) & ~(alignment - 1));
+#endif
+  }
+
+  if (!pointer) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+static void CountedFree(void *pointer, size_t alignment) {
+  if (!pointer) {
+    return;
+  }
+#ifdef _WIN32
+  if (alignment > alignof(std::max_align_t)) {
+    _aligned_free(pointer);
+    return;
+  }
+#else
+  (void)alignment;
+#endif
+  std::free(pointer);
+}
+
+void *operator new(size_t size) {
+  return CountedAllocate(size, alignof(std::max_align_t));
+}
+
+void *operator new[](size_t size) {
+  return CountedAllocate(size, alignof(std::max_align_t));
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+  return CountedAllocate(size, (size_t)alignment);
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+  return CountedAllocate(size, (size_t)alignment);
+}
+
+void operator delete(void *pointer) noexcept {
+  CountedFree(pointer, alignof(std::max_align_t));
+}
+
+void operator delete[](void *pointer) noexcept {
+  CountedFree(pointer, alignof(std::max_align_t));
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+  CountedFree(pointer, alignof(std::max_align_t));
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+  CountedFree(pointer, alignof(std::max_align_t));
+}
+
+void operator delete(void *pointer, std::align_val_t alignment) noexcept {
+  CountedFree(pointer, (size_t)alignment);
+}
+
+void operator delete[](void *pointer, std::align_val_t alignment) noexcept {
+  CountedFree(pointer, (size_t)alignment);
+}
+
+void operator delete(void *pointer, size_t,
+                     std::align_val_t alignment) noexcept {
+  CountedFree(pointer, (size_t)alignment);
+}
+
+void operator delete[](void *pointer, size_t,
+                       std::align_val_t alignment) noexcept {
+  CountedFree(pointer, (size_t)alignment);
+}
+
+#else
+
+uint64_t HeapAllocationCount() { return 0; }
+
+#endif
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Linear allocator for data that lives for one frame: render queues,
+// culling output, command recording scratch. Allocation is a pointer bump;
+// nothing is freed individually and destructors never run, so only
+// trivially destructible types go in. reset() rewinds it once the frame
+// that used it has retired, which with one arena per frame in flight is
+// when its timeline value has passed.
+//
+// Running out falls back to the heap for the rest of the frame; the next
+// reset() grows the block to the high-water mark so that steady state
+// never allocates.
+class FrameArena {
+public:
+  static constexpr size_t kDefaultCapacity = 256 * 1024;
+
+  explicit FrameArena(size_t capacity = kDefaultCapacity);
+  ~FrameArena();
+
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+  // Uninitialized storage for count objects of T.
+  template <typename T> T *allocateArray(size_t count) {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "FrameArena never runs destructors");
+    return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+  }
+
+  template <typename T, typename... Args> T *create(Args &&...args) {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "FrameArena never runs destructors");
+    return new (allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+  }
+
+  void reset();
+
+  size_t used();
+  size_t capacity();
+
+private:
+  std::byte *m_block = nullptr;
+  size_t m_capacity = 0;
+  size_t m_offset = 0;
+
+  // Heap blocks taken after the main block ran out this frame.
+  std::vector<void *> m_overflow;
+  size_t m_overflowBytes = 0;
+};
+
+// Recycles objects of one type instead of destroying them, so whatever
+// they own (vector capacity, strings) survives to the next use. acquire()
+// hands back a released object as release() left it, or a new one;
+// callers reset the fields they use.
+template <typename T> class ObjectPool {
+public:
+  ObjectPool() = default;
+  ~ObjectPool() = default;
+
+  ObjectPool(const ObjectPool &) = delete;
+  ObjectPool &operator=(const ObjectPool &) = delete;
+
+  T *acquire() {
+    if (m_free.empty()) {
+      m_objects.push_back(std::make_unique<T>());
+      m_free.reserve(m_objects.size());
+      return m_objects.back().get();
+    }
+
+    T *object = m_free.back();
+    m_free.pop_back();
+    return object;
+  }
+
+  void release(T *object) { m_free.push_back(object); }
+
+  // Objects ever created; the pool's high-water mark.
+  size_t size() { return m_objects.size(); }
+
+private:
+  std::vector<std::unique_ptr<T>> m_objects;
+  std::vector<T *> m_free;
+};
+
+// Heap allocations (operator new) made by every thread since start. Only
+// counted in debug builds; release builds always return 0.
+uint64_t HeapAllocationCount();
@@ -22,6 +22,24 @@ VkBuffer Mesh::indexBuffer() { return m_indexBuffer; }
 
 VkDeviceMemory Mesh::indexMemory() { return m_indexMemory; }
 
+void Mesh::setPulledRange(const GeometryRange &range) {
+  m_pulledRange = range;
+  m_pulled = true;
+}
+
+bool Mesh::pulled() { return m_pulled; }
+
+const GeometryRange &Mesh::pulledRange() { return m_pulledRange; }
+
+void Mesh::setBounds(Vec3 boundsMin, Vec3 boundsMax) {
+  m_boundsMin = boundsMin;
+  m_boundsMax = boundsMax;
+}
+
+Vec3 Mesh::boundsMin() { return m_boundsMin; }
+
+Vec3 Mesh::boundsMax() { return m_boundsMax; }
+
 void Mesh::clear() {}
 
 // void Mesh::destroyResources(Renderer &renderer) {
@@ -51,7 +69,7 @@ void Mesh::clear() {}
 //   }
 
 //   // Uniform buffers (per-frame)
-//   for (int i = 0; i < FRAME_COUNT; ++i) {
+//   for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
 //     if (m_uboMappedList[i]) {
 //       vkUnmapMemory(device, m_uboMemoryList[i]);
 //       m_uboMappedList[i] = nullptr;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Geometry.hpp"
+
 #include <vulkan/vulkan.h>
 
 #include <vector>
@@ -19,6 +21,16 @@ public:
   VkBuffer indexBuffer();
   VkDeviceMemory indexMemory();
 
+  // Range inside the scene GeometryBuffer, used by the vertex pulling path.
+  void setPulledRange(const GeometryRange &range);
+  bool pulled();
+  const GeometryRange &pulledRange();
+
+  // Object-space bounds, used to cull shadow casters per cascade.
+  void setBounds(Vec3 boundsMin, Vec3 boundsMax);
+  Vec3 boundsMin();
+  Vec3 boundsMax();
+
   void clear();
 
 private:
@@ -27,4 +39,10 @@ private:
   VkDeviceMemory m_vertexMemory = VK_NULL_HANDLE;
   VkBuffer m_indexBuffer = VK_NULL_HANDLE;
   VkDeviceMemory m_indexMemory = VK_NULL_HANDLE;
+
+  bool m_pulled = false;
+  GeometryRange m_pulledRange{};
+
+  Vec3 m_boundsMin{0.0f, 0.0f, 0.0f};
+  Vec3 m_boundsMax{0.0f, 0.0f, 0.0f};
 };
@@ -1,9 +1,14 @@
 #include "Model.hpp"
 
 #include <iostream>
+#include <utility>
 
-void Model::init(std::vector<Mesh> meshes) { m_meshes = meshes; }
+void Model::init(std::vector<Mesh> meshes) { m_meshes = std::move(meshes); }
 
 std::vector<Mesh> &Model::meshes() { return m_meshes; }
 
+void Model::setStatic(bool isStatic) { m_static = isStatic; }
+
+bool Model::isStatic() { return m_static; }
+
 void Model::clear() {}
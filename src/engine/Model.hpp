@@ -13,9 +13,15 @@ public:
 
   std::vector<Mesh> &meshes();
 
+  // Static models are the only casters drawn into the cached shadow
+  // cascades; dynamic ones only shadow the near cascades.
+  void setStatic(bool isStatic);
+  bool isStatic();
+
   void clear();
 
 private:
   std::vector<Mesh> m_meshes;
+  bool m_static = true;
   // This is where the textures go
 };
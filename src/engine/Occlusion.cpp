@@ -0,0 +1,479 @@
+#include "Occlusion.hpp"
+
+#include "Jobs.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+static constexpr uint32_t kFullMask = 0xffffffffu;
+
+OccluderMesh OccluderBox(Vec3 boundsMin, Vec3 boundsMax) {
+  OccluderMesh mesh;
+  for (uint32_t i = 0; i < 8; ++i) {
+    mesh.positions.push_back({i & 1 ? boundsMax.x : boundsMin.x,
+                              i & 2 ? boundsMax.y : boundsMin.y,
+                              i & 4 ? boundsMax.z : boundsMin.z});
+  }
+  // Two triangles per face; both sides are rasterized, so winding is free.
+  mesh.indices = {0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, 0, 4, 5, 0, 5, 1,
+                  2, 3, 7, 2, 7, 6, 0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3};
+  return mesh;
+}
+
+static Vec4 TransformClip(const Mat4 &m, Vec3 p) {
+  return {m.m[0] * p.x + m.m[4] * p.y + m.m[8] * p.z + m.m[12],
+          m.m[1] * p.x + m.m[5] * p.y + m.m[9] * p.z + m.m[13],
+          m.m[2] * p.x + m.m[6] * p.y + m.m[10] * p.z + m.m[14],
+          m.m[3] * p.x + m.m[7] * p.y + m.m[11] * p.z + m.m[15]};
+}
+
+#if MATH_NEON
+inline uint32_t NeonMoveMask(uint32x4_t v) {
+  static const uint32_t kBits[4] = {1, 2, 4, 8};
+  const uint32x4_t bits = vandq_u32(v, vld1q_u32(kBits));
+  uint32x2_t sum = vpadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+  sum = vpadd_u32(sum, sum);
+  return vget_lane_u32(sum, 0);
+}
+#endif
+
+// Coverage of the 8x4 pixels at (x, y), sampled at pixel centers; bit
+// row * 8 + column.
+static uint32_t TileCoverage(const float a[3], const float b[3],
+                             const float c[3], float x, float y) {
+  uint32_t mask = 0;
+#if MATH_SSE
+  const __m128 px =
+      _mm_add_ps(_mm_set1_ps(x), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+  const __m128 zero = _mm_setzero_ps();
+  __m128 left[3], stepX[3], stepY[3];
+  for (int e = 0; e < 3; ++e) {
+    const __m128 ea = _mm_set1_ps(a[e]);
+    left[e] = _mm_add_ps(_mm_mul_ps(ea, px),
+                         _mm_set1_ps(b[e] * (y + 0.5f) + c[e]));
+    stepX[e] = _mm_set1_ps(4.0f * a[e]);
+    stepY[e] = _mm_set1_ps(b[e]);
+  }
+  for (uint32_t row = 0; row < OcclusionBuffer::kTileHeight; ++row) {
+    __m128 inside = _mm_and_ps(_mm_cmpge_ps(left[0], zero),
+                               _mm_and_ps(_mm_cmpge_ps(left[1], zero),
+                                          _mm_cmpge_ps(left[2], zero)));
+    mask |= (uint32_t)_mm_movemask_ps(inside) << (row * 8);
+
+    const __m128 right0 = _mm_add_ps(left[0], stepX[0]);
+    const __m128 right1 = _mm_add_ps(left[1], stepX[1]);
+    const __m128 right2 = _mm_add_ps(left[2], stepX[2]);
+    inside = _mm_and_ps(_mm_cmpge_ps(right0, zero),
+                        _mm_and_ps(_mm_cmpge_ps(right1, zero),
+                                   _mm_cmpge_ps(right2, zero)));
+    mask |= (uint32_t)_mm_movemask_ps(inside) << (row * 8 + 4);
+
+    for (int e = 0; e < 3; ++e) {
+      left[e] = _mm_add_ps(left[e], stepY[e]);
+    }
+  }
+#elif MATH_NEON
+  static const float kOffsets[4] = {0.5f, 1.5f, 2.5f, 3.5f};
+  const float32x4_t px = vaddq_f32(vdupq_n_f32(x), vld1q_f32(kOffsets));
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  float32x4_t left[3], stepX[3], stepY[3];
+  for (int e = 0; e < 3; ++e) {
+    left[e] = vmlaq_f32(vdupq_n_f32(b[e] * (y + 0.5f) + c[e]), px,
+                        vdupq_n_f32(a[e]));
+    stepX[e] = vdupq_n_f32(4.0f * a[e]);
+    stepY[e] = vdupq_n_f32(b[e]);
+  }
+  for (uint32_t row = 0; row < OcclusionBuffer::kTileHeight; ++row) {
+    uint32x4_t inside = vandq_u32(vcgeq_f32(left[0], zero),
+                                  vandq_u32(vcgeq_f32(left[1], zero),
+                                            vcgeq_f32(left[2], zero)));
+    mask |= NeonMoveMask(inside) << (row * 8);
+
+    const float32x4_t right0 = vaddq_f32(left[0], stepX[0]);
+    const float32x4_t right1 = vaddq_f32(left[1], stepX[1]);
+    const float32x4_t right2 = vaddq_f32(left[2], stepX[2]);
+    inside = vandq_u32(vcgeq_f32(right0, zero),
+                       vandq_u32(vcgeq_f32(right1, zero),
+                                 vcgeq_f32(right2, zero)));
+    mask |= NeonMoveMask(inside) << (row * 8 + 4);
+
+    for (int e = 0; e < 3; ++e) {
+      left[e] = vaddq_f32(left[e], stepY[e]);
+    }
+  }
+#else
+  for (uint32_t row = 0; row < OcclusionBuffer::kTileHeight; ++row) {
+    const float py = y + (float)row + 0.5f;
+    for (uint32_t column = 0; column < OcclusionBuffer::kTileWidth;
+         ++column) {
+      const float px = x + (float)column + 0.5f;
+      bool inside = true;
+      for (int e = 0; e < 3; ++e) {
+        inside = inside && a[e] * px + b[e] * py + c[e] >= 0.0f;
+      }
+      mask |= (uint32_t)inside << (row * 8 + column);
+    }
+  }
+#endif
+  return mask;
+}
+
+void OcclusionBuffer::init(uint32_t width, uint32_t height) {
+  m_tilesX = (std::max(width, 1u) + kTileWidth - 1) / kTileWidth;
+  m_tilesY = (std::max(height, 1u) + kTileHeight - 1) / kTileHeight;
+  m_width = m_tilesX * kTileWidth;
+  m_height = m_tilesY * kTileHeight;
+
+  const size_t tiles = (size_t)m_tilesX * m_tilesY;
+  m_zMax0.assign(tiles, 1.0f);
+  m_zMax1.assign(tiles, 0.0f);
+  m_mask.assign(tiles, 0);
+  m_triangles.clear();
+}
+
+void OcclusionBuffer::begin(const Mat4 &viewProj) {
+  m_viewProj = viewProj;
+  std::fill(m_zMax0.begin(), m_zMax0.end(), 1.0f);
+  std::fill(m_zMax1.begin(), m_zMax1.end(), 0.0f);
+  std::fill(m_mask.begin(), m_mask.end(), 0);
+  m_triangles.clear();
+}
+
+void OcclusionBuffer::addOccluder(const OccluderMesh &mesh,
+                                  const Mat4 &world) {
+  const Mat4 transform = mul(m_viewProj, world);
+  m_clip.resize(mesh.positions.size());
+  for (size_t i = 0; i < mesh.positions.size(); ++i) {
+    m_clip[i] = TransformClip(transform, mesh.positions[i]);
+  }
+
+  for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+    setupTriangle(m_clip[mesh.indices[i]], m_clip[mesh.indices[i + 1]],
+                  m_clip[mesh.indices[i + 2]]);
+  }
+}
+
+void OcclusionBuffer::setupTriangle(const Vec4 &v0, const Vec4 &v1,
+                                    const Vec4 &v2) {
+  // In front of the near plane z >= 0, which for a perspective projection
+  // also means w > 0. Clipping would only add occluder area, so dropping
+  // the triangle is the conservative answer.
+  if (v0.z < 0.0f || v1.z < 0.0f || v2.z < 0.0f) {
+    return;
+  }
+  if ((v0.x > v0.w && v1.x > v1.w && v2.x > v2.w) ||
+      (v0.x < -v0.w && v1.x < -v1.w && v2.x < -v2.w) ||
+      (v0.y > v0.w && v1.y > v1.w && v2.y > v2.w) ||
+      (v0.y < -v0.w && v1.y < -v1.w && v2.y < -v2.w) ||
+      (v0.z > v0.w && v1.z > v1.w && v2.z > v2.w)) {
+    return;
+  }
+
+  const Vec4 *v[3] = {&v0, &v1, &v2};
+  float x[3], y[3], z[3];
+  for (int i = 0; i < 3; ++i) {
+    const float invW = 1.0f / v[i]->w;
+    x[i] = (v[i]->x * invW * 0.5f + 0.5f) * (float)m_width;
+    y[i] = (v[i]->y * invW * 0.5f + 0.5f) * (float)m_height;
+    z[i] = v[i]->z * invW;
+  }
+
+  float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+  if (std::fabs(area) < 1e-6f) {
+    return;
+  }
+  // Occluders are seen from both sides: flip to counter-clockwise.
+  if (area < 0.0f) {
+    std::swap(x[1], x[2]);
+    std::swap(y[1], y[2]);
+    std::swap(z[1], z[2]);
+    area = -area;
+  }
+
+  const float minX = std::min({x[0], x[1], x[2]});
+  const float maxX = std::max({x[0], x[1], x[2]});
+  const float minY = std::min({y[0], y[1], y[2]});
+  const float maxY = std::max({y[0], y[1], y[2]});
+  if (maxX < 0.0f || maxY < 0.0f || minX >= (float)m_width ||
+      minY >= (float)m_height) {
+    return;
+  }
+
+  Triangle triangle;
+  for (int i = 0; i < 3; ++i) {
+    const int j = (i + 1) % 3;
+    triangle.edgeA[i] = y[i] - y[j];
+    triangle.edgeB[i] = x[j] - x[i];
+    triangle.edgeC[i] = -(triangle.edgeA[i] * x[i] + triangle.edgeB[i] * y[i]);
+  }
+
+  triangle.zA =
+      ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+  triangle.zB =
+      ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+  triangle.zC = z[0] - triangle.zA * x[0] - triangle.zB * y[0];
+  triangle.zMax = std::max({z[0], z[1], z[2]});
+
+  auto tile = [](float value, uint32_t size, uint32_t count) {
+    const float clamped = std::min(std::max(value, 0.0f), (float)count * size);
+    return std::min((uint32_t)clamped / size, count - 1);
+  };
+  triangle.tileMinX = tile(minX, kTileWidth, m_tilesX);
+  triangle.tileMaxX = tile(maxX, kTileWidth, m_tilesX);
+  triangle.tileMinY = tile(minY, kTileHeight, m_tilesY);
+  triangle.tileMaxY = tile(maxY, kTileHeight, m_tilesY);
+  m_triangles.push_back(triangle);
+}
+
+void OcclusionBuffer::rasterize(JobSystem &jobs) {
+  PROFILE_ZONE("OcclusionBuffer::rasterize");
+
+  // Bands own whole tile rows, so jobs never touch the same tile and every
+  // tile sees its triangles in submission order.
+  jobs.parallelFor(
+      m_tilesY,
+      [this](uint32_t begin, uint32_t end) { rasterizeRows(begin, end); },
+      2);
+}
+
+void OcclusionBuffer::rasterizeRows(uint32_t tileBeginY, uint32_t tileEndY) {
+  for (const Triangle &triangle : m_triangles) {
+    if (triangle.tileMaxY < tileBeginY || triangle.tileMinY >= tileEndY) {
+      continue;
+    }
+
+    const uint32_t rowBegin = std::max(triangle.tileMinY, tileBeginY);
+    const uint32_t rowEnd = std::min(triangle.tileMaxY + 1, tileEndY);
+    for (uint32_t tileY = rowBegin; tileY < rowEnd; ++tileY) {
+      const float y0 = (float)(tileY * kTileHeight);
+      const float y1 = y0 + (float)kTileHeight;
+      for (uint32_t tileX = triangle.tileMinX; tileX <= triangle.tileMaxX;
+           ++tileX) {
+        const float x0 = (float)(tileX * kTileWidth);
+        const float x1 = x0 + (float)kTileWidth;
+        const uint32_t tile = tileY * m_tilesX + tileX;
+
+        // Edge functions are linear, so their extremes over the tile's
+        // pixel centers are at its corner pixels: skip tiles outside an
+        // edge and take tiles inside all three whole.
+        bool outside = false;
+        bool inside = true;
+        for (int e = 0; e < 3 && !outside; ++e) {
+          const float a = triangle.edgeA[e];
+          const float b = triangle.edgeB[e];
+          const float c = triangle.edgeC[e];
+          const float ax0 = a * (x0 + 0.5f), ax1 = a * (x1 - 0.5f);
+          const float by0 = b * (y0 + 0.5f), by1 = b * (y1 - 0.5f);
+          const float high = std::max(ax0, ax1) + std::max(by0, by1) + c;
+          const float low = std::min(ax0, ax1) + std::min(by0, by1) + c;
+          outside = high < 0.0f;
+          inside = inside && low >= 0.0f;
+        }
+        if (outside) {
+          continue;
+        }
+
+        const uint32_t mask =
+            inside ? kFullMask
+                   : TileCoverage(triangle.edgeA, triangle.edgeB,
+                                  triangle.edgeC, x0, y0);
+        if (!mask) {
+          continue;
+        }
+
+        // Farthest the triangle's plane gets over the tile, no farther than
+        // its farthest vertex.
+        const float depth = std::min(
+            triangle.zC + std::max(triangle.zA * x0, triangle.zA * x1) +
+                std::max(triangle.zB * y0, triangle.zB * y1),
+            triangle.zMax);
+        updateTile(tile, mask, depth);
+      }
+    }
+  }
+}
+
+void OcclusionBuffer::updateTile(uint32_t tile, uint32_t mask, float depth) {
+  float &zMax0 = m_zMax0[tile];
+  float &zMax1 = m_zMax1[tile];
+  uint32_t &layerMask = m_mask[tile];
+  if (depth >= zMax0) {
+    return;
+  }
+
+  // The paper's merge heuristic: when the new triangle is much nearer than
+  // the working layer, that layer is unlikely to ever fill the tile, so it
+  // is dropped and the working layer restarts from this triangle.
+  if (zMax1 - depth > zMax0 - zMax1) {
+    zMax1 = 0.0f;
+    layerMask = 0;
+  }
+  zMax1 = std::max(zMax1, depth);
+  layerMask |= mask;
+
+  if (layerMask == kFullMask) {
+    zMax0 = zMax1;
+    zMax1 = 0.0f;
+    layerMask = 0;
+  }
+}
+
+bool OcclusionBuffer::testBox(Vec3 boundsMin, Vec3 boundsMax) {
+  float minX = 1e30f, maxX = -1e30f;
+  float minY = 1e30f, maxY = -1e30f;
+  float nearest = 1e30f;
+  for (uint32_t i = 0; i < 8; ++i) {
+    const Vec4 clip = TransformClip(m_viewProj,
+                                    {i & 1 ? boundsMax.x : boundsMin.x,
+                                     i & 2 ? boundsMax.y : boundsMin.y,
+                                     i & 4 ? boundsMax.z : boundsMin.z});
+    if (clip.z < 0.0f) {
+      return true;
+    }
+    const float invW = 1.0f / clip.w;
+    const float x = (clip.x * invW * 0.5f + 0.5f) * (float)m_width;
+    const float y = (clip.y * invW * 0.5f + 0.5f) * (float)m_height;
+    minX = std::min(minX, x);
+    maxX = std::max(maxX, x);
+    minY = std::min(minY, y);
+    maxY = std::max(maxY, y);
+    nearest = std::min(nearest, clip.z * invW);
+  }
+
+  // Off screen is for frustum culling to decide.
+  if (maxX < 0.0f || maxY < 0.0f || minX >= (float)m_width ||
+      minY >= (float)m_height) {
+    return true;
+  }
+
+  const uint32_t tileMinX = (uint32_t)std::max(minX, 0.0f) / kTileWidth;
+  const uint32_t tileMinY = (uint32_t)std::max(minY, 0.0f) / kTileHeight;
+  const uint32_t tileMaxX =
+      std::min((uint32_t)maxX / kTileWidth, m_tilesX - 1);
+  const uint32_t tileMaxY =
+      std::min((uint32_t)maxY / kTileHeight, m_tilesY - 1);
+
+  // Visible as soon as one tile may hold something farther than the box's
+  // nearest point.
+  for (uint32_t tileY = tileMinY; tileY <= tileMaxY; ++tileY) {
+    const float *row = m_zMax0.data() + (size_t)tileY * m_tilesX;
+    uint32_t tileX = tileMinX;
+#if MATH_SSE
+    const __m128 boxDepth = _mm_set1_ps(nearest);
+    for (; tileX + 4 <= tileMaxX + 1; tileX += 4) {
+      if (_mm_movemask_ps(_mm_cmplt_ps(boxDepth, _mm_loadu_ps(row + tileX)))) {
+        return true;
+      }
+    }
+#elif MATH_NEON
+    const float32x4_t boxDepth = vdupq_n_f32(nearest);
+    for (; tileX + 4 <= tileMaxX + 1; tileX += 4) {
+      if (NeonMoveMask(vcltq_f32(boxDepth, vld1q_f32(row + tileX)))) {
+        return true;
+      }
+    }
+#endif
+    for (; tileX <= tileMaxX; ++tileX) {
+      if (nearest < row[tileX]) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+float OcclusionBuffer::tileDepth(uint32_t tileX, uint32_t tileY) {
+  return m_zMax0[tileY * m_tilesX + tileX];
+}
+
+void RunOcclusionBenchmark() {
+  using Clock = std::chrono::steady_clock;
+
+  JobSystem jobs;
+  jobs.init();
+
+  const Mat4 viewProj =
+      mul(perspectiveRH(1.04719755f, 16.0f / 9.0f, 0.1f, 200.0f),
+          lookAtRH({0.0f, 1.5f, 0.0f}, {0.0f, 1.5f, -1.0f},
+                   {0.0f, 1.0f, 0.0f}));
+
+  // A street of building blocks with gaps between them, and crates from
+  // just past the camera to far behind the blocks.
+  std::mt19937 random(42);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::vector<Mat4> occluders;
+  for (int i = 0; i < 64; ++i) {
+    const float x = -60.0f + 120.0f * unit(random);
+    const float z = -8.0f - 40.0f * unit(random);
+    occluders.push_back(compose({x, 0.0f, z}, Quat{},
+                                {2.0f + 6.0f * unit(random),
+                                 3.0f + 10.0f * unit(random),
+                                 2.0f + 6.0f * unit(random)}));
+  }
+  const OccluderMesh box = OccluderBox({-0.5f, 0.0f, -0.5f},
+                                       {0.5f, 1.0f, 0.5f});
+
+  const uint32_t occludeeCount = 100000;
+  std::vector<Vec3> boundsMin(occludeeCount);
+  std::vector<Vec3> boundsMax(occludeeCount);
+  for (uint32_t i = 0; i < occludeeCount; ++i) {
+    const Vec3 center = {-80.0f + 160.0f * unit(random),
+                         0.5f * unit(random),
+                         -2.0f - 150.0f * unit(random)};
+    const float size = 0.25f + 0.75f * unit(random);
+    boundsMin[i] = sub(center, {size, size, size});
+    boundsMax[i] = add(center, {size, size, size});
+  }
+
+  OcclusionBuffer buffer;
+  buffer.init(320, 192);
+
+  double setupMs = 1e30, rasterMs = 1e30, testMs = 1e30;
+  uint32_t occluded = 0;
+  for (int repeat = 0; repeat < 5; ++repeat) {
+    const Clock::time_point start = Clock::now();
+    buffer.begin(viewProj);
+    for (const Mat4 &world : occluders) {
+      buffer.addOccluder(box, world);
+    }
+    const Clock::time_point setUp = Clock::now();
+    buffer.rasterize(jobs);
+    const Clock::time_point rasterized = Clock::now();
+
+    std::atomic<uint32_t> hidden{0};
+    jobs.parallelFor(
+        occludeeCount,
+        [&](uint32_t begin, uint32_t end) {
+          uint32_t count = 0;
+          for (uint32_t i = begin; i < end; ++i) {
+            count += !buffer.testBox(boundsMin[i], boundsMax[i]);
+          }
+          hidden.fetch_add(count, std::memory_order_relaxed);
+        },
+        256);
+    const Clock::time_point tested = Clock::now();
+
+    auto ms = [](Clock::time_point a, Clock::time_point b) {
+      return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+    setupMs = std::min(setupMs, ms(start, setUp));
+    rasterMs = std::min(rasterMs, ms(setUp, rasterized));
+    testMs = std::min(testMs, ms(rasterized, tested));
+    occluded = hidden.load();
+  }
+
+  std::printf("Occlusion culling (%ux%u, %s, %u threads, best of 5)\n",
+              buffer.width(), buffer.height(), MathBackendName(),
+              jobs.threadCount());
+  std::printf("  %zu occluders, %u triangles: setup %.3f ms, raster %.3f ms\n",
+              occluders.size(), buffer.triangleCount(), setupMs, rasterMs);
+  std::printf("  %u boxes: test %.3f ms, %u occluded (%.1f%%)\n",
+              occludeeCount, testMs, occluded,
+              100.0 * occluded / occludeeCount);
+
+  jobs.shutdown();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Math.hpp"
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem; // forward declaration
+
+// Occluder proxy in object space: a few triangles lying inside the mesh
+// they stand for, so whatever they hide the mesh hides too.
+struct OccluderMesh {
+  std::vector<Vec3> positions;
+  std::vector<uint32_t> indices; // triangle list
+};
+
+// The box itself as a proxy; only right for meshes that fill their bounds
+// (walls, floors, crates).
+OccluderMesh OccluderBox(Vec3 boundsMin, Vec3 boundsMax);
+
+// Low resolution software depth buffer for occlusion culling on the CPU,
+// after Andersson et al., "Masked Software Occlusion Culling". Pixels are
+// grouped into 8x4 tiles; instead of a depth per pixel a tile keeps a
+// 32-bit coverage mask and two depths: everything in the tile is at most
+// as far as the first, and the masked pixels at most as far as the second.
+// The per-tile farthest depth is the coarse level boxes are tested against.
+//
+// Depth is clip space z / w, 0 at the near plane and 1 at the far one, so
+// the same view-projection matrix as the camera's can be used directly.
+// Occluder triangles crossing the near plane are dropped, which only ever
+// lets more through.
+class OcclusionBuffer {
+public:
+  static constexpr uint32_t kTileWidth = 8;
+  static constexpr uint32_t kTileHeight = 4;
+
+  // Rounded up to whole tiles.
+  void init(uint32_t width, uint32_t height);
+
+  // Starts a frame: forgets the occluders and clears to the far plane.
+  void begin(const Mat4 &viewProj);
+  // Transforms and sets up the triangles of mesh placed at world.
+  void addOccluder(const OccluderMesh &mesh, const Mat4 &world);
+  // Rasterizes what was added since begin(), one job per band of tile rows.
+  void rasterize(JobSystem &jobs);
+
+  // Whether any part of the world space box may be visible. Boxes reaching
+  // in front of the near plane always are. Safe to call from many threads
+  // once rasterize() has returned.
+  bool testBox(Vec3 boundsMin, Vec3 boundsMax);
+
+  uint32_t width() { return m_width; }
+  uint32_t height() { return m_height; }
+  // Farthest depth in a tile, for debug views.
+  float tileDepth(uint32_t tileX, uint32_t tileY);
+  // Triangles set up since begin(), after near plane and area rejection.
+  uint32_t triangleCount() { return (uint32_t)m_triangles.size(); }
+
+private:
+  struct Triangle {
+    // Edge functions a * x + b * y + c, >= 0 inside.
+    float edgeA[3];
+    float edgeB[3];
+    float edgeC[3];
+    // Depth plane z = zC + zA * x + zB * y, clamped to zMax.
+    float zA, zB, zC;
+    float zMax;
+    // Tile rectangle, inclusive.
+    uint32_t tileMinX, tileMinY;
+    uint32_t tileMaxX, tileMaxY;
+  };
+
+  uint32_t m_width = 0;
+  uint32_t m_height = 0;
+  uint32_t m_tilesX = 0;
+  uint32_t m_tilesY = 0;
+  Mat4 m_viewProj = Mat4::identity();
+
+  // By tile, row major.
+  std::vector<float> m_zMax0;   // whole tile
+  std::vector<float> m_zMax1;   // pixels in m_mask
+  std::vector<uint32_t> m_mask; // bit y * 8 + x
+  std::vector<Triangle> m_triangles;
+  std::vector<Vec4> m_clip; // addOccluder() scratch
+
+  void setupTriangle(const Vec4 &v0, const Vec4 &v1, const Vec4 &v2);
+  void rasterizeRows(uint32_t tileBeginY, uint32_t tileEndY);
+  void updateTile(uint32_t tile, uint32_t mask, float depth);
+};
+
+// Rasterizes a field of box occluders in front of many occludees and times
+// rasterization and testing. Run with --bench-occlusion.
+void RunOcclusionBenchmark();
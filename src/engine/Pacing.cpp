@@ -0,0 +1,90 @@
+#include "Pacing.hpp"
+
+#include <SDL3/SDL_timer.h>
+
+#include <thread>
+
+// Sleeps are cut this far short of the deadline and the rest is spun;
+// covers scheduler wake-up jitter on the platforms we ship on.
+static constexpr uint64_t kSpinNanoseconds = 1500000;
+
+const char *PresentPolicyName(PresentPolicy presentPolicy) {
+  switch (presentPolicy) {
+  case PresentVsync:
+    return "vsync";
+  case PresentLowLatency:
+    return "low latency vsync";
+  case PresentUncapped:
+    return "uncapped";
+  default:
+    return "unknown";
+  }
+}
+
+const char *PresentModeName(VkPresentModeKHR presentMode) {
+  switch (presentMode) {
+  case VK_PRESENT_MODE_IMMEDIATE_KHR:
+    return "IMMEDIATE";
+  case VK_PRESENT_MODE_MAILBOX_KHR:
+    return "MAILBOX";
+  case VK_PRESENT_MODE_FIFO_KHR:
+    return "FIFO";
+  case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+    return "FIFO_RELAXED";
+  default:
+    return "other";
+  }
+}
+
+uint32_t PresentModePreference(PresentPolicy presentPolicy,
+                               VkPresentModeKHR *presentModes) {
+  switch (presentPolicy) {
+  case PresentLowLatency:
+    presentModes[0] = VK_PRESENT_MODE_MAILBOX_KHR;
+    presentModes[1] = VK_PRESENT_MODE_FIFO_KHR;
+    return 2;
+  case PresentUncapped:
+    presentModes[0] = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    presentModes[1] = VK_PRESENT_MODE_MAILBOX_KHR;
+    presentModes[2] = VK_PRESENT_MODE_FIFO_KHR;
+    return 3;
+  default:
+    presentModes[0] = VK_PRESENT_MODE_FIFO_KHR;
+    return 1;
+  }
+}
+
+uint64_t FramePacer::now() { return SDL_GetTicksNS(); }
+
+void FramePacer::setTargetFps(uint32_t fps) {
+  m_targetFps = fps;
+  m_periodNanoseconds = fps ? SDL_NS_PER_SECOND / fps : 0;
+  reset();
+}
+
+uint32_t FramePacer::targetFps() { return m_targetFps; }
+
+void FramePacer::waitForNextFrame() {
+  if (!m_periodNanoseconds) {
+    return;
+  }
+
+  uint64_t current = now();
+  if (m_nextFrame == 0 || current > m_nextFrame + m_periodNanoseconds) {
+    m_nextFrame = current + m_periodNanoseconds;
+    return;
+  }
+
+  if (current + kSpinNanoseconds < m_nextFrame) {
+    SDL_DelayNS(m_nextFrame - current - kSpinNanoseconds);
+  }
+  while (now() < m_nextFrame) {
+    std::this_thread::yield();
+  }
+
+  // Advance from the deadline, not from now(), so small overshoots do not
+  // accumulate into a lower frame rate.
+  m_nextFrame += m_periodNanoseconds;
+}
+
+void FramePacer::reset() { m_nextFrame = 0; }
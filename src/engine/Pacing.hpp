@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+// How frames reach the display. Each policy lists present modes in order of
+// preference; FIFO is always available as the last resort.
+enum PresentPolicy {
+  PresentVsync = 0,   // FIFO: never renders frames that are not shown
+  PresentLowLatency,  // MAILBOX: vsync without queueing, newest frame wins
+  PresentUncapped,    // IMMEDIATE: tearing allowed, for benchmarking
+  PresentPolicyCount,
+};
+
+const char *PresentPolicyName(PresentPolicy presentPolicy);
+const char *PresentModeName(VkPresentModeKHR presentMode);
+// Fills up to 3 modes; returns how many.
+uint32_t PresentModePreference(PresentPolicy presentPolicy,
+                               VkPresentModeKHR *presentModes);
+
+// CPU-side frame limiter on SDL's nanosecond clock. Sleeps for most of the
+// remaining frame time, then spins for the last stretch, where OS sleeps
+// overshoot.
+class FramePacer {
+public:
+  FramePacer() = default;
+  ~FramePacer() = default;
+
+  static uint64_t now(); // nanoseconds
+
+  // 0 disables the limiter.
+  void setTargetFps(uint32_t fps);
+  uint32_t targetFps();
+
+  // Blocks until the next frame is due. Falling more than a frame behind
+  // restarts the schedule instead of bursting to catch up.
+  void waitForNextFrame();
+
+  // Forget the schedule, e.g. after idling while minimized.
+  void reset();
+
+private:
+  uint32_t m_targetFps = 0;
+  uint64_t m_periodNanoseconds = 0;
+  uint64_t m_nextFrame = 0;
+};
@@ -0,0 +1,182 @@
+#include "../Vulkan.hpp"
+
+#include "Log.hpp"
+#include "Pipeline.hpp"
+
+VkPipeline CreateGraphicsPipeline(VkDevice device,
+                                  const GraphicsPipelineDescription &desc) {
+  std::vector<char> vsBytes;
+  std::vector<char> fsBytes;
+
+  if (!ReadFileBytes(desc.vertexShader, vsBytes)) {
+    Log::error("Missing vertex shader %s", desc.vertexShader);
+    return VK_NULL_HANDLE;
+  }
+
+  if (desc.fragmentShader && !ReadFileBytes(desc.fragmentShader, fsBytes)) {
+    Log::error("Missing fragment shader %s", desc.fragmentShader);
+    return VK_NULL_HANDLE;
+  }
+
+  VkShaderModule vs = CreateShaderModule(device, vsBytes);
+  if (!vs) {
+    Log::error("Failed to create vertex shader module");
+    return VK_NULL_HANDLE;
+  }
+
+  VkShaderModule fs = VK_NULL_HANDLE;
+  if (desc.fragmentShader) {
+    fs = CreateShaderModule(device, fsBytes);
+    if (!fs) {
+      Log::error("Failed to create fragment shader module");
+      vkDestroyShaderModule(device, vs, nullptr);
+      return VK_NULL_HANDLE;
+    }
+  }
+
+  VkPipelineShaderStageCreateInfo pipelineShaderStageCreateInfo[2]{};
+  pipelineShaderStageCreateInfo[0].sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineShaderStageCreateInfo[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  pipelineShaderStageCreateInfo[0].module = vs;
+  pipelineShaderStageCreateInfo[0].pName = "main";
+  pipelineShaderStageCreateInfo[1].sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineShaderStageCreateInfo[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  pipelineShaderStageCreateInfo[1].module = fs;
+  pipelineShaderStageCreateInfo[1].pName = "main";
+
+  // Vertex pulling pipelines fetch everything from storage buffers.
+  VkPipelineVertexInputStateCreateInfo emptyVertexInputStateCreateInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+
+  VkPipelineInputAssemblyStateCreateInfo pipelineInputAsseblyStateCreateInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+  pipelineInputAsseblyStateCreateInfo.topology =
+      VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  pipelineInputAsseblyStateCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+  VkPipelineViewportStateCreateInfo pipelineViewportStateCreateInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+  pipelineViewportStateCreateInfo.viewportCount = 1;
+  pipelineViewportStateCreateInfo.scissorCount = 1;
+
+  VkPipelineRasterizationStateCreateInfo pipelineRasterizationStateCreateInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+  pipelineRasterizationStateCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
+  pipelineRasterizationStateCreateInfo.cullMode = desc.cullMode;
+  pipelineRasterizationStateCreateInfo.frontFace =
+      VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  pipelineRasterizationStateCreateInfo.lineWidth = 1.0f;
+  if (desc.depthBiasConstant != 0.0f || desc.depthBiasSlope != 0.0f) {
+    pipelineRasterizationStateCreateInfo.depthBiasEnable = VK_TRUE;
+    pipelineRasterizationStateCreateInfo.depthBiasConstantFactor =
+        desc.depthBiasConstant;
+    pipelineRasterizationStateCreateInfo.depthBiasSlopeFactor =
+        desc.depthBiasSlope;
+  }
+
+  VkPipelineMultisampleStateCreateInfo pipelineMultisampleStateCreateInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+  pipelineMultisampleStateCreateInfo.rasterizationSamples = desc.samples;
+
+  VkPipelineDepthStencilStateCreateInfo pipelineDepthStencilStateCreateInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
+  pipelineDepthStencilStateCreateInfo.depthTestEnable =
+      desc.depthTest ? VK_TRUE : VK_FALSE;
+  pipelineDepthStencilStateCreateInfo.depthWriteEnable =
+      desc.depthWrite ? VK_TRUE : VK_FALSE;
+  pipelineDepthStencilStateCreateInfo.depthCompareOp = desc.depthCompareOp;
+
+  if (desc.colorAttachmentCount > kMaxColorAttachments) {
+    Log::error("Too many color attachments: %u", desc.colorAttachmentCount);
+    vkDestroyShaderModule(device, vs, nullptr);
+    if (fs) {
+      vkDestroyShaderModule(device, fs, nullptr);
+    }
+    return VK_NULL_HANDLE;
+  }
+
+  VkPipelineColorBlendAttachmentState
+      pipelineColorBlendAttachmentStates[kMaxColorAttachments]{};
+  for (VkPipelineColorBlendAttachmentState &pipelineColorBlendAttachmentState :
+       pipelineColorBlendAttachmentStates) {
+    pipelineColorBlendAttachmentState.colorWriteMask =
+        desc.fragmentShader
+            ? VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                  VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+            : 0;
+    pipelineColorBlendAttachmentState.blendEnable = VK_FALSE;
+  }
+
+  VkPipelineColorBlendStateCreateInfo pipelineColorBlendStateCreateInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+  // Dynamic rendering has no depth-only subpass, so a depth-only pipeline
+  // still declares the scope's color attachments, with writes masked off.
+  pipelineColorBlendStateCreateInfo.attachmentCount =
+      desc.fragmentShader || !desc.renderPass ? desc.colorAttachmentCount : 0;
+  pipelineColorBlendStateCreateInfo.pAttachments =
+      pipelineColorBlendAttachmentStates;
+
+  VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                    VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo pipelineDynamicStateCreateInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+  pipelineDynamicStateCreateInfo.dynamicStateCount = 2;
+  pipelineDynamicStateCreateInfo.pDynamicStates = dynamicStates;
+
+  // Without a render pass the pipeline is built for dynamic rendering into
+  // the described attachment formats.
+  VkPipelineRenderingCreateInfo pipelineRenderingCreateInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO};
+  pipelineRenderingCreateInfo.colorAttachmentCount =
+      pipelineColorBlendStateCreateInfo.attachmentCount;
+  pipelineRenderingCreateInfo.pColorAttachmentFormats = desc.colorFormats;
+  pipelineRenderingCreateInfo.depthAttachmentFormat = desc.depthFormat;
+
+  VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo{};
+  graphicsPipelineCreateInfo.sType =
+      VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  graphicsPipelineCreateInfo.pNext =
+      desc.renderPass ? nullptr : &pipelineRenderingCreateInfo;
+
+  graphicsPipelineCreateInfo.stageCount = desc.fragmentShader ? 2 : 1;
+  graphicsPipelineCreateInfo.pStages = pipelineShaderStageCreateInfo;
+
+  graphicsPipelineCreateInfo.pVertexInputState =
+      desc.vertexInput ? desc.vertexInput : &emptyVertexInputStateCreateInfo;
+  graphicsPipelineCreateInfo.pInputAssemblyState =
+      &pipelineInputAsseblyStateCreateInfo;
+  graphicsPipelineCreateInfo.pViewportState = &pipelineViewportStateCreateInfo;
+  graphicsPipelineCreateInfo.pRasterizationState =
+      &pipelineRasterizationStateCreateInfo;
+  graphicsPipelineCreateInfo.pMultisampleState =
+      &pipelineMultisampleStateCreateInfo;
+  graphicsPipelineCreateInfo.pDepthStencilState =
+      &pipelineDepthStencilStateCreateInfo;
+  graphicsPipelineCreateInfo.pColorBlendState =
+      &pipelineColorBlendStateCreateInfo;
+  graphicsPipelineCreateInfo.pDynamicState = &pipelineDynamicStateCreateInfo;
+
+  graphicsPipelineCreateInfo.layout = desc.layout;
+  graphicsPipelineCreateInfo.renderPass = desc.renderPass;
+  graphicsPipelineCreateInfo.subpass = desc.subpass;
+
+  graphicsPipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+  graphicsPipelineCreateInfo.basePipelineIndex = -1;
+
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1,
+                                &graphicsPipelineCreateInfo, nullptr,
+                                &pipeline) != VK_SUCCESS) {
+    Log::error("vkCreateGraphicsPipelines failed");
+    pipeline = VK_NULL_HANDLE;
+  }
+
+  vkDestroyShaderModule(device, vs, nullptr);
+  if (fs) {
+    vkDestroyShaderModule(device, fs, nullptr);
+  }
+
+  return pipeline;
+}
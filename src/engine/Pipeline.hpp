@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+static constexpr uint32_t kMaxColorAttachments = 4;
+
+// Everything a scene needs to say about a graphics pipeline. Fixed state that
+// every pipeline in the engine shares (triangle lists, dynamic viewport and
+// scissor, no blending) is filled in by CreateGraphicsPipeline.
+struct GraphicsPipelineDescription {
+  const char *vertexShader = nullptr;
+  // nullptr builds a depth-only pipeline with no fragment stage.
+  const char *fragmentShader = nullptr;
+
+  // nullptr means no fixed-function vertex input (vertex pulling).
+  const VkPipelineVertexInputStateCreateInfo *vertexInput = nullptr;
+
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+  // VK_NULL_HANDLE selects dynamic rendering into colorFormats/depthFormat.
+  VkRenderPass renderPass = VK_NULL_HANDLE;
+  uint32_t subpass = 0;
+  VkFormat colorFormats[kMaxColorAttachments]{};
+  VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+  VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+  // Color outputs of the subpass (TAA adds motion vectors); ignored for
+  // depth-only render pass pipelines.
+  uint32_t colorAttachmentCount = 1;
+
+  VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+
+  bool depthTest = true;
+  bool depthWrite = true;
+  VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+
+  // Rasterizer depth bias, enabled when either is nonzero (shadow casters).
+  float depthBiasConstant = 0.0f;
+  float depthBiasSlope = 0.0f;
+};
+
+// Returns VK_NULL_HANDLE on failure.
+VkPipeline CreateGraphicsPipeline(VkDevice device,
+                                  const GraphicsPipelineDescription &desc);
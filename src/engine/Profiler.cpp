@@ -0,0 +1,508 @@
+#include "../Vulkan.hpp"
+
+#include "Profiler.hpp"
+
+#include "Log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+// Zones kept per thread; older ones are overwritten.
+static constexpr uint32_t kThreadEventCapacity = 1u << 16;
+// Frames a capture keeps running after the last requested one, so the
+// render thread and the GPU results of the final frames catch up.
+static constexpr uint32_t kDrainFrames = MAX_FRAMES_IN_FLIGHT + 2;
+
+namespace {
+
+// Fields are relaxed atomics so a reader racing the owner's overwrite gets
+// a stale or torn event it can detect, never undefined behaviour.
+struct ProfileEvent {
+  std::atomic<const char *> name{nullptr};
+  std::atomic<uint64_t> begin{0};
+  std::atomic<uint64_t> end{0};
+  std::atomic<uint32_t> track{ProfileThreadTrack};
+};
+
+// Ring written only by its thread. claimed is bumped before a slot is
+// written and written after, so a reader can tell which of the slots it
+// copied may have been overwritten meanwhile (a seqlock per ring).
+struct ThreadBuffer {
+  uint32_t id = 0;
+  std::string name; // guarded by ProfilerState::mutex
+  std::atomic<uint64_t> claimed{0};
+  std::atomic<uint64_t> written{0};
+  std::unique_ptr<ProfileEvent[]> events;
+};
+
+struct CopiedEvent {
+  const char *name;
+  uint64_t begin;
+  uint64_t end;
+  uint32_t track;
+};
+
+enum CaptureState { CaptureIdle, CaptureRecording, CaptureDraining };
+
+struct ProfilerState {
+  std::mutex mutex; // thread registry and interned names
+  std::vector<std::unique_ptr<ThreadBuffer>> threads;
+  std::unordered_set<std::string> names;
+
+  std::atomic<int> state{CaptureIdle};
+  std::atomic<bool> flightRecorder{false};
+
+  // Main thread only
+  uint32_t framesLeft = 0;
+  uint64_t start = 0;
+  std::string path;
+};
+
+} // namespace
+
+static ProfilerState &State() {
+  static ProfilerState state;
+  return state;
+}
+
+static thread_local ThreadBuffer *t_buffer = nullptr;
+static thread_local const char *t_threadName = nullptr;
+
+static ThreadBuffer *CurrentThreadBuffer() {
+  if (t_buffer) {
+    return t_buffer;
+  }
+
+  ProfilerState &state = State();
+  auto buffer = std::make_unique<ThreadBuffer>();
+  buffer->events = std::make_unique<ProfileEvent[]>(kThreadEventCapacity);
+
+  std::lock_guard<std::mutex> lock(state.mutex);
+  buffer->id = (uint32_t)state.threads.size() + 1;
+  buffer->name = t_threadName ? t_threadName
+                              : "Thread " + std::to_string(buffer->id);
+  t_buffer = buffer.get();
+  state.threads.push_back(std::move(buffer));
+  return t_buffer;
+}
+
+// Copies the events of buffer that are still intact. Returns true when the
+// ring had already wrapped past begin, i.e. the oldest zones are missing.
+static bool CopyEvents(const ThreadBuffer &buffer, uint64_t begin,
+                       std::vector<CopiedEvent> &events) {
+  events.clear();
+
+  const uint64_t written = buffer.written.load(std::memory_order_acquire);
+  const uint64_t first =
+      written > kThreadEventCapacity ? written - kThreadEventCapacity : 0;
+
+  events.reserve((size_t)(written - first));
+  for (uint64_t i = first; i < written; ++i) {
+    const ProfileEvent &event =
+        buffer.events[i & (kThreadEventCapacity - 1)];
+    events.push_back({event.name.load(std::memory_order_relaxed),
+                      event.begin.load(std::memory_order_relaxed),
+                      event.end.load(std::memory_order_relaxed),
+                      event.track.load(std::memory_order_relaxed)});
+  }
+
+  // Slot i was reused once index i + capacity was claimed.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const uint64_t claimed = buffer.claimed.load(std::memory_order_relaxed);
+  const uint64_t intact =
+      claimed > kThreadEventCapacity ? claimed - kThreadEventCapacity : 0;
+  if (intact > first) {
+    events.erase(events.begin(),
+                 events.begin() + (ptrdiff_t)std::min<uint64_t>(
+                                      intact - first, events.size()));
+  }
+
+  return first > 0 && (events.empty() || events.front().begin > begin);
+}
+
+static void WriteJsonString(FILE *file, const char *text) {
+  std::fputc('"', file);
+  for (const char *c = text; *c; ++c) {
+    if (*c == '"' || *c == '\\') {
+      std::fputc('\\', file);
+    }
+    if ((unsigned char)*c >= 0x20) {
+      std::fputc(*c, file);
+    }
+  }
+  std::fputc('"', file);
+}
+
+uint64_t Profiler::now() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Profiler::setThreadName(const char *name) {
+  t_threadName = name;
+  if (t_buffer) {
+    std::lock_guard<std::mutex> lock(State().mutex);
+    t_buffer->name = name;
+  }
+}
+
+const char *Profiler::intern(const std::string &name) {
+  ProfilerState &state = State();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  // Set nodes never move, so the pointer stays valid.
+  return state.names.insert(name).first->c_str();
+}
+
+void Profiler::beginCapture(uint32_t frameCount, const std::string &path) {
+  ProfilerState &state = State();
+  if (state.state.load() != CaptureIdle || frameCount == 0) {
+    return;
+  }
+
+  state.framesLeft = frameCount;
+  state.start = now();
+  state.path = path;
+  state.state.store(CaptureRecording, std::memory_order_release);
+
+  Log::info("Profiler: capturing %u frames", frameCount);
+}
+
+void Profiler::setFlightRecorder(bool enabled) {
+  State().flightRecorder.store(enabled);
+}
+
+bool Profiler::active() {
+  ProfilerState &state = State();
+  return state.flightRecorder.load(std::memory_order_relaxed) ||
+         state.state.load(std::memory_order_relaxed) != CaptureIdle;
+}
+
+void Profiler::markFrame() {
+  ProfilerState &state = State();
+  const int captureState = state.state.load();
+  if (captureState == CaptureIdle || --state.framesLeft > 0) {
+    return;
+  }
+
+  if (captureState == CaptureRecording) {
+    state.framesLeft = kDrainFrames;
+    state.state.store(CaptureDraining);
+    return;
+  }
+
+  state.state.store(CaptureIdle);
+  writeTrace(state.path, state.start, now());
+}
+
+void Profiler::record(const char *name, uint64_t begin, uint64_t end,
+                      ProfileTrack track) {
+  ThreadBuffer *buffer = CurrentThreadBuffer();
+
+  const uint64_t index = buffer->written.load(std::memory_order_relaxed);
+  buffer->claimed.store(index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  ProfileEvent &event = buffer->events[index & (kThreadEventCapacity - 1)];
+  event.name.store(name, std::memory_order_relaxed);
+  event.begin.store(begin, std::memory_order_relaxed);
+  event.end.store(end, std::memory_order_relaxed);
+  event.track.store(track, std::memory_order_relaxed);
+
+  buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::writeTrace(const std::string &path, uint64_t begin,
+                          uint64_t end) {
+  ProfilerState &state = State();
+
+  FILE *file = std::fopen(path.c_str(), "wb");
+  if (!file) {
+    Log::error("Profiler: cannot write %s", path.c_str());
+    return;
+  }
+
+  // Chrome trace event format: pid 1 holds one track per CPU thread, pid 2
+  // the GPU queue. Timestamps are microseconds from begin.
+  std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+  std::fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+             "\"args\":{\"name\":\"CPU\"}},\n",
+             file);
+  std::fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"tid\":0,"
+             "\"args\":{\"name\":\"GPU\"}},\n",
+             file);
+  std::fputs("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":2,\"tid\":1,"
+             "\"args\":{\"name\":\"Graphics queue\"}}",
+             file);
+
+  size_t eventCount = 0;
+  uint32_t wrappedCount = 0;
+  std::vector<CopiedEvent> events;
+
+  std::lock_guard<std::mutex> lock(state.mutex);
+  for (const auto &buffer : state.threads) {
+    wrappedCount += CopyEvents(*buffer, begin, events) ? 1 : 0;
+
+    std::fprintf(file,
+                 ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                 "\"tid\":%u,\"args\":{\"name\":",
+                 buffer->id);
+    WriteJsonString(file, buffer->name.c_str());
+    std::fputs("}}", file);
+
+    for (const CopiedEvent &event : events) {
+      if (!event.name || event.begin < begin || event.end > end ||
+          event.end < event.begin) {
+        continue;
+      }
+
+      const bool gpu = event.track == ProfileGpuTrack;
+      std::fputs(",\n{\"name\":", file);
+      WriteJsonString(file, event.name);
+      std::fprintf(file,
+                   ",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,"
+                   "\"dur\":%.3f}",
+                   gpu ? 2 : 1, gpu ? 1u : buffer->id,
+                   (double)(event.begin - begin) / 1000.0,
+                   (double)(event.end - event.begin) / 1000.0);
+      ++eventCount;
+    }
+  }
+
+  std::fputs("\n]}\n", file);
+  std::fclose(file);
+
+  if (wrappedCount) {
+    Log::info("Profiler: wrote %zu zones to %s (%zu thread(s) wrapped; their "
+              "earliest zones are missing)",
+              (size_t)eventCount, path.c_str(), (size_t)wrappedCount);
+  } else {
+    Log::info("Profiler: wrote %zu zones to %s", (size_t)eventCount,
+              path.c_str());
+  }
+}
+
+void GpuProfiler::init(VkInstance instance, VkPhysicalDevice physicalDevice,
+                       VkDevice device, uint32_t queueFamily,
+                       bool calibratedTimestamps) {
+  VkPhysicalDeviceProperties physicalDeviceProperties{};
+  vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+  m_timestampPeriod = physicalDeviceProperties.limits.timestampPeriod;
+
+  uint32_t queueFamilyPropertyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,
+                                           &queueFamilyPropertyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilyProperties(
+      queueFamilyPropertyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(
+      physicalDevice, &queueFamilyPropertyCount, queueFamilyProperties.data());
+
+  const uint32_t validBits =
+      queueFamily < queueFamilyPropertyCount
+          ? queueFamilyProperties[queueFamily].timestampValidBits
+          : 0;
+  m_supported = validBits > 0;
+  if (!m_supported) {
+    Log::warning("GPU timestamps unavailable; captures have no GPU track");
+    return;
+  }
+  m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+  VkQueryPoolCreateInfo queryPoolCreateInfo{
+      VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+  queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  queryPoolCreateInfo.queryCount = 2 * kMaxZonesPerFrame * MAX_FRAMES_IN_FLIGHT;
+
+  if (vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr,
+                        &m_queryPool) != VK_SUCCESS) {
+    std::cerr << "vkCreateQueryPool failed for the GPU profiler" << std::endl;
+    std::abort();
+  }
+
+  // Calibration needs the device clock and the host clock Profiler::now()
+  // runs on in the same call.
+  auto getCalibrateableTimeDomains =
+      (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)vkGetInstanceProcAddr(
+          instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+  if (calibratedTimestamps && getCalibrateableTimeDomains) {
+    uint32_t timeDomainCount = 0;
+    getCalibrateableTimeDomains(physicalDevice, &timeDomainCount, nullptr);
+    std::vector<VkTimeDomainEXT> timeDomains(timeDomainCount);
+    getCalibrateableTimeDomains(physicalDevice, &timeDomainCount,
+                                timeDomains.data());
+
+    bool hasDevice = false;
+    bool hasHost = false;
+    for (VkTimeDomainEXT timeDomain : timeDomains) {
+      hasDevice |= timeDomain == VK_TIME_DOMAIN_DEVICE_EXT;
+      if (timeDomain == VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT) {
+        LARGE_INTEGER frequency{};
+        QueryPerformanceFrequency(&frequency);
+        m_hostDomain = timeDomain;
+        m_hostTicksPerSecond = (uint64_t)frequency.QuadPart;
+        hasHost = true;
+      }
+    }
+
+    if (hasDevice && hasHost) {
+      m_getCalibratedTimestamps =
+          (PFN_vkGetCalibratedTimestampsEXT)vkGetDeviceProcAddr(
+              device, "vkGetCalibratedTimestampsEXT");
+    }
+  }
+
+  Log::info("GPU profiler: %s", m_getCalibratedTimestamps
+                                    ? "calibrated timestamps"
+                                    : "uncalibrated (submit-aligned)");
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, int frameIndex) {
+  m_frameIndex = -1;
+  m_open.clear();
+  if (!m_supported || !Profiler::active()) {
+    return;
+  }
+
+  m_frameIndex = frameIndex;
+  Frame &frame = m_frames[frameIndex];
+  frame.zones.clear();
+  frame.recorded = false;
+
+  vkCmdResetQueryPool(commandBuffer, m_queryPool,
+                      2 * kMaxZonesPerFrame * frameIndex,
+                      2 * kMaxZonesPerFrame);
+  beginZone(commandBuffer, "GPU frame");
+}
+
+void GpuProfiler::endFrame(VkCommandBuffer commandBuffer) {
+  if (m_frameIndex < 0) {
+    return;
+  }
+
+  while (!m_open.empty()) {
+    endZone(commandBuffer);
+  }
+
+  Frame &frame = m_frames[m_frameIndex];
+  frame.submitTime = Profiler::now();
+  frame.recorded = !frame.zones.empty();
+  m_frameIndex = -1;
+}
+
+void GpuProfiler::beginZone(VkCommandBuffer commandBuffer, const char *name) {
+  if (m_frameIndex < 0) {
+    return;
+  }
+
+  Frame &frame = m_frames[m_frameIndex];
+  if (frame.zones.size() == kMaxZonesPerFrame) {
+    m_open.push_back(UINT32_MAX); // keeps begin/end pairs balanced
+    return;
+  }
+
+  Zone zone{};
+  zone.name = name;
+  zone.query = 2 * (kMaxZonesPerFrame * m_frameIndex +
+                    (uint32_t)frame.zones.size());
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                      m_queryPool, zone.query);
+
+  m_open.push_back((uint32_t)frame.zones.size());
+  frame.zones.push_back(zone);
+}
+
+void GpuProfiler::endZone(VkCommandBuffer commandBuffer) {
+  if (m_frameIndex < 0 || m_open.empty()) {
+    return;
+  }
+
+  const uint32_t index = m_open.back();
+  m_open.pop_back();
+  if (index == UINT32_MAX) {
+    return;
+  }
+
+  const Zone &zone = m_frames[m_frameIndex].zones[index];
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      m_queryPool, zone.query + 1);
+}
+
+void GpuProfiler::collect(VkDevice device, int frameIndex) {
+  Frame &frame = m_frames[frameIndex];
+  if (!frame.recorded) {
+    return;
+  }
+  frame.recorded = false;
+
+  const uint32_t firstQuery = 2 * kMaxZonesPerFrame * frameIndex;
+  const uint32_t queryCount = 2 * (uint32_t)frame.zones.size();
+  std::array<uint64_t, 2 * kMaxZonesPerFrame> timestamps{};
+  if (vkGetQueryPoolResults(device, m_queryPool, firstQuery, queryCount,
+                            sizeof(timestamps), timestamps.data(),
+                            sizeof(uint64_t),
+                            VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+    return;
+  }
+
+  // Anchor: a (GPU tick, host time) pair. Without calibration the frame's
+  // first timestamp is assumed to be its submit time.
+  uint64_t gpuTicks = timestamps[0] & m_timestampMask;
+  uint64_t hostTime = frame.submitTime;
+  if (m_getCalibratedTimestamps) {
+    calibrate(device, gpuTicks, hostTime);
+  }
+
+  for (size_t i = 0; i < frame.zones.size(); ++i) {
+    const uint64_t begin = timestamps[2 * i] & m_timestampMask;
+    const uint64_t end = timestamps[2 * i + 1] & m_timestampMask;
+    const double beginOffset =
+        (double)(int64_t)(begin - gpuTicks) * (double)m_timestampPeriod;
+    const double endOffset =
+        (double)(int64_t)(end - gpuTicks) * (double)m_timestampPeriod;
+
+    Profiler::record(frame.zones[i].name,
+                     (uint64_t)((double)hostTime + beginOffset),
+                     (uint64_t)((double)hostTime + endOffset),
+                     ProfileGpuTrack);
+  }
+}
+
+bool GpuProfiler::calibrate(VkDevice device, uint64_t &gpuTicks,
+                            uint64_t &hostTime) {
+  VkCalibratedTimestampInfoEXT calibratedTimestampInfos[2]{};
+  calibratedTimestampInfos[0].sType =
+      VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+  calibratedTimestampInfos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+  calibratedTimestampInfos[1].sType =
+      VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+  calibratedTimestampInfos[1].timeDomain = m_hostDomain;
+
+  uint64_t calibrated[2] = {};
+  uint64_t maxDeviation = 0;
+  if (m_getCalibratedTimestamps(device, 2, calibratedTimestampInfos,
+                                calibrated, &maxDeviation) != VK_SUCCESS) {
+    return false;
+  }
+
+  // steady_clock counts the same ticks, scaled to nanoseconds.
+  const uint64_t seconds = calibrated[1] / m_hostTicksPerSecond;
+  const uint64_t remainder = calibrated[1] % m_hostTicksPerSecond;
+  gpuTicks = calibrated[0] & m_timestampMask;
+  hostTime = seconds * 1000000000ull +
+             remainder * 1000000000ull / m_hostTicksPerSecond;
+  return true;
+}
+
+void GpuProfiler::shutdown(VkDevice device) {
+  if (m_queryPool) {
+    vkDestroyQueryPool(device, m_queryPool, nullptr);
+    m_queryPool = VK_NULL_HANDLE;
+  }
+  m_getCalibratedTimestamps = nullptr;
+  m_supported = false;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "Constants.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scoped CPU profiling zones, recorded while a capture or the flight
+// recorder is running:
+//
+//   void Renderer::drawFrame(...) {
+//     PROFILE_ZONE("Renderer::drawFrame");
+//
+// Every thread writes into its own ring of recent zones without locks; a
+// trace copies them out and writes a Chrome trace (chrome://tracing,
+// ui.perfetto.dev) with one track per thread plus the GPU zones from
+// GpuProfiler on the same clock.
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name)                                                     \
+  ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+
+enum ProfileTrack : uint32_t {
+  ProfileThreadTrack = 0, // the recording thread's own track
+  ProfileGpuTrack,        // graphics queue
+};
+
+class Profiler {
+public:
+  static constexpr uint32_t kDefaultCaptureFrames = 120;
+
+  // Nanoseconds on std::chrono::steady_clock. On Windows that is QPC, the
+  // host time domain GpuProfiler calibrates against.
+  static uint64_t now();
+
+  // Names the calling thread's track in captures.
+  static void setThreadName(const char *name);
+
+  // Returns a copy of name that lives as long as the program, for zone
+  // names that are not string literals.
+  static const char *intern(const std::string &name);
+
+  // Records the next frameCount frames, then writes the trace to path.
+  // Ignored while a capture is already running.
+  static void beginCapture(uint32_t frameCount, const std::string &path);
+  // Keeps zones recording all the time, so a trace of the last few frames
+  // can be written after the fact (see writeTrace()).
+  static void setFlightRecorder(bool enabled);
+  // True while zones are being recorded.
+  static bool active();
+  // Main thread, once per frame: advances and finishes captures.
+  static void markFrame();
+
+  // Adds a finished zone to the calling thread's buffer.
+  static void record(const char *name, uint64_t begin, uint64_t end,
+                     ProfileTrack track = ProfileThreadTrack);
+
+  // Writes the recorded zones that lie within [begin, end] to path. Safe
+  // to call from any thread while others keep recording.
+  static void writeTrace(const std::string &path, uint64_t begin,
+                         uint64_t end);
+};
+
+class ProfileZone {
+public:
+  explicit ProfileZone(const char *name)
+      : m_name(Profiler::active() ? name : nullptr),
+        m_begin(m_name ? Profiler::now() : 0) {}
+  ~ProfileZone() {
+    if (m_name) {
+      Profiler::record(m_name, m_begin, Profiler::now());
+    }
+  }
+
+  ProfileZone(const ProfileZone &) = delete;
+  ProfileZone &operator=(const ProfileZone &) = delete;
+
+private:
+  const char *m_name;
+  uint64_t m_begin;
+};
+
+// GPU zones from timestamp queries, converted to Profiler::now() time with
+// VK_EXT_calibrated_timestamps and handed to the profiler as the GPU track.
+// Without the extension a frame's first timestamp is pinned to its submit
+// time, which keeps durations exact but offsets approximate.
+class GpuProfiler {
+public:
+  static constexpr uint32_t kMaxZonesPerFrame = 32;
+
+  GpuProfiler() = default;
+  ~GpuProfiler() = default;
+
+  void init(VkInstance instance, VkPhysicalDevice physicalDevice,
+            VkDevice device, uint32_t queueFamily, bool calibratedTimestamps);
+
+  // Bracket a frame's command buffer; outside a render pass. Nothing is
+  // written unless the profiler is active.
+  void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+  void endFrame(VkCommandBuffer commandBuffer);
+
+  // Zones may nest; at most kMaxZonesPerFrame per frame are kept.
+  void beginZone(VkCommandBuffer commandBuffer, const char *name);
+  void endZone(VkCommandBuffer commandBuffer);
+
+  // Reads back a frame slot whose submission has completed.
+  void collect(VkDevice device, int frameIndex);
+
+  void shutdown(VkDevice device);
+
+private:
+  struct Zone {
+    const char *name = nullptr;
+    uint32_t query = 0; // begin; end is query + 1
+  };
+
+  struct Frame {
+    std::vector<Zone> zones;
+    uint64_t submitTime = 0;
+    bool recorded = false;
+  };
+
+  VkQueryPool m_queryPool = VK_NULL_HANDLE;
+  float m_timestampPeriod = 1.0f; // nanoseconds per tick
+  uint64_t m_timestampMask = ~0ull;
+  bool m_supported = false;
+
+  // Calibration
+  PFN_vkGetCalibratedTimestampsEXT m_getCalibratedTimestamps = nullptr;
+  VkTimeDomainEXT m_hostDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+  uint64_t m_hostTicksPerSecond = 1000000000ull;
+
+  std::array<Frame, MAX_FRAMES_IN_FLIGHT> m_frames{};
+  int m_frameIndex = -1; // being recorded, -1 when not capturing
+  std::vector<uint32_t> m_open; // zone indices
+
+  bool calibrate(VkDevice device, uint64_t &gpuTicks, uint64_t &hostTime);
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded single-producer single-consumer ring. push() is only called from
+// one thread and pop() from one (other) thread; neither ever blocks or
+// locks. Head and tail live on separate cache lines so the two sides do not
+// false-share.
+template <typename T, size_t Capacity> class SpscQueue {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "SpscQueue capacity must be a power of two");
+
+public:
+  // Returns false when full.
+  bool push(const T &value) {
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    m_items[tail & (Capacity - 1)] = value;
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns false when empty.
+  bool pop(T &value) {
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = m_items[head & (Capacity - 1)];
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return m_head.load(std::memory_order_acquire) ==
+           m_tail.load(std::memory_order_acquire);
+  }
+
+private:
+  alignas(64) std::atomic<size_t> m_head{0}; // consumer
+  alignas(64) std::atomic<size_t> m_tail{0}; // producer
+  alignas(64) T m_items[Capacity]{};
+};
+
+// Bounded multi-producer single-consumer ring (Vyukov's bounded queue with
+// a single reader). Any number of threads may push(); one thread pops.
+// Each cell carries a sequence number that says whose turn it is, so
+// producers only contend on the tail counter and never wait for each
+// other: a full queue fails the push instead of blocking.
+template <typename T, size_t Capacity> class MpscQueue {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "MpscQueue capacity must be a power of two");
+
+public:
+  MpscQueue() {
+    for (size_t i = 0; i < Capacity; ++i) {
+      m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  // Any thread. Returns false when full.
+  bool push(const T &value) {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell &cell = m_cells[tail & (Capacity - 1)];
+      const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      const intptr_t difference = (intptr_t)sequence - (intptr_t)tail;
+
+      if (difference == 0) {
+        // The cell is free for this lap; claim it.
+        if (m_tail.compare_exchange_weak(tail, tail + 1,
+                                         std::memory_order_relaxed)) {
+          cell.value = value;
+          cell.sequence.store(tail + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (difference < 0) {
+        // Still holds last lap's value: full.
+        return false;
+      } else {
+        // Another producer claimed it first.
+        tail = m_tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Consumer thread only. Returns false when empty, or when the oldest
+  // claimed cell is still being written.
+  bool pop(T &value) {
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    Cell &cell = m_cells[head & (Capacity - 1)];
+    if (cell.sequence.load(std::memory_order_acquire) != head + 1) {
+      return false;
+    }
+    value = cell.value;
+    cell.sequence.store(head + Capacity, std::memory_order_release);
+    m_head.store(head + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence{0};
+    T value{};
+  };
+
+  alignas(64) std::atomic<size_t> m_head{0}; // consumer
+  alignas(64) std::atomic<size_t> m_tail{0}; // producers
+  alignas(64) Cell m_cells[Capacity];
+};
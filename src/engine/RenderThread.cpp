@@ -0,0 +1,115 @@
+#include "RenderThread.hpp"
+
+#include "Profiler.hpp"
+#include "Renderer.hpp"
+#include "Scene.hpp"
+
+RenderThread::~RenderThread() { stop(); }
+
+void RenderThread::init(Renderer &renderer, Scene *scene) {
+  m_renderer = &renderer;
+  m_scene = scene;
+
+  for (uint32_t i = 0; i < kSnapshotCount; ++i) {
+    m_free.push(i);
+  }
+}
+
+void RenderThread::start() {
+  if (m_running) {
+    return;
+  }
+
+  m_running = true;
+  m_thread = std::thread([this] { loop(); });
+}
+
+void RenderThread::stop() {
+  if (!m_running) {
+    return;
+  }
+
+  m_running = false;
+  notify();
+  m_thread.join();
+}
+
+bool RenderThread::running() { return m_running; }
+
+RenderSnapshot &RenderThread::beginSnapshot() {
+  if (m_current == UINT32_MAX) {
+    // Inline rendering returns every snapshot before submitSnapshot()
+    // does, so only the threaded path can find the free queue empty.
+    PROFILE_ZONE("Wait for render thread");
+    while (!m_free.pop(m_current)) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [this] { return !m_free.empty(); });
+    }
+  }
+
+  RenderSnapshot &snapshot = m_snapshots[m_current];
+  snapshot.frame = ++m_frame;
+  snapshot.commands.clear();
+  return snapshot;
+}
+
+void RenderThread::submitSnapshot() {
+  if (m_current == UINT32_MAX) {
+    return;
+  }
+
+  const uint32_t index = m_current;
+  m_current = UINT32_MAX;
+
+  if (!m_running) {
+    render(m_snapshots[index]);
+    m_free.push(index);
+    return;
+  }
+
+  m_ready.push(index);
+  notify();
+}
+
+void RenderThread::loop() {
+  Profiler::setThreadName("Render");
+
+  for (;;) {
+    uint32_t index = 0;
+    if (m_ready.pop(index)) {
+      render(m_snapshots[index]);
+      m_free.push(index);
+      notify();
+      continue;
+    }
+
+    // Only exit once everything submitted before stop() has been drawn.
+    if (!m_running && m_ready.empty()) {
+      break;
+    }
+
+    PROFILE_ZONE("Wait for snapshot");
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_wake.wait(lock, [this] { return !m_ready.empty() || !m_running; });
+  }
+}
+
+void RenderThread::render(RenderSnapshot &snapshot) {
+  PROFILE_ZONE("RenderThread::render");
+
+  for (auto &command : snapshot.commands) {
+    command(*m_renderer);
+  }
+
+  m_renderer->update(snapshot.deltaTime);
+  m_renderer->drawFrame(m_scene, snapshot);
+}
+
+void RenderThread::notify() {
+  // Taking the lock orders the queue update against a waiter between its
+  // predicate check and the wait, so the wake-up cannot be lost.
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+  }
+  m_wake.notify_all();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Queue.hpp"
+#include "Snapshot.hpp"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+class Renderer; // forward declaration
+class Scene;    // forward declaration
+
+// Pipelines simulation and rendering: while the render thread records and
+// submits frame N from its snapshot, the main thread updates the scene and
+// fills the other snapshot for N + 1. Snapshot indices travel through two
+// lock-free SPSC queues (ready: main -> render, free: render -> main); a
+// condition variable is only used to sleep when a queue is empty.
+//
+// When not started, submitSnapshot() renders on the calling thread, so the
+// engine loop is the same in both modes.
+class RenderThread {
+public:
+  static constexpr uint32_t kSnapshotCount = 2;
+
+  RenderThread() = default;
+  ~RenderThread();
+
+  RenderThread(const RenderThread &) = delete;
+  RenderThread &operator=(const RenderThread &) = delete;
+
+  void init(Renderer &renderer, Scene *scene);
+
+  void start();
+  // Renders every submitted snapshot, then joins.
+  void stop();
+  bool running();
+
+  // Main thread: the snapshot to fill next. Blocks while the render thread
+  // still holds both (it is a full frame behind).
+  RenderSnapshot &beginSnapshot();
+  void submitSnapshot();
+
+private:
+  Renderer *m_renderer = nullptr;
+  Scene *m_scene = nullptr;
+
+  std::array<RenderSnapshot, kSnapshotCount> m_snapshots;
+  SpscQueue<uint32_t, kSnapshotCount> m_ready;
+  SpscQueue<uint32_t, kSnapshotCount> m_free;
+  uint32_t m_current = UINT32_MAX; // being filled by the main thread
+  uint64_t m_frame = 0;
+
+  std::thread m_thread;
+  std::atomic<bool> m_running{false};
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+
+  void loop();
+  void render(RenderSnapshot &snapshot);
+  void notify();
+};
@@ -8,6 +8,7 @@
 
 #include "../Vulkan.hpp"
 
+#include "Log.hpp"
 #include "Renderer.hpp"
 #include "Scene.hpp"
 
@@ -38,15 +39,26 @@ bool Renderer::init(const Win32WindowHandles &windowHandler, int width,
   createDevice();
   createSwapchain(width, height);
   createSwapchainViews();
+  m_resolution.init(m_physicalDevice, m_device, m_graphicsFamily);
+  m_gpuProfiler.init(m_instance, m_physicalDevice, m_device, m_graphicsFamily,
+                     m_calibratedTimestampsSupported);
+  createResolutionResources();
+  m_temporal.init(m_device);
+  createTemporalResources();
   createRenderPass();
   createColorResources();
   createDepthResources();
   createFramebuffers();
+  m_memoryReportCountdown = m_framesInFlight + 1;
   createCommandPool();
   createCommandBuffers();
   createSyncObjects();
 
-  std::cout << "Renderer init OK.\n";
+  m_lighting.init(m_physicalDevice, m_device);
+  m_shadows.init(m_physicalDevice, m_device);
+  m_graph.init(m_physicalDevice, m_device);
+
+  Log::info("Renderer init OK.");
 
   return true;
 }
@@ -65,32 +77,302 @@ VkSampleCountFlagBits Renderer::sampleCount() { return m_sampleCount; }
 
 VkRenderPass Renderer::renderPass() { return m_renderPass; }
 
+VkDescriptorSetLayout Renderer::lightingSetLayout() {
+  return m_lighting.descriptorSetLayout();
+}
+
+VkRenderPass Renderer::shadowRenderPass() { return m_shadows.renderPass(); }
+
+VkDescriptorSetLayout Renderer::shadowSetLayout() {
+  return m_shadows.descriptorSetLayout();
+}
+
+bool Renderer::vertexPulling() { return m_vertexPulling; }
+
+void Renderer::setVertexPulling(bool enabled) {
+  m_vertexPulling = enabled;
+  Log::info("Vertex pulling: %s", enabled ? "on" : "off");
+}
+
+bool Renderer::depthPrepass() { return m_depthPrepass; }
+
+void Renderer::setDepthPrepass(bool enabled) {
+  if (m_depthPrepass == enabled) {
+    return;
+  }
+
+  // Subpass layout changes, so the render pass and pipelines are rebuilt.
+  m_depthPrepass = enabled;
+  m_swapchainDirty = true;
+  m_pipelinesDirty = true;
+  Log::info("Depth pre-pass: %s", enabled ? "on" : "off");
+}
+
+uint32_t Renderer::mainSubpass() {
+  // Dynamic rendering has no subpasses; the pre-pass shares the one scope.
+  return m_depthPrepass && !m_dynamicRendering ? 1 : 0;
+}
+
+bool Renderer::dynamicRendering() { return m_dynamicRendering; }
+
+void Renderer::setDynamicRendering(bool enabled) {
+  if (m_dynamicRendering == enabled) {
+    return;
+  }
+
+  if (enabled && !m_dynamicRenderingSupported) {
+    Log::warning("Dynamic rendering is not supported");
+    return;
+  }
+
+  // Pipelines switch between render pass and attachment format targets.
+  m_dynamicRendering = enabled;
+  m_swapchainDirty = true;
+  m_pipelinesDirty = true;
+  Log::info("Main pass: %s", enabled ? "dynamic rendering" : "render pass");
+}
+
+VkFormat Renderer::colorAttachmentFormat(uint32_t index) {
+  if (m_antiAliasing == TemporalAA) {
+    return index == 0 ? TemporalResolve::kSceneColorFormat
+                      : TemporalResolve::kMotionFormat;
+  }
+  return outputFormat();
+}
+
+VkFormat Renderer::depthFormat() { return m_depthFormat; }
+
+static VkSampleCountFlagBits SampleCountFor(AntiAliasing antiAliasing) {
+  switch (antiAliasing) {
+  case Msaa2x:
+    return VK_SAMPLE_COUNT_2_BIT;
+  case Msaa4x:
+    return VK_SAMPLE_COUNT_4_BIT;
+  case Msaa8x:
+    return VK_SAMPLE_COUNT_8_BIT;
+  default:
+    return VK_SAMPLE_COUNT_1_BIT;
+  }
+}
+
+AntiAliasing Renderer::antiAliasing() { return m_antiAliasing; }
+
+bool Renderer::antiAliasingSupported(AntiAliasing antiAliasing) {
+  if (antiAliasing < 0 || antiAliasing >= AntiAliasingCount) {
+    return false;
+  }
+  return (m_supportedSampleCounts & SampleCountFor(antiAliasing)) != 0;
+}
+
+void Renderer::setAntiAliasing(AntiAliasing antiAliasing) {
+  if (m_antiAliasing == antiAliasing) {
+    return;
+  }
+
+  if (!antiAliasingSupported(antiAliasing)) {
+    Log::warning("Anti-aliasing %s is not supported",
+                 AntiAliasingName(antiAliasing));
+    return;
+  }
+
+  // Sample count and attachments change, so everything built against the
+  // render pass is recreated.
+  m_antiAliasing = antiAliasing;
+  m_sampleCount = SampleCountFor(antiAliasing);
+  m_swapchainDirty = true;
+  m_pipelinesDirty = true;
+  Log::info("Anti-aliasing: %s", AntiAliasingName(antiAliasing));
+}
+
+uint32_t Renderer::colorAttachmentCount() {
+  return m_antiAliasing == TemporalAA ? 2 : 1;
+}
+
+bool Renderer::dynamicResolution() { return m_dynamicResolution; }
+
+void Renderer::setDynamicResolution(bool enabled) {
+  if (m_dynamicResolution == enabled) {
+    return;
+  }
+
+  // The main pass output moves between the swapchain and the upscale source.
+  m_dynamicResolution = enabled;
+  m_swapchainDirty = true;
+  m_pipelinesDirty = true;
+  Log::info("Dynamic resolution: %s", enabled ? "on" : "off");
+}
+
+VkExtent2D Renderer::renderExtent() {
+  return m_dynamicResolution ? m_resolution.renderExtent() : m_swapchainExtent;
+}
+
+Dimensions Renderer::renderDimensions() {
+  VkExtent2D extent = renderExtent();
+  return Dimensions{(float)extent.width, (float)extent.height};
+}
+
+const char *LatencyModeName(LatencyMode latencyMode) {
+  switch (latencyMode) {
+  case LowLatency:
+    return "low latency";
+  case BalancedLatency:
+    return "balanced";
+  case HighThroughput:
+    return "throughput";
+  default:
+    return "unknown";
+  }
+}
+
+static int FramesInFlightFor(LatencyMode latencyMode) {
+  switch (latencyMode) {
+  case LowLatency:
+    return 1;
+  case HighThroughput:
+    return MAX_FRAMES_IN_FLIGHT;
+  default:
+    return 2;
+  }
+}
+
+// Latency averages are printed once per this many measured frames.
+static constexpr uint32_t kLatencyReportFrames = 300;
+
+PresentPolicy Renderer::presentPolicy() { return m_presentPolicy; }
+
+void Renderer::setPresentPolicy(PresentPolicy presentPolicy) {
+  if (m_presentPolicy == presentPolicy || presentPolicy < 0 ||
+      presentPolicy >= PresentPolicyCount) {
+    return;
+  }
+
+  m_presentPolicy = presentPolicy;
+  m_swapchainDirty = true;
+  Log::info("Present policy: %s", PresentPolicyName(presentPolicy));
+}
+
+LatencyMode Renderer::latencyMode() { return m_latencyMode; }
+
+void Renderer::setLatencyMode(LatencyMode latencyMode) {
+  if (m_latencyMode == latencyMode || latencyMode < 0 ||
+      latencyMode >= LatencyModeCount) {
+    return;
+  }
+
+  // The swapchain image count follows the mode; frame slots are switched
+  // over once the device is idle in recreateSwapchainIfNeeded().
+  m_latencyMode = latencyMode;
+  m_swapchainDirty = true;
+  Log::info("Latency mode: %s (%d frame(s) in flight)",
+            LatencyModeName(latencyMode), FramesInFlightFor(latencyMode));
+}
+
+int Renderer::framesInFlight() { return m_framesInFlight; }
+
+void Renderer::waitForFrameSlot() {
+  if (!m_device) {
+    return;
+  }
+
+  PROFILE_ZONE("Renderer::waitForFrameSlot");
+  const uint64_t waitStart = Profiler::now();
+  m_timeline.wait(m_frameValues[m_frameIndex]);
+  m_waitNanoseconds += Profiler::now() - waitStart;
+}
+
+float Renderer::inputToPresentMilliseconds() { return m_latencyMilliseconds; }
+
+Renderer::Feedback Renderer::feedback() {
+  std::lock_guard<std::mutex> lock(m_feedbackMutex);
+  return m_feedback;
+}
+
+void Renderer::measureLatency(Clock::time_point inputTime,
+                              Clock::time_point presentTime) {
+  const float milliseconds =
+      std::chrono::duration<float, std::milli>(presentTime - inputTime)
+          .count();
+  m_latencyMilliseconds = milliseconds;
+  m_latencySum += milliseconds;
+  m_latencyMax = std::max(m_latencyMax, milliseconds);
+  ++m_latencySamples;
+
+  if (m_latencySamples >= kLatencyReportFrames) {
+    Log::info("Input to present call (%s): avg %g ms, max %g ms",
+              LatencyModeName(m_latencyMode),
+              m_latencySum / m_latencySamples, m_latencyMax);
+    m_latencySum = 0.0;
+    m_latencyMax = 0.0f;
+    m_latencySamples = 0;
+  }
+}
+
 void Renderer::resize(int width, int height) {
   m_width = width;
   m_height = height;
   m_swapchainDirty = true;
 }
 
-void Renderer::update(float deltaTime) {}
+void Renderer::update(float deltaTime) {
+  // Read back the GPU time of the frame that last used this slot before the
+  // scene picks up renderExtent() for this one. Never blocks; results that
+  // are not ready yet are skipped. Timed even at native resolution, for
+  // telemetry.
+  if (m_device && m_timeline.completed(m_frameValues[m_frameIndex])) {
+    m_resolution.collect(m_device, m_frameIndex, m_dynamicResolution);
+  }
+
+  // The simulation jitters the next camera with these, so they may lag the
+  // frame being drawn by one snapshot.
+  Feedback feedback{};
+  feedback.temporal = m_antiAliasing == TemporalAA;
+  Dimensions dimensions = renderDimensions();
+  feedback.renderWidth = dimensions.width;
+  feedback.renderHeight = dimensions.height;
+
+  std::lock_guard<std::mutex> lock(m_feedbackMutex);
+  m_feedback = feedback;
+}
 
-void Renderer::drawFrame(Scene *scene) {
+void Renderer::drawFrame(Scene *scene, const RenderSnapshot &snapshot) {
   if (!m_device) {
     return;
   }
 
+  PROFILE_ZONE("Renderer::drawFrame");
+  const uint64_t frameStart = Profiler::now();
+
   recreateSwapchainIfNeeded(scene);
 
   const int frameIndex = m_frameIndex;
 
-  vkWaitForFences(m_device, 1, &m_inFlight[frameIndex], VK_TRUE, UINT64_MAX);
-  vkResetFences(m_device, 1, &m_inFlight[frameIndex]);
+  // The slot's command buffer and per-frame buffers are free once the last
+  // submission that used them has passed; no fence to reset.
+  const uint64_t waitStart = Profiler::now();
+  m_timeline.wait(m_frameValues[frameIndex]);
+  m_waitNanoseconds += Profiler::now() - waitStart;
+  m_frameArenas[frameIndex].reset();
+  m_gpuProfiler.collect(m_device, frameIndex);
+
+  if (m_memoryReportCountdown > 0 && --m_memoryReportCountdown == 0) {
+    reportAttachmentMemory();
+  }
 
   uint32_t imageIndex = 0;
-  VkResult result = vkAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX,
-                                          m_imageAvailable[frameIndex],
-                                          VK_NULL_HANDLE, &imageIndex);
+  VkResult result = VK_SUCCESS;
+  const uint64_t acquireStart = Profiler::now();
+  {
+    PROFILE_ZONE("vkAcquireNextImageKHR");
+    result = vkAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX,
+                                   m_imageAvailable[frameIndex],
+                                   VK_NULL_HANDLE, &imageIndex);
+  }
+  const uint64_t acquireNanoseconds = Profiler::now() - acquireStart;
 
   if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+    // Nothing is published for a dropped frame; don't bill its wait to the
+    // next one.
+    m_waitNanoseconds = 0;
     m_swapchainDirty = true;
     return;
   }
@@ -99,38 +381,55 @@ void Renderer::drawFrame(Scene *scene) {
     std::abort();
   }
 
+  std::memcpy((*scene->uboMappedList())[frameIndex], &snapshot.camera.ubo(),
+              sizeof(CameraUBO));
+  m_lighting.update(frameIndex, snapshot.camera, snapshot.lights,
+                    renderExtent());
+  if (snapshot.staticChanged) {
+    m_shadows.invalidate();
+  }
+  m_shadows.update(frameIndex, snapshot.camera, snapshot.sunDirection);
+
   vkResetCommandBuffer(m_cmd[frameIndex], 0);
+  m_snapshot = &snapshot;
   recordCommandBuffer(m_cmd[frameIndex], imageIndex, scene);
-
-  VkPipelineStageFlags waitStage =
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-
-  VkSubmitInfo submitInfo{};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = &m_imageAvailable[frameIndex];
-  submitInfo.pWaitDstStageMask = &waitStage;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &m_cmd[frameIndex];
-  submitInfo.signalSemaphoreCount = 1;
-  submitInfo.pSignalSemaphores = &m_renderFinished[frameIndex];
-
-  result =
-      vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_inFlight[frameIndex]);
-  if (result != VK_SUCCESS) {
-    std::cerr << "vkQueueSubmit failed: " << (int)result << std::endl;
-    std::abort();
+  m_snapshot = nullptr;
+
+  VkSemaphoreSubmitInfo waitSemaphoreSubmitInfo{
+      VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO};
+  waitSemaphoreSubmitInfo.semaphore = m_imageAvailable[frameIndex];
+  waitSemaphoreSubmitInfo.stageMask =
+      VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+  VkSemaphoreSubmitInfo signalSemaphoreSubmitInfo{
+      VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO};
+  signalSemaphoreSubmitInfo.semaphore = m_renderFinished[imageIndex];
+  signalSemaphoreSubmitInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+  {
+    PROFILE_ZONE("vkQueueSubmit2");
+    m_frameValues[frameIndex] =
+        m_timeline.submit(m_graphicsQueue, m_cmd[frameIndex],
+                          &waitSemaphoreSubmitInfo, 1,
+                          &signalSemaphoreSubmitInfo, 1);
   }
 
   VkPresentInfoKHR presentInfo{};
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
   presentInfo.waitSemaphoreCount = 1;
-  presentInfo.pWaitSemaphores = &m_renderFinished[frameIndex];
+  presentInfo.pWaitSemaphores = &m_renderFinished[imageIndex];
   presentInfo.swapchainCount = 1;
   presentInfo.pSwapchains = &m_swapchain;
   presentInfo.pImageIndices = &imageIndex;
 
-  result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
+  {
+    PROFILE_ZONE("vkQueuePresentKHR");
+    result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
+  }
+  // Snapshots without an input time are not measured.
+  if (snapshot.inputTime != Clock::time_point{}) {
+    measureLatency(snapshot.inputTime, Clock::now());
+  }
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
     m_swapchainDirty = true;
   } else if (result != VK_SUCCESS) {
@@ -138,7 +437,63 @@ void Renderer::drawFrame(Scene *scene) {
     std::abort();
   }
 
-  m_frameIndex = (m_frameIndex + 1) % FRAME_COUNT;
+  m_frameIndex = (m_frameIndex + 1) % m_framesInFlight;
+
+  // Heap usage changes slowly and the query is not free.
+  if (m_gpuMemoryCountdown == 0) {
+    m_gpuMemoryBytes = queryGpuMemoryUsage();
+    m_gpuMemoryCountdown = 30;
+  }
+  --m_gpuMemoryCountdown;
+
+  FrameStats frameStats{};
+  frameStats.frame = snapshot.frame;
+  const uint64_t frameNanoseconds = Profiler::now() - frameStart;
+  const uint64_t waitNanoseconds = m_waitNanoseconds + acquireNanoseconds;
+  frameStats.renderMilliseconds =
+      frameNanoseconds > waitNanoseconds
+          ? (float)(frameNanoseconds - waitNanoseconds) / 1.0e6f
+          : 0.0f;
+  frameStats.waitMilliseconds = (float)m_waitNanoseconds / 1.0e6f;
+  frameStats.acquireMilliseconds = (float)acquireNanoseconds / 1.0e6f;
+  frameStats.gpuMilliseconds = m_resolution.lastGpuMilliseconds();
+  frameStats.drawCalls = m_drawCalls;
+  frameStats.triangles = m_triangles;
+  frameStats.gpuMemoryBytes = m_gpuMemoryBytes;
+  m_waitNanoseconds = 0;
+
+  std::lock_guard<std::mutex> lock(m_frameStatsMutex);
+  m_frameStats = frameStats;
+}
+
+Renderer::FrameStats Renderer::frameStats() {
+  std::lock_guard<std::mutex> lock(m_frameStatsMutex);
+  return m_frameStats;
+}
+
+uint64_t Renderer::queryGpuMemoryUsage() {
+  if (!m_memoryBudgetSupported) {
+    return 0;
+  }
+
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT memoryBudgetProperties{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+  VkPhysicalDeviceMemoryProperties2 physicalDeviceMemoryProperties2{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2};
+  physicalDeviceMemoryProperties2.pNext = &memoryBudgetProperties;
+  vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice,
+                                       &physicalDeviceMemoryProperties2);
+
+  const VkPhysicalDeviceMemoryProperties &memoryProperties =
+      physicalDeviceMemoryProperties2.memoryProperties;
+  uint64_t bytes = 0;
+  for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+    if (memoryProperties.memoryHeaps[i].flags &
+        VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      bytes += memoryBudgetProperties.heapUsage[i];
+    }
+  }
+  return bytes;
 }
 
 void Renderer::shutdown() {
@@ -149,27 +504,28 @@ void Renderer::shutdown() {
   waitDeviceIdle();
 
   // Per-frame sync
-  for (int i = 0; i < FRAME_COUNT; ++i) {
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
     if (m_imageAvailable[i]) {
       vkDestroySemaphore(m_device, m_imageAvailable[i], nullptr);
     }
-    if (m_renderFinished[i]) {
-      vkDestroySemaphore(m_device, m_renderFinished[i], nullptr);
-    }
-    if (m_inFlight[i]) {
-      vkDestroyFence(m_device, m_inFlight[i], nullptr);
-    }
 
     m_imageAvailable[i] = VK_NULL_HANDLE;
-    m_renderFinished[i] = VK_NULL_HANDLE;
-    m_inFlight[i] = VK_NULL_HANDLE;
+    m_frameValues[i] = 0;
   }
+  m_timeline.shutdown(m_device);
 
   if (m_cmdPool) {
     vkDestroyCommandPool(m_device, m_cmdPool, nullptr);
     m_cmdPool = VK_NULL_HANDLE;
   }
 
+  m_lighting.shutdown(m_device);
+  m_shadows.shutdown(m_device);
+  m_temporal.shutdown(m_device);
+  m_resolution.shutdown(m_device);
+  m_gpuProfiler.shutdown(m_device);
+  m_graph.shutdown(m_device);
+
   destroySwapchain();
 
   if (m_device) {
@@ -204,7 +560,7 @@ void Renderer::shutdown() {
   m_graphicsFamily = UINT32_MAX;
   m_presentFamily = UINT32_MAX;
 
-  std::cout << "Renderer shutdown OK.\n";
+  Log::info("Renderer shutdown OK.");
 }
 
 void Renderer::createInstance() {
@@ -371,8 +727,9 @@ void Renderer::createPhysicalDevice() {
     }
 
     // Swapchain must have at least one format + present mode.
-    auto sup = QuerySwapchainSupport(physicalDevice, m_surface);
-    if (sup.formats.empty() || sup.presentModes.empty()) {
+    QuerySwapchainSupport(physicalDevice, m_surface, m_swapchainSupport);
+    if (m_swapchainSupport.formats.empty() ||
+        m_swapchainSupport.presentModes.empty()) {
       std::cerr << "Swapchain must have at least one supported format and "
                    "present mode.\n";
       std::abort();
@@ -381,18 +738,6 @@ void Renderer::createPhysicalDevice() {
     VkPhysicalDeviceProperties physicalDeviceProperties{};
     vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
 
-    VkSampleCountFlags counts =
-        physicalDeviceProperties.limits.framebufferColorSampleCounts &
-        physicalDeviceProperties.limits.framebufferDepthSampleCounts;
-
-    if (counts & VK_SAMPLE_COUNT_8_BIT) {
-      m_sampleCount = VK_SAMPLE_COUNT_8_BIT;
-    } else if (counts & VK_SAMPLE_COUNT_4_BIT) {
-      m_sampleCount = VK_SAMPLE_COUNT_4_BIT;
-    } else if (counts & VK_SAMPLE_COUNT_2_BIT) {
-      m_sampleCount = VK_SAMPLE_COUNT_2_BIT;
-    }
-
     int score = 0;
     if (physicalDeviceProperties.deviceType ==
         VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
@@ -433,10 +778,41 @@ void Renderer::createPhysicalDevice() {
   VkPhysicalDeviceProperties physicalDeviceProperties{};
   vkGetPhysicalDeviceProperties(m_physicalDevice, &physicalDeviceProperties);
 
-  std::cout << "Using GPU: " << physicalDeviceProperties.deviceName
-            << std::endl;
-  std::cout << "Queue families: graphics=" << m_graphicsFamily
-            << " present=" << m_presentFamily << std::endl;
+  m_supportedSampleCounts =
+      physicalDeviceProperties.limits.framebufferColorSampleCounts &
+      physicalDeviceProperties.limits.framebufferDepthSampleCounts;
+
+  // Default to the highest MSAA level up to 8x; TAA is opt-in at runtime.
+  for (AntiAliasing antiAliasing : {Msaa8x, Msaa4x, Msaa2x}) {
+    if (antiAliasingSupported(antiAliasing)) {
+      m_antiAliasing = antiAliasing;
+      break;
+    }
+  }
+  m_sampleCount = SampleCountFor(m_antiAliasing);
+
+  // Dynamic rendering is core in 1.3 but still reported as a feature; the
+  // render pass path stays as the fallback.
+  VkPhysicalDeviceVulkan13Features physicalDeviceVulkan13Features{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
+  VkPhysicalDeviceFeatures2 physicalDeviceFeatures2{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+  physicalDeviceFeatures2.pNext = &physicalDeviceVulkan13Features;
+  if (physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_3) {
+    vkGetPhysicalDeviceFeatures2(m_physicalDevice, &physicalDeviceFeatures2);
+  }
+  m_dynamicRenderingSupported =
+      physicalDeviceVulkan13Features.dynamicRendering == VK_TRUE;
+  m_multiDrawIndirectSupported =
+      physicalDeviceFeatures2.features.multiDrawIndirect == VK_TRUE &&
+      physicalDeviceFeatures2.features.drawIndirectFirstInstance == VK_TRUE;
+  m_dynamicRendering = m_dynamicRenderingSupported;
+
+  Log::info("Using GPU: %s", physicalDeviceProperties.deviceName);
+  Log::info("Main pass: %s",
+            m_dynamicRendering ? "dynamic rendering" : "render pass");
+  Log::info("Queue families: graphics=%u present=%u", m_graphicsFamily,
+            m_presentFamily);
 }
 
 void Renderer::createDevice() {
@@ -456,12 +832,44 @@ void Renderer::createDevice() {
     deviceQueueCreateInfos.push_back(deviceQueueCreateInfo);
   }
 
-  const std::vector<const char *> devExts = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  std::vector<const char *> devExts = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+
+  // Optional: lines GPU timestamps up with CPU time in profiler captures.
+  m_calibratedTimestampsSupported = CheckDeviceExtensionSupport(
+      m_physicalDevice, {VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME});
+  if (m_calibratedTimestampsSupported) {
+    devExts.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+  }
+
+  // Optional: GPU memory in use, for telemetry.
+  m_memoryBudgetSupported = CheckDeviceExtensionSupport(
+      m_physicalDevice, {VK_EXT_MEMORY_BUDGET_EXTENSION_NAME});
+  if (m_memoryBudgetSupported) {
+    devExts.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
 
   VkPhysicalDeviceFeatures physicalDeviceFeatures{};
+  if (m_multiDrawIndirectSupported) {
+    physicalDeviceFeatures.multiDrawIndirect = VK_TRUE;
+    physicalDeviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+  }
+
+  // Frame scheduling signals one timeline semaphore per submission.
+  VkPhysicalDeviceVulkan12Features physicalDeviceVulkan12Features{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+  physicalDeviceVulkan12Features.timelineSemaphore = VK_TRUE;
+
+  // The render graph records its barriers with vkCmdPipelineBarrier2.
+  VkPhysicalDeviceVulkan13Features physicalDeviceVulkan13Features{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
+  physicalDeviceVulkan13Features.pNext = &physicalDeviceVulkan12Features;
+  physicalDeviceVulkan13Features.synchronization2 = VK_TRUE;
+  physicalDeviceVulkan13Features.dynamicRendering =
+      m_dynamicRenderingSupported ? VK_TRUE : VK_FALSE;
 
   VkDeviceCreateInfo deviceCreateInfo{};
   deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  deviceCreateInfo.pNext = &physicalDeviceVulkan13Features;
   deviceCreateInfo.queueCreateInfoCount =
       (uint32_t)deviceQueueCreateInfos.size();
   deviceCreateInfo.pQueueCreateInfos = deviceQueueCreateInfos.data();
@@ -488,15 +896,31 @@ void Renderer::createDevice() {
 }
 
 void Renderer::createSwapchain(int width, int height) {
-  auto swapChainSupport = QuerySwapchainSupport(m_physicalDevice, m_surface);
+  QuerySwapchainSupport(m_physicalDevice, m_surface, m_swapchainSupport);
+  const SwapchainSupport &swapChainSupport = m_swapchainSupport;
 
   VkSurfaceFormatKHR surfaceFormat =
       ChooseSurfaceFormat(swapChainSupport.formats);
+  VkPresentModeKHR preferredPresentModes[3]{};
+  uint32_t preferredPresentModeCount =
+      PresentModePreference(m_presentPolicy, preferredPresentModes);
   VkPresentModeKHR presentMode =
-      ChoosePresentMode(swapChainSupport.presentModes);
+      ChoosePresentMode(swapChainSupport.presentModes, preferredPresentModes,
+                        preferredPresentModeCount);
+  if (presentMode != m_presentMode) {
+    Log::info("Present mode: %s", PresentModeName(presentMode));
+  }
+  m_presentMode = presentMode;
   VkExtent2D extent = ChooseExtent(swapChainSupport.caps, width, height);
 
-  uint32_t imageCount = swapChainSupport.caps.minImageCount + 1;
+  // Low latency keeps the queue of presented images as short as the
+  // surface allows; throughput gives the extra frame in flight an image.
+  uint32_t imageCount = swapChainSupport.caps.minImageCount;
+  if (m_latencyMode == BalancedLatency) {
+    imageCount += 1;
+  } else if (m_latencyMode == HighThroughput) {
+    imageCount += 2;
+  }
   if (swapChainSupport.caps.maxImageCount > 0 &&
       imageCount > swapChainSupport.caps.maxImageCount) {
     imageCount = swapChainSupport.caps.maxImageCount;
@@ -542,6 +966,17 @@ void Renderer::createSwapchain(int width, int height) {
   m_swapchainImages.resize(swapchainCount);
   vkGetSwapchainImagesKHR(m_device, m_swapchain, &swapchainCount,
                           m_swapchainImages.data());
+
+  VkSemaphoreCreateInfo semaphoreCreateInfo{
+      VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+  m_renderFinished.resize(swapchainCount, VK_NULL_HANDLE);
+  for (VkSemaphore &semaphore : m_renderFinished) {
+    if (vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr,
+                          &semaphore) != VK_SUCCESS) {
+      std::cerr << "Could not create render finished semaphore" << std::endl;
+      std::abort();
+    }
+  }
 }
 
 void Renderer::createSwapchainViews() {
@@ -572,38 +1007,88 @@ void Renderer::createSwapchainViews() {
 }
 
 void Renderer::createRenderPass() {
-  VkSubpassDependency subpassDependency{};
-  subpassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-  subpassDependency.dstSubpass = 0;
-  subpassDependency.srcStageMask =
+  if (m_dynamicRendering) {
+    return; // attachments are named at vkCmdBeginRendering
+  }
+
+  const bool temporal = m_antiAliasing == TemporalAA;
+
+  VkSubpassDependency subpassDependencies[3]{};
+  subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  subpassDependencies[0].dstSubpass = 0;
+  subpassDependencies[0].srcStageMask =
       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-  subpassDependency.dstStageMask =
+  subpassDependencies[0].dstStageMask =
       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-  subpassDependency.srcAccessMask = 0;
-  subpassDependency.dstAccessMask =
+  subpassDependencies[0].srcAccessMask = 0;
+  subpassDependencies[0].dstAccessMask =
       VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
+  // Depth pre-pass: shading subpass depth tests against the depth-only one.
+  subpassDependencies[1].srcSubpass = 0;
+  subpassDependencies[1].dstSubpass = 1;
+  subpassDependencies[1].srcStageMask =
+      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  // EQUAL may be tested late (e.g. when the shading pipeline cannot use
+  // early tests), so both test stages wait for the pre-pass.
+  subpassDependencies[1].dstStageMask =
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  subpassDependencies[1].srcAccessMask =
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  subpassDependencies[1].dstAccessMask =
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+  subpassDependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+  uint32_t dependencyCount = m_depthPrepass ? 2 : 1;
+
+  if (temporal || m_dynamicResolution) {
+    // Last frame's resolve or upscale may still be sampling the output.
+    subpassDependencies[0].srcStageMask |=
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+    // The resolve pass samples scene color and motion vectors; the upscale
+    // pass samples its source.
+    VkSubpassDependency &resolveDependency =
+        subpassDependencies[dependencyCount++];
+    resolveDependency.srcSubpass = mainSubpass();
+    resolveDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+    resolveDependency.srcStageMask =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    resolveDependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    resolveDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    resolveDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  }
+
   VkRenderPassCreateInfo renderPassCreateInfo{};
   renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-  renderPassCreateInfo.subpassCount = 1;
-  renderPassCreateInfo.dependencyCount = 1;
-  renderPassCreateInfo.pDependencies = &subpassDependency;
+  renderPassCreateInfo.subpassCount = m_depthPrepass ? 2 : 1;
+  renderPassCreateInfo.dependencyCount = dependencyCount;
+  renderPassCreateInfo.pDependencies = subpassDependencies;
 
   if (m_sampleCount == VK_SAMPLE_COUNT_1_BIT) {
-    // ----- No MSAA path: swapchain color + depth -----
+    // ----- No MSAA path: output color + depth -----
+    // TAA renders offscreen instead: scene color + depth + motion vectors,
+    // all sampled afterwards by the resolve pass.
 
     VkAttachmentDescription colorDescription{};
-    colorDescription.format = m_swapchainFormat;
+    colorDescription.format =
+        temporal ? TemporalResolve::kSceneColorFormat : outputFormat();
     colorDescription.samples = VK_SAMPLE_COUNT_1_BIT;
     colorDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     colorDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorDescription.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorDescription.finalLayout =
+        temporal ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                 : outputFinalLayout();
+
+    VkAttachmentDescription motionDescription = colorDescription;
+    motionDescription.format = TemporalResolve::kMotionFormat;
 
     VkAttachmentDescription depthDescription{};
     depthDescription.format = m_depthFormat;
@@ -616,22 +1101,29 @@ void Renderer::createRenderPass() {
     depthDescription.finalLayout =
         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-    VkAttachmentReference colorReference{
-        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference colorReferences[2] = {
+        {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+        {2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}};
     VkAttachmentReference depthReference{
         1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
 
-    VkSubpassDescription subpass{};
+    VkSubpassDescription subpasses[2]{};
+    VkSubpassDescription &subpass = subpasses[mainSubpass()];
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorReference;
+    subpass.colorAttachmentCount = colorAttachmentCount();
+    subpass.pColorAttachments = colorReferences;
     subpass.pDepthStencilAttachment = &depthReference;
 
-    VkAttachmentDescription attachmentDescriptions[2] = {colorDescription,
-                                                         depthDescription};
-    renderPassCreateInfo.attachmentCount = 2;
+    if (m_depthPrepass) {
+      subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+      subpasses[0].pDepthStencilAttachment = &depthReference;
+    }
+
+    VkAttachmentDescription attachmentDescriptions[3] = {
+        colorDescription, depthDescription, motionDescription};
+    renderPassCreateInfo.attachmentCount = temporal ? 3 : 2;
     renderPassCreateInfo.pAttachments = attachmentDescriptions;
-    renderPassCreateInfo.pSubpasses = &subpass;
+    renderPassCreateInfo.pSubpasses = subpasses;
 
     VkResult result = vkCreateRenderPass(m_device, &renderPassCreateInfo,
                                          nullptr, &m_renderPass);
@@ -640,10 +1132,10 @@ void Renderer::createRenderPass() {
       std::abort();
     }
   } else {
-    // ----- MSAA path: msaaColor + resolve(swapchain) + msaaDepth -----
+    // ----- MSAA path: msaaColor + resolve(output) + msaaDepth -----
 
     VkAttachmentDescription colorDescription{};
-    colorDescription.format = m_swapchainFormat;
+    colorDescription.format = outputFormat();
     colorDescription.samples = m_sampleCount;
     colorDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     colorDescription.storeOp =
@@ -653,9 +1145,9 @@ void Renderer::createRenderPass() {
     colorDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     colorDescription.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-    // Attachment 1: resolve color (this is the swapchain image view)
+    // Attachment 1: resolve color (swapchain image or upscale source)
     VkAttachmentDescription resolveDescription{};
-    resolveDescription.format = m_swapchainFormat;
+    resolveDescription.format = outputFormat();
     resolveDescription.samples = VK_SAMPLE_COUNT_1_BIT;
     resolveDescription.loadOp =
         VK_ATTACHMENT_LOAD_OP_DONT_CARE; // will be written by resolve op
@@ -663,7 +1155,7 @@ void Renderer::createRenderPass() {
     resolveDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     resolveDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     resolveDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    resolveDescription.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    resolveDescription.finalLayout = outputFinalLayout();
 
     // Attachment 2: multisampled depth
     VkAttachmentDescription depthDescription{};
@@ -684,18 +1176,24 @@ void Renderer::createRenderPass() {
     VkAttachmentReference depthReference{
         2, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
 
-    VkSubpassDescription subpass{};
+    VkSubpassDescription subpasses[2]{};
+    VkSubpassDescription &subpass = subpasses[mainSubpass()];
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorReference;
     subpass.pResolveAttachments = &resolveReference;
     subpass.pDepthStencilAttachment = &depthReference;
 
+    if (m_depthPrepass) {
+      subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+      subpasses[0].pDepthStencilAttachment = &depthReference;
+    }
+
     VkAttachmentDescription attachmentDescriptions[3] = {
         colorDescription, resolveDescription, depthDescription};
     renderPassCreateInfo.attachmentCount = 3;
     renderPassCreateInfo.pAttachments = attachmentDescriptions;
-    renderPassCreateInfo.pSubpasses = &subpass;
+    renderPassCreateInfo.pSubpasses = subpasses;
 
     VkResult result = vkCreateRenderPass(m_device, &renderPassCreateInfo,
                                          nullptr, &m_renderPass);
@@ -721,20 +1219,27 @@ void Renderer::createColorResources() {
     vkFreeMemory(m_device, m_colorMemory, nullptr);
     m_colorMemory = VK_NULL_HANDLE;
   }
+  m_colorMemoryLazy = false;
 
   if (m_sampleCount == VK_SAMPLE_COUNT_1_BIT) {
     return; // no MSAA needed
   }
+  if (m_dynamicRendering) {
+    return; // a render graph transient, declared per frame
+  }
 
+  // Cleared on load and resolved before the pass ends; never stored.
   if (!CreateImage2D(m_physicalDevice, m_device, m_sampleCount,
                      m_swapchainExtent.width, m_swapchainExtent.height,
-                     m_swapchainFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                     m_colorImage, m_colorMemory)) {
+                     outputFormat(),
+                     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                         VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                     m_colorImage, m_colorMemory, &m_colorMemoryLazy)) {
     std::cerr << "Failed to create MSAA color image" << std::endl;
     std::abort();
   }
 
-  m_colorView = CreateImageView(m_device, m_colorImage, m_swapchainFormat,
+  m_colorView = CreateImageView(m_device, m_colorImage, outputFormat(),
                                 VK_IMAGE_ASPECT_COLOR_BIT);
 
   if (!m_colorView) {
@@ -747,11 +1252,17 @@ void Renderer::createDepthResources() {
   if (m_depthView) {
     destroyDepthResources();
   }
+  if (m_dynamicRendering) {
+    return; // a render graph transient, declared per frame
+  }
 
+  // Only lives inside the main render pass (STORE_OP_DONT_CARE).
   if (!CreateImage2D(m_physicalDevice, m_device, m_sampleCount,
                      m_swapchainExtent.width, m_swapchainExtent.height,
-                     m_depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-                     m_depthImage, m_depthMemory)) {
+                     m_depthFormat,
+                     VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                         VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                     m_depthImage, m_depthMemory, &m_depthMemoryLazy)) {
     std::cerr << "Failed to create depth image" << std::endl;
     std::abort();
   }
@@ -764,23 +1275,77 @@ void Renderer::createDepthResources() {
   }
 }
 
+void Renderer::createResolutionResources() {
+  if (!m_dynamicResolution) {
+    return;
+  }
+
+  // Allocated once at the largest scale; scale changes only move the
+  // viewport and scissor.
+  m_resolution.createTargets(m_physicalDevice, m_device, m_swapchainExtent,
+                             m_swapchainFormat, m_swapchainImageViews);
+}
+
+void Renderer::createTemporalResources() {
+  if (m_antiAliasing != TemporalAA) {
+    return;
+  }
+
+  std::vector<VkImageView> outputViews = m_swapchainImageViews;
+  if (m_dynamicResolution) {
+    outputViews = {m_resolution.sourceView()};
+  }
+
+  m_temporal.createTargets(m_physicalDevice, m_device, m_swapchainExtent,
+                           outputFormat(), outputFinalLayout(), outputViews);
+}
+
+VkFormat Renderer::outputFormat() {
+  return m_dynamicResolution ? DynamicResolution::kSourceFormat
+                             : m_swapchainFormat;
+}
+
+VkImageLayout Renderer::outputFinalLayout() {
+  return m_dynamicResolution ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                             : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+}
+
+VkImageView Renderer::outputView(uint32_t imageIndex) {
+  return m_dynamicResolution ? m_resolution.sourceView()
+                             : m_swapchainImageViews[imageIndex];
+}
+
 void Renderer::createFramebuffers() {
+  if (m_dynamicRendering) {
+    return;
+  }
+
   m_framebuffers.resize(m_swapchainImageViews.size());
 
   for (size_t i = 0; i < m_swapchainImageViews.size(); ++i) {
     VkFramebufferCreateInfo frameBufferCreateInfo{};
 
-    if (m_sampleCount == VK_SAMPLE_COUNT_1_BIT) {
-      VkImageView attachments[] = {m_swapchainImageViews[i], m_depthView};
+    // Outlives the branches below; vkCreateFramebuffer reads it.
+    VkImageView attachments[3]{};
+
+    if (m_antiAliasing == TemporalAA) {
+      // Offscreen targets are shared; the resolve pass owns the swapchain.
+      attachments[0] = m_temporal.sceneColorView(); // 0: scene color
+      attachments[1] = m_depthView;                 // 1: depth
+      attachments[2] = m_temporal.motionView();     // 2: motion vectors
+
+      frameBufferCreateInfo.pAttachments = attachments;
+      frameBufferCreateInfo.attachmentCount = 3;
+    } else if (m_sampleCount == VK_SAMPLE_COUNT_1_BIT) {
+      attachments[0] = outputView((uint32_t)i);
+      attachments[1] = m_depthView;
 
       frameBufferCreateInfo.pAttachments = attachments;
       frameBufferCreateInfo.attachmentCount = 2;
     } else {
-      VkImageView attachments[] = {
-          m_colorView,              // attachment 0: MSAA color
-          m_swapchainImageViews[i], // attachment 1: resolve (presented)
-          m_depthView               // attachment 2: depth
-      };
+      attachments[0] = m_colorView;              // attachment 0: MSAA color
+      attachments[1] = outputView((uint32_t)i);  // 1: resolve (output)
+      attachments[2] = m_depthView;              // attachment 2: depth
 
       frameBufferCreateInfo.pAttachments = attachments;
       frameBufferCreateInfo.attachmentCount = 3;
@@ -821,7 +1386,7 @@ void Renderer::createCommandBuffers() {
       VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
   commandBufferAllocateInfo.commandPool = m_cmdPool;
   commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  commandBufferAllocateInfo.commandBufferCount = FRAME_COUNT;
+  commandBufferAllocateInfo.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
 
   VkResult result = vkAllocateCommandBuffers(
       m_device, &commandBufferAllocateInfo, m_cmd.data());
@@ -835,52 +1400,253 @@ void Renderer::createCommandBuffers() {
 void Renderer::createSyncObjects() {
   VkSemaphoreCreateInfo semaphoreCreateInfo{
       VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
-  VkFenceCreateInfo fenceCreateInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
-  fenceCreateInfo.flags =
-      VK_FENCE_CREATE_SIGNALED_BIT; // start signaled so first frame doesn't
-                                    // wait forever
 
-  for (int i = 0; i < FRAME_COUNT; ++i) {
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
     if (vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr,
                           &m_imageAvailable[i]) != VK_SUCCESS) {
       std::cerr << "Could not create image semaphore" << std::endl;
       std::abort();
     }
-    if (vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr,
-                          &m_renderFinished[i]) != VK_SUCCESS) {
-      std::cerr << "Could not create render finished semaphore" << std::endl;
-      std::abort();
-    }
-    if (vkCreateFence(m_device, &fenceCreateInfo, nullptr, &m_inFlight[i]) !=
-        VK_SUCCESS) {
-      std::cerr << "Could not create fence" << std::endl;
-      std::abort();
-    }
+    // Value 0 is already reached, so the first frame does not wait.
+    m_frameValues[i] = 0;
   }
+
+  m_timeline.init(m_device);
 }
 
 void Renderer::recordCommandBuffer(VkCommandBuffer commandBuffer,
                                    uint32_t imageIndex, Scene *scene) {
-
-  auto pipelineLayout = *scene->pipelineLayout();
-  auto pipeline = *scene->pipeline();
-  auto descriptorSets = *scene->descriptorSets();
+  PROFILE_ZONE("Renderer::recordCommandBuffer");
 
   VkCommandBufferBeginInfo commandBufferBeginInfo{};
   commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
   vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+  m_gpuProfiler.beginFrame(commandBuffer, m_frameIndex);
+  m_resolution.beginFrame(commandBuffer, m_frameIndex);
+  m_drawCalls = 0;
+  m_triangles = 0;
+  scene->geometry()->beginFrame(commandBuffer, m_frameIndex);
+
+  // Scene targets are full size; only this top-left region is rendered.
+  const VkExtent2D extent = renderExtent();
+
+  // The pulled pipeline has no vertex input; every mesh is drawn out of the
+  // scene GeometryBuffer with one pipeline and one descriptor set bind.
+  const bool pulled = m_vertexPulling && *scene->pulledPipeline();
+
+  const bool temporal = m_antiAliasing == TemporalAA;
+
+  m_mainDraws = buildDrawList(scene, pulled);
+
+  m_graph.begin(m_timeline.completedValue(), m_timeline.submittedValue(),
+                m_frameArenas[m_frameIndex]);
+
+  GraphResource lightCounts = m_graph.importBuffer(
+      "light counts", m_lighting.countBuffer(m_frameIndex));
+  GraphResource lightIndices = m_graph.importBuffer(
+      "light indices", m_lighting.indexBuffer(m_frameIndex));
+  GraphResource shadowMap = m_graph.importImage(
+      "shadow map", m_shadows.image(), VK_IMAGE_ASPECT_DEPTH_BIT,
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+  GraphResource swapchainImage =
+      m_graph.importImage("swapchain", m_swapchainImages[imageIndex],
+                          VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+  // Render pass paths already end in PRESENT_SRC; this only adds a barrier
+  // after dynamic rendering.
+  m_graph.markOutput(swapchainImage, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+  // Without a VkRenderPass the attachments that only live inside the main
+  // pass are graph transients; their contents are never kept.
+  GraphResource depth = kInvalidGraphResource;
+  GraphResource multisampledColor = kInvalidGraphResource;
+  if (m_dynamicRendering) {
+    GraphImageDescription depthDescription{};
+    depthDescription.format = m_depthFormat;
+    depthDescription.extent = m_swapchainExtent;
+    depthDescription.samples = m_sampleCount;
+    depthDescription.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                             VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    depthDescription.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    depth = m_graph.createImage("depth", depthDescription);
+
+    if (m_sampleCount != VK_SAMPLE_COUNT_1_BIT) {
+      GraphImageDescription colorDescription{};
+      colorDescription.format = outputFormat();
+      colorDescription.extent = m_swapchainExtent;
+      colorDescription.samples = m_sampleCount;
+      colorDescription.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                               VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+      multisampledColor =
+          m_graph.createImage("multisampled color", colorDescription);
+    }
+  }
+
+  GraphResource sceneColor = kInvalidGraphResource;
+  GraphResource motion = kInvalidGraphResource;
+  if (temporal) {
+    sceneColor = m_graph.importImage("scene color",
+                                     m_temporal.sceneColorImage(),
+                                     VK_IMAGE_ASPECT_COLOR_BIT,
+                                     VK_IMAGE_LAYOUT_UNDEFINED);
+    motion = m_graph.importImage("motion vectors", m_temporal.motionImage(),
+                                 VK_IMAGE_ASPECT_COLOR_BIT,
+                                 VK_IMAGE_LAYOUT_UNDEFINED);
+  }
+
+  GraphResource upscaleSource = kInvalidGraphResource;
+  if (m_dynamicResolution) {
+    upscaleSource = m_graph.importImage(
+        "upscale source", m_resolution.sourceImage(),
+        VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+  }
+
+  // Where the last scene pass lands before (optional) upscaling.
+  GraphResource output =
+      m_dynamicResolution ? upscaleSource : swapchainImage;
+  GraphAccess mainOutputAccess =
+      m_dynamicRendering
+          ? GraphColorAttachmentWrite()
+          : GraphRenderPassAccess(GraphColorAttachmentWrite(),
+                                  outputFinalLayout());
+
+  // Bin this frame's lights into the froxel grid before shading.
+  uint32_t clusterPass =
+      m_graph.addPass("cluster cull", [this](VkCommandBuffer cmd) {
+        m_lighting.dispatch(cmd, m_frameIndex);
+      });
+  m_graph.write(clusterPass, lightCounts, GraphComputeStorageWrite());
+  m_graph.write(clusterPass, lightIndices, GraphComputeStorageWrite());
+
+  uint32_t shadowPass = m_graph.addPass(
+      "shadows", [this, scene, pulled](VkCommandBuffer cmd) {
+        recordShadowPasses(cmd, scene, pulled);
+      });
+  m_graph.write(shadowPass, shadowMap,
+                GraphRenderPassAccess(
+                    GraphDepthAttachmentWrite(),
+                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL));
+
+  uint32_t mainPass = m_graph.addPass(
+      "main", [this, scene, pulled, imageIndex, extent, depth,
+               multisampledColor](VkCommandBuffer cmd) {
+        if (m_dynamicRendering) {
+          recordMainRendering(cmd, imageIndex, scene, pulled, extent, depth,
+                              multisampledColor);
+        } else {
+          recordMainPass(cmd, imageIndex, scene, pulled, extent);
+        }
+      });
+  m_graph.read(mainPass, lightCounts, GraphFragmentStorageRead());
+  m_graph.read(mainPass, lightIndices, GraphFragmentStorageRead());
+  m_graph.read(mainPass, shadowMap, GraphDepthSampledRead());
+  if (m_dynamicRendering) {
+    m_graph.write(mainPass, depth, GraphDepthAttachmentWrite());
+    if (multisampledColor != kInvalidGraphResource) {
+      m_graph.write(mainPass, multisampledColor, GraphColorAttachmentWrite());
+    }
+  }
+  if (temporal) {
+    GraphAccess sampled =
+        m_dynamicRendering
+            ? GraphColorAttachmentWrite()
+            : GraphRenderPassAccess(GraphColorAttachmentWrite(),
+                                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    m_graph.write(mainPass, sceneColor, sampled);
+    m_graph.write(mainPass, motion, sampled);
+
+    uint32_t resolvePass = m_graph.addPass(
+        "temporal resolve", [this, imageIndex, extent](VkCommandBuffer cmd) {
+          m_temporal.resolve(cmd, imageIndex, extent);
+        });
+    m_graph.read(resolvePass, sceneColor, GraphFragmentSampledRead());
+    m_graph.read(resolvePass, motion, GraphFragmentSampledRead());
+    // The resolve keeps its own VkRenderPass in either mode.
+    m_graph.write(resolvePass, output,
+                  GraphRenderPassAccess(GraphColorAttachmentWrite(),
+                                        outputFinalLayout()));
+  } else {
+    m_graph.write(mainPass, output, mainOutputAccess);
+  }
+
+  if (m_dynamicResolution) {
+    uint32_t upscalePass =
+        m_graph.addPass("upscale", [this, imageIndex](VkCommandBuffer cmd) {
+          m_resolution.upscale(cmd, imageIndex);
+        });
+    m_graph.read(upscalePass, upscaleSource, GraphFragmentSampledRead());
+    m_graph.write(upscalePass, swapchainImage,
+                  GraphRenderPassAccess(GraphColorAttachmentWrite(),
+                                        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR));
+  }
+
+  m_graph.compile();
+  m_graph.execute(commandBuffer, &m_gpuProfiler);
+
+  m_resolution.endFrame(commandBuffer, m_frameIndex);
+  m_gpuProfiler.endFrame(commandBuffer);
+
+  vkEndCommandBuffer(commandBuffer);
+}
+
+void Renderer::bindSceneState(VkCommandBuffer commandBuffer, Scene *scene,
+                              bool pulled, VkExtent2D extent) {
+  auto pipelineLayout = *scene->pipelineLayout();
+  auto descriptorSets = *scene->descriptorSets();
+
+  VkViewport viewport{};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = (float)extent.width;
+  viewport.height = (float)extent.height;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+  VkRect2D scissor{};
+  scissor.offset = {0, 0};
+  scissor.extent = extent;
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipelineLayout, 0, 1, &descriptorSets[m_frameIndex],
+                          0, nullptr);
+
+  if (pulled) {
+    VkDescriptorSet geometrySet = scene->geometry()->descriptorSet();
+    const uint32_t drawsOffset = scene->geometry()->drawsOffset();
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, 1, 1, &geometrySet, 1,
+                            &drawsOffset);
+  }
+
+  VkDescriptorSet lightingSet = m_lighting.descriptorSet(m_frameIndex);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipelineLayout, 2, 1, &lightingSet, 0, nullptr);
+
+  VkDescriptorSet shadowSet = m_shadows.descriptorSet(m_frameIndex);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipelineLayout, 3, 1, &shadowSet, 0, nullptr);
+}
+
+void Renderer::recordMainPass(VkCommandBuffer commandBuffer,
+                              uint32_t imageIndex, Scene *scene, bool pulled,
+                              VkExtent2D extent) {
+  auto pipelineLayout = *scene->pipelineLayout();
+  auto pipeline = *scene->pipeline();
+  auto pulledPipeline = *scene->pulledPipeline();
 
   VkRenderPassBeginInfo renderPassBeginInfo{};
   renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
   renderPassBeginInfo.renderPass = m_renderPass;
   renderPassBeginInfo.framebuffer = m_framebuffers[imageIndex];
   renderPassBeginInfo.renderArea.offset = {0, 0};
-  renderPassBeginInfo.renderArea.extent = m_swapchainExtent;
+  renderPassBeginInfo.renderArea.extent = extent;
 
-  if (m_sampleCount == VK_SAMPLE_COUNT_1_BIT) {
-    VkClearValue clears[2]{};
+  // Outlives the branches below; vkCmdBeginRenderPass reads it.
+  VkClearValue clears[3]{};
 
+  if (m_sampleCount == VK_SAMPLE_COUNT_1_BIT) {
     // A pleasant “evergreen-ish” clear.
     clears[0].color.float32[0] = m_clearColor[0];
     clears[0].color.float32[1] = m_clearColor[1];
@@ -890,11 +1656,10 @@ void Renderer::recordCommandBuffer(VkCommandBuffer commandBuffer,
     clears[1].depthStencil.depth = 1.0f;
     clears[1].depthStencil.stencil = 0;
 
+    // clears[2] is zero motion when TAA adds the motion vector attachment.
     renderPassBeginInfo.pClearValues = clears;
-    renderPassBeginInfo.clearValueCount = 2;
+    renderPassBeginInfo.clearValueCount = colorAttachmentCount() == 2 ? 3 : 2;
   } else {
-    VkClearValue clears[3]{};
-
     // A pleasant “evergreen-ish” clear.
     clears[0].color.float32[0] = m_clearColor[0];
     clears[0].color.float32[1] = m_clearColor[1];
@@ -911,47 +1676,302 @@ void Renderer::recordCommandBuffer(VkCommandBuffer commandBuffer,
   vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo,
                        VK_SUBPASS_CONTENTS_INLINE);
 
-  VkViewport viewport{};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = (float)m_swapchainExtent.width;
-  viewport.height = (float)m_swapchainExtent.height;
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+  bindSceneState(commandBuffer, scene, pulled, extent);
 
-  VkRect2D scissor{};
-  scissor.offset = {0, 0};
-  scissor.extent = m_swapchainExtent;
-  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+  if (m_depthPrepass) {
+    // Depth-only subpass; the shading subpass then tests EQUAL so each pixel
+    // is shaded once.
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      pulled ? *scene->pulledDepthPipeline()
+                             : *scene->depthPipeline());
+    drawMeshes(commandBuffer, pipelineLayout, pulled, m_mainDraws);
 
-  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          pipelineLayout, 0, 1, &descriptorSets[m_frameIndex],
-                          0, nullptr);
+    vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+  }
 
-  Mat4 model = Mat4::identity(); // MUST be initialized
-  vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,
-                     0, sizeof(Mat4), &model);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    pulled ? pulledPipeline : pipeline);
+  drawMeshes(commandBuffer, pipelineLayout, pulled, m_mainDraws);
 
-  VkDeviceSize off = 0;
+  vkCmdEndRenderPass(commandBuffer);
+}
+
+void Renderer::recordMainRendering(VkCommandBuffer commandBuffer,
+                                   uint32_t imageIndex, Scene *scene,
+                                   bool pulled, VkExtent2D extent,
+                                   GraphResource depth,
+                                   GraphResource multisampledColor) {
+  auto pipelineLayout = *scene->pipelineLayout();
+  auto pipeline = *scene->pipeline();
+  auto pulledPipeline = *scene->pulledPipeline();
+
+  const bool temporal = m_antiAliasing == TemporalAA;
+  const bool multisampled = m_sampleCount != VK_SAMPLE_COUNT_1_BIT;
+
+  // Same attachments as the render pass path, named per frame instead of
+  // through a framebuffer; layouts are handled by the graph.
+  VkRenderingAttachmentInfo colorAttachments[2]{};
+  for (VkRenderingAttachmentInfo &colorAttachment : colorAttachments) {
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  }
 
-  // model/mesh rendering.
-  for (Model &model : scene->models()) {
-    for (Mesh &mesh : model.meshes()) {
-      VkBuffer vertexBuffer = mesh.vertexBuffer();
-      VkBuffer indexBuffer = mesh.indexBuffer();
-      uint32_t indexCount = mesh.indexCount();
+  // A pleasant “evergreen-ish” clear.
+  colorAttachments[0].clearValue.color.float32[0] = m_clearColor[0];
+  colorAttachments[0].clearValue.color.float32[1] = m_clearColor[1];
+  colorAttachments[0].clearValue.color.float32[2] = m_clearColor[2];
+  colorAttachments[0].clearValue.color.float32[3] = 1.0f;
+
+  if (temporal) {
+    colorAttachments[0].imageView = m_temporal.sceneColorView();
+    colorAttachments[1].imageView = m_temporal.motionView(); // zero motion
+  } else if (multisampled) {
+    // Resolved into the output at the end of the scope; never stored.
+    colorAttachments[0].imageView = m_graph.imageView(multisampledColor);
+    colorAttachments[0].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachments[0].resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+    colorAttachments[0].resolveImageView = outputView(imageIndex);
+    colorAttachments[0].resolveImageLayout =
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  } else {
+    colorAttachments[0].imageView = outputView(imageIndex);
+  }
 
-      vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &off);
-      vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+  VkRenderingAttachmentInfo depthAttachment{
+      VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO};
+  depthAttachment.imageView = m_graph.imageView(depth);
+  depthAttachment.imageLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.clearValue.depthStencil.depth = 1.0f;
+  depthAttachment.clearValue.depthStencil.stencil = 0;
+
+  VkRenderingInfo renderingInfo{VK_STRUCTURE_TYPE_RENDERING_INFO};
+  renderingInfo.renderArea.offset = {0, 0};
+  renderingInfo.renderArea.extent = extent;
+  renderingInfo.layerCount = 1;
+  renderingInfo.colorAttachmentCount = colorAttachmentCount();
+  renderingInfo.pColorAttachments = colorAttachments;
+  renderingInfo.pDepthAttachment = &depthAttachment;
+
+  vkCmdBeginRendering(commandBuffer, &renderingInfo);
+
+  bindSceneState(commandBuffer, scene, pulled, extent);
+
+  if (m_depthPrepass) {
+    // No subpasses here: the depth-only draws run first in the same scope,
+    // so depth stays in tile memory and the EQUAL test sees it through
+    // rasterization order.
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      pulled ? *scene->pulledDepthPipeline()
+                             : *scene->depthPipeline());
+    drawMeshes(commandBuffer, pipelineLayout, pulled, m_mainDraws);
+  }
 
-      vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    pulled ? pulledPipeline : pipeline);
+  drawMeshes(commandBuffer, pipelineLayout, pulled, m_mainDraws);
+
+  vkCmdEndRendering(commandBuffer);
+}
+
+void Renderer::recordShadowPasses(VkCommandBuffer commandBuffer,
+                                  Scene *scene, bool pulled) {
+  auto pipelineLayout = *scene->pipelineLayout();
+  auto shadowPipeline =
+      pulled ? *scene->pulledShadowPipeline() : *scene->shadowPipeline();
+  auto descriptorSets = *scene->descriptorSets();
+
+  VkDescriptorSet shadowSet = m_shadows.descriptorSet(m_frameIndex);
+
+  for (uint32_t c = 0; c < kCascadeCount; ++c) {
+    // Cached cascades keep last frame's contents (and matrix).
+    if (!m_shadows.needsRender(c)) {
+      continue;
+    }
+
+    m_shadows.beginCascade(commandBuffer, c);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      shadowPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, 0, 1,
+                            &descriptorSets[m_frameIndex], 0, nullptr);
+    if (pulled) {
+      VkDescriptorSet geometrySet = scene->geometry()->descriptorSet();
+      const uint32_t drawsOffset = scene->geometry()->drawsOffset();
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              pipelineLayout, 1, 1, &geometrySet, 1,
+                              &drawsOffset);
     }
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, 3, 1, &shadowSet, 0, nullptr);
+
+    drawMeshes(commandBuffer, pipelineLayout, pulled,
+               buildDrawList(scene, pulled, (int)c), (int)c);
+
+    m_shadows.endCascade(commandBuffer);
   }
+}
 
-  vkCmdEndRenderPass(commandBuffer);
-  vkEndCommandBuffer(commandBuffer);
+Renderer::DrawList Renderer::buildDrawList(Scene *scene, bool pulled,
+                                           int shadowCascade) {
+  // One snapshot instance per mesh, in entity table order, so this is a
+  // single linear pass. Meshes themselves are immutable GPU data and are
+  // read from the scene.
+  std::vector<Model> &models = scene->models();
+
+  DrawItem *items = m_frameArenas[m_frameIndex].allocateArray<DrawItem>(
+      m_snapshot->instances.size());
+  uint32_t count = 0;
+
+  for (const RenderInstance &instance : m_snapshot->instances) {
+    if (shadowCascade < 0 && !instance.visible) {
+      continue;
+    }
+    if (shadowCascade >= 0) {
+      // Dynamic instances would invalidate a cached cascade every frame.
+      if (!instance.castsShadows ||
+          (m_shadows.cached(shadowCascade) && !instance.isStatic) ||
+          !m_shadows.castsInto(shadowCascade, instance.boundsMin,
+                               instance.boundsMax)) {
+        continue;
+      }
+    }
+
+    if (instance.model >= models.size() ||
+        instance.mesh >= models[instance.model].meshes().size()) {
+      continue;
+    }
+    Mesh &mesh = models[instance.model].meshes()[instance.mesh];
+    if (pulled && !mesh.pulled()) {
+      continue;
+    }
+
+    items[count++] = {&mesh, &instance.transform};
+  }
+
+  DrawList list{items, count};
+  if (pulled) {
+    GeometryBuffer *geometry = scene->geometry();
+    list.geometry = geometry;
+    list.firstDraw = geometry->reserveDraws(list.count);
+    for (uint32_t i = 0; i < list.count; ++i) {
+      geometry->writeDraw(list.firstDraw + i, *items[i].transform,
+                          items[i].mesh->pulledRange());
+    }
+  }
+  return list;
+}
+
+void Renderer::drawMeshes(VkCommandBuffer commandBuffer,
+                          VkPipelineLayout pipelineLayout, bool pulled,
+                          const DrawList &draws, int shadowCascade) {
+  DrawPush push{}; // model MUST be initialized (identity by default)
+  push.shadowCascade = shadowCascade < 0 ? 0 : (uint32_t)shadowCascade;
+
+  if (pulled) {
+    // Model matrices and geometry ranges are in the list's draw records;
+    // only the cascade is pushed, once for the whole list.
+    vkCmdPushConstants(commandBuffer, pipelineLayout,
+                       VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawPush),
+                       &push);
+
+    if (m_multiDrawIndirectSupported && draws.count > 0) {
+      vkCmdDrawIndirect(commandBuffer, draws.geometry->indirectBuffer(),
+                        draws.geometry->indirectOffset(draws.firstDraw),
+                        draws.count, sizeof(VkDrawIndirectCommand));
+      ++m_drawCalls;
+    }
+    for (uint32_t i = 0; i < draws.count; ++i) {
+      const GeometryRange &range = draws.items[i].mesh->pulledRange();
+      if (!m_multiDrawIndirectSupported) {
+        // Same records, selected by firstInstance.
+        vkCmdDraw(commandBuffer, range.indexCount, 1, range.firstIndex,
+                  draws.firstDraw + i);
+        ++m_drawCalls;
+      }
+      m_triangles += range.indexCount / 3;
+    }
+    return;
+  }
+
+  VkDeviceSize off = 0;
+
+  for (uint32_t i = 0; i < draws.count; ++i) {
+    Mesh &mesh = *draws.items[i].mesh;
+    push.model = *draws.items[i].transform;
+
+    VkBuffer vertexBuffer = mesh.vertexBuffer();
+    VkBuffer indexBuffer = mesh.indexBuffer();
+    uint32_t indexCount = mesh.indexCount();
+
+    vkCmdPushConstants(commandBuffer, pipelineLayout,
+                       VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawPush),
+                       &push);
+
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &off);
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+    vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+    ++m_drawCalls;
+    m_triangles += indexCount / 3;
+  }
+}
+
+void Renderer::reportAttachmentMemory() {
+  constexpr double kMiB = 1024.0 * 1024.0;
+
+  if (m_dynamicRendering) {
+    Log::info("Transient attachment memory: render graph, %g MiB (%g MiB "
+              "unaliased)",
+              m_graph.transientBytes() / kMiB,
+              m_graph.transientBytesWithoutAliasing() / kMiB);
+    return;
+  }
+
+  VkDeviceSize reservedTotal = 0;
+  VkDeviceSize committedTotal = 0;
+
+  auto report = [&](const char *name, VkImage image, VkDeviceMemory memory,
+                    bool lazy) {
+    if (!image) {
+      return;
+    }
+
+    VkMemoryRequirements memoryRequirements{};
+    vkGetImageMemoryRequirements(m_device, image, &memoryRequirements);
+
+    // Only lazily allocated memory can be partially committed.
+    VkDeviceSize committed = memoryRequirements.size;
+    if (lazy) {
+      vkGetDeviceMemoryCommitment(m_device, memory, &committed);
+    }
+
+    reservedTotal += memoryRequirements.size;
+    committedTotal += committed;
+
+    Log::info("  %s: %g MiB reserved, %g MiB committed (%s)", name,
+              memoryRequirements.size / kMiB, committed / kMiB,
+              lazy ? "lazily allocated" : "device local");
+  };
+
+  Log::info("Transient attachment memory (%ux%u, %d sample%s):",
+            m_swapchainExtent.width, m_swapchainExtent.height,
+            (int)m_sampleCount,
+            m_sampleCount == VK_SAMPLE_COUNT_1_BIT ? "" : "s");
+  report("MSAA color", m_colorImage, m_colorMemory, m_colorMemoryLazy);
+  report("depth", m_depthImage, m_depthMemory, m_depthMemoryLazy);
+  Log::info("  saved %g MiB of %g MiB",
+            (reservedTotal - committedTotal) / kMiB, reservedTotal / kMiB);
+
+  if (!m_colorMemoryLazy && !m_depthMemoryLazy) {
+    Log::info("  no LAZILY_ALLOCATED memory type; transient usage only lets "
+              "the driver alias these");
+  }
 }
 
 void Renderer::waitDeviceIdle() {
@@ -970,24 +1990,49 @@ void Renderer::recreateSwapchainIfNeeded(Scene *scene) {
 
   waitDeviceIdle();
 
-  // Pipeline depends on renderpass, which depends on swapchain format.
-  scene->destroyPipeline(*this);
+  // Render pass pipelines depend on the render pass, which is rebuilt here.
+  // Dynamic rendering pipelines only depend on attachment formats and
+  // sample counts, so a plain resize keeps them.
+  bool rebuildPipelines = !m_dynamicRendering || m_pipelinesDirty;
+  if (rebuildPipelines) {
+    scene->destroyPipeline(*this);
+  }
+
+  const VkFormat previousSwapchainFormat = m_swapchainFormat;
   destroySwapchain();
 
+  // Idle device: every slot is free, so the slot count can change here.
+  m_framesInFlight = FramesInFlightFor(m_latencyMode);
+  m_frameIndex = 0;
+
   createSwapchain(m_width, m_height);
+  if (!rebuildPipelines && m_swapchainFormat != previousSwapchainFormat &&
+      colorAttachmentFormat(0) == m_swapchainFormat) {
+    scene->destroyPipeline(*this);
+    rebuildPipelines = true;
+  }
+
   createSwapchainViews();
+  createResolutionResources();
+  createTemporalResources();
   createRenderPass();
   createColorResources();
   createDepthResources();
   createFramebuffers();
-  scene->createPipeline(*this);
+  m_memoryReportCountdown = m_framesInFlight + 1;
+  if (rebuildPipelines) {
+    scene->createPipeline(*this);
+  }
 
   m_swapchainDirty = false;
+  m_pipelinesDirty = false;
 }
 
 void Renderer::destroySwapchain() {
   destroyColorResources();
   destroyDepthResources();
+  m_temporal.destroyTargets(m_device);
+  m_resolution.destroyTargets(m_device);
 
   for (auto fb : m_framebuffers) {
     vkDestroyFramebuffer(m_device, fb, nullptr);
@@ -1007,6 +2052,11 @@ void Renderer::destroySwapchain() {
   m_swapchainImageViews.clear();
   m_swapchainImages.clear();
 
+  for (VkSemaphore semaphore : m_renderFinished) {
+    vkDestroySemaphore(m_device, semaphore, nullptr);
+  }
+  m_renderFinished.clear();
+
   if (m_swapchain) {
     vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
     m_swapchain = VK_NULL_HANDLE;
@@ -1030,6 +2080,7 @@ void Renderer::destroyColorResources() {
     vkFreeMemory(m_device, m_colorMemory, nullptr);
     m_colorMemory = VK_NULL_HANDLE;
   }
+  m_colorMemoryLazy = false;
 }
 
 void Renderer::destroyDepthResources() {
@@ -1049,4 +2100,5 @@ void Renderer::destroyDepthResources() {
     vkFreeMemory(m_device, m_depthMemory, nullptr);
     m_depthMemory = VK_NULL_HANDLE;
   }
+  m_depthMemoryLazy = false;
 }
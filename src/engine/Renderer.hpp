@@ -1,17 +1,42 @@
 #pragma once
 
+#include "../Vulkan.hpp"
+
 #include "Camera.hpp"
 #include "Constants.hpp"
 #include "Dimensions.hpp"
+#include "Graph.hpp"
+#include "Lighting.hpp"
+#include "Memory.hpp"
+#include "Pacing.hpp"
 #include "Platform.hpp"
+#include "Profiler.hpp"
+#include "Resolution.hpp"
 #include "Scene.hpp"
+#include "Shadows.hpp"
+#include "Snapshot.hpp"
+#include "Temporal.hpp"
+#include "Timeline.hpp"
 
 #include <vulkan/vulkan.h>
 
 #include <array>
+#include <chrono>
 #include <cstdint>
+#include <mutex>
 #include <vector>
 
+// Frames in flight and swapchain depth, trading input latency against
+// CPU/GPU overlap.
+enum LatencyMode {
+  LowLatency = 0, // 1 frame in flight, input sampled right before recording
+  BalancedLatency,
+  HighThroughput, // 3 frames in flight, deeper swapchain
+  LatencyModeCount,
+};
+
+const char *LatencyModeName(LatencyMode latencyMode);
+
 class Renderer {
 public:
   Renderer() = default;
@@ -29,24 +54,128 @@ public:
   VkDevice device();
   VkSampleCountFlagBits sampleCount();
   VkRenderPass renderPass();
+  // Clustered light list and grid, bound at set 2 by the scene pipelines.
+  VkDescriptorSetLayout lightingSetLayout();
+  // Cascaded shadow maps: casters render into shadowRenderPass(), shading
+  // samples them through set 3.
+  VkRenderPass shadowRenderPass();
+  VkDescriptorSetLayout shadowSetLayout();
+
+  // Draw through the storage-buffer vertex pulling pipeline when the scene
+  // provides one.
+  bool vertexPulling();
+  void setVertexPulling(bool enabled);
+
+  // Depth-only subpass before shading; main pipelines then use EQUAL with
+  // depth writes off. Scenes build their main pipelines for mainSubpass().
+  bool depthPrepass();
+  void setDepthPrepass(bool enabled);
+  uint32_t mainSubpass();
+
+  // VK_KHR_dynamic_rendering (core 1.3) for the main pass: no VkRenderPass
+  // or framebuffers, so renderPass() is VK_NULL_HANDLE and scene pipelines
+  // target colorAttachmentFormat()/depthFormat() instead. Falls back to the
+  // render pass path when the device does not support it.
+  bool dynamicRendering();
+  void setDynamicRendering(bool enabled);
+
+  // Off, MSAA 2x/4x/8x or TAA; changing it rebuilds the render pass, the
+  // targets and the scene pipelines.
+  AntiAliasing antiAliasing();
+  bool antiAliasingSupported(AntiAliasing antiAliasing);
+  void setAntiAliasing(AntiAliasing antiAliasing);
+  // Color outputs of the main subpass (TAA adds motion vectors).
+  uint32_t colorAttachmentCount();
+  VkFormat colorAttachmentFormat(uint32_t index);
+  VkFormat depthFormat();
+
+  // Render the scene at a GPU-time driven fraction of the swapchain extent
+  // and upscale into the swapchain image.
+  bool dynamicResolution();
+  void setDynamicResolution(bool enabled);
+  // Extent the scene is rasterized at this frame.
+  VkExtent2D renderExtent();
+  Dimensions renderDimensions();
+
+  // FIFO/MAILBOX/IMMEDIATE selection; changing it recreates the swapchain.
+  PresentPolicy presentPolicy();
+  void setPresentPolicy(PresentPolicy presentPolicy);
+
+  // Changing the mode recreates the swapchain with a matching image count.
+  LatencyMode latencyMode();
+  void setLatencyMode(LatencyMode latencyMode);
+  int framesInFlight();
+  // Blocks until the next frame's slot is free. When rendering on the main
+  // thread this is called before input is sampled so that what gets recorded
+  // is as fresh as possible; drawFrame() waits again, which is then free.
+  void waitForFrameSlot();
+  // Time from a snapshot's inputTime until vkQueuePresentKHR returned for
+  // its frame. Excludes the GPU and presentation engine after that call.
+  float inputToPresentMilliseconds();
+
+  // Render state the simulation needs (TAA jitter). Published after every
+  // update(); safe to read from another thread than the one rendering.
+  struct Feedback {
+    bool temporal = false;
+    float renderWidth = 1.0f;
+    float renderHeight = 1.0f;
+  };
+  Feedback feedback();
+
+  // Cost of the last drawn frame, for telemetry. Published at the end of
+  // every drawFrame(); safe to read from another thread.
+  struct FrameStats {
+    uint64_t frame = 0;
+    float renderMilliseconds = 0.0f;  // drawFrame() minus the waits below
+    float waitMilliseconds = 0.0f;    // frame slot (timeline) waits
+    float acquireMilliseconds = 0.0f; // vkAcquireNextImageKHR
+    float gpuMilliseconds = 0.0f;     // latest frame the GPU finished
+    uint32_t drawCalls = 0;           // scene meshes, shadow passes included
+    uint64_t triangles = 0;
+    uint64_t gpuMemoryBytes = 0; // device-local heap usage; 0 if unknown
+  };
+  FrameStats frameStats();
 
+  // With a render thread, everything below runs on it; setters called from
+  // elsewhere go through RenderSnapshot::commands.
   void resize(int width, int height);
   void update(float deltaTime);
-  void drawFrame(Scene *scene);
+  void drawFrame(Scene *scene, const RenderSnapshot &snapshot);
 
   void shutdown();
 
 private:
   bool m_enableValidation = false;
   bool m_swapchainDirty = false;
+  // Set by mode changes that alter pipeline targets (formats, samples,
+  // subpasses); a plain resize leaves dynamic rendering pipelines alone.
+  bool m_pipelinesDirty = false;
+  bool m_dynamicRenderingSupported = false;
+  bool m_calibratedTimestampsSupported = false;
+  // multiDrawIndirect and drawIndirectFirstInstance: a pulled draw list is
+  // one vkCmdDrawIndirect instead of a vkCmdDraw per mesh.
+  bool m_multiDrawIndirectSupported = false;
+  bool m_memoryBudgetSupported = false;
+  bool m_dynamicRendering = false;
+  bool m_vertexPulling = false;
+  bool m_depthPrepass = false;
+  bool m_dynamicResolution = false;
   int m_width = 0;
   int m_height = 0;
 
+  PresentPolicy m_presentPolicy = PresentVsync;
+  // Mode of the current swapchain; printed whenever it changes.
+  VkPresentModeKHR m_presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+  LatencyMode m_latencyMode = BalancedLatency;
+  int m_framesInFlight = 2;
+
   std::array<float, 3> m_clearColor = {0.0, 0.0, 1.0}; // {0.10, 0.16, 0.18};
 
   VkInstance m_instance = VK_NULL_HANDLE;
 
   VkSampleCountFlagBits m_sampleCount = VK_SAMPLE_COUNT_1_BIT;
+  VkSampleCountFlags m_supportedSampleCounts = VK_SAMPLE_COUNT_1_BIT;
+  AntiAliasing m_antiAliasing = AntiAliasingOff;
 
   VkDebugUtilsMessengerEXT m_debugMessenger = VK_NULL_HANDLE;
 
@@ -60,6 +189,7 @@ private:
   VkImage m_colorImage = VK_NULL_HANDLE;
   VkDeviceMemory m_colorMemory = VK_NULL_HANDLE;
   VkImageView m_colorView = VK_NULL_HANDLE;
+  bool m_colorMemoryLazy = false;
 
   uint32_t m_graphicsFamily = UINT32_MAX;
   uint32_t m_presentFamily = UINT32_MAX;
@@ -71,22 +201,87 @@ private:
   VkExtent2D m_swapchainExtent{};
   std::vector<VkImage> m_swapchainImages;
   std::vector<VkImageView> m_swapchainImageViews;
+  // Signalled by the submit that draws to each image and waited on by its
+  // present. Indexed by image rather than frame slot: a slot is free once
+  // its submission completes, but the present waiting on the semaphore is
+  // only known to be done when that image is acquired again.
+  std::vector<VkSemaphore> m_renderFinished;
 
   VkFormat m_depthFormat = VK_FORMAT_D32_SFLOAT;
   VkImage m_depthImage = VK_NULL_HANDLE;
   VkDeviceMemory m_depthMemory = VK_NULL_HANDLE;
   VkImageView m_depthView = VK_NULL_HANDLE;
+  bool m_depthMemoryLazy = false;
+
+  // Frames left until the transient attachment memory report; lazily
+  // allocated memory is only committed once the attachments are used.
+  int m_memoryReportCountdown = 0;
 
   VkRenderPass m_renderPass = VK_NULL_HANDLE;
   std::vector<VkFramebuffer> m_framebuffers;
 
+  // Reused by every swapchain (re)creation.
+  SwapchainSupport m_swapchainSupport;
+
   VkCommandPool m_cmdPool = VK_NULL_HANDLE;
 
+  ClusteredLighting m_lighting;
+  CascadedShadows m_shadows;
+  TemporalResolve m_temporal;
+  DynamicResolution m_resolution;
+  GpuProfiler m_gpuProfiler;
+  RenderGraph m_graph;
+  Timeline m_timeline;
+
+  // The frame being drawn; only valid inside drawFrame().
+  const RenderSnapshot *m_snapshot = nullptr;
+
+  // Render queue entry. Lists live in the frame arena and point into the
+  // scene and the snapshot, so they are only valid while recording.
+  struct DrawItem {
+    Mesh *mesh = nullptr;
+    const Mat4 *transform = nullptr;
+  };
+
+  struct DrawList {
+    const DrawItem *items = nullptr;
+    uint32_t count = 0;
+    // Pulled lists only: where buildDrawList() wrote their records.
+    GeometryBuffer *geometry = nullptr;
+    uint32_t firstDraw = 0;
+  };
+
+  // Per-frame CPU scratch (render queues, graph callbacks, barrier lists),
+  // one per frame slot and reset once the slot's submission has retired.
+  std::array<FrameArena, MAX_FRAMES_IN_FLIGHT> m_frameArenas;
+  // Main view queue, shared by the depth pre-pass and the shading pass.
+  DrawList m_mainDraws;
+
+  std::mutex m_feedbackMutex;
+  Feedback m_feedback;
+
+  // Accumulated while a frame is drawn, then published as m_frameStats.
+  uint64_t m_waitNanoseconds = 0;
+  uint32_t m_drawCalls = 0;
+  uint64_t m_triangles = 0;
+  uint64_t m_gpuMemoryBytes = 0;
+  uint32_t m_gpuMemoryCountdown = 0;
+  std::mutex m_frameStatsMutex;
+  FrameStats m_frameStats;
+
   int m_frameIndex = 0;
-  std::array<VkCommandBuffer, FRAME_COUNT> m_cmd{};
-  std::array<VkSemaphore, FRAME_COUNT> m_imageAvailable{};
-  std::array<VkSemaphore, FRAME_COUNT> m_renderFinished{};
-  std::array<VkFence, FRAME_COUNT> m_inFlight{};
+  std::array<VkCommandBuffer, MAX_FRAMES_IN_FLIGHT> m_cmd{};
+  // Swapchain acquire/present still need binary semaphores.
+  std::array<VkSemaphore, MAX_FRAMES_IN_FLIGHT> m_imageAvailable{};
+  // Timeline value of the last submission that used each frame slot.
+  std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> m_frameValues{};
+
+  // Input-to-present-call latency, sampled when vkQueuePresentKHR returns.
+  using Clock = std::chrono::steady_clock;
+  float m_latencyMilliseconds = 0.0f;
+  double m_latencySum = 0.0;
+  float m_latencyMax = 0.0f;
+  uint32_t m_latencySamples = 0;
 
   void createInstance();
   void setupDebug();
@@ -98,13 +293,46 @@ private:
   void createRenderPass();
   void createColorResources();
   void createDepthResources();
+  void createResolutionResources();
+  void createTemporalResources();
   void createFramebuffers();
   void createCommandPool();
   void createCommandBuffers();
   void createSyncObjects();
+  void measureLatency(Clock::time_point inputTime,
+                      Clock::time_point presentTime);
+
+  // Where the main pass (or the TAA resolve) writes: the swapchain image, or
+  // the upscale source with dynamic resolution.
+  VkFormat outputFormat();
+  VkImageLayout outputFinalLayout();
+  VkImageView outputView(uint32_t imageIndex);
 
   void recordCommandBuffer(VkCommandBuffer cmd, uint32_t imageIndex,
                            Scene *scene);
+  // Records the main scene render pass; run as a graph pass.
+  void recordMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex,
+                      Scene *scene, bool pulled, VkExtent2D extent);
+  // Dynamic rendering equivalent; the depth pre-pass shares the scope.
+  // Depth and MSAA color are graph transients of the current frame.
+  void recordMainRendering(VkCommandBuffer commandBuffer,
+                           uint32_t imageIndex, Scene *scene, bool pulled,
+                           VkExtent2D extent, GraphResource depth,
+                           GraphResource multisampledColor);
+  // Viewport, scissor and the scene descriptor sets (0-3).
+  void bindSceneState(VkCommandBuffer commandBuffer, Scene *scene,
+                      bool pulled, VkExtent2D extent);
+  void recordShadowPasses(VkCommandBuffer commandBuffer, Scene *scene,
+                          bool pulled);
+  // shadowCascade < 0 lists every mesh; otherwise only casters into it.
+  DrawList buildDrawList(Scene *scene, bool pulled, int shadowCascade = -1);
+  void drawMeshes(VkCommandBuffer commandBuffer,
+                  VkPipelineLayout pipelineLayout, bool pulled,
+                  const DrawList &draws, int shadowCascade = -1);
+
+  // Logs the MSAA color and depth footprint: reserved vs committed bytes.
+  void reportAttachmentMemory();
+  uint64_t queryGpuMemoryUsage();
 
   void waitDeviceIdle();
 
@@ -0,0 +1,474 @@
+#include "../Vulkan.hpp"
+
+#include "Log.hpp"
+#include "Pipeline.hpp"
+#include "Resolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Frames to wait after a scale change before judging it; results lag by the
+// frames in flight.
+static constexpr uint32_t kSettleFrames = 8;
+// Below this fraction of the target the scale is allowed to grow again.
+static constexpr float kHeadroom = 0.85f;
+// 0 = soft, 1 = strongest contrast-adaptive sharpening.
+static constexpr float kSharpness = 0.5f;
+
+// Matches the push block in shaders/upscale.frag.
+struct UpscalePush {
+  float source[4]; // 1/width, 1/height of the source image
+  float region[4]; // xy uv extent of the rendered region, z sharpness
+};
+
+void DynamicResolution::init(VkPhysicalDevice physicalDevice, VkDevice device,
+                             uint32_t queueFamily) {
+  VkPhysicalDeviceProperties physicalDeviceProperties{};
+  vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+  m_timestampPeriod = physicalDeviceProperties.limits.timestampPeriod;
+
+  uint32_t queueFamilyPropertyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,
+                                           &queueFamilyPropertyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilyProperties(
+      queueFamilyPropertyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(
+      physicalDevice, &queueFamilyPropertyCount, queueFamilyProperties.data());
+
+  m_timestampsSupported =
+      queueFamily < queueFamilyPropertyCount &&
+      queueFamilyProperties[queueFamily].timestampValidBits > 0;
+
+  if (m_timestampsSupported) {
+    VkQueryPoolCreateInfo queryPoolCreateInfo{
+        VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCreateInfo.queryCount = 2 * MAX_FRAMES_IN_FLIGHT;
+
+    if (vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr,
+                          &m_queryPool) != VK_SUCCESS) {
+      std::cerr << "vkCreateQueryPool failed for dynamic resolution"
+                << std::endl;
+      std::abort();
+    }
+  } else {
+    Log::warning("GPU timestamps unavailable; dynamic resolution stays at "
+                 "full scale");
+  }
+
+  VkSamplerCreateInfo samplerCreateInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+  samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+  samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+  samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.maxLod = 0.0f;
+
+  if (vkCreateSampler(device, &samplerCreateInfo, nullptr, &m_sampler) !=
+      VK_SUCCESS) {
+    std::cerr << "Failed to create upscale sampler" << std::endl;
+    std::abort();
+  }
+
+  VkDescriptorSetLayoutBinding descriptorSetLayoutBinding{};
+  descriptorSetLayoutBinding.binding = 0;
+  descriptorSetLayoutBinding.descriptorType =
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorSetLayoutBinding.descriptorCount = 1;
+  descriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+  descriptorSetLayoutCreateInfo.bindingCount = 1;
+  descriptorSetLayoutCreateInfo.pBindings = &descriptorSetLayoutBinding;
+
+  if (vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo,
+                                  nullptr,
+                                  &m_descriptorSetLayout) != VK_SUCCESS) {
+    std::cerr << "vkCreateDescriptorSetLayout failed for upscale" << std::endl;
+    std::abort();
+  }
+
+  VkDescriptorPoolSize descriptorPoolSize{};
+  descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorPoolSize.descriptorCount = 1;
+
+  VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+  descriptorPoolCreateInfo.maxSets = 1;
+  descriptorPoolCreateInfo.poolSizeCount = 1;
+  descriptorPoolCreateInfo.pPoolSizes = &descriptorPoolSize;
+
+  if (vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr,
+                             &m_descriptorPool) != VK_SUCCESS) {
+    std::cerr << "vkCreateDescriptorPool failed for upscale" << std::endl;
+    std::abort();
+  }
+
+  VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+  descriptorSetAllocateInfo.descriptorPool = m_descriptorPool;
+  descriptorSetAllocateInfo.descriptorSetCount = 1;
+  descriptorSetAllocateInfo.pSetLayouts = &m_descriptorSetLayout;
+
+  if (vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
+                               &m_descriptorSet) != VK_SUCCESS) {
+    std::cerr << "vkAllocateDescriptorSets failed for upscale" << std::endl;
+    std::abort();
+  }
+
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(UpscalePush);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+  pipelineLayoutCreateInfo.setLayoutCount = 1;
+  pipelineLayoutCreateInfo.pSetLayouts = &m_descriptorSetLayout;
+  pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+  pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+  if (vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr,
+                             &m_pipelineLayout) != VK_SUCCESS) {
+    std::cerr << "vkCreatePipelineLayout failed for upscale" << std::endl;
+    std::abort();
+  }
+}
+
+void DynamicResolution::createTargets(
+    VkPhysicalDevice physicalDevice, VkDevice device, VkExtent2D maxExtent,
+    VkFormat swapchainFormat,
+    const std::vector<VkImageView> &swapchainImageViews) {
+  destroyTargets(device);
+
+  m_maxExtent = maxExtent;
+
+  if (!CreateImage2D(physicalDevice, device, VK_SAMPLE_COUNT_1_BIT,
+                     maxExtent.width, maxExtent.height, kSourceFormat,
+                     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                         VK_IMAGE_USAGE_SAMPLED_BIT,
+                     m_sourceImage, m_sourceMemory)) {
+    std::cerr << "Failed to create upscale source image" << std::endl;
+    std::abort();
+  }
+
+  m_sourceView = CreateImageView(device, m_sourceImage, kSourceFormat,
+                                 VK_IMAGE_ASPECT_COLOR_BIT);
+  if (!m_sourceView) {
+    std::cerr << "Failed to create upscale source view" << std::endl;
+    std::abort();
+  }
+
+  createRenderPass(device, swapchainFormat);
+
+  m_framebuffers.resize(swapchainImageViews.size());
+  for (size_t i = 0; i < swapchainImageViews.size(); ++i) {
+    VkFramebufferCreateInfo framebufferCreateInfo{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+    framebufferCreateInfo.renderPass = m_renderPass;
+    framebufferCreateInfo.attachmentCount = 1;
+    framebufferCreateInfo.pAttachments = &swapchainImageViews[i];
+    framebufferCreateInfo.width = maxExtent.width;
+    framebufferCreateInfo.height = maxExtent.height;
+    framebufferCreateInfo.layers = 1;
+
+    if (vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr,
+                            &m_framebuffers[i]) != VK_SUCCESS) {
+      std::cerr << "vkCreateFramebuffer failed for upscale" << std::endl;
+      std::abort();
+    }
+  }
+
+  GraphicsPipelineDescription graphicsPipelineDescription{};
+  graphicsPipelineDescription.vertexShader = "shaders/fullscreen.vert.spv";
+  graphicsPipelineDescription.fragmentShader = "shaders/upscale.frag.spv";
+  graphicsPipelineDescription.layout = m_pipelineLayout;
+  graphicsPipelineDescription.renderPass = m_renderPass;
+  graphicsPipelineDescription.depthTest = false;
+  graphicsPipelineDescription.depthWrite = false;
+
+  m_pipeline = CreateGraphicsPipeline(device, graphicsPipelineDescription);
+  if (!m_pipeline) {
+    std::abort();
+  }
+
+  VkDescriptorImageInfo descriptorImageInfo{};
+  descriptorImageInfo.sampler = m_sampler;
+  descriptorImageInfo.imageView = m_sourceView;
+  descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  VkWriteDescriptorSet writeDescriptorSet{
+      VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+  writeDescriptorSet.dstSet = m_descriptorSet;
+  writeDescriptorSet.dstBinding = 0;
+  writeDescriptorSet.descriptorCount = 1;
+  writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  writeDescriptorSet.pImageInfo = &descriptorImageInfo;
+
+  vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+}
+
+void DynamicResolution::destroyTargets(VkDevice device) {
+  if (!device) {
+    return;
+  }
+
+  if (m_pipeline) {
+    vkDestroyPipeline(device, m_pipeline, nullptr);
+    m_pipeline = VK_NULL_HANDLE;
+  }
+
+  for (VkFramebuffer framebuffer : m_framebuffers) {
+    vkDestroyFramebuffer(device, framebuffer, nullptr);
+  }
+  m_framebuffers.clear();
+
+  if (m_renderPass) {
+    vkDestroyRenderPass(device, m_renderPass, nullptr);
+    m_renderPass = VK_NULL_HANDLE;
+  }
+
+  if (m_sourceView) {
+    vkDestroyImageView(device, m_sourceView, nullptr);
+    m_sourceView = VK_NULL_HANDLE;
+  }
+  if (m_sourceImage) {
+    vkDestroyImage(device, m_sourceImage, nullptr);
+    m_sourceImage = VK_NULL_HANDLE;
+  }
+  if (m_sourceMemory) {
+    vkFreeMemory(device, m_sourceMemory, nullptr);
+    m_sourceMemory = VK_NULL_HANDLE;
+  }
+}
+
+VkImage DynamicResolution::sourceImage() { return m_sourceImage; }
+
+VkImageView DynamicResolution::sourceView() { return m_sourceView; }
+
+void DynamicResolution::beginFrame(VkCommandBuffer commandBuffer,
+                                   int frameIndex) {
+  if (!m_timestampsSupported) {
+    return;
+  }
+
+  vkCmdResetQueryPool(commandBuffer, m_queryPool, 2 * frameIndex, 2);
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                      m_queryPool, 2 * frameIndex);
+}
+
+void DynamicResolution::endFrame(VkCommandBuffer commandBuffer,
+                                 int frameIndex) {
+  if (!m_timestampsSupported) {
+    return;
+  }
+
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      m_queryPool, 2 * frameIndex + 1);
+  m_queriesWritten[frameIndex] = true;
+}
+
+void DynamicResolution::collect(VkDevice device, int frameIndex,
+                                bool adjustScale) {
+  if (!m_timestampsSupported || !m_queriesWritten[frameIndex]) {
+    return;
+  }
+
+  uint64_t timestamps[2] = {};
+  VkResult result = vkGetQueryPoolResults(
+      device, m_queryPool, 2 * frameIndex, 2, sizeof(timestamps), timestamps,
+      sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+  if (result != VK_SUCCESS) {
+    return;
+  }
+
+  m_queriesWritten[frameIndex] = false;
+
+  const double nanoseconds =
+      (double)(timestamps[1] - timestamps[0]) * (double)m_timestampPeriod;
+  m_lastGpuMilliseconds = (float)(nanoseconds / 1.0e6);
+  if (adjustScale) {
+    adjust(m_lastGpuMilliseconds);
+  }
+}
+
+VkExtent2D DynamicResolution::renderExtent() {
+  VkExtent2D extent{};
+  extent.width =
+      std::max(1u, (uint32_t)std::lround(m_maxExtent.width * m_scale));
+  extent.height =
+      std::max(1u, (uint32_t)std::lround(m_maxExtent.height * m_scale));
+  return extent;
+}
+
+float DynamicResolution::scale() { return m_scale; }
+
+float DynamicResolution::gpuMilliseconds() { return m_gpuMilliseconds; }
+
+float DynamicResolution::lastGpuMilliseconds() {
+  return m_lastGpuMilliseconds;
+}
+
+void DynamicResolution::setTargetMilliseconds(float milliseconds) {
+  m_targetMilliseconds = milliseconds;
+}
+
+void DynamicResolution::adjust(float gpuMilliseconds) {
+  // Smooth out per-frame noise before reacting.
+  m_gpuMilliseconds = m_gpuMilliseconds == 0.0f
+                          ? gpuMilliseconds
+                          : m_gpuMilliseconds * 0.9f + gpuMilliseconds * 0.1f;
+
+  if (++m_framesSinceChange < kSettleFrames) {
+    return;
+  }
+
+  if (m_gpuMilliseconds <= m_targetMilliseconds &&
+      m_gpuMilliseconds >= m_targetMilliseconds * kHeadroom) {
+    return;
+  }
+
+  // Cost scales with pixel count, i.e. with scale squared.
+  float desired =
+      m_scale * std::sqrt(m_targetMilliseconds / m_gpuMilliseconds);
+  desired = std::clamp(desired, kMinRenderScale, kMaxRenderScale);
+  desired = std::round(desired / kRenderScaleStep) * kRenderScaleStep;
+  desired = std::clamp(desired, kMinRenderScale, kMaxRenderScale);
+
+  if (std::fabs(desired - m_scale) >= kRenderScaleStep * 0.5f) {
+    m_scale = desired;
+    m_framesSinceChange = 0;
+    Log::info("Render scale: %g (GPU %g ms)", m_scale, m_gpuMilliseconds);
+  }
+}
+
+void DynamicResolution::upscale(VkCommandBuffer commandBuffer,
+                                uint32_t imageIndex) {
+  VkRenderPassBeginInfo renderPassBeginInfo{
+      VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+  renderPassBeginInfo.renderPass = m_renderPass;
+  renderPassBeginInfo.framebuffer = m_framebuffers[imageIndex];
+  renderPassBeginInfo.renderArea.offset = {0, 0};
+  renderPassBeginInfo.renderArea.extent = m_maxExtent;
+
+  vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo,
+                       VK_SUBPASS_CONTENTS_INLINE);
+
+  VkViewport viewport{};
+  viewport.width = (float)m_maxExtent.width;
+  viewport.height = (float)m_maxExtent.height;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+  VkRect2D scissor{};
+  scissor.extent = m_maxExtent;
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    m_pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          m_pipelineLayout, 0, 1, &m_descriptorSet, 0,
+                          nullptr);
+
+  VkExtent2D region = renderExtent();
+
+  UpscalePush push{};
+  push.source[0] = 1.0f / (float)m_maxExtent.width;
+  push.source[1] = 1.0f / (float)m_maxExtent.height;
+  push.region[0] = (float)region.width / (float)m_maxExtent.width;
+  push.region[1] = (float)region.height / (float)m_maxExtent.height;
+  push.region[2] = kSharpness;
+
+  vkCmdPushConstants(commandBuffer, m_pipelineLayout,
+                     VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(UpscalePush),
+                     &push);
+
+  vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+  vkCmdEndRenderPass(commandBuffer);
+}
+
+void DynamicResolution::createRenderPass(VkDevice device,
+                                         VkFormat swapchainFormat) {
+  VkAttachmentDescription colorDescription{};
+  colorDescription.format = swapchainFormat;
+  colorDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+  colorDescription.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  colorDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  colorDescription.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+  VkAttachmentReference colorReference{
+      0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &colorReference;
+
+  // The swapchain image is handed over at COLOR_ATTACHMENT_OUTPUT.
+  VkSubpassDependency subpassDependency{};
+  subpassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+  subpassDependency.dstSubpass = 0;
+  subpassDependency.srcStageMask =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  subpassDependency.dstStageMask =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  subpassDependency.srcAccessMask = 0;
+  subpassDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+  VkRenderPassCreateInfo renderPassCreateInfo{
+      VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+  renderPassCreateInfo.attachmentCount = 1;
+  renderPassCreateInfo.pAttachments = &colorDescription;
+  renderPassCreateInfo.subpassCount = 1;
+  renderPassCreateInfo.pSubpasses = &subpass;
+  renderPassCreateInfo.dependencyCount = 1;
+  renderPassCreateInfo.pDependencies = &subpassDependency;
+
+  if (vkCreateRenderPass(device, &renderPassCreateInfo, nullptr,
+                         &m_renderPass) != VK_SUCCESS) {
+    std::cerr << "vkCreateRenderPass failed for upscale" << std::endl;
+    std::abort();
+  }
+}
+
+void DynamicResolution::shutdown(VkDevice device) {
+  if (!device) {
+    return;
+  }
+
+  destroyTargets(device);
+
+  if (m_pipelineLayout) {
+    vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+    m_pipelineLayout = VK_NULL_HANDLE;
+  }
+
+  if (m_descriptorPool) {
+    vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+    m_descriptorPool = VK_NULL_HANDLE;
+    m_descriptorSet = VK_NULL_HANDLE;
+  }
+
+  if (m_descriptorSetLayout) {
+    vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+    m_descriptorSetLayout = VK_NULL_HANDLE;
+  }
+
+  if (m_sampler) {
+    vkDestroySampler(device, m_sampler, nullptr);
+    m_sampler = VK_NULL_HANDLE;
+  }
+
+  if (m_queryPool) {
+    vkDestroyQueryPool(device, m_queryPool, nullptr);
+    m_queryPool = VK_NULL_HANDLE;
+  }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Constants.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Render scale bounds (per axis) and the step the controller moves in.
+// Quantizing keeps TAA history resets rare.
+static constexpr float kMinRenderScale = 0.5f;
+static constexpr float kMaxRenderScale = 1.0f;
+static constexpr float kRenderScaleStep = 0.05f;
+
+// Dynamic resolution: the scene renders into the top-left scale x extent
+// region of targets allocated at full (max) size, so changing the scale only
+// changes viewport and scissor. upscale() then filters that region into the
+// swapchain image with a contrast-adaptive sharpen. The scale is driven by
+// GPU timestamps bracketing each frame's command buffer.
+class DynamicResolution {
+public:
+  static constexpr VkFormat kSourceFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+  DynamicResolution() = default;
+  ~DynamicResolution() = default;
+
+  void init(VkPhysicalDevice physicalDevice, VkDevice device,
+            uint32_t queueFamily);
+
+  void createTargets(VkPhysicalDevice physicalDevice, VkDevice device,
+                     VkExtent2D maxExtent, VkFormat swapchainFormat,
+                     const std::vector<VkImageView> &swapchainImageViews);
+  void destroyTargets(VkDevice device);
+
+  // Single-sampled image the scene (or the TAA resolve) writes into.
+  VkImage sourceImage();
+  VkImageView sourceView();
+
+  // Brackets the frame's GPU work with timestamps. Outside a render pass.
+  void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+  void endFrame(VkCommandBuffer commandBuffer, int frameIndex);
+
+  // Reads the timestamps of a frame whose submission has completed and,
+  // when adjustScale is set, moves the scale toward the target frame time.
+  void collect(VkDevice device, int frameIndex, bool adjustScale);
+
+  VkExtent2D renderExtent();
+  float scale();
+  float gpuMilliseconds();
+  // Unsmoothed GPU time of the last collected frame.
+  float lastGpuMilliseconds();
+  void setTargetMilliseconds(float milliseconds);
+
+  void upscale(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+  void shutdown(VkDevice device);
+
+private:
+  VkExtent2D m_maxExtent{};
+  float m_scale = kMaxRenderScale;
+  float m_targetMilliseconds = 1000.0f / 60.0f;
+  float m_gpuMilliseconds = 0.0f;
+  float m_lastGpuMilliseconds = 0.0f;
+  uint32_t m_framesSinceChange = 0;
+
+  // Timestamps: two per frame in flight.
+  VkQueryPool m_queryPool = VK_NULL_HANDLE;
+  float m_timestampPeriod = 1.0f; // nanoseconds per tick
+  bool m_timestampsSupported = false;
+  std::array<bool, MAX_FRAMES_IN_FLIGHT> m_queriesWritten{};
+
+  VkImage m_sourceImage = VK_NULL_HANDLE;
+  VkDeviceMemory m_sourceMemory = VK_NULL_HANDLE;
+  VkImageView m_sourceView = VK_NULL_HANDLE;
+
+  VkSampler m_sampler = VK_NULL_HANDLE;
+  VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+  VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+
+  VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+  VkPipeline m_pipeline = VK_NULL_HANDLE;
+  VkRenderPass m_renderPass = VK_NULL_HANDLE;
+  std::vector<VkFramebuffer> m_framebuffers;
+
+  void adjust(float gpuMilliseconds);
+  void createRenderPass(VkDevice device, VkFormat swapchainFormat);
+};
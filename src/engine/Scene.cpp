@@ -1,15 +1,32 @@
 #include "../Vulkan.hpp"
 
+#include "Jobs.hpp"
+#include "Profiler.hpp"
 #include "Renderer.hpp"
 #include "Scene.hpp"
 
+#include <atomic>
 #include <iostream>
+#include <utility>
+
+// Occlusion buffer resolution; one tile is 8x4 of these pixels.
+static constexpr uint32_t kOcclusionWidth = 320;
+static constexpr uint32_t kOcclusionHeight = 192;
 
 void Scene::init(Renderer &renderer, Camera camera, std::vector<Model> models,
                  std::function<void(Renderer &, Scene *)> createPipeline,
                  std::function<void(Renderer &, Scene *)> destroyPipeline) {
   m_camera = camera;
-  m_models = models;
+  m_models.clear();
+  m_entities.clear();
+  m_transforms.clear();
+  m_bvh.clear();
+  m_occluders.clear();
+  m_occlusion.init(kOcclusionWidth, kOcclusionHeight);
+  m_models.reserve(models.size());
+  for (Model &model : models) {
+    addModel(std::move(model));
+  }
   m_createPipeline = createPipeline;
   m_destroyPipeline = destroyPipeline;
 
@@ -17,15 +34,132 @@ void Scene::init(Renderer &renderer, Camera camera, std::vector<Model> models,
   m_createPipeline(renderer, this);
 }
 
-void Scene::update(Renderer &renderer, float deltaTime) {
+void Scene::simulate(float stepSeconds) {
   // orbit update (camera owns orbit state)
-  m_camera.orbitStep(deltaTime, 0.2);
+  m_camera.orbitStep(stepSeconds, 0.2);
+}
+
+void Scene::update(Renderer &renderer, JobSystem &jobs, float alpha) {
+  PROFILE_ZONE("Scene::update");
+
+  // TAA needs a different sub-pixel offset every frame, measured in pixels
+  // of the (possibly scaled) render target.
+  Renderer::Feedback feedback = renderer.feedback();
+  m_camera.setJitter(feedback.temporal, feedback.renderWidth,
+                     feedback.renderHeight);
 
   // Keep camera current (aspect updates on resize handled in onResize).
-  m_camera.updateMatrices();
+  m_camera.updateMatrices(alpha);
+
+  // World matrices follow the last simulation step; only the camera is
+  // interpolated.
+  m_transforms.update(jobs);
+
+  for (uint32_t index : m_entities.destroyed()) {
+    m_bvh.remove(index);
+  }
+  m_entities.clearDestroyed();
+
+  m_entities.update(m_transforms, jobs);
+  for (uint32_t a = 0; a < ArchetypeCount; ++a) {
+    if (!m_entities.refreshed((EntityArchetype)a)) {
+      continue;
+    }
+    EntityTable &table = m_entities.table((EntityArchetype)a);
+    for (uint32_t row = 0; row < table.size(); ++row) {
+      m_bvh.setBounds(table.entity[row], table.worldMin[row],
+                      table.worldMax[row]);
+    }
+  }
+  m_bvh.update(jobs);
+
+  cull(jobs);
+}
+
+void Scene::cull(JobSystem &jobs) {
+  PROFILE_ZONE("Scene::cull");
+
+  for (uint32_t index : m_visibleIds) {
+    m_visible[index] = 0;
+  }
 
-  std::memcpy(m_uboMappedList[renderer.frameIndex()], &m_camera.ubo(),
-              sizeof(CameraUBO));
+  // Main view culling: mark what the camera's frustum touches.
+  const Mat4 &viewProj = m_camera.ubo().viewProj;
+  Vec4 planes[6];
+  frustumPlanes(viewProj, planes);
+  m_visibleIds.clear();
+  m_bvh.queryFrustum(planes, m_visibleIds);
+  for (uint32_t index : m_visibleIds) {
+    if (index >= m_visible.size()) {
+      m_visible.resize(index + 1, 0);
+    }
+    m_visible[index] = 1;
+  }
+
+  m_occludedCount = 0;
+  if (!m_occlusionCulling || m_occluders.empty()) {
+    return;
+  }
+
+  // Then unmark what hides behind the occluder proxies, before anything
+  // reaches the renderer.
+  m_occlusion.begin(viewProj);
+  for (const Occluder &occluder : m_occluders) {
+    m_occlusion.addOccluder(occluder.proxy, m_transforms.world(occluder.node));
+  }
+  m_occlusion.rasterize(jobs);
+
+  std::atomic<uint32_t> occluded{0};
+  jobs.parallelFor(
+      (uint32_t)m_visibleIds.size(),
+      [this, &occluded](uint32_t begin, uint32_t end) {
+        uint32_t count = 0;
+        for (uint32_t i = begin; i < end; ++i) {
+          const uint32_t index = m_visibleIds[i];
+          Vec3 boundsMin, boundsMax;
+          m_bvh.bounds(index, boundsMin, boundsMax);
+          if (!m_occlusion.testBox(boundsMin, boundsMax)) {
+            m_visible[index] = 0;
+            ++count;
+          }
+        }
+        occluded.fetch_add(count, std::memory_order_relaxed);
+      },
+      256);
+  m_occludedCount = occluded.load(std::memory_order_relaxed);
+}
+
+void Scene::capture(RenderSnapshot &snapshot) {
+  snapshot.camera = m_camera;
+  snapshot.lights = m_lights;
+  snapshot.sunDirection = m_sunDirection;
+
+  // World matrices and bounds go straight from the entity tables into the
+  // snapshot's instance list, which the renderer reads per draw.
+  snapshot.instances.resize(m_entities.size());
+  size_t count = 0;
+  for (uint32_t a = 0; a < ArchetypeCount; ++a) {
+    EntityTable &table = m_entities.table((EntityArchetype)a);
+    for (uint32_t row = 0; row < table.size(); ++row) {
+      const uint32_t flags = table.flags[row];
+      if (flags & EntityHidden) {
+        continue;
+      }
+
+      RenderInstance &instance = snapshot.instances[count++];
+      instance.model = table.model[row];
+      instance.mesh = table.mesh[row];
+      instance.isStatic = a == ArchetypeStatic;
+      instance.castsShadows = !(flags & EntityNoShadows);
+      instance.transform = table.world[row];
+      instance.boundsMin = table.worldMin[row];
+      instance.boundsMax = table.worldMax[row];
+      const uint32_t index = table.entity[row];
+      instance.visible = index < m_visible.size() && m_visible[index];
+    }
+  }
+  snapshot.instances.resize(count);
+  snapshot.staticChanged = m_entities.staticChanged();
 }
 
 void Scene::draw(Renderer &renderer) {}
@@ -44,37 +178,113 @@ void Scene::attachCamera(Camera camera) { m_camera = camera; }
 
 Camera &Scene::camera() { return m_camera; }
 
-void Scene::addModel(Model model) { m_models.push_back(std::move(model)); }
+uint32_t Scene::addModel(Model model, bool place) {
+  m_models.push_back(std::move(model));
+  const uint32_t index = (uint32_t)m_models.size() - 1;
+  if (place) {
+    addInstance(index, m_transforms.add(Transform{}));
+  }
+  return index;
+}
 
 std::vector<Model> &Scene::models() { return m_models; }
 
+TransformHierarchy &Scene::transforms() { return m_transforms; }
+
+void Scene::addInstance(uint32_t model, uint32_t node) {
+  std::vector<Mesh> &meshes = m_models[model].meshes();
+  for (uint32_t i = 0; i < meshes.size(); ++i) {
+    EntityDesc desc;
+    desc.node = node;
+    desc.model = model;
+    desc.mesh = i;
+    desc.boundsMin = meshes[i].boundsMin();
+    desc.boundsMax = meshes[i].boundsMax();
+    desc.isStatic = m_models[model].isStatic();
+    m_entities.create(desc);
+  }
+}
+
+EntityStorage &Scene::entities() { return m_entities; }
+
+Bvh &Scene::spatialIndex() { return m_bvh; }
+
+Entity Scene::pick(Vec3 origin, Vec3 direction, float maxDistance) {
+  uint32_t index = 0;
+  float distance = 0.0f;
+  if (!m_bvh.raycast(origin, direction, maxDistance, index, distance)) {
+    return Entity{};
+  }
+  return m_entities.handle(index);
+}
+
+void Scene::addOccluder(uint32_t node, OccluderMesh proxy) {
+  m_occluders.push_back({node, std::move(proxy)});
+}
+
+void Scene::setOcclusionCulling(bool enabled) { m_occlusionCulling = enabled; }
+
+bool Scene::occlusionCulling() { return m_occlusionCulling; }
+
+uint32_t Scene::occludedCount() { return m_occludedCount; }
+
+void Scene::addLight(Light light) { m_lights.push_back(light); }
+
+std::vector<Light> &Scene::lights() { return m_lights; }
+
+void Scene::setSunDirection(Vec3 direction) {
+  m_sunDirection = normalize(direction);
+}
+
+Vec3 Scene::sunDirection() { return m_sunDirection; }
+
 VkPipelineLayout *Scene::pipelineLayout() { return &m_pipelineLayout; }
 
 VkPipeline *Scene::pipeline() { return &m_pipeline; }
 
+VkPipeline *Scene::pulledPipeline() { return &m_pulledPipeline; }
+
+VkPipeline *Scene::depthPipeline() { return &m_depthPipeline; }
+
+VkPipeline *Scene::pulledDepthPipeline() { return &m_pulledDepthPipeline; }
+
+VkPipeline *Scene::shadowPipeline() { return &m_shadowPipeline; }
+
+VkPipeline *Scene::pulledShadowPipeline() { return &m_pulledShadowPipeline; }
+
+GeometryBuffer *Scene::geometry() { return &m_geometry; }
+
 VkDescriptorSetLayout *Scene::descriptorSetLayout() {
   return &m_descriptorSetLayout;
 }
 
 VkDescriptorPool *Scene::descriptorPool() { return &m_descriptorPool; };
 
-std::array<VkDescriptorSet, FRAME_COUNT> *Scene::descriptorSets() {
+std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> *Scene::descriptorSets() {
   return &m_DescriptorSets;
 }
 
-std::array<VkBuffer, FRAME_COUNT> *Scene::uboBufferList() {
+std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> *Scene::uboBufferList() {
   return &m_uboBufferList;
 }
 
-std::array<VkDeviceMemory, FRAME_COUNT> *Scene::uboMemoryList() {
+std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> *Scene::uboMemoryList() {
   return &m_uboMemoryList;
 }
 
-std::array<void *, FRAME_COUNT> *Scene::uboMappedList() {
+std::array<void *, MAX_FRAMES_IN_FLIGHT> *Scene::uboMappedList() {
   return &m_uboMappedList;
 }
 
-void Scene::shutdown() {
+void Scene::shutdown(Renderer &renderer) {
+  auto device = renderer.device();
+  if (!device) {
+    return;
+  }
+
+  vkDeviceWaitIdle(device);
+
   // m_destroyPipeline();
   // destroyResources();
+  m_geometry.shutdown(device);
 }
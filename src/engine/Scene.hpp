@@ -1,9 +1,15 @@
 #pragma once
 
+#include "Bvh.hpp"
 #include "Camera.hpp"
 #include "Constants.hpp"
+#include "Entities.hpp"
+#include "Geometry.hpp"
+#include "Lighting.hpp"
 #include "Mesh.hpp"
 #include "Model.hpp"
+#include "Occlusion.hpp"
+#include "Snapshot.hpp"
 #include "Transform.hpp"
 #include "Vertex.hpp"
 
@@ -14,7 +20,8 @@
 #include <functional>
 #include <vector>
 
-class Renderer; // forward declaration
+class JobSystem; // forward declaration
+class Renderer;  // forward declaration
 
 class Scene {
 public:
@@ -24,7 +31,15 @@ public:
   void init(Renderer &renderer, Camera camera, std::vector<Model> models,
             std::function<void(Renderer &, Scene *)> createPipeline,
             std::function<void(Renderer &, Scene *)> destroyPipeline);
-  void update(Renderer &renderer, float deltaTime);
+  // Advances the simulation by one fixed step.
+  void simulate(float stepSeconds);
+  // Once per rendered frame. alpha is how far the frame falls between the
+  // last two simulation steps. Brings world transforms, entity bounds and
+  // the spatial index up to date, spread over jobs, then culls entities
+  // outside the camera's frustum or behind occluders.
+  void update(Renderer &renderer, JobSystem &jobs, float alpha);
+  // Copies what the renderer needs for this frame into snapshot.
+  void capture(RenderSnapshot &snapshot);
   void draw(Renderer &renderer);
   void createPipeline(Renderer &renderer);
   void destroyPipeline(Renderer &renderer);
@@ -33,40 +48,109 @@ public:
   void attachCamera(Camera camera);
   Camera &camera();
 
-  void addModel(Model model);
+  // Returns the model's index, for addInstance(). Unless place is false
+  // the model is also placed once, at a new root node.
+  uint32_t addModel(Model model, bool place = true);
   std::vector<Model> &models();
 
+  TransformHierarchy &transforms();
+  // Places model at node: one entity per mesh, static if the model is.
+  void addInstance(uint32_t model, uint32_t node);
+  // What the scene draws, one entity per placed mesh.
+  EntityStorage &entities();
+
+  // Entity world bounds, kept up to date by update(); ids are entity
+  // indices.
+  Bvh &spatialIndex();
+  // First entity whose bounds the ray enters, or an invalid handle.
+  Entity pick(Vec3 origin, Vec3 direction, float maxDistance = 1.0e30f);
+
+  // proxy, placed at node, is rasterized into the CPU occlusion buffer
+  // every frame. It must lie inside the geometry it stands for.
+  void addOccluder(uint32_t node, OccluderMesh proxy);
+  void setOcclusionCulling(bool enabled);
+  bool occlusionCulling();
+  // Entities in the frustum that the last update() found hidden.
+  uint32_t occludedCount();
+
+  // Point and spot lights, binned into clusters by the renderer every frame.
+  void addLight(Light light);
+  std::vector<Light> &lights();
+
+  // Direction the directional (sun) light travels; casts cascaded shadows.
+  void setSunDirection(Vec3 direction);
+  Vec3 sunDirection();
+
   VkPipelineLayout *pipelineLayout();
   VkPipeline *pipeline();
+  VkPipeline *pulledPipeline();
+  VkPipeline *depthPipeline();
+  VkPipeline *pulledDepthPipeline();
+  VkPipeline *shadowPipeline();
+  VkPipeline *pulledShadowPipeline();
+
+  GeometryBuffer *geometry();
 
   VkDescriptorSetLayout *descriptorSetLayout();
   VkDescriptorPool *descriptorPool();
-  std::array<VkDescriptorSet, FRAME_COUNT> *descriptorSets();
+  std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> *descriptorSets();
 
-  std::array<VkBuffer, FRAME_COUNT> *uboBufferList();
-  std::array<VkDeviceMemory, FRAME_COUNT> *uboMemoryList();
-  std::array<void *, FRAME_COUNT> *uboMappedList();
+  std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> *uboBufferList();
+  std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> *uboMemoryList();
+  std::array<void *, MAX_FRAMES_IN_FLIGHT> *uboMappedList();
 
-  void shutdown();
+  void shutdown(Renderer &renderer);
 
 private:
   Camera m_camera;
   std::vector<Model> m_models;
-
-  // Pipeline
+  TransformHierarchy m_transforms;
+  EntityStorage m_entities;
+  Bvh m_bvh;
+  // Main view culling results: ids in the frustum, and by entity index
+  // whether they survived occlusion culling too.
+  std::vector<uint32_t> m_visibleIds;
+  std::vector<uint8_t> m_visible;
+
+  struct Occluder {
+    uint32_t node = 0;
+    OccluderMesh proxy;
+  };
+  std::vector<Occluder> m_occluders;
+  OcclusionBuffer m_occlusion;
+  bool m_occlusionCulling = true;
+  uint32_t m_occludedCount = 0;
+  std::vector<Light> m_lights;
+  Vec3 m_sunDirection = normalize({-0.3f, -1.0f, -0.2f});
+
+  // Pipeline (the layout is shared by the fixed-function and pulled variants)
   VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
   VkPipeline m_pipeline = VK_NULL_HANDLE;
+  VkPipeline m_pulledPipeline = VK_NULL_HANDLE;
+
+  // Position-only, no fragment stage (depth pre-pass subpass)
+  VkPipeline m_depthPipeline = VK_NULL_HANDLE;
+  VkPipeline m_pulledDepthPipeline = VK_NULL_HANDLE;
+
+  // Position-only casters into the renderer's shadow render pass
+  VkPipeline m_shadowPipeline = VK_NULL_HANDLE;
+  VkPipeline m_pulledShadowPipeline = VK_NULL_HANDLE;
+
+  // Shared vertex/index storage for the vertex pulling path (set 1)
+  GeometryBuffer m_geometry;
 
   // Descriptors (set 0 = per-frame camera)
   VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
   VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
-  std::array<VkDescriptorSet, FRAME_COUNT> m_DescriptorSets{};
+  std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> m_DescriptorSets{};
 
   // Uniform buffers (one per frame-in-flight)
-  std::array<VkBuffer, FRAME_COUNT> m_uboBufferList{};
-  std::array<VkDeviceMemory, FRAME_COUNT> m_uboMemoryList{};
-  std::array<void *, FRAME_COUNT> m_uboMappedList{};
+  std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> m_uboBufferList{};
+  std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> m_uboMemoryList{};
+  std::array<void *, MAX_FRAMES_IN_FLIGHT> m_uboMappedList{};
 
   std::function<void(Renderer &, Scene *)> m_createPipeline;
   std::function<void(Renderer &, Scene *)> m_destroyPipeline;
+
+  void cull(JobSystem &jobs);
 };
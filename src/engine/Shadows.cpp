@@ -0,0 +1,547 @@
+#include "../Vulkan.hpp"
+
+#include "Shadows.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// Cascades cover [zNear, kShadowDistance]; beyond that nothing is shadowed.
+static constexpr float kShadowDistance = 60.0f;
+// Blend between logarithmic (1) and uniform (0) split placement.
+static constexpr float kSplitLambda = 0.75f;
+// Extra depth toward the light so casters outside the view still shadow it.
+static constexpr float kCasterExtension = 50.0f;
+
+void CascadedShadows::init(VkPhysicalDevice physicalDevice, VkDevice device) {
+  createImage(physicalDevice, device);
+  createRenderPass(device);
+  createDescriptors(physicalDevice, device);
+
+  for (uint32_t c = 0; c < kCascadeCount; ++c) {
+    VkFramebufferCreateInfo framebufferCreateInfo{
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+    framebufferCreateInfo.renderPass = m_renderPass;
+    framebufferCreateInfo.attachmentCount = 1;
+    framebufferCreateInfo.pAttachments = &m_layerViews[c];
+    framebufferCreateInfo.width = kShadowMapSize;
+    framebufferCreateInfo.height = kShadowMapSize;
+    framebufferCreateInfo.layers = 1;
+
+    if (vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr,
+                            &m_framebuffers[c]) != VK_SUCCESS) {
+      std::cerr << "vkCreateFramebuffer failed for shadow cascade"
+                << std::endl;
+      std::abort();
+    }
+  }
+
+  m_valid = false;
+}
+
+void CascadedShadows::update(int frameIndex, const Camera &camera,
+                             Vec3 lightDirection) {
+  Vec3 direction = normalize(lightDirection);
+
+  const bool lightMoved =
+      !m_valid || dot(direction, m_lightDirection) < 0.99999f;
+  if (lightMoved) {
+    Vec3 up = std::fabs(direction.y) > 0.99f ? Vec3{0.0f, 0.0f, 1.0f}
+                                             : Vec3{0.0f, 1.0f, 0.0f};
+    m_lightDirection = direction;
+    m_lightRotation = lookAtRH({0.0f, 0.0f, 0.0f}, direction, up);
+  }
+
+  // Practical split scheme over the shadowed range.
+  const float zNear = camera.zNear();
+  const float shadowDistance = std::min(camera.zFar(), kShadowDistance);
+
+  float splits[kCascadeCount];
+  for (uint32_t c = 0; c < kCascadeCount; ++c) {
+    float p = (float)(c + 1) / (float)kCascadeCount;
+    float logSplit = zNear * std::pow(shadowDistance / zNear, p);
+    float uniformSplit = zNear + (shadowDistance - zNear) * p;
+    splits[c] = kSplitLambda * logSplit + (1.0f - kSplitLambda) * uniformSplit;
+  }
+
+  const Mat4 invView = inverse(camera.ubo().view);
+  const float tanHalfFovy = std::tan(camera.fovy() * 0.5f);
+  const float aspect = camera.aspect();
+
+  float sliceNear = zNear;
+  for (uint32_t c = 0; c < kCascadeCount; ++c) {
+    float sliceFar = splits[c];
+
+    // World-space corners of this slice of the view frustum.
+    Vec3 corners[8];
+    int corner = 0;
+    for (float d : {sliceNear, sliceFar}) {
+      float halfH = d * tanHalfFovy;
+      float halfW = halfH * aspect;
+      for (float sy : {-1.0f, 1.0f}) {
+        for (float sx : {-1.0f, 1.0f}) {
+          corners[corner++] =
+              transformPoint(invView, {sx * halfW, sy * halfH, -d});
+        }
+      }
+    }
+
+    // Bounding sphere keeps the cascade size constant under rotation, which
+    // is what makes texel snapping stable.
+    Vec3 center{};
+    for (const Vec3 &p : corners) {
+      center = add(center, p);
+    }
+    center = mul(center, 1.0f / 8.0f);
+
+    float radius = 0.0f;
+    for (const Vec3 &p : corners) {
+      radius = std::max(radius, length(sub(p, center)));
+    }
+    radius = std::ceil(radius * 16.0f) / 16.0f;
+
+    const bool isCached = c >= kFirstCachedCascade;
+    if (isCached) {
+      // Pad cached cascades so they still cover the slice while the camera
+      // drifts up to the movement threshold.
+      float texel = 2.0f * radius / (float)kShadowMapSize;
+      radius += kCacheMoveTexels * texel;
+    }
+
+    const float texel = 2.0f * radius / (float)kShadowMapSize;
+
+    Vec3 centerLS = transformPoint(m_lightRotation, center);
+    centerLS.x = std::floor(centerLS.x / texel) * texel;
+    centerLS.y = std::floor(centerLS.y / texel) * texel;
+
+    bool render = !isCached || lightMoved;
+    if (!render) {
+      const float threshold = kCacheMoveTexels * texel;
+      render = std::fabs(centerLS.x - m_centers[c].x) > threshold ||
+               std::fabs(centerLS.y - m_centers[c].y) > threshold ||
+               std::fabs(centerLS.z - m_centers[c].z) > threshold ||
+               std::fabs(radius - m_radii[c]) > texel;
+    }
+
+    m_render[c] = render;
+
+    if (render) {
+      m_centers[c] = centerLS;
+      m_radii[c] = radius;
+
+      Mat4 proj = orthoRH(centerLS.x - radius, centerLS.x + radius,
+                          centerLS.y - radius, centerLS.y + radius,
+                          -(centerLS.z + radius + kCasterExtension),
+                          -(centerLS.z - radius));
+      m_params.lightViewProj[c] = mul(proj, m_lightRotation);
+    }
+
+    sliceNear = sliceFar;
+  }
+
+  m_params.splits = {splits[0], splits[1], splits[2], splits[3]};
+  m_params.lightDir = {m_lightDirection.x, m_lightDirection.y,
+                       m_lightDirection.z, 0.0f};
+  m_valid = true;
+
+  std::memcpy(m_paramsMapped[frameIndex], &m_params, sizeof(ShadowParams));
+}
+
+void CascadedShadows::invalidate() { m_valid = false; }
+
+bool CascadedShadows::needsRender(uint32_t cascade) {
+  return m_render[cascade];
+}
+
+bool CascadedShadows::cached(uint32_t cascade) {
+  return cascade >= kFirstCachedCascade;
+}
+
+bool CascadedShadows::castsInto(uint32_t cascade, Vec3 boundsMin,
+                                Vec3 boundsMax) {
+  Vec3 center = mul(add(boundsMin, boundsMax), 0.5f);
+  float sphereRadius = length(sub(boundsMax, boundsMin)) * 0.5f;
+
+  Vec3 centerLS = transformPoint(m_lightRotation, center);
+  const Vec3 &cascadeLS = m_centers[cascade];
+  const float reach = m_radii[cascade] + sphereRadius;
+
+  if (std::fabs(centerLS.x - cascadeLS.x) > reach ||
+      std::fabs(centerLS.y - cascadeLS.y) > reach) {
+    return false;
+  }
+
+  // Entirely behind the cascade (farther from the light) casts nothing into
+  // it; anything toward the light may.
+  if (centerLS.z + sphereRadius < cascadeLS.z - m_radii[cascade]) {
+    return false;
+  }
+
+  return true;
+}
+
+void CascadedShadows::beginCascade(VkCommandBuffer commandBuffer,
+                                   uint32_t cascade) {
+  VkClearValue clear{};
+  clear.depthStencil.depth = 1.0f;
+  clear.depthStencil.stencil = 0;
+
+  VkRenderPassBeginInfo renderPassBeginInfo{
+      VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+  renderPassBeginInfo.renderPass = m_renderPass;
+  renderPassBeginInfo.framebuffer = m_framebuffers[cascade];
+  renderPassBeginInfo.renderArea.offset = {0, 0};
+  renderPassBeginInfo.renderArea.extent = {kShadowMapSize, kShadowMapSize};
+  renderPassBeginInfo.clearValueCount = 1;
+  renderPassBeginInfo.pClearValues = &clear;
+
+  vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo,
+                       VK_SUBPASS_CONTENTS_INLINE);
+
+  VkViewport viewport{};
+  viewport.width = (float)kShadowMapSize;
+  viewport.height = (float)kShadowMapSize;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+  VkRect2D scissor{};
+  scissor.extent = {kShadowMapSize, kShadowMapSize};
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void CascadedShadows::endCascade(VkCommandBuffer commandBuffer) {
+  vkCmdEndRenderPass(commandBuffer);
+}
+
+VkImage CascadedShadows::image() { return m_image; }
+
+VkRenderPass CascadedShadows::renderPass() { return m_renderPass; }
+
+VkDescriptorSetLayout CascadedShadows::descriptorSetLayout() {
+  return m_descriptorSetLayout;
+}
+
+VkDescriptorSet CascadedShadows::descriptorSet(int frameIndex) {
+  return m_descriptorSets[frameIndex];
+}
+
+void CascadedShadows::createImage(VkPhysicalDevice physicalDevice,
+                                  VkDevice device) {
+  VkImageCreateInfo imageCreateInfo{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+  imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageCreateInfo.extent = {kShadowMapSize, kShadowMapSize, 1};
+  imageCreateInfo.mipLevels = 1;
+  imageCreateInfo.arrayLayers = kCascadeCount;
+  imageCreateInfo.format = m_format;
+  imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                          VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if (vkCreateImage(device, &imageCreateInfo, nullptr, &m_image) !=
+      VK_SUCCESS) {
+    std::cerr << "Failed to create shadow map image" << std::endl;
+    std::abort();
+  }
+
+  VkMemoryRequirements memoryRequirements{};
+  vkGetImageMemoryRequirements(device, m_image, &memoryRequirements);
+
+  VkMemoryAllocateInfo memoryAllocateInfo{
+      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+  memoryAllocateInfo.allocationSize = memoryRequirements.size;
+  memoryAllocateInfo.memoryTypeIndex =
+      FindMemoryType(physicalDevice, memoryRequirements.memoryTypeBits,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  if (memoryAllocateInfo.memoryTypeIndex == UINT32_MAX ||
+      vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &m_memory) !=
+          VK_SUCCESS) {
+    std::cerr << "Failed to allocate shadow map memory" << std::endl;
+    std::abort();
+  }
+
+  vkBindImageMemory(device, m_image, m_memory, 0);
+
+  VkImageViewCreateInfo imageViewCreateInfo{
+      VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+  imageViewCreateInfo.image = m_image;
+  imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+  imageViewCreateInfo.format = m_format;
+  imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+  imageViewCreateInfo.subresourceRange.levelCount = 1;
+  imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+  imageViewCreateInfo.subresourceRange.layerCount = kCascadeCount;
+
+  if (vkCreateImageView(device, &imageViewCreateInfo, nullptr,
+                        &m_arrayView) != VK_SUCCESS) {
+    std::cerr << "Failed to create shadow map array view" << std::endl;
+    std::abort();
+  }
+
+  imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  imageViewCreateInfo.subresourceRange.layerCount = 1;
+  for (uint32_t c = 0; c < kCascadeCount; ++c) {
+    imageViewCreateInfo.subresourceRange.baseArrayLayer = c;
+    if (vkCreateImageView(device, &imageViewCreateInfo, nullptr,
+                          &m_layerViews[c]) != VK_SUCCESS) {
+      std::cerr << "Failed to create shadow cascade view" << std::endl;
+      std::abort();
+    }
+  }
+
+  VkSamplerCreateInfo samplerCreateInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+  samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+  samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+  samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+  samplerCreateInfo.compareEnable = VK_TRUE;
+  samplerCreateInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  samplerCreateInfo.maxLod = 0.0f;
+
+  if (vkCreateSampler(device, &samplerCreateInfo, nullptr, &m_sampler) !=
+      VK_SUCCESS) {
+    std::cerr << "Failed to create shadow sampler" << std::endl;
+    std::abort();
+  }
+}
+
+void CascadedShadows::createRenderPass(VkDevice device) {
+  VkAttachmentDescription depthDescription{};
+  depthDescription.format = m_format;
+  depthDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+  depthDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  depthDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depthDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  depthDescription.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+  VkAttachmentReference depthReference{
+      0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.pDepthStencilAttachment = &depthReference;
+
+  VkSubpassDependency subpassDependencies[2]{};
+  // Previous frame's shading may still be sampling this layer.
+  subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  subpassDependencies[0].dstSubpass = 0;
+  subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  subpassDependencies[0].dstStageMask =
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  subpassDependencies[0].srcAccessMask = 0;
+  subpassDependencies[0].dstAccessMask =
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  // Shading samples the result.
+  subpassDependencies[1].srcSubpass = 0;
+  subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+  subpassDependencies[1].srcStageMask =
+      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  subpassDependencies[1].srcAccessMask =
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  subpassDependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  VkRenderPassCreateInfo renderPassCreateInfo{
+      VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+  renderPassCreateInfo.attachmentCount = 1;
+  renderPassCreateInfo.pAttachments = &depthDescription;
+  renderPassCreateInfo.subpassCount = 1;
+  renderPassCreateInfo.pSubpasses = &subpass;
+  renderPassCreateInfo.dependencyCount = 2;
+  renderPassCreateInfo.pDependencies = subpassDependencies;
+
+  if (vkCreateRenderPass(device, &renderPassCreateInfo, nullptr,
+                         &m_renderPass) != VK_SUCCESS) {
+    std::cerr << "vkCreateRenderPass failed for shadows" << std::endl;
+    std::abort();
+  }
+}
+
+void CascadedShadows::createDescriptors(VkPhysicalDevice physicalDevice,
+                                        VkDevice device) {
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    if (!CreateBuffer(physicalDevice, device, sizeof(ShadowParams),
+                      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                      m_paramsBuffers[i], m_paramsMemory[i])) {
+      std::cerr << "Failed to create shadow params buffer" << std::endl;
+      std::abort();
+    }
+
+    vkMapMemory(device, m_paramsMemory[i], 0, sizeof(ShadowParams), 0,
+                &m_paramsMapped[i]);
+  }
+
+  // binding 0 = cascade matrices/splits, 1 = shadow map (compare sampler).
+  VkDescriptorSetLayoutBinding descriptorSetLayoutBindings[2]{};
+  descriptorSetLayoutBindings[0].binding = 0;
+  descriptorSetLayoutBindings[0].descriptorType =
+      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  descriptorSetLayoutBindings[0].descriptorCount = 1;
+  descriptorSetLayoutBindings[0].stageFlags =
+      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+  descriptorSetLayoutBindings[1].binding = 1;
+  descriptorSetLayoutBindings[1].descriptorType =
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorSetLayoutBindings[1].descriptorCount = 1;
+  descriptorSetLayoutBindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+  descriptorSetLayoutCreateInfo.bindingCount = 2;
+  descriptorSetLayoutCreateInfo.pBindings = descriptorSetLayoutBindings;
+
+  if (vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo,
+                                  nullptr,
+                                  &m_descriptorSetLayout) != VK_SUCCESS) {
+    std::cerr << "vkCreateDescriptorSetLayout failed for shadows" << std::endl;
+    std::abort();
+  }
+
+  VkDescriptorPoolSize descriptorPoolSizes[2]{};
+  descriptorPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  descriptorPoolSizes[0].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+  descriptorPoolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorPoolSizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+
+  VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+  descriptorPoolCreateInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+  descriptorPoolCreateInfo.poolSizeCount = 2;
+  descriptorPoolCreateInfo.pPoolSizes = descriptorPoolSizes;
+
+  if (vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr,
+                             &m_descriptorPool) != VK_SUCCESS) {
+    std::cerr << "vkCreateDescriptorPool failed for shadows" << std::endl;
+    std::abort();
+  }
+
+  std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> descriptorSetLayouts;
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    descriptorSetLayouts[i] = m_descriptorSetLayout;
+  }
+
+  VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+  descriptorSetAllocateInfo.descriptorPool = m_descriptorPool;
+  descriptorSetAllocateInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+  descriptorSetAllocateInfo.pSetLayouts = descriptorSetLayouts.data();
+
+  if (vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
+                               m_descriptorSets.data()) != VK_SUCCESS) {
+    std::cerr << "vkAllocateDescriptorSets failed for shadows" << std::endl;
+    std::abort();
+  }
+
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    VkDescriptorBufferInfo descriptorBufferInfo{};
+    descriptorBufferInfo.buffer = m_paramsBuffers[i];
+    descriptorBufferInfo.offset = 0;
+    descriptorBufferInfo.range = sizeof(ShadowParams);
+
+    VkDescriptorImageInfo descriptorImageInfo{};
+    descriptorImageInfo.sampler = m_sampler;
+    descriptorImageInfo.imageView = m_arrayView;
+    descriptorImageInfo.imageLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet writeDescriptorSets[2]{};
+    writeDescriptorSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeDescriptorSets[0].dstSet = m_descriptorSets[i];
+    writeDescriptorSets[0].dstBinding = 0;
+    writeDescriptorSets[0].descriptorCount = 1;
+    writeDescriptorSets[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    writeDescriptorSets[0].pBufferInfo = &descriptorBufferInfo;
+    writeDescriptorSets[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeDescriptorSets[1].dstSet = m_descriptorSets[i];
+    writeDescriptorSets[1].dstBinding = 1;
+    writeDescriptorSets[1].descriptorCount = 1;
+    writeDescriptorSets[1].descriptorType =
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writeDescriptorSets[1].pImageInfo = &descriptorImageInfo;
+
+    vkUpdateDescriptorSets(device, 2, writeDescriptorSets, 0, nullptr);
+  }
+}
+
+void CascadedShadows::shutdown(VkDevice device) {
+  if (!device) {
+    return;
+  }
+
+  for (uint32_t c = 0; c < kCascadeCount; ++c) {
+    if (m_framebuffers[c]) {
+      vkDestroyFramebuffer(device, m_framebuffers[c], nullptr);
+      m_framebuffers[c] = VK_NULL_HANDLE;
+    }
+    if (m_layerViews[c]) {
+      vkDestroyImageView(device, m_layerViews[c], nullptr);
+      m_layerViews[c] = VK_NULL_HANDLE;
+    }
+  }
+
+  if (m_renderPass) {
+    vkDestroyRenderPass(device, m_renderPass, nullptr);
+    m_renderPass = VK_NULL_HANDLE;
+  }
+
+  if (m_sampler) {
+    vkDestroySampler(device, m_sampler, nullptr);
+    m_sampler = VK_NULL_HANDLE;
+  }
+
+  if (m_arrayView) {
+    vkDestroyImageView(device, m_arrayView, nullptr);
+    m_arrayView = VK_NULL_HANDLE;
+  }
+
+  if (m_image) {
+    vkDestroyImage(device, m_image, nullptr);
+    m_image = VK_NULL_HANDLE;
+  }
+
+  if (m_memory) {
+    vkFreeMemory(device, m_memory, nullptr);
+    m_memory = VK_NULL_HANDLE;
+  }
+
+  if (m_descriptorPool) {
+    vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+    m_descriptorPool = VK_NULL_HANDLE;
+    m_descriptorSets = {};
+  }
+
+  if (m_descriptorSetLayout) {
+    vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+    m_descriptorSetLayout = VK_NULL_HANDLE;
+  }
+
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    if (m_paramsMapped[i]) {
+      vkUnmapMemory(device, m_paramsMemory[i]);
+      m_paramsMapped[i] = nullptr;
+    }
+    if (m_paramsBuffers[i]) {
+      vkDestroyBuffer(device, m_paramsBuffers[i], nullptr);
+      m_paramsBuffers[i] = VK_NULL_HANDLE;
+    }
+    if (m_paramsMemory[i]) {
+      vkFreeMemory(device, m_paramsMemory[i], nullptr);
+      m_paramsMemory[i] = VK_NULL_HANDLE;
+    }
+  }
+}
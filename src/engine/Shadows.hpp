@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Camera.hpp"
+#include "Constants.hpp"
+#include "Math.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+
+static constexpr uint32_t kCascadeCount = 4;
+static constexpr uint32_t kShadowMapSize = 2048;
+
+// Cascades from this index on hold static casters only and are re-rendered
+// only when invalidated (light moved, or the camera moved far enough that the
+// texel-snapped cascade center shifted by more than kCacheMoveTexels).
+static constexpr uint32_t kFirstCachedCascade = 2;
+static constexpr float kCacheMoveTexels = 16.0f;
+
+// Matches `ShadowParams` in shaders/shadows.glsl (std140).
+struct ShadowParams {
+  Mat4 lightViewProj[kCascadeCount];
+  Vec4 splits;   // view distance where each cascade ends
+  Vec4 lightDir; // xyz direction the light travels
+};
+
+// Cascaded shadow maps for the scene's directional light: one D32 array
+// image (a layer per cascade), a depth-only render pass, and the shadow set
+// (set 3) that carries the cascade matrices and the comparison sampler.
+class CascadedShadows {
+public:
+  CascadedShadows() = default;
+  ~CascadedShadows() = default;
+
+  void init(VkPhysicalDevice physicalDevice, VkDevice device);
+
+  // Fits cascades to the camera frustum, decides which ones need rendering
+  // this frame and uploads the matrices for this frame in flight.
+  void update(int frameIndex, const Camera &camera, Vec3 lightDirection);
+
+  // Forces every cascade to re-render next update.
+  void invalidate();
+
+  bool needsRender(uint32_t cascade);
+  bool cached(uint32_t cascade);
+  // Conservative caster test of a world-space AABB against a cascade volume.
+  bool castsInto(uint32_t cascade, Vec3 boundsMin, Vec3 boundsMax);
+
+  void beginCascade(VkCommandBuffer commandBuffer, uint32_t cascade);
+  void endCascade(VkCommandBuffer commandBuffer);
+
+  VkImage image();
+  VkRenderPass renderPass();
+  VkDescriptorSetLayout descriptorSetLayout();
+  VkDescriptorSet descriptorSet(int frameIndex);
+
+  void shutdown(VkDevice device);
+
+private:
+  VkFormat m_format = VK_FORMAT_D32_SFLOAT;
+
+  VkImage m_image = VK_NULL_HANDLE;
+  VkDeviceMemory m_memory = VK_NULL_HANDLE;
+  VkImageView m_arrayView = VK_NULL_HANDLE;
+  std::array<VkImageView, kCascadeCount> m_layerViews{};
+  std::array<VkFramebuffer, kCascadeCount> m_framebuffers{};
+  VkSampler m_sampler = VK_NULL_HANDLE;
+
+  VkRenderPass m_renderPass = VK_NULL_HANDLE;
+
+  VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+  VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+  std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> m_descriptorSets{};
+
+  std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> m_paramsBuffers{};
+  std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> m_paramsMemory{};
+  std::array<void *, MAX_FRAMES_IN_FLIGHT> m_paramsMapped{};
+
+  // Matrices the cascade contents were rendered with; cached cascades keep
+  // sampling with the matrix they were last rendered with.
+  ShadowParams m_params{};
+  std::array<Vec3, kCascadeCount> m_centers{};  // light space, texel-snapped
+  std::array<float, kCascadeCount> m_radii{};
+  std::array<bool, kCascadeCount> m_render{};
+  Vec3 m_lightDirection{0.0f, 0.0f, 0.0f};
+  Mat4 m_lightRotation{};
+  bool m_valid = false;
+
+  void createImage(VkPhysicalDevice physicalDevice, VkDevice device);
+  void createRenderPass(VkDevice device);
+  void createDescriptors(VkPhysicalDevice physicalDevice, VkDevice device);
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Camera.hpp"
+#include "Lighting.hpp"
+#include "Math.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class Renderer; // forward declaration
+
+// One mesh to draw, as the simulation left it this frame.
+struct RenderInstance {
+  uint32_t model = 0; // index into Scene::models()
+  uint32_t mesh = 0;  // index into the model's meshes
+  bool isStatic = true;
+  bool castsShadows = true;
+  bool visible = true; // in the main view frustum and not occluded
+  Mat4 transform{};
+  // World space.
+  Vec3 boundsMin{};
+  Vec3 boundsMax{};
+};
+
+// Everything the renderer reads about a frame, copied out of the simulation
+// so the render thread never touches live Scene state. Filled by the main
+// thread, then read-only until the render thread hands the buffer back.
+struct RenderSnapshot {
+  uint64_t frame = 0;
+  float deltaTime = 0.0f;
+  // When input for this frame was sampled; latency is measured from here.
+  std::chrono::steady_clock::time_point inputTime{};
+
+  Camera camera;
+  std::vector<Light> lights;
+  Vec3 sunDirection{};
+  std::vector<RenderInstance> instances;
+  // The static instances differ from the previous snapshot's, so the cached
+  // shadow cascades are stale.
+  bool staticChanged = false;
+
+  // Renderer setting changes from input handling, applied on the render
+  // thread before the frame is drawn.
+  std::vector<std::function<void(Renderer &)>> commands;
+};
@@ -0,0 +1,120 @@
+#include "Telemetry.hpp"
+
+#include "Log.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Frames before the median is trusted for hitch detection.
+static constexpr uint32_t kWarmupFrames = 120;
+// Lines between flushes; hitches flush immediately.
+static constexpr uint32_t kFlushLines = 60;
+
+Telemetry::~Telemetry() { close(); }
+
+bool Telemetry::open(const std::string &path) {
+  close();
+
+  m_file = std::fopen(path.c_str(), "wb");
+  if (!m_file) {
+    Log::error("Telemetry: cannot open %s", path.c_str());
+    return false;
+  }
+
+  Log::info("Telemetry: writing to %s", path.c_str());
+  return true;
+}
+
+bool Telemetry::opened() { return m_file != nullptr; }
+
+void Telemetry::close() {
+  if (m_file) {
+    std::fclose(m_file);
+    m_file = nullptr;
+  }
+}
+
+void Telemetry::setHitchMultiple(float multiple) {
+  m_hitchMultiple = std::max(multiple, 0.0f);
+}
+
+float Telemetry::hitchMultiple() { return m_hitchMultiple; }
+
+bool Telemetry::record(const FrameTelemetry &frame) {
+  // Judge against the window before this frame joins it.
+  const float median = percentile(0.5f);
+  const bool hitch = m_hitchMultiple > 0.0f &&
+                     m_windowCount >= kWarmupFrames &&
+                     frame.frameMilliseconds > median * m_hitchMultiple;
+
+  if (m_windowCount == kWindowFrames) {
+    --m_buckets[bucket(m_window[m_windowNext])];
+  } else {
+    ++m_windowCount;
+  }
+  m_window[m_windowNext] = frame.frameMilliseconds;
+  ++m_buckets[bucket(frame.frameMilliseconds)];
+  m_windowNext = (m_windowNext + 1) % kWindowFrames;
+
+  if (!m_file) {
+    return hitch;
+  }
+
+  std::fprintf(m_file,
+               "{\"frame\":%llu,\"frameMs\":%.3f,\"cpuMs\":%.3f,"
+               "\"simulationMs\":%.3f,\"renderMs\":%.3f,\"gpuMs\":%.3f,"
+               "\"waitMs\":%.3f,\"acquireMs\":%.3f,\"drawCalls\":%u,"
+               "\"triangles\":%llu,\"gpuMemoryMB\":%.1f,\"p50\":%.1f,"
+               "\"p99\":%.1f,\"max\":%.3f,\"hitch\":%s}\n",
+               (unsigned long long)frame.frame, frame.frameMilliseconds,
+               frame.simulationMilliseconds + frame.renderMilliseconds,
+               frame.simulationMilliseconds, frame.renderMilliseconds,
+               frame.gpuMilliseconds, frame.waitMilliseconds,
+               frame.acquireMilliseconds, frame.drawCalls,
+               (unsigned long long)frame.triangles,
+               (double)frame.gpuMemoryBytes / (1024.0 * 1024.0),
+               percentile(0.5f), percentile(0.99f), maxMilliseconds(),
+               hitch ? "true" : "false");
+
+  if (hitch || ++m_linesSinceFlush >= kFlushLines) {
+    std::fflush(m_file);
+    m_linesSinceFlush = 0;
+  }
+
+  return hitch;
+}
+
+float Telemetry::percentile(float fraction) {
+  if (m_windowCount == 0) {
+    return 0.0f;
+  }
+
+  const uint32_t rank = std::min(
+      m_windowCount - 1,
+      (uint32_t)std::ceil(std::clamp(fraction, 0.0f, 1.0f) * m_windowCount));
+  uint32_t seen = 0;
+  for (uint32_t i = 0; i < kBucketCount; ++i) {
+    seen += m_buckets[i];
+    if (seen > rank) {
+      // Upper edge, so a steady frame time never reads as below itself.
+      return (float)(i + 1) * kBucketMilliseconds;
+    }
+  }
+  return (float)kBucketCount * kBucketMilliseconds;
+}
+
+float Telemetry::maxMilliseconds() {
+  float result = 0.0f;
+  for (uint32_t i = 0; i < m_windowCount; ++i) {
+    result = std::max(result, m_window[i]);
+  }
+  return result;
+}
+
+uint32_t Telemetry::bucket(float milliseconds) {
+  if (!(milliseconds > 0.0f)) {
+    return 0;
+  }
+  return std::min(kBucketCount - 1,
+                  (uint32_t)(milliseconds / kBucketMilliseconds));
+}
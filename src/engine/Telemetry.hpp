@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// One line of the telemetry stream.
+struct FrameTelemetry {
+  uint64_t frame = 0;
+  float frameMilliseconds = 0.0f;      // wall time since the previous frame
+  float simulationMilliseconds = 0.0f; // main thread, input to snapshot
+  float renderMilliseconds = 0.0f;     // recording and submission
+  float gpuMilliseconds = 0.0f;
+  float waitMilliseconds = 0.0f; // frame slot (timeline) waits
+  float acquireMilliseconds = 0.0f;
+  uint32_t drawCalls = 0;
+  uint64_t triangles = 0;
+  uint64_t gpuMemoryBytes = 0; // 0 when the driver cannot tell
+};
+
+// Per-frame stats as JSON lines, plus a rolling frame time histogram over
+// the last kWindowFrames frames for percentiles and hitch detection. The
+// path may be a file or, on Windows, a named pipe (\\.\pipe\name) that a
+// local collector has opened.
+class Telemetry {
+public:
+  static constexpr uint32_t kWindowFrames = 600;
+  // Histogram buckets of 0.1 ms up to 250 ms; slower frames share the last.
+  static constexpr uint32_t kBucketCount = 2500;
+  static constexpr float kBucketMilliseconds = 0.1f;
+
+  Telemetry() = default;
+  ~Telemetry();
+
+  Telemetry(const Telemetry &) = delete;
+  Telemetry &operator=(const Telemetry &) = delete;
+
+  bool open(const std::string &path);
+  bool opened();
+  void close();
+
+  // A frame slower than multiple x the median is a hitch; 0 disables.
+  void setHitchMultiple(float multiple);
+  float hitchMultiple();
+
+  // Adds a frame to the histogram and the stream. Returns true when it
+  // was a hitch.
+  bool record(const FrameTelemetry &frame);
+
+  // Frame time percentile over the window, fraction in [0, 1], with the
+  // resolution of a bucket.
+  float percentile(float fraction);
+  float maxMilliseconds();
+
+private:
+  FILE *m_file = nullptr;
+  float m_hitchMultiple = 2.5f;
+  uint32_t m_linesSinceFlush = 0;
+
+  std::array<uint32_t, kBucketCount> m_buckets{};
+  std::array<float, kWindowFrames> m_window{};
+  uint32_t m_windowCount = 0;
+  uint32_t m_windowNext = 0;
+
+  static uint32_t bucket(float milliseconds);
+};
@@ -0,0 +1,471 @@
+#include "../Vulkan.hpp"
+
+#include "Pipeline.hpp"
+#include "Temporal.hpp"
+
+#include <iostream>
+
+// How much of the clamped history survives each frame once converged.
+static constexpr float kHistoryFeedback = 0.9f;
+
+// Matches the push block in shaders/taa.frag.
+struct TemporalPush {
+  float texel[4];  // 1/width, 1/height, width, height
+  float params[4]; // x history weight (0 = reset), yz rendered uv extent
+};
+
+const char *AntiAliasingName(AntiAliasing antiAliasing) {
+  switch (antiAliasing) {
+  case AntiAliasingOff:
+    return "off";
+  case Msaa2x:
+    return "MSAA 2x";
+  case Msaa4x:
+    return "MSAA 4x";
+  case Msaa8x:
+    return "MSAA 8x";
+  case TemporalAA:
+    return "TAA";
+  default:
+    return "unknown";
+  }
+}
+
+void TemporalResolve::init(VkDevice device) {
+  VkSamplerCreateInfo samplerCreateInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+  samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+  samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+  samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.maxLod = 0.0f;
+
+  if (vkCreateSampler(device, &samplerCreateInfo, nullptr, &m_sampler) !=
+      VK_SUCCESS) {
+    std::cerr << "Failed to create TAA sampler" << std::endl;
+    std::abort();
+  }
+
+  // binding 0 = scene color, 1 = motion vectors, 2 = previous history.
+  VkDescriptorSetLayoutBinding descriptorSetLayoutBindings[3]{};
+  for (uint32_t i = 0; i < 3; ++i) {
+    descriptorSetLayoutBindings[i].binding = i;
+    descriptorSetLayoutBindings[i].descriptorType =
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorSetLayoutBindings[i].descriptorCount = 1;
+    descriptorSetLayoutBindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  }
+
+  VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+  descriptorSetLayoutCreateInfo.bindingCount = 3;
+  descriptorSetLayoutCreateInfo.pBindings = descriptorSetLayoutBindings;
+
+  if (vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo,
+                                  nullptr,
+                                  &m_descriptorSetLayout) != VK_SUCCESS) {
+    std::cerr << "vkCreateDescriptorSetLayout failed for TAA" << std::endl;
+    std::abort();
+  }
+
+  VkDescriptorPoolSize descriptorPoolSize{};
+  descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorPoolSize.descriptorCount = 3 * 2;
+
+  VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+  descriptorPoolCreateInfo.maxSets = 2;
+  descriptorPoolCreateInfo.poolSizeCount = 1;
+  descriptorPoolCreateInfo.pPoolSizes = &descriptorPoolSize;
+
+  if (vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr,
+                             &m_descriptorPool) != VK_SUCCESS) {
+    std::cerr << "vkCreateDescriptorPool failed for TAA" << std::endl;
+    std::abort();
+  }
+
+  VkDescriptorSetLayout descriptorSetLayouts[2] = {m_descriptorSetLayout,
+                                                   m_descriptorSetLayout};
+
+  VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+  descriptorSetAllocateInfo.descriptorPool = m_descriptorPool;
+  descriptorSetAllocateInfo.descriptorSetCount = 2;
+  descriptorSetAllocateInfo.pSetLayouts = descriptorSetLayouts;
+
+  if (vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
+                               m_descriptorSets.data()) != VK_SUCCESS) {
+    std::cerr << "vkAllocateDescriptorSets failed for TAA" << std::endl;
+    std::abort();
+  }
+
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(TemporalPush);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+  pipelineLayoutCreateInfo.setLayoutCount = 1;
+  pipelineLayoutCreateInfo.pSetLayouts = &m_descriptorSetLayout;
+  pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+  pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+  if (vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr,
+                             &m_pipelineLayout) != VK_SUCCESS) {
+    std::cerr << "vkCreatePipelineLayout failed for TAA" << std::endl;
+    std::abort();
+  }
+}
+
+void TemporalResolve::createTargets(
+    VkPhysicalDevice physicalDevice, VkDevice device, VkExtent2D extent,
+    VkFormat outputFormat, VkImageLayout outputFinalLayout,
+    const std::vector<VkImageView> &outputViews) {
+  destroyTargets(device);
+
+  m_extent = extent;
+  m_renderExtent = extent;
+  m_outputCount = (uint32_t)outputViews.size();
+
+  const VkImageUsageFlags targetUsage =
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+  if (!CreateImage2D(physicalDevice, device, VK_SAMPLE_COUNT_1_BIT,
+                     extent.width, extent.height, kSceneColorFormat,
+                     targetUsage, m_sceneColorImage, m_sceneColorMemory) ||
+      !CreateImage2D(physicalDevice, device, VK_SAMPLE_COUNT_1_BIT,
+                     extent.width, extent.height, kMotionFormat, targetUsage,
+                     m_motionImage, m_motionMemory)) {
+    std::cerr << "Failed to create TAA targets" << std::endl;
+    std::abort();
+  }
+
+  m_sceneColorView = CreateImageView(device, m_sceneColorImage,
+                                     kSceneColorFormat,
+                                     VK_IMAGE_ASPECT_COLOR_BIT);
+  m_motionView = CreateImageView(device, m_motionImage, kMotionFormat,
+                                 VK_IMAGE_ASPECT_COLOR_BIT);
+
+  for (uint32_t i = 0; i < 2; ++i) {
+    if (!CreateImage2D(physicalDevice, device, VK_SAMPLE_COUNT_1_BIT,
+                       extent.width, extent.height, kSceneColorFormat,
+                       targetUsage, m_historyImages[i], m_historyMemory[i])) {
+      std::cerr << "Failed to create TAA history image" << std::endl;
+      std::abort();
+    }
+
+    m_historyViews[i] =
+        CreateImageView(device, m_historyImages[i], kSceneColorFormat,
+                        VK_IMAGE_ASPECT_COLOR_BIT);
+  }
+
+  if (!m_sceneColorView || !m_motionView || !m_historyViews[0] ||
+      !m_historyViews[1]) {
+    std::cerr << "Failed to create TAA image views" << std::endl;
+    std::abort();
+  }
+
+  createRenderPass(device, outputFormat, outputFinalLayout);
+
+  m_framebuffers.resize(2 * m_outputCount);
+  for (uint32_t h = 0; h < 2; ++h) {
+    for (uint32_t i = 0; i < m_outputCount; ++i) {
+      VkImageView attachments[] = {m_historyViews[h], outputViews[i]};
+
+      VkFramebufferCreateInfo framebufferCreateInfo{
+          VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+      framebufferCreateInfo.renderPass = m_renderPass;
+      framebufferCreateInfo.attachmentCount = 2;
+      framebufferCreateInfo.pAttachments = attachments;
+      framebufferCreateInfo.width = extent.width;
+      framebufferCreateInfo.height = extent.height;
+      framebufferCreateInfo.layers = 1;
+
+      if (vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr,
+                              &m_framebuffers[h * m_outputCount + i]) !=
+          VK_SUCCESS) {
+        std::cerr << "vkCreateFramebuffer failed for TAA" << std::endl;
+        std::abort();
+      }
+    }
+  }
+
+  GraphicsPipelineDescription graphicsPipelineDescription{};
+  graphicsPipelineDescription.vertexShader = "shaders/fullscreen.vert.spv";
+  graphicsPipelineDescription.fragmentShader = "shaders/taa.frag.spv";
+  graphicsPipelineDescription.layout = m_pipelineLayout;
+  graphicsPipelineDescription.renderPass = m_renderPass;
+  graphicsPipelineDescription.colorAttachmentCount = 2;
+  graphicsPipelineDescription.depthTest = false;
+  graphicsPipelineDescription.depthWrite = false;
+
+  m_pipeline = CreateGraphicsPipeline(device, graphicsPipelineDescription);
+  if (!m_pipeline) {
+    std::abort();
+  }
+
+  writeDescriptors(device);
+
+  m_historyValid = false;
+  m_historyInitialized = false;
+}
+
+void TemporalResolve::destroyTargets(VkDevice device) {
+  if (!device) {
+    return;
+  }
+
+  if (m_pipeline) {
+    vkDestroyPipeline(device, m_pipeline, nullptr);
+    m_pipeline = VK_NULL_HANDLE;
+  }
+
+  for (VkFramebuffer framebuffer : m_framebuffers) {
+    vkDestroyFramebuffer(device, framebuffer, nullptr);
+  }
+  m_framebuffers.clear();
+
+  if (m_renderPass) {
+    vkDestroyRenderPass(device, m_renderPass, nullptr);
+    m_renderPass = VK_NULL_HANDLE;
+  }
+
+  auto destroyTarget = [device](VkImage &image, VkDeviceMemory &memory,
+                                VkImageView &view) {
+    if (view) {
+      vkDestroyImageView(device, view, nullptr);
+      view = VK_NULL_HANDLE;
+    }
+    if (image) {
+      vkDestroyImage(device, image, nullptr);
+      image = VK_NULL_HANDLE;
+    }
+    if (memory) {
+      vkFreeMemory(device, memory, nullptr);
+      memory = VK_NULL_HANDLE;
+    }
+  };
+
+  destroyTarget(m_sceneColorImage, m_sceneColorMemory, m_sceneColorView);
+  destroyTarget(m_motionImage, m_motionMemory, m_motionView);
+  for (uint32_t i = 0; i < 2; ++i) {
+    destroyTarget(m_historyImages[i], m_historyMemory[i], m_historyViews[i]);
+  }
+}
+
+VkImage TemporalResolve::sceneColorImage() { return m_sceneColorImage; }
+
+VkImage TemporalResolve::motionImage() { return m_motionImage; }
+
+VkImageView TemporalResolve::sceneColorView() { return m_sceneColorView; }
+
+VkImageView TemporalResolve::motionView() { return m_motionView; }
+
+void TemporalResolve::resetHistory() { m_historyValid = false; }
+
+void TemporalResolve::resolve(VkCommandBuffer commandBuffer,
+                              uint32_t imageIndex, VkExtent2D renderExtent) {
+  if (renderExtent.width != m_renderExtent.width ||
+      renderExtent.height != m_renderExtent.height) {
+    // The history was rendered at a different scale.
+    m_renderExtent = renderExtent;
+    m_historyValid = false;
+  }
+
+  if (!m_historyInitialized) {
+    // The history read on the first frame must be in a sampleable layout,
+    // even though its weight is zero.
+    VkImageMemoryBarrier imageMemoryBarriers[2]{};
+    for (uint32_t i = 0; i < 2; ++i) {
+      imageMemoryBarriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      imageMemoryBarriers[i].srcAccessMask = 0;
+      imageMemoryBarriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+      imageMemoryBarriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      imageMemoryBarriers[i].newLayout =
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      imageMemoryBarriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      imageMemoryBarriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      imageMemoryBarriers[i].image = m_historyImages[i];
+      imageMemoryBarriers[i].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0,
+                                                 1, 0, 1};
+    }
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                         0, nullptr, 2, imageMemoryBarriers);
+
+    m_historyInitialized = true;
+  }
+
+  VkRenderPassBeginInfo renderPassBeginInfo{
+      VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+  renderPassBeginInfo.renderPass = m_renderPass;
+  renderPassBeginInfo.framebuffer =
+      m_framebuffers[m_current * m_outputCount + imageIndex % m_outputCount];
+  renderPassBeginInfo.renderArea.offset = {0, 0};
+  renderPassBeginInfo.renderArea.extent = m_renderExtent;
+
+  vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo,
+                       VK_SUBPASS_CONTENTS_INLINE);
+
+  VkViewport viewport{};
+  viewport.width = (float)m_renderExtent.width;
+  viewport.height = (float)m_renderExtent.height;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+  VkRect2D scissor{};
+  scissor.extent = m_renderExtent;
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    m_pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          m_pipelineLayout, 0, 1, &m_descriptorSets[m_current],
+                          0, nullptr);
+
+  TemporalPush push{};
+  push.texel[0] = 1.0f / (float)m_extent.width;
+  push.texel[1] = 1.0f / (float)m_extent.height;
+  push.texel[2] = (float)m_extent.width;
+  push.texel[3] = (float)m_extent.height;
+  push.params[0] = m_historyValid ? kHistoryFeedback : 0.0f;
+  push.params[1] = (float)m_renderExtent.width / (float)m_extent.width;
+  push.params[2] = (float)m_renderExtent.height / (float)m_extent.height;
+
+  vkCmdPushConstants(commandBuffer, m_pipelineLayout,
+                     VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(TemporalPush),
+                     &push);
+
+  // Fullscreen triangle generated from gl_VertexIndex.
+  vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+  vkCmdEndRenderPass(commandBuffer);
+
+  m_historyValid = true;
+  m_current = 1 - m_current;
+}
+
+void TemporalResolve::createRenderPass(VkDevice device,
+                                       VkFormat outputFormat,
+                                       VkImageLayout outputFinalLayout) {
+  // Attachment 0: next history, attachment 1: output image.
+  VkAttachmentDescription attachmentDescriptions[2]{};
+  attachmentDescriptions[0].format = kSceneColorFormat;
+  attachmentDescriptions[0].samples = VK_SAMPLE_COUNT_1_BIT;
+  attachmentDescriptions[0].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachmentDescriptions[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  attachmentDescriptions[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachmentDescriptions[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachmentDescriptions[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  attachmentDescriptions[0].finalLayout =
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  attachmentDescriptions[1] = attachmentDescriptions[0];
+  attachmentDescriptions[1].format = outputFormat;
+  attachmentDescriptions[1].finalLayout = outputFinalLayout;
+
+  VkAttachmentReference colorReferences[2] = {
+      {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+      {1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}};
+
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 2;
+  subpass.pColorAttachments = colorReferences;
+
+  // The history being overwritten was sampled by the previous resolve, and
+  // the swapchain image is handed over at COLOR_ATTACHMENT_OUTPUT. On the way
+  // out, the new history (and an upscale source) is sampled by a later pass.
+  VkSubpassDependency subpassDependencies[2]{};
+  subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  subpassDependencies[0].dstSubpass = 0;
+  subpassDependencies[0].srcStageMask =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  subpassDependencies[0].dstStageMask =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  subpassDependencies[0].srcAccessMask = 0;
+  subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+  subpassDependencies[1].srcSubpass = 0;
+  subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+  subpassDependencies[1].srcStageMask =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  subpassDependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  VkRenderPassCreateInfo renderPassCreateInfo{
+      VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+  renderPassCreateInfo.attachmentCount = 2;
+  renderPassCreateInfo.pAttachments = attachmentDescriptions;
+  renderPassCreateInfo.subpassCount = 1;
+  renderPassCreateInfo.pSubpasses = &subpass;
+  renderPassCreateInfo.dependencyCount = 2;
+  renderPassCreateInfo.pDependencies = subpassDependencies;
+
+  if (vkCreateRenderPass(device, &renderPassCreateInfo, nullptr,
+                         &m_renderPass) != VK_SUCCESS) {
+    std::cerr << "vkCreateRenderPass failed for TAA" << std::endl;
+    std::abort();
+  }
+}
+
+void TemporalResolve::writeDescriptors(VkDevice device) {
+  for (uint32_t h = 0; h < 2; ++h) {
+    VkDescriptorImageInfo descriptorImageInfos[3]{};
+    descriptorImageInfos[0].imageView = m_sceneColorView;
+    descriptorImageInfos[1].imageView = m_motionView;
+    descriptorImageInfos[2].imageView = m_historyViews[1 - h];
+
+    VkWriteDescriptorSet writeDescriptorSets[3]{};
+    for (uint32_t i = 0; i < 3; ++i) {
+      descriptorImageInfos[i].sampler = m_sampler;
+      descriptorImageInfos[i].imageLayout =
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+      writeDescriptorSets[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writeDescriptorSets[i].dstSet = m_descriptorSets[h];
+      writeDescriptorSets[i].dstBinding = i;
+      writeDescriptorSets[i].descriptorCount = 1;
+      writeDescriptorSets[i].descriptorType =
+          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+      writeDescriptorSets[i].pImageInfo = &descriptorImageInfos[i];
+    }
+
+    vkUpdateDescriptorSets(device, 3, writeDescriptorSets, 0, nullptr);
+  }
+}
+
+void TemporalResolve::shutdown(VkDevice device) {
+  if (!device) {
+    return;
+  }
+
+  destroyTargets(device);
+
+  if (m_pipelineLayout) {
+    vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+    m_pipelineLayout = VK_NULL_HANDLE;
+  }
+
+  if (m_descriptorPool) {
+    vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+    m_descriptorPool = VK_NULL_HANDLE;
+    m_descriptorSets = {};
+  }
+
+  if (m_descriptorSetLayout) {
+    vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+    m_descriptorSetLayout = VK_NULL_HANDLE;
+  }
+
+  if (m_sampler) {
+    vkDestroySampler(device, m_sampler, nullptr);
+    m_sampler = VK_NULL_HANDLE;
+  }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Runtime anti-aliasing choice. MSAA levels above what the device supports
+// are rejected by Renderer::antiAliasingSupported.
+enum AntiAliasing {
+  AntiAliasingOff = 0,
+  Msaa2x = 1,
+  Msaa4x = 2,
+  Msaa8x = 3,
+  TemporalAA = 4,
+  AntiAliasingCount = 5,
+};
+
+const char *AntiAliasingName(AntiAliasing antiAliasing);
+
+// Temporal anti-aliasing resolve. In TAA mode the main pass renders
+// single-sampled into sceneColorView() plus a motion vector attachment;
+// resolve() then blends with the reprojected, neighborhood-clamped history
+// and writes both the next history image and the output image: the swapchain
+// image, or the dynamic resolution source when the output is upscaled.
+class TemporalResolve {
+public:
+  static constexpr VkFormat kSceneColorFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+  static constexpr VkFormat kMotionFormat = VK_FORMAT_R16G16_SFLOAT;
+
+  TemporalResolve() = default;
+  ~TemporalResolve() = default;
+
+  // Swapchain-independent objects (sampler, descriptors, pipeline layout).
+  void init(VkDevice device);
+
+  // Extent- and output-dependent targets, render pass and pipeline.
+  // outputViews holds one view per swapchain image, or a single view that
+  // every frame writes; outputFinalLayout is PRESENT_SRC for the swapchain.
+  void createTargets(VkPhysicalDevice physicalDevice, VkDevice device,
+                     VkExtent2D extent, VkFormat outputFormat,
+                     VkImageLayout outputFinalLayout,
+                     const std::vector<VkImageView> &outputViews);
+  void destroyTargets(VkDevice device);
+
+  VkImage sceneColorImage();
+  VkImage motionImage();
+  VkImageView sceneColorView();
+  VkImageView motionView();
+
+  // Drops the accumulated history (camera cut, mode switch).
+  void resetHistory();
+
+  // Records the resolve pass over the top-left renderExtent region. Must be
+  // recorded after the main render pass. A region change drops the history.
+  void resolve(VkCommandBuffer commandBuffer, uint32_t imageIndex,
+               VkExtent2D renderExtent);
+
+  void shutdown(VkDevice device);
+
+private:
+  VkExtent2D m_extent{};
+  VkExtent2D m_renderExtent{};
+
+  VkImage m_sceneColorImage = VK_NULL_HANDLE;
+  VkDeviceMemory m_sceneColorMemory = VK_NULL_HANDLE;
+  VkImageView m_sceneColorView = VK_NULL_HANDLE;
+
+  VkImage m_motionImage = VK_NULL_HANDLE;
+  VkDeviceMemory m_motionMemory = VK_NULL_HANDLE;
+  VkImageView m_motionView = VK_NULL_HANDLE;
+
+  // Ping-pong: resolve reads history[1 - current] and writes history[current].
+  std::array<VkImage, 2> m_historyImages{};
+  std::array<VkDeviceMemory, 2> m_historyMemory{};
+  std::array<VkImageView, 2> m_historyViews{};
+  uint32_t m_current = 0;
+  bool m_historyValid = false;
+  bool m_historyInitialized = false;
+
+  VkSampler m_sampler = VK_NULL_HANDLE;
+
+  VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+  VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+  std::array<VkDescriptorSet, 2> m_descriptorSets{};
+
+  VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+  VkPipeline m_pipeline = VK_NULL_HANDLE;
+  VkRenderPass m_renderPass = VK_NULL_HANDLE;
+  // [history index * output count + output index]
+  std::vector<VkFramebuffer> m_framebuffers;
+  uint32_t m_outputCount = 0;
+
+  void createRenderPass(VkDevice device, VkFormat outputFormat,
+                        VkImageLayout outputFinalLayout);
+  void writeDescriptors(VkDevice device);
+};
@@ -0,0 +1,117 @@
+#include "Timeline.hpp"
+
+#include "Profiler.hpp"
+
+#include <iostream>
+#include <vector>
+
+void Timeline::init(VkDevice device) {
+  m_device = device;
+
+  VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo{
+      VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+  semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  semaphoreTypeCreateInfo.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphoreCreateInfo{
+      VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+  semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+
+  if (vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr,
+                        &m_semaphore) != VK_SUCCESS) {
+    std::cerr << "Could not create timeline semaphore" << std::endl;
+    std::abort();
+  }
+
+  m_submittedValue = 0;
+  m_completedValue = 0;
+}
+
+uint64_t Timeline::submit(VkQueue queue, VkCommandBuffer commandBuffer,
+                          const VkSemaphoreSubmitInfo *waits,
+                          uint32_t waitCount,
+                          const VkSemaphoreSubmitInfo *signals,
+                          uint32_t signalCount) {
+  const uint64_t value = m_submittedValue + 1;
+
+  std::vector<VkSemaphoreSubmitInfo> &signalInfos = m_signalInfos;
+  signalInfos.assign(signals, signals + signalCount);
+  VkSemaphoreSubmitInfo timelineSignal{
+      VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO};
+  timelineSignal.semaphore = m_semaphore;
+  timelineSignal.value = value;
+  timelineSignal.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+  signalInfos.push_back(timelineSignal);
+
+  VkCommandBufferSubmitInfo commandBufferSubmitInfo{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO};
+  commandBufferSubmitInfo.commandBuffer = commandBuffer;
+
+  VkSubmitInfo2 submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO_2};
+  submitInfo.waitSemaphoreInfoCount = waitCount;
+  submitInfo.pWaitSemaphoreInfos = waits;
+  submitInfo.commandBufferInfoCount = commandBuffer ? 1 : 0;
+  submitInfo.pCommandBufferInfos = &commandBufferSubmitInfo;
+  submitInfo.signalSemaphoreInfoCount = (uint32_t)signalInfos.size();
+  submitInfo.pSignalSemaphoreInfos = signalInfos.data();
+
+  VkResult result = vkQueueSubmit2(queue, 1, &submitInfo, VK_NULL_HANDLE);
+  if (result != VK_SUCCESS) {
+    std::cerr << "vkQueueSubmit2 failed: " << (int)result << std::endl;
+    std::abort();
+  }
+
+  m_submittedValue = value;
+  return value;
+}
+
+uint64_t Timeline::submittedValue() { return m_submittedValue; }
+
+uint64_t Timeline::completedValue() {
+  if (m_completedValue < m_submittedValue) {
+    uint64_t value = 0;
+    if (vkGetSemaphoreCounterValue(m_device, m_semaphore, &value) ==
+        VK_SUCCESS) {
+      m_completedValue = value;
+    }
+  }
+  return m_completedValue;
+}
+
+bool Timeline::completed(uint64_t value) {
+  // The cached value avoids a driver call for anything already known done.
+  return value <= m_completedValue || value <= completedValue();
+}
+
+void Timeline::wait(uint64_t value) {
+  if (completed(value)) {
+    return;
+  }
+
+  PROFILE_ZONE("Timeline::wait");
+
+  VkSemaphoreWaitInfo semaphoreWaitInfo{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+  semaphoreWaitInfo.semaphoreCount = 1;
+  semaphoreWaitInfo.pSemaphores = &m_semaphore;
+  semaphoreWaitInfo.pValues = &value;
+
+  VkResult result = vkWaitSemaphores(m_device, &semaphoreWaitInfo, UINT64_MAX);
+  if (result != VK_SUCCESS) {
+    std::cerr << "vkWaitSemaphores failed: " << (int)result << std::endl;
+    std::abort();
+  }
+
+  if (value > m_completedValue) {
+    m_completedValue = value;
+  }
+}
+
+VkSemaphore Timeline::semaphore() { return m_semaphore; }
+
+void Timeline::shutdown(VkDevice device) {
+  if (m_semaphore) {
+    wait(m_submittedValue);
+    vkDestroySemaphore(device, m_semaphore, nullptr);
+    m_semaphore = VK_NULL_HANDLE;
+  }
+}
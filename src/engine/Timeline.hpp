@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// Submission scheduler around one timeline semaphore. Every submit() signals
+// the next value of a single monotonically increasing counter, whatever the
+// queue, so "has this work finished?" is one integer comparison. CPU waits
+// for slot reuse and readbacks are expressed in those values instead of
+// per-frame fences.
+class Timeline {
+public:
+  Timeline() = default;
+  ~Timeline() = default;
+
+  Timeline(const Timeline &) = delete;
+  Timeline &operator=(const Timeline &) = delete;
+
+  void init(VkDevice device);
+
+  // Submits commandBuffer to queue, waiting on and signaling the given
+  // (binary or timeline) semaphores in addition to the timeline's own
+  // signal. Returns the value that marks this submission complete.
+  uint64_t submit(VkQueue queue, VkCommandBuffer commandBuffer,
+                  const VkSemaphoreSubmitInfo *waits = nullptr,
+                  uint32_t waitCount = 0,
+                  const VkSemaphoreSubmitInfo *signals = nullptr,
+                  uint32_t signalCount = 0);
+
+  // Value of the most recent submit(); 0 before the first.
+  uint64_t submittedValue();
+  // Polls the semaphore; never blocks.
+  uint64_t completedValue();
+  bool completed(uint64_t value);
+  // Blocks until value has been reached. Values of 0 return immediately.
+  void wait(uint64_t value);
+
+  VkSemaphore semaphore();
+
+  // Waits for all submissions.
+  void shutdown(VkDevice device);
+
+private:
+  VkDevice m_device = VK_NULL_HANDLE;
+  VkSemaphore m_semaphore = VK_NULL_HANDLE;
+  uint64_t m_submittedValue = 0;
+  uint64_t m_completedValue = 0; // last value read back
+  // Caller's signals plus the timeline's; kept so submit() reuses it.
+  std::vector<VkSemaphoreSubmitInfo> m_signalInfos;
+};
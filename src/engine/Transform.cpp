@@ -0,0 +1,318 @@
+#include "Transform.hpp"
+
+#include "Jobs.hpp"
+#include "Log.hpp"
+#include "Profiler.hpp"
+
+#include <atomic>
+#include <cassert>
+
+// Below this many nodes under dirty roots, update() stays on the calling
+// thread; the jobs would cost more than they save.
+static constexpr uint32_t kParallelNodes = 4096;
+
+uint32_t TransformHierarchy::add(const Transform &local, uint32_t parent) {
+  assert(parent == kNoParent || parent < m_slotOf.size());
+
+  const uint32_t handle = (uint32_t)m_slotOf.size();
+  const uint32_t slot = (uint32_t)m_position.size();
+
+  m_slotOf.push_back(slot);
+  m_parentOf.push_back(parent);
+
+  m_position.push_back(local.position);
+  m_rotation.push_back(local.rotation);
+  m_scale.push_back(local.scaleV);
+  m_local.push_back(Mat4::identity());
+  m_world.push_back(Mat4::identity());
+  m_firstChild.push_back(0);
+  m_childCount.push_back(0);
+  m_rootOf.push_back(0);
+  m_dirty.push_back(kLocalDirty);
+
+  m_structureDirty = true;
+  return handle;
+}
+
+bool TransformHierarchy::setParent(uint32_t node, uint32_t parent) {
+  for (uint32_t ancestor = parent; ancestor != kNoParent;
+       ancestor = m_parentOf[ancestor]) {
+    if (ancestor == node) {
+      Log::warning("TransformHierarchy: node %u cannot be parented to its "
+                   "descendant %u",
+                   node, parent);
+      return false;
+    }
+  }
+
+  if (m_parentOf[node] != parent) {
+    m_parentOf[node] = parent;
+    // A new parent world is all that changes; propagate() carries it down
+    // the subtree from here.
+    m_dirty[m_slotOf[node]] |= kLocalDirty;
+    m_structureDirty = true;
+  }
+  return true;
+}
+
+uint32_t TransformHierarchy::parent(uint32_t node) { return m_parentOf[node]; }
+
+void TransformHierarchy::setLocal(uint32_t node, const Transform &local) {
+  const uint32_t slot = m_slotOf[node];
+  m_position[slot] = local.position;
+  m_rotation[slot] = local.rotation;
+  m_scale[slot] = local.scaleV;
+  markDirty(slot);
+}
+
+void TransformHierarchy::setPosition(uint32_t node, Vec3 position) {
+  const uint32_t slot = m_slotOf[node];
+  m_position[slot] = position;
+  markDirty(slot);
+}
+
+void TransformHierarchy::setRotation(uint32_t node, Quat rotation) {
+  const uint32_t slot = m_slotOf[node];
+  m_rotation[slot] = rotation;
+  markDirty(slot);
+}
+
+void TransformHierarchy::setScale(uint32_t node, Vec3 scale) {
+  const uint32_t slot = m_slotOf[node];
+  m_scale[slot] = scale;
+  markDirty(slot);
+}
+
+Transform TransformHierarchy::local(uint32_t node) {
+  const uint32_t slot = m_slotOf[node];
+  return {m_position[slot], m_rotation[slot], m_scale[slot]};
+}
+
+const Mat4 &TransformHierarchy::world(uint32_t node) {
+  return m_world[m_slotOf[node]];
+}
+
+void TransformHierarchy::update(JobSystem &jobs) {
+  PROFILE_ZONE("TransformHierarchy::update");
+
+  if (m_structureDirty) {
+    sort();
+    m_structureDirty = false;
+  }
+
+  m_updatedCount = 0;
+  if (m_dirtyRoots.empty()) {
+    return;
+  }
+
+  uint32_t nodes = 0;
+  for (uint32_t root : m_dirtyRoots) {
+    nodes += m_roots[root].end - m_roots[root].begin;
+  }
+
+  if (nodes < kParallelNodes || m_dirtyRoots.size() == 1) {
+    for (uint32_t root : m_dirtyRoots) {
+      m_updatedCount += propagate(m_roots[root]);
+    }
+  } else {
+    // Roots share nothing, so each chunk of them runs without locks.
+    std::atomic<uint32_t> updated{0};
+    jobs.parallelFor(
+        (uint32_t)m_dirtyRoots.size(),
+        [this, &updated](uint32_t begin, uint32_t end) {
+          uint32_t count = 0;
+          for (uint32_t i = begin; i < end; ++i) {
+            count += propagate(m_roots[m_dirtyRoots[i]]);
+          }
+          updated.fetch_add(count, std::memory_order_relaxed);
+        },
+        1);
+    m_updatedCount = updated.load(std::memory_order_relaxed);
+  }
+
+  for (uint32_t root : m_dirtyRoots) {
+    m_rootDirty[root] = 0;
+  }
+  m_dirtyRoots.clear();
+}
+
+void TransformHierarchy::clear() {
+  m_slotOf.clear();
+  m_parentOf.clear();
+  m_position.clear();
+  m_rotation.clear();
+  m_scale.clear();
+  m_local.clear();
+  m_world.clear();
+  m_firstChild.clear();
+  m_childCount.clear();
+  m_rootOf.clear();
+  m_dirty.clear();
+  m_roots.clear();
+  m_rootDirty.clear();
+  m_dirtyRoots.clear();
+  m_structureDirty = false;
+  m_updatedCount = 0;
+}
+
+void TransformHierarchy::markDirty(uint32_t slot) {
+  m_dirty[slot] |= kLocalDirty;
+
+  // m_rootOf is stale until sort(), which finds the dirty roots itself.
+  if (m_structureDirty) {
+    return;
+  }
+
+  const uint32_t root = m_rootOf[slot];
+  if (!m_rootDirty[root]) {
+    m_rootDirty[root] = 1;
+    m_dirtyRoots.push_back(root);
+  }
+}
+
+void TransformHierarchy::sort() {
+  PROFILE_ZONE("TransformHierarchy::sort");
+
+  const uint32_t count = (uint32_t)m_slotOf.size();
+
+  // Children of each handle, in handle order.
+  std::vector<uint32_t> childStart(count + 1, 0);
+  for (uint32_t handle = 0; handle < count; ++handle) {
+    if (m_parentOf[handle] != kNoParent) {
+      ++childStart[m_parentOf[handle] + 1];
+    }
+  }
+  for (uint32_t handle = 0; handle < count; ++handle) {
+    childStart[handle + 1] += childStart[handle];
+  }
+  std::vector<uint32_t> children(childStart[count]);
+  std::vector<uint32_t> cursor(childStart.begin(), childStart.end() - 1);
+  for (uint32_t handle = 0; handle < count; ++handle) {
+    if (m_parentOf[handle] != kNoParent) {
+      children[cursor[m_parentOf[handle]]++] = handle;
+    }
+  }
+
+  // Breadth first from each root, so a subtree is one range and siblings
+  // are adjacent.
+  std::vector<uint32_t> order;
+  order.reserve(count);
+  std::vector<uint32_t> firstChild(count);
+  std::vector<uint32_t> childCount(count);
+  std::vector<uint32_t> rootOf(count);
+  m_roots.clear();
+
+  for (uint32_t handle = 0; handle < count; ++handle) {
+    if (m_parentOf[handle] != kNoParent) {
+      continue;
+    }
+
+    Root root;
+    root.begin = (uint32_t)order.size();
+    order.push_back(handle);
+    for (uint32_t head = root.begin; head < order.size(); ++head) {
+      const uint32_t node = order[head];
+      firstChild[head] = (uint32_t)order.size();
+      childCount[head] = childStart[node + 1] - childStart[node];
+      rootOf[head] = (uint32_t)m_roots.size();
+      order.insert(order.end(), children.begin() + childStart[node],
+                   children.begin() + childStart[node + 1]);
+    }
+    root.end = (uint32_t)order.size();
+    m_roots.push_back(root);
+  }
+  assert(order.size() == count);
+
+  // Matrices and dirty bits move with their nodes, so only what add(),
+  // setParent() and the setters touched is recomputed.
+  std::vector<Vec3> position(count);
+  std::vector<Quat> rotation(count);
+  std::vector<Vec3> scale(count);
+  std::vector<Mat4> local(count);
+  std::vector<Mat4> world(count);
+  std::vector<uint8_t> dirty(count);
+  for (uint32_t slot = 0; slot < count; ++slot) {
+    const uint32_t previous = m_slotOf[order[slot]];
+    position[slot] = m_position[previous];
+    rotation[slot] = m_rotation[previous];
+    scale[slot] = m_scale[previous];
+    local[slot] = m_local[previous];
+    world[slot] = m_world[previous];
+    dirty[slot] = m_dirty[previous];
+  }
+  for (uint32_t slot = 0; slot < count; ++slot) {
+    m_slotOf[order[slot]] = slot;
+  }
+
+  m_position = std::move(position);
+  m_rotation = std::move(rotation);
+  m_scale = std::move(scale);
+  m_local = std::move(local);
+  m_world = std::move(world);
+  m_dirty = std::move(dirty);
+  m_firstChild = std::move(firstChild);
+  m_childCount = std::move(childCount);
+  m_rootOf = std::move(rootOf);
+
+  // Root indices changed, so the dirty roots are found again from the
+  // nodes' bits.
+  m_rootDirty.assign(m_roots.size(), 0);
+  m_dirtyRoots.clear();
+  for (uint32_t slot = 0; slot < count; ++slot) {
+    const uint32_t root = m_rootOf[slot];
+    if (m_dirty[slot] && !m_rootDirty[root]) {
+      m_rootDirty[root] = 1;
+      m_dirtyRoots.push_back(root);
+    }
+  }
+}
+
+uint32_t TransformHierarchy::propagate(const Root &root) {
+  uint32_t updated = 0;
+
+  const uint32_t top = root.begin;
+  if (m_dirty[top] & kLocalDirty) {
+    m_local[top] = compose(m_position[top], m_rotation[top], m_scale[top]);
+    m_world[top] = m_local[top];
+    m_dirty[top] |= kWorldDirty;
+    ++updated;
+  }
+
+  // Parents come first, so a parent's world matrix is final by the time
+  // its children are reached.
+  for (uint32_t slot = root.begin; slot < root.end; ++slot) {
+    const uint32_t first = m_firstChild[slot];
+    const uint32_t count = m_childCount[slot];
+    if (count == 0) {
+      continue;
+    }
+
+    if (m_dirty[slot] & kWorldDirty) {
+      for (uint32_t child = first; child < first + count; ++child) {
+        if (m_dirty[child] & kLocalDirty) {
+          m_local[child] =
+              compose(m_position[child], m_rotation[child], m_scale[child]);
+        }
+        m_dirty[child] |= kWorldDirty;
+      }
+      mulBatch(m_world[slot], &m_local[first], &m_world[first], count);
+      updated += count;
+      continue;
+    }
+
+    for (uint32_t child = first; child < first + count; ++child) {
+      if (m_dirty[child] & kLocalDirty) {
+        m_local[child] =
+            compose(m_position[child], m_rotation[child], m_scale[child]);
+        m_world[child] = mul(m_world[slot], m_local[child]);
+        m_dirty[child] |= kWorldDirty;
+        ++updated;
+      }
+    }
+  }
+
+  for (uint32_t slot = root.begin; slot < root.end; ++slot) {
+    m_dirty[slot] = 0;
+  }
+  return updated;
+}
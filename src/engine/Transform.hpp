@@ -2,10 +2,91 @@
 
 #include "Math.hpp"
 
+#include <cstdint>
+#include <vector>
+
+class JobSystem; // forward declaration
+
 struct Transform {
   Vec3 position{0.0f, 0.0f, 0.0f};
+  Quat rotation{};
   Vec3 scaleV{1.0f, 1.0f, 1.0f};
-  // rotation omitted for now (add quaternion later if you want)
 
-  Mat4 matrix() const { return mul(translate(position), scale(scaleV)); }
-};
\ No newline at end of file
+  Mat4 matrix() const { return compose(position, rotation, scaleV); }
+};
+
+// Parent/child transforms for everything placed in a scene. Nodes are
+// addressed by the handle add() returns, which never changes; storage is
+// structure-of-arrays in slots ordered so that every root's subtree is one
+// contiguous range, breadth first within it. Parents therefore come before
+// their children and siblings sit next to each other, so a parent's world
+// matrix is applied to all of its children with one mulBatch().
+//
+// Setters only mark the node dirty. update() recomputes the world matrices
+// of dirty nodes and everything below them, skips roots with nothing
+// dirty, and spreads the dirty roots over the job system.
+class TransformHierarchy {
+public:
+  static constexpr uint32_t kNoParent = UINT32_MAX;
+
+  uint32_t add(const Transform &local, uint32_t parent = kNoParent);
+  // Fails (and logs) if parent is node or one of its descendants.
+  bool setParent(uint32_t node, uint32_t parent);
+  uint32_t parent(uint32_t node);
+
+  void setLocal(uint32_t node, const Transform &local);
+  void setPosition(uint32_t node, Vec3 position);
+  void setRotation(uint32_t node, Quat rotation);
+  void setScale(uint32_t node, Vec3 scale);
+  Transform local(uint32_t node);
+
+  // As of the last update().
+  const Mat4 &world(uint32_t node);
+
+  void update(JobSystem &jobs);
+
+  uint32_t size() { return (uint32_t)m_slotOf.size(); }
+  // Nodes whose world matrix the last update() recomputed.
+  uint32_t updatedCount() { return m_updatedCount; }
+
+  void clear();
+
+private:
+  enum : uint8_t {
+    kLocalDirty = 1, // position/rotation/scale changed
+    kWorldDirty = 2, // world matrix changed this update
+  };
+
+  struct Root {
+    uint32_t begin = 0; // slot range of the subtree
+    uint32_t end = 0;
+  };
+
+  // By handle.
+  std::vector<uint32_t> m_slotOf;
+  std::vector<uint32_t> m_parentOf; // handle, or kNoParent
+
+  // By slot.
+  std::vector<Vec3> m_position;
+  std::vector<Quat> m_rotation;
+  std::vector<Vec3> m_scale;
+  std::vector<Mat4> m_local;
+  std::vector<Mat4> m_world;
+  std::vector<uint32_t> m_firstChild; // slot
+  std::vector<uint32_t> m_childCount;
+  std::vector<uint32_t> m_rootOf; // index into m_roots
+  std::vector<uint8_t> m_dirty;
+
+  std::vector<Root> m_roots;
+  std::vector<uint8_t> m_rootDirty;
+  std::vector<uint32_t> m_dirtyRoots;
+
+  // Nodes were added or reparented; slots are re-sorted before the next
+  // update.
+  bool m_structureDirty = false;
+  uint32_t m_updatedCount = 0;
+
+  void markDirty(uint32_t slot);
+  void sort();
+  uint32_t propagate(const Root &root);
+};
@@ -1,9 +1,12 @@
 #include "../Vulkan.hpp"
 
+#include "Log.hpp"
 #include "Renderer.hpp"
 #include "Vertex.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <utility>
 
 VertexCollector::VertexCollector(std::vector<VertexAttribute> vertexAttributes)
     : m_vertexAttributes(vertexAttributes) {}
@@ -65,36 +68,48 @@ unsigned long long VertexCollector::vertexStride() {
   return sizeAccumulator;
 }
 
+int VertexCollector::attributeOffset(VertexAttribute vertexAttribute) {
+  int offset = 0;
+
+  for (VertexAttribute collected : m_vertexAttributes) {
+    if (collected == vertexAttribute) {
+      return offset;
+    }
+
+    offset += AttributeCount(collected);
+  }
+
+  return -1;
+}
+
 void VertexCollector::insertVertex(Vertex vertex) {
   m_vertices.push_back(vertex);
 }
 
 void VertexCollector::addVertices(std::vector<Vertex> vertices) {
-  m_vertices = vertices;
+  m_vertices = std::move(vertices);
 }
 
 void VertexCollector::addIndices(std::vector<uint32_t> indices) {
-  m_indices = indices;
+  m_indices = std::move(indices);
 }
 
 std::vector<float> VertexCollector::rawVertexData() {
-  std::vector<float> data;
+  const size_t floatsPerVertex = vertexStride() / sizeof(float);
+  std::vector<float> data(m_vertices.size() * floatsPerVertex);
 
-  for (Vertex vertex : m_vertices) {
+  float *out = data.data();
+  for (const Vertex &vertex : m_vertices) {
     for (VertexAttribute vertexAttribute : m_vertexAttributes) {
-      std::vector<float> attributeData =
-          VertexAttributeData(vertex, vertexAttribute);
-
-      for (float element : attributeData) {
-        data.push_back(element);
-      }
+      out += VertexAttributeData(vertex, vertexAttribute, out);
     }
   }
 
   return data;
 }
 
-Model VertexCollector::buildModel(Renderer &renderer) {
+Model VertexCollector::buildModel(Renderer &renderer,
+                                  GeometryBuffer *geometry) {
   auto physicalDevice = renderer.physicalDevice();
   auto device = renderer.device();
 
@@ -127,25 +142,58 @@ Model VertexCollector::buildModel(Renderer &renderer) {
     std::abort();
   }
 
+  std::vector<float> vertexData = rawVertexData();
+
   void *data = nullptr;
   vkMapMemory(device, vertexMemory, 0, vertexBufferSize, 0, &data);
-  std::memcpy(data, rawVertexData().data(), (size_t)vertexBufferSize);
+  std::memcpy(data, vertexData.data(), (size_t)vertexBufferSize);
   vkUnmapMemory(device, vertexMemory);
 
   vkMapMemory(device, indexMemory, 0, indexBufferSize, 0, &data);
   std::memcpy(data, m_indices.data(), (size_t)indexBufferSize);
   vkUnmapMemory(device, indexMemory);
 
-  std::cout << "vertices=" << m_vertices.size()
-            << " indices=" << m_indices.size() << std::endl;
+  Log::debug("vertices=%zu indices=%zu", m_vertices.size(),
+             m_indices.size());
 
   Mesh mesh;
   mesh.init(indexCount, vertexBuffer, vertexMemory, indexBuffer, indexMemory);
 
+  if (!m_vertices.empty()) {
+    Vec3 boundsMin{m_vertices[0].px, m_vertices[0].py, m_vertices[0].pz};
+    Vec3 boundsMax = boundsMin;
+    for (const Vertex &vertex : m_vertices) {
+      boundsMin = {std::min(boundsMin.x, vertex.px),
+                   std::min(boundsMin.y, vertex.py),
+                   std::min(boundsMin.z, vertex.pz)};
+      boundsMax = {std::max(boundsMax.x, vertex.px),
+                   std::max(boundsMax.y, vertex.py),
+                   std::max(boundsMax.z, vertex.pz)};
+    }
+    mesh.setBounds(boundsMin, boundsMax);
+  }
+
+  if (geometry) {
+    GeometryRange range{};
+    const uint32_t stride = (uint32_t)(vertexStride() / sizeof(float));
+    if (!geometry->append(vertexData, stride, m_indices, range)) {
+      std::cerr << "Geometry buffer is full" << std::endl;
+      std::abort();
+    }
+
+    const VertexAttribute pulledAttributes[kPulledAttributeCount] = {
+        Position, Normal, Tangent, TextureCoordinate, Color};
+    for (int i = 0; i < kPulledAttributeCount; ++i) {
+      range.attributeOffsets[i] = attributeOffset(pulledAttributes[i]);
+    }
+
+    mesh.setPulledRange(range);
+  }
+
   std::vector<Mesh> meshes = {mesh};
 
   Model model;
-  model.init(meshes);
+  model.init(std::move(meshes));
 
   return model;
 }
@@ -2,6 +2,7 @@
 
 #include "../Vulkan.hpp"
 
+#include "Geometry.hpp"
 #include "Model.hpp"
 
 #include <stddef.h>
@@ -40,20 +41,38 @@ struct Vertex {
   float r, g, b;        // Color
 };
 
-inline std::vector<float> VertexAttributeData(Vertex vertex,
-                                              VertexAttribute vertexAttribute) {
+// Writes the attribute's AttributeCount() floats to out and returns the
+// count written.
+inline int VertexAttributeData(const Vertex &vertex,
+                               VertexAttribute vertexAttribute, float *out) {
   switch (vertexAttribute) {
   case VertexAttribute::Position:
-    return {vertex.px, vertex.py, vertex.pz};
+    out[0] = vertex.px;
+    out[1] = vertex.py;
+    out[2] = vertex.pz;
+    return 3;
   case VertexAttribute::Normal:
-    return {vertex.nx, vertex.ny, vertex.nz};
+    out[0] = vertex.nx;
+    out[1] = vertex.ny;
+    out[2] = vertex.nz;
+    return 3;
   case VertexAttribute::Tangent:
-    return {vertex.px, vertex.py, vertex.pz};
+    out[0] = vertex.tx;
+    out[1] = vertex.ty;
+    out[2] = vertex.tz;
+    out[3] = vertex.tw;
+    return 4;
   case VertexAttribute::TextureCoordinate:
-    return {vertex.tx, vertex.ty, vertex.tz, vertex.tw};
+    out[0] = vertex.ux;
+    out[1] = vertex.uy;
+    return 2;
   case VertexAttribute::Color:
-    return {vertex.r, vertex.g, vertex.b};
+    out[0] = vertex.r;
+    out[1] = vertex.g;
+    out[2] = vertex.b;
+    return 3;
   }
+  return 0;
 }
 
 class VertexCollector {
@@ -65,13 +84,18 @@ public:
 
   unsigned long long vertexStride();
 
+  // Float offset of an attribute within one vertex, -1 if not collected.
+  int attributeOffset(VertexAttribute vertexAttribute);
+
   void insertVertex(Vertex vertex);
   void addVertices(std::vector<Vertex> vertices);
   void addIndices(std::vector<uint32_t> indices);
 
   std::vector<float> rawVertexData();
 
-  Model buildModel(Renderer &renderer);
+  // When geometry is given the mesh is also appended to it for the vertex
+  // pulling path.
+  Model buildModel(Renderer &renderer, GeometryBuffer *geometry = nullptr);
 
 private:
   std::vector<VertexAttribute> m_vertexAttributes;
@@ -1,12 +1,12 @@
 #include "Window.hpp"
 
-#include <iostream>
+#include "Log.hpp"
 
 Window::~Window() { shutdown(); }
 
 bool Window::init(const char *title, int width, int height) {
   if (!SDL_Init(SDL_INIT_VIDEO)) {
-    std::cerr << "SDL_Init failed: " << SDL_GetError() << std::endl;
+    Log::error("SDL_Init failed: %s", SDL_GetError());
     return false;
   }
 
@@ -17,7 +17,7 @@ bool Window::init(const char *title, int width, int height) {
                               SDL_WINDOW_RESIZABLE | SDL_WINDOW_VULKAN);
 
   if (!m_window) {
-    std::cerr << "SDL_CreateWindow failed: " << SDL_GetError() << std::endl;
+    Log::error("SDL_CreateWindow failed: %s", SDL_GetError());
     SDL_Quit();
     return false;
   }
@@ -40,6 +40,7 @@ void Window::shutdown() {
 
 bool Window::pumpEvents() {
   m_resized = false;
+  m_pressedKeys.clear();
 
   SDL_Event e;
   while (SDL_PollEvent(&e)) {
@@ -56,6 +57,31 @@ bool Window::pumpEvents() {
       m_resized = true;
       break;
 
+    case SDL_EVENT_WINDOW_MINIMIZED:
+    case SDL_EVENT_WINDOW_HIDDEN:
+      m_minimized = true;
+      break;
+
+    case SDL_EVENT_WINDOW_RESTORED:
+    case SDL_EVENT_WINDOW_MAXIMIZED:
+    case SDL_EVENT_WINDOW_SHOWN:
+      m_minimized = false;
+      break;
+
+    case SDL_EVENT_WINDOW_OCCLUDED:
+      m_occluded = true;
+      break;
+
+    case SDL_EVENT_WINDOW_EXPOSED:
+      m_occluded = false;
+      break;
+
+    case SDL_EVENT_KEY_DOWN:
+      if (!e.key.repeat) {
+        m_pressedKeys.push_back(e.key.key);
+      }
+      break;
+
     default:
       break;
     }
@@ -64,6 +90,10 @@ bool Window::pumpEvents() {
   return m_running;
 }
 
+void Window::waitForEvents(int timeoutMilliseconds) {
+  SDL_WaitEventTimeout(nullptr, timeoutMilliseconds);
+}
+
 Win32WindowHandles Window::win32Handles() const {
   Win32WindowHandles wh{};
 
@@ -73,8 +103,7 @@ Win32WindowHandles Window::win32Handles() const {
 
   SDL_PropertiesID props = SDL_GetWindowProperties(m_window);
   if (!props) {
-    std::cerr << "SDL_GetWindowProperties failed: " << SDL_GetError()
-              << std::endl;
+    Log::error("SDL_GetWindowProperties failed: %s", SDL_GetError());
 
     return wh;
   }
@@ -9,7 +9,9 @@
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_properties.h>
 
+#include <algorithm>
 #include <string>
+#include <vector>
 #include <windows.h>
 
 class Window {
@@ -26,6 +28,18 @@ public:
   // Pump all queued events; returns false if app should quit.
   bool pumpEvents();
 
+  // True if the key went down during the last pumpEvents().
+  bool keyPressed(SDL_Keycode key) const {
+    return std::find(m_pressedKeys.begin(), m_pressedKeys.end(), key) !=
+           m_pressedKeys.end();
+  }
+
+  // Minimized or fully covered; nothing drawn would be seen.
+  bool hidden() const { return m_minimized || m_occluded; }
+  // Sleeps until an event arrives or timeoutMilliseconds pass; the event is
+  // left for the next pumpEvents().
+  void waitForEvents(int timeoutMilliseconds);
+
   bool wasResized() const { return m_resized; }
   void clearResizedFlag() { m_resized = false; }
 
@@ -40,6 +54,9 @@ private:
   SDL_Window *m_window = nullptr;
   bool m_running = true;
   bool m_resized = false;
+  bool m_minimized = false;
+  bool m_occluded = false;
   int m_width = 0;
   int m_height = 0;
+  std::vector<SDL_Keycode> m_pressedKeys;
 };
@@ -1,6 +1,10 @@
 #include "Engine.hpp"
 
-#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+#include <string>
 
 Engine::~Engine() { shutdown(); }
 
@@ -10,13 +14,18 @@ bool Engine::init() {
   const int startW = 1600;
   const int startH = 1200;
 
+  // The log writer and workers start before anything else; SDL-bound work
+  // is queued with MainThread affinity and drained by run().
+  Log::init();
+  m_jobs.init();
+
   if (!m_window.init("evergreen", startW, startH)) {
     return false;
   }
 
   auto wh = m_window.win32Handles();
   if (!wh.hwnd || !wh.hinstance) {
-    std::cerr << "Engine: failed to get Win32 handles.\n";
+    Log::error("Engine: failed to get Win32 handles.");
     return false;
   }
 
@@ -29,7 +38,7 @@ bool Engine::init() {
   bool enableValidation = true;
 
   if (!m_renderer.init(wh, startW, startH, enableValidation)) {
-    std::cerr << "Engine: renderer init failed.\n";
+    Log::error("Engine: renderer init failed.");
     return false;
   }
 
@@ -37,39 +46,338 @@ bool Engine::init() {
 }
 
 void Engine::run() {
+  Profiler::setThreadName("Main");
+  m_renderThread.init(m_renderer, m_scene.get());
+  if (m_threadedRendering) {
+    m_renderThread.start();
+  }
+
   bool running = true;
+  m_allocationCount = HeapAllocationCount();
 
   while (running) {
+    // Nothing to show: sleep until the window comes back instead of
+    // spinning, and restart timing so the first frame back has a sane delta.
+    if (m_window.hidden()) {
+      m_window.waitForEvents(100);
+      running = m_window.pumpEvents();
+      handleResize();
+      m_previousTime = 0;
+      m_accumulator = 0.0;
+      m_pacer.reset();
+      continue;
+    }
+
+    Profiler::markFrame();
+    PROFILE_ZONE("Engine::run");
+
+    // Frame limiter first, so the waits below and input sampling happen as
+    // late as possible before recording.
+    {
+      PROFILE_ZONE("FramePacer::waitForNextFrame");
+      m_pacer.waitForNextFrame();
+    }
+
+    // Blocks while the render thread is still a full frame behind.
+    RenderSnapshot &snapshot = m_renderThread.beginSnapshot();
+
+    // Without a render thread, wait for a free frame slot before sampling
+    // input rather than after, so the recorded frame reflects the newest
+    // input. With one frame in flight this is what makes the low-latency
+    // mode low latency.
+    if (!m_renderThread.running()) {
+      m_renderer.waitForFrameSlot();
+    }
+
+    const uint64_t simulationStart = Profiler::now();
     running = m_window.pumpEvents();
+    m_jobs.runMainThreadJobs();
 
     tick();
+    handleInput();
+    snapshot.inputTime = std::chrono::steady_clock::now();
 
-    if (m_window.wasResized()) {
-      m_renderer.resize(m_window.width(), m_window.height());
-      m_scene.get()->resize(m_window.width(), m_window.height());
+    handleResize();
 
-      m_window.clearResizedFlag();
+    const float alpha = simulate();
+    m_scene.get()->update(m_renderer, m_jobs, alpha);
+
+    m_scene.get()->capture(snapshot);
+    snapshot.deltaTime = m_deltaTime;
+    snapshot.commands = std::move(m_renderCommands);
+    m_renderCommands.clear();
+    const uint64_t frame = snapshot.frame;
+    const uint64_t simulationNanoseconds = Profiler::now() - simulationStart;
+    m_renderThread.submitSnapshot();
+
+    recordTelemetry(frame, simulationNanoseconds);
+    reportAllocations();
+
+    if (m_threadedRendering != m_renderThread.running()) {
+      if (m_threadedRendering) {
+        m_renderThread.start();
+      } else {
+        m_renderThread.stop();
+      }
+      Log::info("Render thread: %s", m_threadedRendering ? "on" : "off");
     }
+  }
+
+  m_renderThread.stop();
+}
+
+bool Engine::enableTelemetry(const std::string &path, float hitchMultiple) {
+  if (!m_telemetry.open(path)) {
+    return false;
+  }
+
+  // Hitch traces need the zones from before the hitch was noticed.
+  m_telemetry.setHitchMultiple(hitchMultiple);
+  Profiler::setFlightRecorder(hitchMultiple > 0.0f);
+  return true;
+}
+
+void Engine::recordTelemetry(uint64_t frame, uint64_t simulationNanoseconds) {
+  // Traces at most this many hitches per run, so a bad run cannot fill the
+  // disk.
+  const uint32_t kMaxHitchTraces = 16;
+
+  // The hitch frame's render thread and GPU zones land a few frames after
+  // it was detected.
+  if (m_hitchTraceCountdown > 0 && --m_hitchTraceCountdown == 0) {
+    const std::string path =
+        "evergreen-hitch-" + std::to_string(m_hitchTraceFrame) + ".json";
+    const uint64_t begin = m_hitchTraceBegin;
+    const uint64_t end = Profiler::now();
+    m_jobs.run([path, begin, end] { Profiler::writeTrace(path, begin, end); });
+  }
+
+  if (!m_telemetry.opened()) {
+    return;
+  }
+
+  // With a render thread these describe the previous frame.
+  const Renderer::FrameStats stats = m_renderer.frameStats();
+
+  FrameTelemetry telemetry{};
+  telemetry.frame = frame;
+  telemetry.frameMilliseconds = m_deltaTime * 1000.0f;
+  telemetry.simulationMilliseconds = (float)simulationNanoseconds / 1.0e6f;
+  telemetry.renderMilliseconds = stats.renderMilliseconds;
+  telemetry.gpuMilliseconds = stats.gpuMilliseconds;
+  telemetry.waitMilliseconds = stats.waitMilliseconds;
+  telemetry.acquireMilliseconds = stats.acquireMilliseconds;
+  telemetry.drawCalls = stats.drawCalls;
+  telemetry.triangles = stats.triangles;
+  telemetry.gpuMemoryBytes = stats.gpuMemoryBytes;
+
+  const float median = m_telemetry.percentile(0.5f);
+  if (!m_telemetry.record(telemetry)) {
+    return;
+  }
+
+  Log::warning("Hitch: frame %llu took %g ms (median %g ms)",
+               (unsigned long long)frame, telemetry.frameMilliseconds, median);
+
+  if (m_hitchTraceCountdown == 0 && m_hitchTraceCount < kMaxHitchTraces) {
+    ++m_hitchTraceCount;
+    m_hitchTraceFrame = frame;
+    // From the end of the frame before, for context.
+    const uint64_t frameNanoseconds =
+        (uint64_t)((double)telemetry.frameMilliseconds * 1.0e6);
+    m_hitchTraceBegin = Profiler::now() - 2 * frameNanoseconds;
+    m_hitchTraceCountdown = MAX_FRAMES_IN_FLIGHT + 2;
+  }
+}
+
+void Engine::reportAllocations() {
+#ifndef NDEBUG
+  // Steady state should average zero; anything else is a per-frame
+  // allocation that belongs in a frame arena or a pool.
+  const uint32_t kReportFrames = 600;
+
+  if (++m_allocationFrames < kReportFrames) {
+    return;
+  }
+
+  const uint64_t count = HeapAllocationCount();
+  Log::info("Heap: %g allocations per frame",
+            (double)(count - m_allocationCount) / m_allocationFrames);
+  m_allocationCount = count;
+  m_allocationFrames = 0;
+#endif
+}
+
+void Engine::renderCommand(std::function<void(Renderer &)> command) {
+  m_renderCommands.push_back(std::move(command));
+}
 
-    m_renderer.update(m_deltaTime);
-    m_scene.get()->update(m_renderer, m_deltaTime);
+void Engine::handleResize() {
+  if (m_window.wasResized()) {
+    const int width = m_window.width();
+    const int height = m_window.height();
+    renderCommand([width, height](Renderer &renderer) {
+      renderer.resize(width, height);
+    });
+    m_scene.get()->resize(width, height);
 
-    m_renderer.drawFrame(m_scene.get());
+    m_window.clearResizedFlag();
   }
 }
 
 void Engine::tick() {
-  uint64_t now = SDL_GetTicks();
+  uint64_t now = FramePacer::now();
   if (m_previousTime == 0) {
     m_previousTime = now;
   }
-  m_deltaTime = float(now - m_previousTime) / 1000.0f;
+  m_deltaTime = float(double(now - m_previousTime) / 1.0e9);
   m_previousTime = now;
 }
 
+void Engine::setSimulationRate(uint32_t hz) {
+  m_simulationHz = std::max(hz, 1u);
+  m_accumulator = 0.0;
+}
+
+float Engine::simulate() {
+  PROFILE_ZONE("Engine::simulate");
+
+  // Caps the work a single slow frame can cause. Without it, a frame that
+  // takes longer than the steps it owes grows the debt every frame.
+  const int kMaxStepsPerFrame = 5;
+
+  const double step = 1.0 / (double)m_simulationHz;
+  m_accumulator += m_deltaTime;
+
+  int steps = 0;
+  while (m_accumulator >= step && steps < kMaxStepsPerFrame) {
+    m_scene.get()->simulate((float)step);
+    m_accumulator -= step;
+    ++steps;
+  }
+
+  // Over the cap the simulation falls behind wall time rather than spiral.
+  if (m_accumulator >= step) {
+    m_accumulator = std::fmod(m_accumulator, step);
+  }
+
+  return (float)(m_accumulator / step);
+}
+
+void Engine::handleInput() {
+  // Renderer settings are changed on whichever thread renders, through
+  // commands carried by the next snapshot.
+
+  // F1: fixed-function vertex input <-> storage buffer vertex pulling.
+  if (m_window.keyPressed(SDLK_F1)) {
+    renderCommand([](Renderer &renderer) {
+      renderer.setVertexPulling(!renderer.vertexPulling());
+    });
+  }
+
+  // F2: single pass (LESS) <-> depth pre-pass + EQUAL shading pass.
+  if (m_window.keyPressed(SDLK_F2)) {
+    renderCommand([](Renderer &renderer) {
+      renderer.setDepthPrepass(!renderer.depthPrepass());
+    });
+  }
+
+  // F3: cycle anti-aliasing off -> MSAA 2x/4x/8x -> TAA, skipping levels the
+  // device does not support.
+  if (m_window.keyPressed(SDLK_F3)) {
+    renderCommand([](Renderer &renderer) {
+      AntiAliasing antiAliasing = renderer.antiAliasing();
+      do {
+        antiAliasing = (AntiAliasing)((antiAliasing + 1) % AntiAliasingCount);
+      } while (!renderer.antiAliasingSupported(antiAliasing));
+
+      renderer.setAntiAliasing(antiAliasing);
+    });
+  }
+
+  // F4: native resolution <-> GPU-time driven render scale plus upscale.
+  if (m_window.keyPressed(SDLK_F4)) {
+    renderCommand([](Renderer &renderer) {
+      renderer.setDynamicResolution(!renderer.dynamicResolution());
+    });
+  }
+
+  // F5: dynamic rendering <-> VkRenderPass/framebuffer main pass.
+  if (m_window.keyPressed(SDLK_F5)) {
+    renderCommand([](Renderer &renderer) {
+      renderer.setDynamicRendering(!renderer.dynamicRendering());
+    });
+  }
+
+  // F6: cycle latency mode: low latency -> balanced -> throughput.
+  if (m_window.keyPressed(SDLK_F6)) {
+    renderCommand([](Renderer &renderer) {
+      renderer.setLatencyMode(
+          (LatencyMode)((renderer.latencyMode() + 1) % LatencyModeCount));
+    });
+  }
+
+  // F7: cycle present policy: vsync (FIFO) -> MAILBOX -> IMMEDIATE.
+  if (m_window.keyPressed(SDLK_F7)) {
+    renderCommand([](Renderer &renderer) {
+      renderer.setPresentPolicy(
+          (PresentPolicy)((renderer.presentPolicy() + 1) % PresentPolicyCount));
+    });
+  }
+
+  // F8: cycle the frame limiter: off -> 30 -> 60 -> 120 FPS.
+  if (m_window.keyPressed(SDLK_F8)) {
+    static const uint32_t kTargetFps[] = {0, 30, 60, 120};
+    size_t next = 0;
+    for (size_t i = 0; i < std::size(kTargetFps); ++i) {
+      if (kTargetFps[i] == m_pacer.targetFps()) {
+        next = (i + 1) % std::size(kTargetFps);
+      }
+    }
+    m_pacer.setTargetFps(kTargetFps[next]);
+    if (kTargetFps[next]) {
+      Log::info("Frame limiter: %u FPS", kTargetFps[next]);
+    } else {
+      Log::info("Frame limiter: off");
+    }
+  }
+
+  // F9: render thread (simulation of frame N+1 overlaps recording of N) <->
+  // update and render on the main thread.
+  if (m_window.keyPressed(SDLK_F9)) {
+    m_threadedRendering = !m_threadedRendering;
+  }
+
+  // F10: capture the next frames to a Chrome trace (chrome://tracing or
+  // ui.perfetto.dev).
+  if (m_window.keyPressed(SDLK_F10)) {
+    Profiler::beginCapture(Profiler::kDefaultCaptureFrames,
+                           "evergreen-trace-" +
+                               std::to_string(++m_captureCount) + ".json");
+  }
+
+  // F11: CPU occlusion culling on <-> off. Culling runs in Scene::update()
+  // on this thread, so no render command is needed.
+  if (m_window.keyPressed(SDLK_F11) && m_scene) {
+    m_scene->setOcclusionCulling(!m_scene->occlusionCulling());
+    Log::info("Occlusion culling: %s",
+              m_scene->occlusionCulling() ? "on" : "off");
+  }
+}
+
 void Engine::shutdown() {
+  // The render thread and jobs may still reference the scene or renderer;
+  // finish them first.
+  m_renderThread.stop();
+  m_jobs.shutdown();
+
   // Order matters, scene depends on renderer, and renderer depends on window.
-  m_scene.get()->shutdown();
+  if (m_scene) {
+    m_scene->shutdown(m_renderer);
+  }
   m_renderer.shutdown();
   m_window.shutdown();
+
+  // Last, so everything above can still log.
+  Log::shutdown();
 }
@@ -1,10 +1,21 @@
 #pragma once
 
+#include "Jobs.hpp"
+#include "Log.hpp"
+#include "Memory.hpp"
+#include "Pacing.hpp"
+#include "Profiler.hpp"
+#include "RenderThread.hpp"
 #include "Renderer.hpp"
 #include "Scene.hpp"
+#include "Telemetry.hpp"
 #include "Window.hpp"
 
+#include <functional>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 class Engine {
 public:
@@ -16,24 +27,66 @@ public:
 
   bool init();
 
-  void loadScene(Scene scene) { m_scene = std::make_unique<Scene>(scene); };
+  void loadScene(Scene scene) {
+    m_scene = std::make_unique<Scene>(std::move(scene));
+  };
   void run();
 
   void shutdown();
 
   float deltaTime() { return m_deltaTime; };
 
+  // Simulation runs in fixed steps of 1 / hz seconds, independent of the
+  // frame rate; rendering interpolates between the last two steps.
+  void setSimulationRate(uint32_t hz);
+
+  // Streams per-frame stats as JSON lines to path and, unless hitchMultiple
+  // is 0, writes a trace of every frame slower than hitchMultiple x the
+  // median.
+  bool enableTelemetry(const std::string &path, float hitchMultiple);
+  uint32_t simulationRate() { return m_simulationHz; };
+
+  JobSystem &jobs() { return m_jobs; };
   Window &window() { return m_window; };
   Renderer &renderer() { return m_renderer; };
   Scene *scene() { return m_scene.get(); };
 
 private:
-  uint64_t m_previousTime = 0;
+  uint64_t m_previousTime = 0; // nanoseconds
   float m_deltaTime = 0;
 
+  uint32_t m_captureCount = 0;
+
+  Telemetry m_telemetry;
+  uint32_t m_hitchTraceCount = 0;
+  uint32_t m_hitchTraceCountdown = 0; // frames until the pending trace
+  uint64_t m_hitchTraceFrame = 0;
+  uint64_t m_hitchTraceBegin = 0;
+
+  // Debug builds: heap allocations since the last report, every thread.
+  uint64_t m_allocationCount = 0;
+  uint32_t m_allocationFrames = 0;
+
+  uint32_t m_simulationHz = 60;
+  double m_accumulator = 0.0; // seconds of simulation owed
+
+  FramePacer m_pacer;
+  JobSystem m_jobs;
+  RenderThread m_renderThread;
+  bool m_threadedRendering = true;
+  // Renderer changes queued by input handling for the next snapshot.
+  std::vector<std::function<void(Renderer &)>> m_renderCommands;
   Window m_window;
   Renderer m_renderer;
   std::unique_ptr<Scene> m_scene;
 
   void tick();
+  // Runs the fixed steps owed for this frame; returns the interpolation
+  // factor between the last two.
+  float simulate();
+  void handleInput();
+  void handleResize();
+  void recordTelemetry(uint64_t frame, uint64_t simulationNanoseconds);
+  void reportAllocations();
+  void renderCommand(std::function<void(Renderer &)> command);
 };
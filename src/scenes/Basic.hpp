@@ -6,6 +6,8 @@
 #include "../engine/Cube.hpp"
 #include "../engine/Dimensions.hpp"
 #include "../engine/Loader.hpp"
+#include "../engine/Log.hpp"
+#include "../engine/Pipeline.hpp"
 #include "../engine/Renderer.hpp"
 #include "../engine/Scene.hpp"
 
@@ -61,11 +63,11 @@ void createDescriptorPool(Renderer &renderer, Scene *scene) {
 
   VkDescriptorPoolSize descriptorPoolSize{};
   descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  descriptorPoolSize.descriptorCount = FRAME_COUNT;
+  descriptorPoolSize.descriptorCount = MAX_FRAMES_IN_FLIGHT;
 
   VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{
       VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
-  descriptorPoolCreateInfo.maxSets = FRAME_COUNT;
+  descriptorPoolCreateInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
   descriptorPoolCreateInfo.poolSizeCount = 1;
   descriptorPoolCreateInfo.pPoolSizes = &descriptorPoolSize;
 
@@ -76,15 +78,15 @@ void createDescriptorPool(Renderer &renderer, Scene *scene) {
     std::abort();
   }
 
-  std::array<VkDescriptorSetLayout, FRAME_COUNT> descriptorSetLayouts;
-  for (int i = 0; i < FRAME_COUNT; ++i) {
+  std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> descriptorSetLayouts;
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
     descriptorSetLayouts[i] = *descriptorSetLayout;
   }
 
   VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{
       VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
   descriptorSetAllocateInfo.descriptorPool = *descriptorPool;
-  descriptorSetAllocateInfo.descriptorSetCount = FRAME_COUNT;
+  descriptorSetAllocateInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
   descriptorSetAllocateInfo.pSetLayouts = descriptorSetLayouts.data();
 
   if (vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo,
@@ -99,14 +101,22 @@ void createPipeline(Renderer &renderer, Scene *scene) {
 
   auto pipelineLayout = scene->pipelineLayout();
   auto pipeline = scene->pipeline();
+  auto pulledPipeline = scene->pulledPipeline();
+  auto depthPipeline = scene->depthPipeline();
+  auto pulledDepthPipeline = scene->pulledDepthPipeline();
+  auto shadowPipeline = scene->shadowPipeline();
+  auto pulledShadowPipeline = scene->pulledShadowPipeline();
 
   auto descriptorSetLayout = scene->descriptorSetLayout();
-
-  auto vertexCollector = basicVertexCollector();
-
-  if (*pipeline) {
-    vkDestroyPipeline(device, *pipeline, nullptr);
-    *pipeline = VK_NULL_HANDLE;
+  auto geometrySetLayout = scene->geometry()->descriptorSetLayout();
+
+  for (VkPipeline *p : {pipeline, pulledPipeline, depthPipeline,
+                        pulledDepthPipeline, shadowPipeline,
+                        pulledShadowPipeline}) {
+    if (*p) {
+      vkDestroyPipeline(device, *p, nullptr);
+      *p = VK_NULL_HANDLE;
+    }
   }
 
   if (*pipelineLayout) {
@@ -114,43 +124,6 @@ void createPipeline(Renderer &renderer, Scene *scene) {
     *pipelineLayout = VK_NULL_HANDLE;
   }
 
-  std::vector<char> vsBytes;
-  std::vector<char> fsBytes;
-
-  if (!ReadFileBytes("shaders/test.vert.spv", vsBytes)) {
-    std::cerr << "Missing vertex shader shaders/test.vert.spv" << std::endl;
-    std::abort();
-  }
-
-  if (!ReadFileBytes("shaders/test.frag.spv", fsBytes)) {
-    std::cerr << "Missing fragment shader shaders/test.frag.spv" << std::endl;
-    std::abort();
-  }
-
-  VkShaderModule vs = CreateShaderModule(device, vsBytes);
-  if (!vs) {
-    std::cerr << "Failed to create vertex shader module" << std::endl;
-    std::abort();
-  }
-
-  VkShaderModule fs = CreateShaderModule(device, fsBytes);
-  if (!fs) {
-    std::cerr << "Failed to create fragment shader module" << std::endl;
-    std::abort();
-  }
-
-  VkPipelineShaderStageCreateInfo pipelineShaderStageCreateInfo[2]{};
-  pipelineShaderStageCreateInfo[0].sType =
-      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  pipelineShaderStageCreateInfo[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-  pipelineShaderStageCreateInfo[0].module = vs;
-  pipelineShaderStageCreateInfo[0].pName = "main";
-  pipelineShaderStageCreateInfo[1].sType =
-      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  pipelineShaderStageCreateInfo[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  pipelineShaderStageCreateInfo[1].module = fs;
-  pipelineShaderStageCreateInfo[1].pName = "main";
-
   // Vertex input
   VkVertexInputBindingDescription vertexInputBindingDescription{};
   vertexInputBindingDescription.binding = 0;
@@ -186,124 +159,139 @@ void createPipeline(Renderer &renderer, Scene *scene) {
   pipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions =
       vertexInputAttributeDescription;
 
-  VkPipelineInputAssemblyStateCreateInfo pipelineInputAsseblyStateCreateInfo{
-      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
-  pipelineInputAsseblyStateCreateInfo.topology =
-      VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-  pipelineInputAsseblyStateCreateInfo.primitiveRestartEnable = VK_FALSE;
-
-  VkPipelineViewportStateCreateInfo pipelineViewportStateCreateInfo{
-      VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
-  pipelineViewportStateCreateInfo.viewportCount = 1;
-  pipelineViewportStateCreateInfo.scissorCount = 1;
-
-  VkPipelineRasterizationStateCreateInfo pipelineRasterizationStateCreateInfo{
-      VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
-  pipelineRasterizationStateCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
-  pipelineRasterizationStateCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-  pipelineRasterizationStateCreateInfo.frontFace =
-      VK_FRONT_FACE_COUNTER_CLOCKWISE;
-  pipelineRasterizationStateCreateInfo.lineWidth = 1.0f;
-  pipelineRasterizationStateCreateInfo.cullMode = VK_CULL_MODE_NONE;
-
-  VkPipelineMultisampleStateCreateInfo pipelineMultisampleStateCreateInfo{
-      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
-  pipelineMultisampleStateCreateInfo.rasterizationSamples =
-      renderer.sampleCount();
-
-  VkPipelineDepthStencilStateCreateInfo pipelineDepthStencilStateCreateInfo{
-      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
-  pipelineDepthStencilStateCreateInfo.depthTestEnable = VK_TRUE;
-  pipelineDepthStencilStateCreateInfo.depthWriteEnable = VK_TRUE;
-  pipelineDepthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
-
-  VkPipelineColorBlendAttachmentState pipelineColorBlendAttachmentState{};
-  pipelineColorBlendAttachmentState.colorWriteMask =
-      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-  pipelineColorBlendAttachmentState.blendEnable = VK_FALSE;
-
-  VkPipelineColorBlendStateCreateInfo pipelineColorBlendStateCreateInfo{
-      VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
-  pipelineColorBlendStateCreateInfo.attachmentCount = 1;
-  pipelineColorBlendStateCreateInfo.pAttachments =
-      &pipelineColorBlendAttachmentState;
-
-  VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT,
-                                    VK_DYNAMIC_STATE_SCISSOR};
-  VkPipelineDynamicStateCreateInfo pipelineDynamicStateCreateInfo{
-      VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
-  pipelineDynamicStateCreateInfo.dynamicStateCount = 2;
-  pipelineDynamicStateCreateInfo.pDynamicStates = dynamicStates;
-
-  // Push constant = model matrix.
+  // Depth pre-pass and shadow casters only read position.
+  VkPipelineVertexInputStateCreateInfo depthVertexInputStateCreateInfo =
+      pipelineVertexInputStateCreateInfo;
+  depthVertexInputStateCreateInfo.vertexAttributeDescriptionCount = 1;
+
+  // Push constant = model matrix + shadow cascade.
   VkPushConstantRange pushConstantRange{};
   pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
   pushConstantRange.offset = 0;
-  pushConstantRange.size = sizeof(Mat4);
+  pushConstantRange.size = sizeof(DrawPush);
 
   if (*descriptorSetLayout == VK_NULL_HANDLE) {
-    std::cerr << "createPipeline: m_setLayoutFrame is VK_NULL_HANDLE "
-                 "(descriptor set layout missing)\n";
+    Log::error("createPipeline: m_setLayoutFrame is VK_NULL_HANDLE "
+               "(descriptor set layout missing)");
   }
 
+  // Set 0 = per-frame camera, set 1 = pulled geometry, set 2 = clustered
+  // lights, set 3 = shadow cascades.
+  VkDescriptorSetLayout setLayouts[] = {
+      *descriptorSetLayout, *geometrySetLayout, renderer.lightingSetLayout(),
+      renderer.shadowSetLayout()};
+
   VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{
       VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
-  pipelineLayoutCreateInfo.setLayoutCount = 1;
-  pipelineLayoutCreateInfo.pSetLayouts = descriptorSetLayout;
+  pipelineLayoutCreateInfo.setLayoutCount = 4;
+  pipelineLayoutCreateInfo.pSetLayouts = setLayouts;
   pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
   pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
   if (vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr,
                              pipelineLayout) != VK_SUCCESS) {
     std::cerr << "vkCreatePipelineLayout failed\n";
-    vkDestroyShaderModule(device, vs, nullptr);
-    vkDestroyShaderModule(device, fs, nullptr);
     std::abort();
   }
 
-  VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo{};
-  graphicsPipelineCreateInfo.sType =
-      VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  graphicsPipelineCreateInfo.pNext = nullptr;
+  GraphicsPipelineDescription graphicsPipelineDescription{};
+  graphicsPipelineDescription.vertexShader = "shaders/test.vert.spv";
+  graphicsPipelineDescription.fragmentShader = "shaders/test.frag.spv";
+  graphicsPipelineDescription.vertexInput =
+      &pipelineVertexInputStateCreateInfo;
+  graphicsPipelineDescription.layout = *pipelineLayout;
+  graphicsPipelineDescription.renderPass = renderer.renderPass();
+  graphicsPipelineDescription.subpass = renderer.mainSubpass();
+  graphicsPipelineDescription.samples = renderer.sampleCount();
+  graphicsPipelineDescription.colorAttachmentCount =
+      renderer.colorAttachmentCount();
+  for (uint32_t i = 0; i < renderer.colorAttachmentCount(); ++i) {
+    graphicsPipelineDescription.colorFormats[i] =
+        renderer.colorAttachmentFormat(i);
+  }
+  graphicsPipelineDescription.depthFormat = renderer.depthFormat();
+
+  if (renderer.depthPrepass()) {
+    // Depth is already final; shade only the visible fragment.
+    graphicsPipelineDescription.depthWrite = false;
+    graphicsPipelineDescription.depthCompareOp = VK_COMPARE_OP_EQUAL;
+  }
 
-  graphicsPipelineCreateInfo.stageCount = 2;
-  graphicsPipelineCreateInfo.pStages = pipelineShaderStageCreateInfo;
+  *pipeline = CreateGraphicsPipeline(device, graphicsPipelineDescription);
+  if (!*pipeline) {
+    std::abort();
+  }
 
-  graphicsPipelineCreateInfo.pVertexInputState =
-      &pipelineVertexInputStateCreateInfo;
-  graphicsPipelineCreateInfo.pInputAssemblyState =
-      &pipelineInputAsseblyStateCreateInfo;
-  graphicsPipelineCreateInfo.pViewportState = &pipelineViewportStateCreateInfo;
-  graphicsPipelineCreateInfo.pRasterizationState =
-      &pipelineRasterizationStateCreateInfo;
-  graphicsPipelineCreateInfo.pMultisampleState =
-      &pipelineMultisampleStateCreateInfo;
-  graphicsPipelineCreateInfo.pDepthStencilState =
-      &pipelineDepthStencilStateCreateInfo;
-  graphicsPipelineCreateInfo.pColorBlendState =
-      &pipelineColorBlendStateCreateInfo;
-  graphicsPipelineCreateInfo.pDynamicState = &pipelineDynamicStateCreateInfo;
-
-  graphicsPipelineCreateInfo.layout = *pipelineLayout;
-  graphicsPipelineCreateInfo.renderPass = renderer.renderPass();
-  graphicsPipelineCreateInfo.subpass = 0;
-
-  // Optional but commonly set:
-  graphicsPipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
-  graphicsPipelineCreateInfo.basePipelineIndex = -1;
-
-  if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1,
-                                &graphicsPipelineCreateInfo, nullptr,
-                                pipeline) != VK_SUCCESS) {
-    vkDestroyShaderModule(device, vs, nullptr);
-    vkDestroyShaderModule(device, fs, nullptr);
-    std::cerr << "vkCreateGraphicsPipelines failed\n";
+  // Same shading, but no fixed-function vertex input.
+  graphicsPipelineDescription.vertexShader = "shaders/pull.vert.spv";
+  graphicsPipelineDescription.vertexInput = nullptr;
+
+  *pulledPipeline = CreateGraphicsPipeline(device, graphicsPipelineDescription);
+  if (!*pulledPipeline) {
     std::abort();
   }
 
-  vkDestroyShaderModule(device, vs, nullptr);
-  vkDestroyShaderModule(device, fs, nullptr);
+  GraphicsPipelineDescription shadowPipelineDescription{};
+  shadowPipelineDescription.vertexShader = "shaders/shadow.vert.spv";
+  shadowPipelineDescription.fragmentShader = nullptr;
+  shadowPipelineDescription.vertexInput = &depthVertexInputStateCreateInfo;
+  shadowPipelineDescription.layout = *pipelineLayout;
+  shadowPipelineDescription.renderPass = renderer.shadowRenderPass();
+  shadowPipelineDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+  // Cube faces are closed, so both sides cast; bias hides the acne instead.
+  shadowPipelineDescription.depthBiasConstant = 1.25f;
+  shadowPipelineDescription.depthBiasSlope = 1.75f;
+
+  *shadowPipeline = CreateGraphicsPipeline(device, shadowPipelineDescription);
+  if (!*shadowPipeline) {
+    std::abort();
+  }
+
+  shadowPipelineDescription.vertexShader = "shaders/shadow_pull.vert.spv";
+  shadowPipelineDescription.vertexInput = nullptr;
+
+  *pulledShadowPipeline =
+      CreateGraphicsPipeline(device, shadowPipelineDescription);
+  if (!*pulledShadowPipeline) {
+    std::abort();
+  }
+
+  if (!renderer.depthPrepass()) {
+    return;
+  }
+
+  GraphicsPipelineDescription depthPipelineDescription{};
+  depthPipelineDescription.vertexShader = "shaders/depth.vert.spv";
+  depthPipelineDescription.fragmentShader = nullptr;
+  depthPipelineDescription.vertexInput = &depthVertexInputStateCreateInfo;
+  depthPipelineDescription.layout = *pipelineLayout;
+  depthPipelineDescription.renderPass = renderer.renderPass();
+  depthPipelineDescription.subpass = 0;
+  depthPipelineDescription.samples = renderer.sampleCount();
+  // Only used by dynamic rendering, where pre-pass and shading share one
+  // rendering scope.
+  depthPipelineDescription.colorAttachmentCount =
+      renderer.colorAttachmentCount();
+  for (uint32_t i = 0; i < renderer.colorAttachmentCount(); ++i) {
+    depthPipelineDescription.colorFormats[i] =
+        renderer.colorAttachmentFormat(i);
+  }
+  depthPipelineDescription.depthFormat = renderer.depthFormat();
+
+  *depthPipeline = CreateGraphicsPipeline(device, depthPipelineDescription);
+  if (!*depthPipeline) {
+    std::abort();
+  }
+
+  // pull.vert writes the same invariant position; its varyings go unused.
+  depthPipelineDescription.vertexShader = "shaders/pull.vert.spv";
+  depthPipelineDescription.vertexInput = nullptr;
+
+  *pulledDepthPipeline =
+      CreateGraphicsPipeline(device, depthPipelineDescription);
+  if (!*pulledDepthPipeline) {
+    std::abort();
+  }
 }
 
 void destroyPipeline(Renderer &renderer, Scene *scene) {
@@ -311,17 +299,24 @@ void destroyPipeline(Renderer &renderer, Scene *scene) {
 
   auto pipelineLayout = scene->pipelineLayout();
   auto pipeline = scene->pipeline();
-
-  auto descriptorSetLayout = scene->descriptorSetLayout();
+  auto pulledPipeline = scene->pulledPipeline();
+  auto depthPipeline = scene->depthPipeline();
+  auto pulledDepthPipeline = scene->pulledDepthPipeline();
+  auto shadowPipeline = scene->shadowPipeline();
+  auto pulledShadowPipeline = scene->pulledShadowPipeline();
 
   if (!device) {
     return;
   }
 
-  // Destroy old pipeline and layout if rebuilding (swapchain resize).
-  if (*pipeline) {
-    vkDestroyPipeline(device, *pipeline, nullptr);
-    *pipeline = VK_NULL_HANDLE;
+  // Destroy old pipelines and layout if rebuilding (swapchain resize).
+  for (VkPipeline *p : {pipeline, pulledPipeline, depthPipeline,
+                        pulledDepthPipeline, shadowPipeline,
+                        pulledShadowPipeline}) {
+    if (*p) {
+      vkDestroyPipeline(device, *p, nullptr);
+      *p = VK_NULL_HANDLE;
+    }
   }
 
   if (*pipelineLayout) {
@@ -339,7 +334,7 @@ void createUniformBuffers(Renderer &renderer, Scene *scene) {
 
   auto descriptorSets = scene->descriptorSets();
 
-  for (int i = 0; i < FRAME_COUNT; ++i) {
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
     if (!CreateBuffer(renderer.physicalDevice(), device, sizeof(CameraUBO),
                       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
@@ -372,17 +367,45 @@ void createUniformBuffers(Renderer &renderer, Scene *scene) {
   }
 }
 
-std::vector<Model> createModels(Renderer &renderer) {
+void createLights(Scene *scene) {
+  // A ring of point lights around the cube plus a few spots from above; the
+  // clustered pass keeps per-pixel cost bounded regardless of the count.
+  const int pointCount = 240;
+  for (int i = 0; i < pointCount; ++i) {
+    float t = (float)i / (float)pointCount;
+    float angle = t * 6.28318530f * 3.0f;
+    float radius = 2.0f + 6.0f * t;
+    Vec3 position{radius * std::cos(angle), -1.5f + 3.0f * t,
+                  radius * std::sin(angle)};
+    Vec3 color{0.5f + 0.5f * std::cos(angle),
+               0.5f + 0.5f * std::cos(angle + 2.094f),
+               0.5f + 0.5f * std::cos(angle + 4.188f)};
+
+    scene->addLight(MakePointLight(position, 1.5f, color, 2.0f));
+  }
+
+  const int spotCount = 16;
+  for (int i = 0; i < spotCount; ++i) {
+    float angle = (float)i / (float)spotCount * 6.28318530f;
+    Vec3 position{3.0f * std::cos(angle), 4.0f, 3.0f * std::sin(angle)};
+    Vec3 direction = sub(Vec3{0.0f, 0.0f, 0.0f}, position);
+
+    scene->addLight(MakeSpotLight(position, direction, 8.0f, 0.2f, 0.35f,
+                                  {1.0f, 0.9f, 0.7f}, 4.0f));
+  }
+}
+
+std::vector<Model> createModels(Renderer &renderer, Scene *scene) {
   auto vertexCollector = basicVertexCollector();
   GenerateCube(&vertexCollector);
 
-  auto model = vertexCollector.buildModel(renderer);
+  auto model = vertexCollector.buildModel(renderer, scene->geometry());
 
   std::vector<Model> models = {model};
   return models;
 }
 
-Scene LoadScene(Renderer &renderer) {
+Scene LoadScene(Renderer &renderer, JobSystem &jobs) {
   Scene scene;
 
   // First create descriptors.
@@ -392,15 +415,25 @@ Scene LoadScene(Renderer &renderer) {
   // Next create uniform buffers.
   createUniformBuffers(renderer, &scene);
 
-  // Next create model.
-  auto models = createModels(renderer);
+  // Next create shared geometry storage (vertex pulling) and model.
+  scene.geometry()->init(renderer, 1u << 22, 1u << 22);
+  auto models = createModels(renderer, &scene);
 
   // Finally create Camera.
   auto camera = createCamera(renderer.dimensions());
 
-  scene.init(renderer, camera, models, createPipeline, destroyPipeline);
+  scene.init(renderer, camera, std::move(models), createPipeline,
+             destroyPipeline);
+
+  createLights(&scene);
 
-  // loadModel("./assets/model/chair/chair.glb");
+  // Imported next to the cube when the asset is there.
+  const uint32_t chair =
+      loadModel(renderer, jobs, scene, "./assets/model/chair/chair.glb",
+                basicVertexCollector());
+  if (chair != TransformHierarchy::kNoParent) {
+    scene.transforms().setPosition(chair, {2.5f, -1.0f, 0.0f});
+  }
 
   return scene;
 }
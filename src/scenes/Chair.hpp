@@ -12,7 +12,7 @@
 #include <memory>
 #include <vector>
 
-Scene LoadScene(Renderer &renderer) {
+Scene LoadScene(Renderer &renderer, JobSystem &jobs) {
   Scene scene;
 
   //   // First create descriptors
@@ -33,7 +33,9 @@ Scene LoadScene(Renderer &renderer) {
   //   scene.init(renderer, camera, renderables, createPipeline,
   //   destroyPipeline);
 
-  loadModel("./assets/model/chair/chair.glb");
+  scene.geometry()->init(renderer, 1u << 22, 1u << 22);
+  loadModel(renderer, jobs, scene, "./assets/model/chair/chair.glb",
+            VertexCollector({Position, Normal, Color}));
 
   return scene;
 }